@@ -23,11 +23,56 @@ namespace KAA
 			return IDecryptFile(path);
 		}
 
+		std::vector<file_result_t> Communicator::EncryptFiles(const std::vector<filesystem::path::file>& paths)
+		{
+			return IEncryptFiles(paths);
+		}
+
+		std::vector<file_result_t> Communicator::DecryptFiles(const std::vector<filesystem::path::file>& paths)
+		{
+			return IDecryptFiles(paths);
+		}
+
+		std::vector<file_result_t> Communicator::EncryptDirectory(const filesystem::path::directory& path)
+		{
+			return IEncryptDirectory(path);
+		}
+
+		std::vector<file_result_t> Communicator::DecryptDirectory(const filesystem::path::directory& path)
+		{
+			return IDecryptDirectory(path);
+		}
+
 		bool Communicator::IsFileEncrypted(const filesystem::path::file& path) const
 		{
 			return IIsFileEncrypted(path);
 		}
 
+		std::shared_ptr<batch_operation_t> Communicator::StartEncryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return IStartEncryptFiles(paths, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> Communicator::StartDecryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return IStartDecryptFiles(paths, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> Communicator::StartEncryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return IStartEncryptDirectory(path, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> Communicator::StartDecryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return IStartDecryptDirectory(path, std::move(handler));
+		}
+
+		std::shared_ptr<query_operation_t> Communicator::StartIsFileEncrypted(const filesystem::path::file& path)
+		{
+			return IStartIsFileEncrypted(path);
+		}
+
 		std::vector<std::pair<std::wstring, core_id>> Communicator::GetAvailableCiphers(void) const
 		{
 			return IGetAvailableCiphers();
@@ -17,6 +17,7 @@
 #include "KAA/include/filesystem/path.h"
 
 #include "Features.h"
+#include "Operation.h"
 
 namespace KAA
 {
@@ -24,6 +25,26 @@ namespace KAA
 	{
 		class CommunicatorProgressHandler;
 
+		// NOTE: outcome of a file of a batch operation.
+		enum class file_status_t
+		{
+			succeeded,
+			failed,
+			skipped, // KAA: not processed: the file is encrypted already, or plain when decrypting.
+			stopped // KAA: not processed, the operation has been stopped before the file.
+		};
+
+		// NOTE: failure holds the system message of the error of a failed file, it is empty otherwise.
+		struct file_result_t
+		{
+			filesystem::path::file path;
+			file_status_t status;
+			std::string failure;
+		};
+
+		typedef Operation<std::vector<file_result_t>> batch_operation_t;
+		typedef Operation<bool> query_operation_t;
+
 		// FUTURE: KAA: try to separate progress handling from classes (looks like SRP violation).
 		class Communicator
 		{
@@ -33,8 +54,27 @@ namespace KAA
 			void EncryptFile(const filesystem::path::file&);
 			void DecryptFile(const filesystem::path::file&);
 
+			// NOTE: one operation for all the files, a failed file does not stop the rest.
+			// RETURNS: a result per file, in order.
+			std::vector<file_result_t> EncryptFiles(const std::vector<filesystem::path::file>&);
+			std::vector<file_result_t> DecryptFiles(const std::vector<filesystem::path::file>&);
+
+			// NOTE: every file of the directory tree, several at once; the key storage is left out. Links to directories are not followed.
+			// RETURNS: a result per file (and per directory that could not be listed), ordered by path.
+			std::vector<file_result_t> EncryptDirectory(const filesystem::path::directory&);
+			std::vector<file_result_t> DecryptDirectory(const filesystem::path::directory&);
+
 			bool IsFileEncrypted(const filesystem::path::file&) const;
 
+			// NOTE: asynchronous forms: return at once, the operation runs on the executor of the communicator and reports to its own progress handler (optional).
+			// Operations changing files run one at a time in the order started. A status query does not wait for the queued ones,
+			// but it does wait for the one running: that operation holds the core until it is done.
+			std::shared_ptr<batch_operation_t> StartEncryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>);
+			std::shared_ptr<batch_operation_t> StartDecryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>);
+			std::shared_ptr<batch_operation_t> StartEncryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>);
+			std::shared_ptr<batch_operation_t> StartDecryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>);
+			std::shared_ptr<query_operation_t> StartIsFileEncrypted(const filesystem::path::file&);
+
 			std::vector<std::pair<std::wstring, core_id>> GetAvailableCiphers(void) const;
 			core_id GetCipher(void) const;
 			void SetCipher(core_id);
@@ -52,8 +92,20 @@ namespace KAA
 			virtual void IEncryptFile(const filesystem::path::file&) = 0;
 			virtual void IDecryptFile(const filesystem::path::file&) = 0;
 
+			virtual std::vector<file_result_t> IEncryptFiles(const std::vector<filesystem::path::file>&) = 0;
+			virtual std::vector<file_result_t> IDecryptFiles(const std::vector<filesystem::path::file>&) = 0;
+
+			virtual std::vector<file_result_t> IEncryptDirectory(const filesystem::path::directory&) = 0;
+			virtual std::vector<file_result_t> IDecryptDirectory(const filesystem::path::directory&) = 0;
+
 			virtual bool IIsFileEncrypted(const filesystem::path::file&) const = 0;
 
+			virtual std::shared_ptr<batch_operation_t> IStartEncryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) = 0;
+			virtual std::shared_ptr<batch_operation_t> IStartDecryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) = 0;
+			virtual std::shared_ptr<batch_operation_t> IStartEncryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) = 0;
+			virtual std::shared_ptr<batch_operation_t> IStartDecryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) = 0;
+			virtual std::shared_ptr<query_operation_t> IStartIsFileEncrypted(const filesystem::path::file&) = 0;
+
 			virtual std::vector<std::pair<std::wstring, core_id>> IGetAvailableCiphers(void) const = 0;
 			virtual core_id IGetCipher(void) const = 0;
 			virtual void ISetCipher(core_id) = 0;
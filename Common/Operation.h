@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <future>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: handle of an operation started by a communicator: poll it, wait for it or cancel it.
+		// A cancelled operation stops within a progress interval and keeps the results it has got so far;
+		// one cancelled before it has started fails instead.
+		template <typename result_t>
+		class Operation final
+		{
+		public:
+			Operation() :
+			result(completion.get_future().share()),
+			cancelled(false)
+			{}
+
+			Operation(const Operation&) = delete;
+			Operation(Operation&&) = delete;
+			~Operation() = default;
+
+			Operation& operator = (const Operation&) = delete;
+			Operation& operator = (Operation&&) = delete;
+
+			bool IsFinished(void) const
+			{
+				return std::future_status::ready == result.wait_for(std::chrono::seconds(0));
+			}
+
+			void Wait(void) const
+			{
+				result.wait();
+			}
+
+			// RETURNS: true if the operation has finished in time.
+			bool WaitFor(const std::chrono::milliseconds timeout) const
+			{
+				return std::future_status::ready == result.wait_for(timeout);
+			}
+
+			void Cancel(void)
+			{
+				cancelled = true;
+			}
+
+			bool IsCancelled(void) const
+			{
+				return cancelled;
+			}
+
+			// NOTE: waits for the operation, rethrows its failure.
+			result_t GetResult(void) const
+			{
+				return result.get();
+			}
+
+			// NOTE: called by the communicator, once.
+			void Complete(result_t value)
+			{
+				completion.set_value(std::move(value));
+			}
+
+			void Fail(std::exception_ptr failure)
+			{
+				completion.set_exception(std::move(failure));
+			}
+
+		private:
+			std::promise<result_t> completion;
+			std::shared_future<result_t> result;
+			std::atomic<bool> cancelled;
+		};
+	}
+}
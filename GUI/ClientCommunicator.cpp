@@ -54,6 +54,46 @@ namespace KAA
 			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_COMPLETE_DECRYPT_FILE_OPERATION);
 		}
 
+		std::vector<file_result_t> ClientCommunicator::IEncryptFiles(const std::vector<filesystem::path::file>& paths)
+		try
+		{
+			return m_communicator->EncryptFiles(paths);
+		}
+		catch(const failure& error)
+		{
+			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_COMPLETE_ENCRYPT_FILE_OPERATION);
+		}
+
+		std::vector<file_result_t> ClientCommunicator::IDecryptFiles(const std::vector<filesystem::path::file>& paths)
+		try
+		{
+			return m_communicator->DecryptFiles(paths);
+		}
+		catch(const failure& error)
+		{
+			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_COMPLETE_DECRYPT_FILE_OPERATION);
+		}
+
+		std::vector<file_result_t> ClientCommunicator::IEncryptDirectory(const filesystem::path::directory& path)
+		try
+		{
+			return m_communicator->EncryptDirectory(path);
+		}
+		catch(const failure& error)
+		{
+			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_COMPLETE_ENCRYPT_FILE_OPERATION);
+		}
+
+		std::vector<file_result_t> ClientCommunicator::IDecryptDirectory(const filesystem::path::directory& path)
+		try
+		{
+			return m_communicator->DecryptDirectory(path);
+		}
+		catch(const failure& error)
+		{
+			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_COMPLETE_DECRYPT_FILE_OPERATION);
+		}
+
 		bool ClientCommunicator::IIsFileEncrypted(const filesystem::path::file& path) const
 		try
 		{
@@ -64,6 +104,32 @@ namespace KAA
 			ThrowUserReport(error, UserReport::severity_t::warning, IDS_UNABLE_TO_DETERMINE_FILE_STATE);
 		}
 
+		// NOTE: failures of the operation itself are rethrown as they are by its result.
+		std::shared_ptr<batch_operation_t> ClientCommunicator::IStartEncryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return m_communicator->StartEncryptFiles(paths, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ClientCommunicator::IStartDecryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return m_communicator->StartDecryptFiles(paths, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ClientCommunicator::IStartEncryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return m_communicator->StartEncryptDirectory(path, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ClientCommunicator::IStartDecryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return m_communicator->StartDecryptDirectory(path, std::move(handler));
+		}
+
+		std::shared_ptr<query_operation_t> ClientCommunicator::IStartIsFileEncrypted(const filesystem::path::file& path)
+		{
+			return m_communicator->StartIsFileEncrypted(path);
+		}
+
 		std::vector<std::pair<std::wstring, core_id>> ClientCommunicator::IGetAvailableCiphers(void) const
 		{
 			return m_communicator->GetAvailableCiphers();
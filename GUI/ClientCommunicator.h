@@ -28,8 +28,20 @@ namespace KAA
 			void IEncryptFile(const filesystem::path::file&) override;
 			void IDecryptFile(const filesystem::path::file&) override;
 
+			std::vector<file_result_t> IEncryptFiles(const std::vector<filesystem::path::file>&) override;
+			std::vector<file_result_t> IDecryptFiles(const std::vector<filesystem::path::file>&) override;
+
+			std::vector<file_result_t> IEncryptDirectory(const filesystem::path::directory&) override;
+			std::vector<file_result_t> IDecryptDirectory(const filesystem::path::directory&) override;
+
 			bool IIsFileEncrypted(const filesystem::path::file&) const override;
 
+			std::shared_ptr<batch_operation_t> IStartEncryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartDecryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartEncryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartDecryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<query_operation_t> IStartIsFileEncrypted(const filesystem::path::file&) override;
+
 			std::vector<std::pair<std::wstring, core_id>> IGetAvailableCiphers(void) const override;
 			core_id IGetCipher(void) const override;
 			void ISetCipher(core_id) override;
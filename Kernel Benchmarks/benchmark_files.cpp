@@ -0,0 +1,114 @@
+#include "benchmark_files.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+#include <windows.h>
+
+namespace
+{
+	constexpr size_t block_size = 1024 * 1024; // 1 MiB
+
+	uint64_t Mix(uint64_t value)
+	{
+		value += 0x9E3779B97F4A7C15ULL;
+		value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+		value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBULL;
+		return value ^ ( value >> 31 );
+	}
+
+	// RETURNS: size of the file or -1 if it does not exist.
+	int64_t QueryFileSize(const std::wstring& path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA attributes = { 0 };
+		if(0 == ::GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes))
+			return -1;
+		return static_cast<int64_t>(( static_cast<uint64_t>(attributes.nFileSizeHigh) << 32 ) | attributes.nFileSizeLow);
+	}
+
+	uint64_t QueryFreeSpace(const std::wstring& directory)
+	{
+		ULARGE_INTEGER available = { 0 };
+		if(0 == ::GetDiskFreeSpaceExW(directory.c_str(), &available, nullptr, nullptr))
+			return 0;
+		return available.QuadPart;
+	}
+
+	void WriteFileData(const std::wstring& path, const uint64_t size)
+	{
+		const auto file = ::CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if(INVALID_HANDLE_VALUE == file)
+			throw std::runtime_error("unable to create benchmark file");
+
+		std::vector<uint64_t> block(block_size / sizeof(uint64_t));
+		uint64_t counter = 0;
+		auto written = true;
+		for(uint64_t offset = 0; written && offset < size; offset += block_size)
+		{
+			for(auto& value : block)
+				value = Mix(counter++);
+			const auto bytes_to_write = static_cast<DWORD>(std::min<uint64_t>(block_size, size - offset));
+			DWORD bytes_written = 0;
+			written = ( 0 != ::WriteFile(file, block.data(), bytes_to_write, &bytes_written, nullptr) ) && ( bytes_written == bytes_to_write );
+		}
+		::CloseHandle(file);
+		if(!written)
+		{
+			::DeleteFileW(path.c_str());
+			throw std::runtime_error("unable to write benchmark file");
+		}
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		namespace Benchmarks
+		{
+			void FileSizes(benchmark::internal::Benchmark* benchmark)
+			{
+				benchmark->RangeMultiplier(16)->Range(smallest_file, largest_file);
+			}
+
+			filesystem::path::directory GetBenchmarkDirectory(const wchar_t* name)
+			{
+				wchar_t temp[MAX_PATH] = { 0 };
+				::GetTempPathW(MAX_PATH, temp);
+				const filesystem::path::directory root { ( filesystem::path::directory { temp } + L"File Security stage benchmark" ).to_wstring() };
+				::CreateDirectoryW(root.to_wstring().c_str(), nullptr);
+				const filesystem::path::directory directory { ( root + name ).to_wstring() };
+				::CreateDirectoryW(directory.to_wstring().c_str(), nullptr);
+				return directory;
+			}
+
+			bool PrepareFile(const filesystem::path::file& path, const uint64_t size, const unsigned copies)
+			{
+				const auto exists = static_cast<int64_t>(size) == QueryFileSize(path.to_wstring());
+				const auto required = size * copies + ( exists ? 0 : size );
+				if(QueryFreeSpace(path.get_directory().to_wstring()) < required)
+					return false;
+				if(!exists)
+					WriteFileData(path.to_wstring(), size);
+				return true;
+			}
+
+			void CopyData(const filesystem::path::file& source, const filesystem::path::file& destination)
+			{
+				if(0 == ::CopyFileW(source.to_wstring().c_str(), destination.to_wstring().c_str(), FALSE))
+					throw std::runtime_error("unable to copy benchmark file");
+				::SetFileAttributesW(destination.to_wstring().c_str(), FILE_ATTRIBUTE_NORMAL);
+			}
+
+			void RemoveFile(const filesystem::path::file& path)
+			{
+				::SetFileAttributesW(path.to_wstring().c_str(), FILE_ATTRIBUTE_NORMAL);
+				::DeleteFileW(path.to_wstring().c_str());
+			}
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+#include "KAA/include/filesystem/path.h"
+
+namespace benchmark
+{
+	namespace internal
+	{
+		class Benchmark;
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		namespace Benchmarks
+		{
+			constexpr int64_t smallest_file = 4 * 1024; // 4 KiB : a single cluster
+			constexpr int64_t largest_file = 16LL * 1024 * 1024 * 1024; // 16 GiB : exceeds the memory of most machines
+
+			// NOTE: file sizes from 4 KiB to 16 GiB, a step of 16 times.
+			void FileSizes(benchmark::internal::Benchmark*);
+
+			// RETURNS: directory of the benchmark in the temporary directory, created if it does not exist.
+			filesystem::path::directory GetBenchmarkDirectory(const wchar_t* name);
+
+			// NOTE: files of pseudo-random data take a while to write, they are kept in the directory for later runs.
+			// RETURNS: false if the volume has not got room for the file and the given number of its copies.
+			bool PrepareFile(const filesystem::path::file&, uint64_t size, unsigned copies);
+
+			void CopyData(const filesystem::path::file& source, const filesystem::path::file& destination);
+			void RemoveFile(const filesystem::path::file&);
+		}
+	}
+}
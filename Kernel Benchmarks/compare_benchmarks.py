@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+"""Compares two runs of Kernel Benchmarks and reports the benchmarks that got slower.
+
+Each run is the JSON output of Google Benchmark, e.g. for a release:
+
+    "Kernel Benchmarks.exe" --benchmark_out=1.2.json --benchmark_out_format=json --benchmark_repetitions=5
+
+and then:
+
+    compare_benchmarks.py 1.1.json 1.2.json --threshold 0.05
+
+A benchmark run several times is represented by the median of its repetitions. Benchmarks skipped in either
+run (e.g. no room for a 16 GiB file) are listed but not compared. The exit status is 1 if any benchmark is
+slower than the baseline by more than the threshold, 2 if the files cannot be read, 0 otherwise.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_times(path, metric):
+    """Returns {benchmark name: time in nanoseconds}, None for a benchmark that has failed or been skipped."""
+    with open(path, encoding="utf-8") as results:
+        benchmarks = json.load(results)["benchmarks"]
+
+    repetitions = {}
+    medians = {}
+    for benchmark in benchmarks:
+        name = benchmark.get("run_name", benchmark["name"])
+        if benchmark.get("error_occurred") or benchmark.get("skipped"):
+            repetitions.setdefault(name, None)
+            continue
+        time = benchmark[metric] * TIME_UNITS[benchmark.get("time_unit", "ns")]
+        if benchmark.get("run_type") == "aggregate":
+            if benchmark.get("aggregate_name") == "median":
+                medians[name] = time
+        elif repetitions.get(name, []) is not None:
+            repetitions.setdefault(name, []).append(time)
+
+    times = {}
+    for name in set(repetitions) | set(medians):
+        runs = repetitions.get(name)
+        times[name] = medians.get(name, statistics.median(runs) if runs else None)
+    return times
+
+
+def format_time(nanoseconds):
+    for unit in ("s", "ms", "us"):
+        if nanoseconds >= TIME_UNITS[unit]:
+            return "%.3f %s" % (nanoseconds / TIME_UNITS[unit], unit)
+    return "%.1f ns" % nanoseconds
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="JSON results of the previous release")
+    parser.add_argument("contender", help="JSON results of the release being checked")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative slowdown tolerated, 0.05 is 5%% (default)")
+    parser.add_argument("--metric", choices=("real_time", "cpu_time"), default="real_time", help="time compared (default: real_time)")
+    arguments = parser.parse_args()
+
+    try:
+        baseline = load_times(arguments.baseline, arguments.metric)
+        contender = load_times(arguments.contender, arguments.metric)
+    except (OSError, ValueError, KeyError) as error:
+        print("unable to read benchmark results: %s" % error, file=sys.stderr)
+        return 2
+
+    regressions = 0
+    width = max((len(name) for name in set(baseline) | set(contender)), default=0)
+    print("%-*s %14s %14s %9s" % (width, "benchmark", "baseline", "contender", "change"))
+    for name in sorted(set(baseline) | set(contender)):
+        before = baseline.get(name)
+        after = contender.get(name)
+        if name not in baseline:
+            print("%-*s %14s %14s %9s" % (width, name, "-", format_time(after) if after else "skipped", "new"))
+            continue
+        if name not in contender:
+            print("%-*s %14s %14s %9s" % (width, name, format_time(before) if before else "skipped", "-", "removed"))
+            continue
+        if not before or not after:
+            print("%-*s %14s %14s %9s" % (width, name, format_time(before) if before else "skipped", format_time(after) if after else "skipped", "-"))
+            continue
+        change = after / before - 1.0
+        verdict = ""
+        if change > arguments.threshold:
+            verdict = "  REGRESSION"
+            regressions += 1
+        print("%-*s %14s %14s %+8.1f%%%s" % (width, name, format_time(before), format_time(after), change * 100.0, verdict))
+
+    if regressions:
+        print("\n%d benchmark(s) slower than the baseline by more than %.1f%%" % (regressions, arguments.threshold * 100.0))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
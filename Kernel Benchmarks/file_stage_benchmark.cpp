@@ -0,0 +1,299 @@
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "KAA/include/filesystem/crt_file_system.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+#include "KAA/include/filesystem/wiper.h"
+
+// FUTURE: KAA: remove <windows.h>
+#undef EncryptFile
+#undef DecryptFile
+
+#include "../Kernel/AsyncGammaFileCipher.h"
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/GammaFileCipher.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/Kernel.h"
+#include "../Kernel/KeyGenerator.h"
+#include "../Kernel/MD5BasedKeyStorage.h"
+#include "../Kernel/NativeCopy.h"
+#include "../Kernel/WiperFactory.h"
+
+#include "benchmark_files.h"
+
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Benchmarks;
+
+// NOTE: the stages of a file operation one by one, then the whole of it. Every benchmark takes the file size as its argument,
+// sizes the volume has not got room for are skipped. Data files are kept in the temporary directory, what a stage makes is removed.
+namespace
+{
+	constexpr size_t key_generation_slab = 16U * 1024U * 1024U; // 16 MiB : as AbsoluteSecurityCore generates a key.
+
+	std::shared_ptr<KAA::filesystem::driver> GetFilesystem(void)
+	{
+		static const auto filesystem = std::make_shared<KAA::filesystem::crt_file_system>();
+		return filesystem;
+	}
+
+	std::shared_ptr<IOPolicy> GetIOPolicy(void)
+	{
+		static const auto io_policy = std::make_shared<IOPolicy>();
+		return io_policy;
+	}
+
+	// NOTE: file sizes of FileSizes (powers of 16, then the largest file, as a range ends), each at queue depths of 1, 4 and 16.
+	void FileSizesAndQueueDepths(benchmark::internal::Benchmark* benchmark)
+	{
+		for(auto size = smallest_file; ; size = std::min(size * 16, largest_file))
+		{
+			for(const auto queue_depth : { 1, 4, 16 })
+				benchmark->Args({ size, queue_depth });
+			if(largest_file == size)
+				break;
+		}
+	}
+
+	KAA::filesystem::path::file GetDataFile(const KAA::filesystem::path::directory& directory, const int64_t size, const wchar_t* name)
+	{
+		return directory + ( std::wstring(name) + L"-" + std::to_wstring(size) + L".bin" );
+	}
+
+	// RETURNS: false if the benchmark has been skipped.
+	bool Prepare(benchmark::State& state, const KAA::filesystem::path::file& path, const unsigned copies)
+	{
+		if(PrepareFile(path, static_cast<uint64_t>(state.range(0)), copies))
+			return true;
+		state.SkipWithError("not enough free space on the volume");
+		return false;
+	}
+
+	void SetProcessed(benchmark::State& state)
+	{
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+	}
+
+	// KAA: gamma is its own inverse: applying it again restores the file for the next iteration.
+	void gamma_file_cipher_in_place(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"cipher");
+		const auto data = GetDataFile(directory, state.range(0), L"data");
+		const auto key = GetDataFile(directory, state.range(0), L"key");
+		const auto work = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, data, 1) || !Prepare(state, key, 0))
+			return;
+		CopyData(data, work);
+
+		GammaFileCipher cipher(GetFilesystem(), GetIOPolicy());
+		for(auto _ : state)
+			cipher.EncryptFile(work, key);
+		RemoveFile(work);
+		SetProcessed(state);
+	}
+
+	// NOTE: chunks of 1 MiB, the queue depth is the second argument.
+	void async_gamma_file_cipher_in_place(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"cipher");
+		const auto data = GetDataFile(directory, state.range(0), L"data");
+		const auto key = GetDataFile(directory, state.range(0), L"key");
+		const auto work = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, data, 1) || !Prepare(state, key, 0))
+			return;
+		CopyData(data, work);
+
+		const io_parameters_t parameters = { 1024U * 1024U, static_cast<unsigned>(state.range(1)) };
+		AsyncGammaFileCipher cipher(GetFilesystem(), std::make_shared<IOPolicy>(parameters));
+		for(auto _ : state)
+			cipher.EncryptFile(work, key);
+		RemoveFile(work);
+		SetProcessed(state);
+	}
+
+	void gamma_file_cipher_out_of_place(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"cipher");
+		const auto data = GetDataFile(directory, state.range(0), L"data");
+		const auto key = GetDataFile(directory, state.range(0), L"key");
+		const auto destination = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, data, 1) || !Prepare(state, key, 0))
+			return;
+
+		GammaFileCipher cipher(GetFilesystem(), GetIOPolicy());
+		for(auto _ : state)
+		{
+			cipher.EncryptFile(data, destination, key);
+			state.PauseTiming();
+			RemoveFile(destination);
+			state.ResumeTiming();
+		}
+		SetProcessed(state);
+	}
+
+	// KAA: AbsoluteSecurityCore::GenerateKey: slabs of the key generator, the whole key in memory.
+	void generate_key(benchmark::State& state)
+	{
+		const auto size = static_cast<uint64_t>(state.range(0));
+		KeyGenerator generator;
+		std::vector<uint8_t> slab(static_cast<size_t>(std::min<uint64_t>(key_generation_slab, size)));
+		for(auto _ : state)
+		{
+			for(uint64_t offset = 0; offset < size; offset += slab.size())
+				generator.Generate(static_cast<size_t>(std::min<uint64_t>(slab.size(), size - offset)), slab.data());
+			benchmark::ClobberMemory();
+		}
+		SetProcessed(state);
+	}
+
+	// NOTE: decryption and encryption status queries start here: MD5 reads the whole file, CRC32 hashes its name only.
+	void md5_key_path_lookup(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"key storage");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		if(!Prepare(state, data, 0))
+			return;
+
+		const MD5BasedKeyStorage storage(GetFilesystem(), GetIOPolicy(), directory);
+		for(auto _ : state)
+			benchmark::DoNotOptimize(storage.ContainsKey(storage.GetKeyPathForSpecifiedPath(data)));
+		SetProcessed(state);
+	}
+
+	void crc32_key_path_lookup(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"key storage");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		if(!Prepare(state, data, 0))
+			return;
+
+		const CRC32BasedKeyStorage storage(GetFilesystem(), directory);
+		for(auto _ : state)
+			benchmark::DoNotOptimize(storage.ContainsKey(storage.GetKeyPathForSpecifiedPath(data)));
+		SetProcessed(state);
+	}
+
+	// KAA: ServerCommunicator::CopyFile: block clone, then system copy, then buffered copy through the driver.
+	enum class copy_t
+	{
+		clone,
+		system,
+		buffered
+	};
+
+	void BufferedCopy(const KAA::filesystem::path::file& source_path, const KAA::filesystem::path::file& destination_path, std::vector<uint8_t>& buffer)
+	{
+		const KAA::filesystem::driver::mode sequential_read_only(false, true);
+		const KAA::filesystem::driver::share exclusive_access(false, false);
+		const auto source = GetFilesystem()->open_file(source_path, sequential_read_only, exclusive_access);
+
+		const KAA::filesystem::driver::create_mode persistent_not_exists;
+		const KAA::filesystem::driver::mode sequential_write_only(true, false);
+		const KAA::filesystem::driver::permission allow_read_write;
+		const auto destination = GetFilesystem()->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+
+		size_t bytes_read = 0;
+		do
+		{
+			bytes_read = source->read(buffer.size(), buffer.data());
+			destination->write(buffer.data(), bytes_read);
+		} while(0 != bytes_read);
+		destination->commit();
+	}
+
+	void copy_file(benchmark::State& state, const copy_t copy)
+	{
+		const auto directory = GetBenchmarkDirectory(L"copy");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		const auto destination = GetDataFile(directory, state.range(0), L"copy");
+		if(!Prepare(state, data, 1))
+			return;
+
+		const auto ignore_progress = [] (uint64_t) { return KAA::progress_state_t::quiet; };
+		std::vector<uint8_t> buffer(GetIOPolicy()->GetParameters(destination).chunk_size);
+		for(auto _ : state)
+		{
+			auto copied = true;
+			switch(copy)
+			{
+			case copy_t::clone:
+				copied = CloneFile(data, destination, ignore_progress);
+				break;
+			case copy_t::system:
+				copied = SystemCopyFile(data, destination, ignore_progress);
+				break;
+			case copy_t::buffered:
+				BufferedCopy(data, destination, buffer);
+				break;
+			}
+			state.PauseTiming();
+			RemoveFile(destination);
+			state.ResumeTiming();
+			if(!copied)
+			{
+				state.SkipWithError("copy path does not apply to the volume");
+				break;
+			}
+		}
+		SetProcessed(state);
+	}
+
+	// NOTE: the wiper removes the file, a copy is made for each iteration.
+	void wipe_file(benchmark::State& state, const wiper_t algorithm)
+	{
+		const auto directory = GetBenchmarkDirectory(L"wipe");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		const auto victim = GetDataFile(directory, state.range(0), L"victim");
+		if(!Prepare(state, data, 1))
+			return;
+
+		const auto wiper = QueryWiper(algorithm, GetFilesystem());
+		for(auto _ : state)
+		{
+			state.PauseTiming();
+			CopyData(data, victim);
+			state.ResumeTiming();
+			wiper->wipe_file(victim);
+		}
+		SetProcessed(state);
+	}
+
+	// NOTE: the whole operation through the kernel with the settings of a new installation (engine, cipher, processing mode, wipe method),
+	// the keys are stored next to the file. The settings of the current user are neither used nor changed.
+	void encrypt_decrypt_round_trip(benchmark::State& state)
+	{
+		const auto directory = GetBenchmarkDirectory(L"round trip");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		const auto work = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, data, 4)) // KAA: the file, its backup or ciphertext, and the key.
+			return;
+		CopyData(data, work);
+
+		const auto communicator = GetClassObject(KAA::filesystem::path::directory { ( directory + L"keys" ).to_wstring() });
+		for(auto _ : state)
+		{
+			communicator->EncryptFile(work);
+			communicator->DecryptFile(work);
+		}
+		RemoveFile(work);
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0) * 2);
+	}
+}
+
+BENCHMARK(gamma_file_cipher_in_place)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(async_gamma_file_cipher_in_place)->Apply(FileSizesAndQueueDepths)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(gamma_file_cipher_out_of_place)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(generate_key)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(md5_key_path_lookup)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(crc32_key_path_lookup)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(copy_file, clone, copy_t::clone)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(copy_file, system, copy_t::system)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(copy_file, buffered, copy_t::buffered)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(wipe_file, ordinary_remove, wiper_t::ordinary_remove)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(wipe_file, simple_overwrite, wiper_t::simple_overwrite)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK(encrypt_decrypt_round_trip)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,137 @@
+#include "benchmark/benchmark.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+
+// FUTURE: KAA: remove <windows.h>
+#undef EncryptFile
+#undef DecryptFile
+
+#include "../Kernel/FileSystemFactory.h"
+#include "../Kernel/GammaFileCipher.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/NativeFileSystem.h"
+
+#include "benchmark_files.h"
+
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Benchmarks;
+
+// NOTE: filesystem drivers side by side: the CRT, native handles through the system cache, and native handles bypassing it.
+// Data files are shared with file_stage_benchmark, what a benchmark writes is removed.
+namespace
+{
+	constexpr size_t chunk_size = 1024U * 1024U; // 1 MiB : the chunk of the ciphers and the buffered copy.
+
+	std::shared_ptr<IOPolicy> GetIOPolicy(void)
+	{
+		static const auto io_policy = std::make_shared<IOPolicy>();
+		return io_policy;
+	}
+
+	KAA::filesystem::path::file GetDataFile(const KAA::filesystem::path::directory& directory, const int64_t size, const wchar_t* name)
+	{
+		return directory + ( std::wstring(name) + L"-" + std::to_wstring(size) + L".bin" );
+	}
+
+	// RETURNS: false if the benchmark has been skipped.
+	bool Prepare(benchmark::State& state, const KAA::filesystem::path::file& path, const unsigned copies)
+	{
+		if(PrepareFile(path, static_cast<uint64_t>(state.range(0)), copies))
+			return true;
+		state.SkipWithError("not enough free space on the volume");
+		return false;
+	}
+
+	void SetProcessed(benchmark::State& state)
+	{
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+	}
+
+	void sequential_read(benchmark::State& state, const filesystem_t driver)
+	{
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		if(!Prepare(state, data, 0))
+			return;
+
+		const auto filesystem = QueryFileSystem(driver);
+		const KAA::filesystem::driver::mode sequential_read_only(false, true);
+		const KAA::filesystem::driver::share exclusive_access(false, false);
+		std::vector<uint8_t> buffer(chunk_size);
+		for(auto _ : state)
+		{
+			const auto file = filesystem->open_file(data, sequential_read_only, exclusive_access);
+			while(0 != file->read(buffer.size(), buffer.data()));
+			benchmark::ClobberMemory();
+		}
+		SetProcessed(state);
+	}
+
+	// KAA: ServerCommunicator::CopyFile and AbsoluteSecurityCore::CreateKeyFile: a new file written from start to end.
+	void sequential_write(benchmark::State& state, const filesystem_t driver, const bool preallocate)
+	{
+		const auto directory = GetBenchmarkDirectory(L"filesystem");
+		const auto destination = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data"), 1))
+			return;
+
+		const auto filesystem = QueryFileSystem(driver);
+		const KAA::filesystem::driver::create_mode persistent_not_exists;
+		const KAA::filesystem::driver::mode sequential_write_only(true, false);
+		const KAA::filesystem::driver::share exclusive_access(false, false);
+		const KAA::filesystem::driver::permission allow_read_write;
+		const auto size = static_cast<uint64_t>(state.range(0));
+		std::vector<uint8_t> buffer(chunk_size, 0x5A);
+		for(auto _ : state)
+		{
+			{
+				const auto file = filesystem->create_file(destination, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+				if(preallocate)
+					PreallocateFile(*file, size);
+				for(uint64_t offset = 0; offset < size; offset += buffer.size())
+					file->write(buffer.data(), static_cast<size_t>(std::min<uint64_t>(buffer.size(), size - offset)));
+				file->commit();
+			}
+			state.PauseTiming();
+			RemoveFile(destination);
+			state.ResumeTiming();
+		}
+		SetProcessed(state);
+	}
+
+	// KAA: gamma is its own inverse: applying it again restores the file for the next iteration.
+	void gamma_file_cipher_in_place(benchmark::State& state, const filesystem_t driver)
+	{
+		const auto directory = GetBenchmarkDirectory(L"filesystem");
+		const auto data = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"data");
+		const auto key = GetDataFile(GetBenchmarkDirectory(L"cipher"), state.range(0), L"key");
+		const auto work = GetDataFile(directory, state.range(0), L"work");
+		if(!Prepare(state, data, 1) || !Prepare(state, key, 0))
+			return;
+		CopyData(data, work);
+
+		GammaFileCipher cipher(QueryFileSystem(driver), GetIOPolicy());
+		for(auto _ : state)
+			cipher.EncryptFile(work, key);
+		RemoveFile(work);
+		SetProcessed(state);
+	}
+}
+
+BENCHMARK_CAPTURE(sequential_read, crt_runtime, filesystem_t::crt_runtime)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_read, native, filesystem_t::native)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_read, native_unbuffered, filesystem_t::native_unbuffered)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_write, crt_runtime, filesystem_t::crt_runtime, false)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_write, native, filesystem_t::native, false)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_write, native_preallocated, filesystem_t::native, true)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_write, native_unbuffered, filesystem_t::native_unbuffered, false)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(sequential_write, native_unbuffered_preallocated, filesystem_t::native_unbuffered, true)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(gamma_file_cipher_in_place, crt_runtime, filesystem_t::crt_runtime)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(gamma_file_cipher_in_place, native, filesystem_t::native)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(gamma_file_cipher_in_place, native_unbuffered, filesystem_t::native_unbuffered)->Apply(FileSizes)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,76 @@
+#include "benchmark/benchmark.h"
+
+#include <vector>
+
+#include "KAA/include/cryptography/cryptography.h"
+
+#include "../Kernel/KeyGenerator.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	constexpr auto smallest_key = 64 * 1024; // 64 KiB : a single chunk
+	constexpr auto largest_key = 256 * 1024 * 1024; // 256 MiB
+
+	// KAA: the previous key generation path - operating system generator, 64 KiB at a time, calling thread only.
+	void chunked_system_generate(benchmark::State& state)
+	{
+		constexpr auto chunk_size = 64U * 1024U; // 64 KiB
+		const auto size = static_cast<size_t>(state.range(0));
+		std::vector<uint8_t> key(size);
+		for(auto _ : state)
+		{
+			for(size_t offset = 0; offset < size; offset += chunk_size)
+				KAA::cryptography::generate(std::min<size_t>(chunk_size, size - offset), &key[offset]);
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+	}
+
+	void key_generator(benchmark::State& state)
+	{
+		KeyGenerator generator;
+		const auto size = static_cast<size_t>(state.range(0));
+		std::vector<uint8_t> key(size);
+		for(auto _ : state)
+		{
+			generator.Generate(size, key.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+	}
+
+	// KAA: one request, the slab the core asks for, filled by the calling thread and the number of helpers given.
+	void key_generator_helpers(benchmark::State& state)
+	{
+		KeyGenerator generator(1, static_cast<unsigned>(state.range(1)));
+		const auto size = static_cast<size_t>(state.range(0));
+		std::vector<uint8_t> key(size);
+		for(auto _ : state)
+		{
+			generator.Generate(size, key.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+	}
+
+	// KAA: requests of several files at once share one generator, as the files of a directory job do.
+	void concurrent_key_generator(benchmark::State& state)
+	{
+		static KeyGenerator generator;
+		const auto size = static_cast<size_t>(state.range(0));
+		std::vector<uint8_t> key(size);
+		for(auto _ : state)
+		{
+			generator.Generate(size, key.data());
+			benchmark::ClobberMemory();
+		}
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * size);
+	}
+}
+
+BENCHMARK(chunked_system_generate)->RangeMultiplier(16)->Range(smallest_key, largest_key)->UseRealTime();
+BENCHMARK(key_generator)->RangeMultiplier(16)->Range(smallest_key, largest_key)->UseRealTime();
+BENCHMARK(key_generator_helpers)->ArgsProduct({ { 16 * 1024 * 1024, largest_key }, { 0, 1, 3, 7, 15 } })->UseRealTime();
+BENCHMARK(concurrent_key_generator)->Arg(smallest_key)->Arg(16 * 1024 * 1024)->ThreadRange(1, 8)->UseRealTime();
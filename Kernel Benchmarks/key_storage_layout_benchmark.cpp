@@ -0,0 +1,161 @@
+#include "benchmark/benchmark.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "KAA/include/filesystem/crt_file_system.h"
+#include "KAA/include/filesystem/path.h"
+
+#include <windows.h>
+
+#include "../Kernel/KeyStorage.h"
+#include "../Kernel/ShardedKeyStorage.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	constexpr auto stored_keys = 1024 * 1024; // 1M : the key storage of a large deployment
+	constexpr auto complete_marker = L"complete";
+
+	uint64_t Mix(uint64_t value)
+	{
+		value += 0x9E3779B97F4A7C15ULL;
+		value = ( value ^ ( value >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+		value = ( value ^ ( value >> 27 ) ) * 0x94D049BB133111EBULL;
+		return value ^ ( value >> 31 );
+	}
+
+	// KAA: stands for a content hash: 32 hex digits, spread evenly over the shards.
+	std::wstring GetKeyName(const uint64_t index)
+	{
+		constexpr wchar_t digits[] = L"0123456789abcdef";
+		std::wstring name;
+		for(const auto part : { Mix(index), Mix(~index) })
+			for(int shift = 60; shift >= 0; shift -= 4)
+				name.push_back(digits[( part >> shift ) & 0x0F]);
+		return name;
+	}
+
+	bool FileExists(const std::wstring& path)
+	{
+		return INVALID_FILE_ATTRIBUTES != ::GetFileAttributesW(path.c_str());
+	}
+
+	// NOTE: names keys after the given path, so that the benchmark measures directory lookups only.
+	class NamingKeyStorage final : public KeyStorage
+	{
+	public:
+		explicit NamingKeyStorage(KAA::filesystem::path::directory path) :
+		path(std::move(path))
+		{}
+
+	private:
+		KAA::filesystem::path::directory path;
+
+		void ISetPath(KAA::filesystem::path::directory value) override
+		{
+			path = std::move(value);
+		}
+
+		KAA::filesystem::path::directory IGetPath(void) const override
+		{
+			return path;
+		}
+
+		KAA::filesystem::path::file IGetKeyPathForSpecifiedPath(const KAA::filesystem::path::file& name) const override
+		{
+			return path + ( name.to_wstring() + L".bin" );
+		}
+
+		std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override
+		{
+			return nullptr;
+		}
+
+		void IStoreKey(const KAA::filesystem::path::file& key_file, const KAA::filesystem::path::file& key_path) override
+		{
+			::MoveFileW(key_file.to_wstring().c_str(), key_path.to_wstring().c_str());
+		}
+
+		bool IContainsKey(const KAA::filesystem::path::file& key_path) const override
+		{
+			return FileExists(key_path.to_wstring());
+		}
+
+		KAA::filesystem::path::file ILoadKey(const KAA::filesystem::path::file& key_path) override
+		{
+			return key_path;
+		}
+
+		void IUnloadKey(const KAA::filesystem::path::file&, const KAA::filesystem::path::file&) override
+		{}
+
+		void IRemoveKey(const KAA::filesystem::path::file& key_path, const KAA::filesystem::path::file&) override
+		{
+			::DeleteFileW(key_path.to_wstring().c_str());
+		}
+	};
+
+	KAA::filesystem::path::directory GetStoragePath(const wchar_t* layout)
+	{
+		wchar_t temp[MAX_PATH] = { 0 };
+		::GetTempPathW(MAX_PATH, temp);
+		const KAA::filesystem::path::directory root { ( KAA::filesystem::path::directory { temp } + L"File Security key storage benchmark" ).to_wstring() };
+		::CreateDirectoryW(root.to_wstring().c_str(), nullptr);
+		const KAA::filesystem::path::directory storage { ( root + layout ).to_wstring() };
+		::CreateDirectoryW(storage.to_wstring().c_str(), nullptr);
+		return storage;
+	}
+
+	// KAA: creating a million files takes minutes, the stores are kept in the temporary directory for later runs.
+	std::unique_ptr<KeyStorage> PrepareKeyStorage(const wchar_t* layout, const bool sharded)
+	{
+		const auto path = GetStoragePath(layout);
+		std::unique_ptr<KeyStorage> storage = std::make_unique<NamingKeyStorage>(path);
+		if(sharded)
+			storage = std::make_unique<ShardedKeyStorage>(std::move(storage), std::make_shared<KAA::filesystem::crt_file_system>());
+
+		const auto marker = ( path + complete_marker ).to_wstring();
+		if(FileExists(marker))
+			return storage;
+
+		const auto key_file = ( path + L"key.tmp" ).to_wstring();
+		for(uint64_t index = 0; index < stored_keys; ++index)
+		{
+			const auto key_path = storage->GetKeyPathForSpecifiedPath(KAA::filesystem::path::file { GetKeyName(index) });
+			if(storage->ContainsKey(key_path))
+				continue;
+			::CloseHandle(::CreateFileW(key_file.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+			storage->StoreKey(KAA::filesystem::path::file { key_file }, key_path);
+		}
+		::CloseHandle(::CreateFileW(marker.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+		return storage;
+	}
+
+	// NOTE: resolves and checks the key path of stored keys in random order (missing - keys never stored), as decryption and encryption status queries do.
+	void key_lookup(benchmark::State& state, const wchar_t* layout, const bool sharded_store, const bool sharded_lookup, const bool missing)
+	{
+		const auto store = PrepareKeyStorage(layout, sharded_store);
+		std::unique_ptr<KeyStorage> storage = std::make_unique<NamingKeyStorage>(store->GetPath());
+		if(sharded_lookup)
+			storage = std::make_unique<ShardedKeyStorage>(std::move(storage), std::make_shared<KAA::filesystem::crt_file_system>());
+
+		uint64_t lookup = 0;
+		for(auto _ : state)
+		{
+			const auto index = Mix(lookup++) % stored_keys + ( missing ? stored_keys : 0 );
+			const auto key_path = storage->GetKeyPathForSpecifiedPath(KAA::filesystem::path::file { GetKeyName(index) });
+			benchmark::DoNotOptimize(storage->ContainsKey(key_path));
+		}
+		state.SetItemsProcessed(state.iterations());
+	}
+}
+
+BENCHMARK_CAPTURE(key_lookup, flat, L"flat", false, false, false)->UseRealTime();
+BENCHMARK_CAPTURE(key_lookup, flat_missing, L"flat", false, false, true)->UseRealTime();
+BENCHMARK_CAPTURE(key_lookup, sharded, L"sharded", true, true, false)->UseRealTime();
+BENCHMARK_CAPTURE(key_lookup, sharded_missing, L"sharded", true, true, true)->UseRealTime();
+// KAA: a flat store read through the sharded layout - the fallback taken by stores created before sharding.
+BENCHMARK_CAPTURE(key_lookup, flat_through_sharded, L"flat", false, true, false)->UseRealTime();
@@ -0,0 +1,124 @@
+#include "benchmark/benchmark.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+#include "KAA/include/filesystem/wiper.h"
+
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/GammaFileCipher.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/MD5BasedKeyStorage.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/WiperFactory.h"
+
+using namespace KAA::FileSecurity;
+
+// NOTE: stages of file_stage_benchmark on the in-memory filesystem: the code alone, without the disk and the system cache.
+namespace
+{
+	constexpr int64_t smallest_file = 4 * 1024; // 4 KiB
+	constexpr int64_t largest_file = 256 * 1024 * 1024; // 256 MiB : the file and its key are kept in memory.
+
+	const KAA::filesystem::path::directory data_directory { LR"(C:\data)" };
+	const KAA::filesystem::path::directory key_storage_directory { LR"(C:\keys)" };
+
+	void FileSizes(benchmark::internal::Benchmark* benchmark)
+	{
+		benchmark->RangeMultiplier(16)->Range(smallest_file, largest_file);
+	}
+
+	std::shared_ptr<KAA::filesystem::driver> CreateFilesystem(void)
+	{
+		auto filesystem = std::make_shared<MemoryFileSystem>();
+		filesystem->create_directory(data_directory);
+		filesystem->create_directory(key_storage_directory);
+		return filesystem;
+	}
+
+	std::shared_ptr<IOPolicy> GetIOPolicy(void)
+	{
+		static const auto io_policy = std::make_shared<IOPolicy>(io_parameters_t { 1024U * 1024U, 1U }); // 1 MiB
+		return io_policy;
+	}
+
+	void CreateFile(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const int64_t size)
+	{
+		const KAA::filesystem::driver::create_mode persistent_not_exists;
+		const KAA::filesystem::driver::mode sequential_write_only(true, false);
+		const KAA::filesystem::driver::share exclusive_access(false, false);
+		const KAA::filesystem::driver::permission allow_read_write;
+		const auto file = filesystem.create_file(path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+		std::vector<uint8_t> data(static_cast<size_t>(size));
+		for(size_t index = 0; index < data.size(); ++index)
+			data[index] = static_cast<uint8_t>(index * 2654435761U >> 24);
+		file->write(data.data(), data.size());
+	}
+
+	void SetProcessed(benchmark::State& state)
+	{
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * state.range(0));
+	}
+
+	void memory_gamma_file_cipher_in_place(benchmark::State& state)
+	{
+		const auto filesystem = CreateFilesystem();
+		const auto data = data_directory + L"data.bin";
+		const auto key = key_storage_directory + L"key.bin";
+		CreateFile(*filesystem, data, state.range(0));
+		CreateFile(*filesystem, key, state.range(0));
+
+		GammaFileCipher cipher(filesystem, GetIOPolicy());
+		for(auto _ : state)
+			cipher.EncryptFile(data, key);
+		SetProcessed(state);
+	}
+
+	void memory_md5_key_path_lookup(benchmark::State& state)
+	{
+		const auto filesystem = CreateFilesystem();
+		const auto data = data_directory + L"data.bin";
+		CreateFile(*filesystem, data, state.range(0));
+
+		const MD5BasedKeyStorage storage(filesystem, GetIOPolicy(), key_storage_directory);
+		for(auto _ : state)
+			benchmark::DoNotOptimize(storage.ContainsKey(storage.GetKeyPathForSpecifiedPath(data)));
+		SetProcessed(state);
+	}
+
+	void memory_crc32_key_path_lookup(benchmark::State& state)
+	{
+		const auto filesystem = CreateFilesystem();
+		const auto data = data_directory + L"data.bin";
+		CreateFile(*filesystem, data, state.range(0));
+
+		const CRC32BasedKeyStorage storage(filesystem, key_storage_directory);
+		for(auto _ : state)
+			benchmark::DoNotOptimize(storage.ContainsKey(storage.GetKeyPathForSpecifiedPath(data)));
+		SetProcessed(state);
+	}
+
+	void memory_wipe_file(benchmark::State& state, const wiper_t algorithm)
+	{
+		const auto filesystem = CreateFilesystem();
+		const auto victim = data_directory + L"victim.bin";
+		const auto wiper = QueryWiper(algorithm, filesystem);
+		for(auto _ : state)
+		{
+			state.PauseTiming();
+			CreateFile(*filesystem, victim, state.range(0));
+			state.ResumeTiming();
+			wiper->wipe_file(victim);
+		}
+		SetProcessed(state);
+	}
+}
+
+BENCHMARK(memory_gamma_file_cipher_in_place)->Apply(FileSizes);
+BENCHMARK(memory_md5_key_path_lookup)->Apply(FileSizes);
+BENCHMARK(memory_crc32_key_path_lookup)->Apply(FileSizes);
+BENCHMARK_CAPTURE(memory_wipe_file, ordinary_remove, wiper_t::ordinary_remove)->Apply(FileSizes);
+BENCHMARK_CAPTURE(memory_wipe_file, simple_overwrite, wiper_t::simple_overwrite)->Apply(FileSizes);
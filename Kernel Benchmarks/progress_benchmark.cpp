@@ -0,0 +1,95 @@
+#include "benchmark/benchmark.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "../Common/CommunicatorProgressHandler.h"
+#include "../Kernel/CipherProgressDispatcher.h"
+#include "../Kernel/CoreProgressDispatcher.h"
+#include "../Kernel/ProgressCounter.h"
+#include "../Kernel/ProgressRelay.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	constexpr uint64_t chunk_size = 64 * 1024; // 64 KiB : a chunk of the ciphers
+	constexpr auto window_update = std::chrono::microseconds(5); // KAA: about what a SendMessage to the window of another thread takes.
+	constexpr auto relay_interval = std::chrono::milliseconds(50);
+
+	// KAA: shared by every thread of a benchmark, the way the handler of the communicator is.
+	class SessionHandler final : public CommunicatorProgressHandler
+	{
+	public:
+		explicit SessionHandler(const std::chrono::microseconds update) :
+		update(update),
+		processed(0)
+		{}
+
+	private:
+		const std::chrono::microseconds update;
+		std::mutex guard;
+		uint64_t processed;
+
+		KAA::progress_state_t IOperationStarted(const std::string&, uint64_t) override
+		{
+			return KAA::progress_state_t::proceed;
+		}
+
+		KAA::progress_state_t IOperationProgress(const uint64_t portion) override
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			processed += portion;
+			const auto finish = std::chrono::steady_clock::now() + update;
+			while(std::chrono::steady_clock::now() < finish);
+			return KAA::progress_state_t::proceed;
+		}
+	};
+
+	void Report(benchmark::State& state, FileProgressHandler& cipher_progress)
+	{
+		for(auto _ : state)
+			benchmark::DoNotOptimize(cipher_progress.ChunkProcessed(chunk_size));
+		state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * chunk_size);
+	}
+
+	// KAA: before: every chunk goes down cipher dispatcher, core dispatcher and the handler, a virtual call each.
+	void dispatch_chain(benchmark::State& state)
+	{
+		static const auto session = std::make_shared<SessionHandler>(std::chrono::microseconds::zero());
+		CipherProgressDispatcher cipher_progress(std::make_shared<CoreProgressDispatcher>(session));
+		Report(state, cipher_progress);
+	}
+
+	void dispatch_chain_to_window(benchmark::State& state)
+	{
+		static const auto session = std::make_shared<SessionHandler>(window_update);
+		CipherProgressDispatcher cipher_progress(std::make_shared<CoreProgressDispatcher>(session));
+		Report(state, cipher_progress);
+	}
+
+	// KAA: after: every chunk is an atomic add to the counter.
+	void progress_counter(benchmark::State& state)
+	{
+		static const auto counter = std::make_shared<ProgressCounter>();
+		CipherProgressDispatcher cipher_progress;
+		cipher_progress.SetProgressCounter(counter);
+		Report(state, cipher_progress);
+	}
+
+	void progress_relay_to_window(benchmark::State& state)
+	{
+		static const auto relay = std::make_shared<ProgressRelay>(std::make_shared<SessionHandler>(window_update), relay_interval);
+		CipherProgressDispatcher cipher_progress;
+		cipher_progress.SetProgressCounter(relay->GetCounter());
+		Report(state, cipher_progress);
+	}
+}
+
+BENCHMARK(dispatch_chain)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(dispatch_chain_to_window)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(progress_counter)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(progress_relay_to_window)->ThreadRange(1, 8)->UseRealTime();
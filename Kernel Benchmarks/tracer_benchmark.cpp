@@ -0,0 +1,40 @@
+#include "benchmark/benchmark.h"
+
+#include <cstdint>
+
+#include "../Kernel/Tracer.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	constexpr uint64_t file_size = 64 * 1024 * 1024; // 64 MiB
+	constexpr int64_t recorded_spans = 1000000; // KAA: the tracer keeps every span, bounded to keep memory in check.
+
+	// KAA: what a stage pays when tracing is off: a load and a branch on the way in and out.
+	void trace_span_disabled(benchmark::State& state)
+	{
+		for(auto _ : state)
+		{
+			const TraceSpan span("Cipher", file_size);
+			benchmark::DoNotOptimize(span.IsRecording());
+		}
+	}
+
+	void trace_span_enabled(benchmark::State& state)
+	{
+		static Tracer tracer;
+		if(0 == state.thread_index())
+			Tracer::Install(&tracer);
+		for(auto _ : state)
+		{
+			const TraceSpan span("Cipher", file_size);
+			benchmark::DoNotOptimize(span.IsRecording());
+		}
+		if(0 == state.thread_index())
+			Tracer::Install(nullptr);
+	}
+}
+
+BENCHMARK(trace_span_disabled)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK(trace_span_enabled)->Iterations(recorded_spans)->ThreadRange(1, 8)->UseRealTime();
@@ -0,0 +1,64 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../Kernel/Blake3.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	std::string ToHex(const Blake3::digest_t& digest)
+	{
+		constexpr char digits[] = "0123456789abcdef";
+		std::string hex;
+		for(const auto byte : digest)
+		{
+			hex.push_back(digits[byte >> 4]);
+			hex.push_back(digits[byte & 0x0F]);
+		}
+		return hex;
+	}
+
+	// KAA: input of the official BLAKE3 test vectors.
+	std::vector<uint8_t> MakeInput(const size_t size)
+	{
+		std::vector<uint8_t> input(size);
+		for(size_t index = 0; index < size; ++index)
+			input[index] = static_cast<uint8_t>(index % 251);
+		return input;
+	}
+
+	std::string Hash(const std::vector<uint8_t>& input, const size_t step)
+	{
+		Blake3 hash;
+		for(size_t offset = 0; offset < input.size(); offset += step)
+			hash.Update(input.data() + offset, std::min(step, input.size() - offset));
+		return ToHex(hash.Complete());
+	}
+}
+
+TEST(blake3, matches_official_test_vectors)
+{
+	EXPECT_EQ("af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262", Hash(MakeInput(0), 1));
+	EXPECT_EQ("42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7", Hash(MakeInput(1024), 1024));
+	EXPECT_EQ("d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444", Hash(MakeInput(1025), 1025));
+	EXPECT_EQ("bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085", Hash(MakeInput(102400), 102400));
+}
+
+TEST(blake3, split_updates_and_subtrees_give_the_same_digest)
+{
+	constexpr uint64_t subtree_chunks = 8;
+	constexpr size_t subtree_size = subtree_chunks * Blake3::chunk_size;
+	const auto input = MakeInput(3 * subtree_size + 5000);
+	const auto expected = Hash(input, input.size());
+	EXPECT_EQ(expected, Hash(input, 7));
+
+	Blake3 hash;
+	for(uint64_t subtree = 0; subtree < 3; ++subtree)
+		hash.AddSubtree(Blake3::HashSubtree(input.data() + subtree * subtree_size, subtree_chunks, subtree * subtree_chunks), subtree_chunks);
+	hash.Update(input.data() + 3 * subtree_size, input.size() - 3 * subtree_size);
+	EXPECT_EQ(expected, ToHex(hash.Complete()));
+}
@@ -0,0 +1,144 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/CachedKeyStorage.h"
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/Tracer.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	const filesystem::driver::mode random_read_write(true, true, true, true);
+
+	// NOTE: the memory driver tells file identity, the cache works as it does on Windows volumes.
+	class cached_key_storage : public testing::Test
+	{
+	protected:
+		cached_key_storage() :
+		filesystem(std::make_shared<MemoryFileSystem>()),
+		key_storage_path(LR"(C:\keys)"),
+		directory(LR"(C:\data)"),
+		path(directory + L"file.bin")
+		{
+			filesystem->create_directory(key_storage_path);
+			filesystem->create_directory(directory);
+			WriteFile(*filesystem, path, MakeData(10000, 1));
+		}
+
+		std::unique_ptr<CachedKeyStorage> MakeStorage(void) const
+		{
+			return std::make_unique<CachedKeyStorage>(std::make_unique<CRC32BasedKeyStorage>(filesystem, key_storage_path), filesystem);
+		}
+
+		static void ExpectStatistics(const CachedKeyStorage& storage, const uint64_t hits, const uint64_t misses)
+		{
+			const auto statistics = storage.GetStatistics();
+			EXPECT_EQ(hits, statistics.hits);
+			EXPECT_EQ(misses, statistics.misses);
+		}
+
+		std::shared_ptr<MemoryFileSystem> filesystem;
+		const filesystem::path::directory key_storage_path;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+	};
+}
+
+TEST_F(cached_key_storage, misses_unknown_files_and_hits_known_ones)
+{
+	const auto storage = MakeStorage();
+	const CRC32BasedKeyStorage uncached(filesystem, key_storage_path);
+	const auto expected = uncached.GetKeyPathForSpecifiedPath(path);
+
+	EXPECT_EQ(expected.to_wstring(), storage->GetKeyPathForSpecifiedPath(path).to_wstring());
+	ExpectStatistics(*storage, 0, 1);
+	EXPECT_EQ(expected.to_wstring(), storage->GetKeyPathForSpecifiedPath(path).to_wstring());
+	ExpectStatistics(*storage, 1, 1);
+}
+
+TEST_F(cached_key_storage, misses_files_that_do_not_exist)
+{
+	const auto storage = MakeStorage();
+	const auto absent = directory + L"absent.bin";
+	EXPECT_ANY_THROW(storage->GetKeyPathForSpecifiedPath(absent));
+	ExpectStatistics(*storage, 0, 1);
+}
+
+// NOTE: a write changes the version of the file: the entry is not used, the key path of the new content is.
+TEST_F(cached_key_storage, forgets_files_that_have_changed)
+{
+	const auto storage = MakeStorage();
+	const auto before = storage->GetKeyPathForSpecifiedPath(path);
+	{
+		const auto file = filesystem->open_file(path, random_read_write, exclusive_access);
+		file->seek(0, filesystem::file::end);
+		const uint8_t tail = 0x5A;
+		file->write(&tail, sizeof(tail));
+	}
+
+	const auto after = storage->GetKeyPathForSpecifiedPath(path);
+	ExpectStatistics(*storage, 0, 2);
+	EXPECT_NE(before.to_wstring(), after.to_wstring());
+	EXPECT_EQ(CRC32BasedKeyStorage(filesystem, key_storage_path).GetKeyPathForSpecifiedPath(path).to_wstring(), after.to_wstring());
+	storage->GetKeyPathForSpecifiedPath(path);
+	ExpectStatistics(*storage, 1, 2);
+}
+
+// NOTE: a change of the metadata moves the change time: the entry is not trusted though the content is the same.
+TEST_F(cached_key_storage, forgets_files_whose_metadata_has_changed)
+{
+	const auto storage = MakeStorage();
+	const auto expected = storage->GetKeyPathForSpecifiedPath(path);
+	filesystem->set_file_permissions(path, allow_read_write);
+
+	EXPECT_EQ(expected.to_wstring(), storage->GetKeyPathForSpecifiedPath(path).to_wstring());
+	ExpectStatistics(*storage, 0, 2);
+}
+
+// NOTE: entries are kept in the journal of the key storage: another instance (the next session) hits files the first one has seen.
+TEST_F(cached_key_storage, reloads_the_journal_in_another_instance)
+{
+	const auto expected = MakeStorage()->GetKeyPathForSpecifiedPath(path);
+
+	const auto reopened = MakeStorage();
+	EXPECT_EQ(expected.to_wstring(), reopened->GetKeyPathForSpecifiedPath(path).to_wstring());
+	ExpectStatistics(*reopened, 1, 0);
+}
+
+TEST_F(cached_key_storage, remembers_key_paths_computed_elsewhere)
+{
+	const auto storage = MakeStorage();
+	const auto key_path = key_storage_path + L"digest.key";
+	storage->RememberKeyPath(path, key_path);
+	EXPECT_EQ(key_path.to_wstring(), storage->GetKeyPathForSpecifiedPath(path).to_wstring());
+	ExpectStatistics(*storage, 1, 0);
+}
+
+TEST_F(cached_key_storage, traces_its_counters)
+{
+	Tracer tracer;
+	Tracer::Install(&tracer);
+	{
+		const auto storage = MakeStorage();
+		storage->GetKeyPathForSpecifiedPath(path);
+		storage->GetKeyPathForSpecifiedPath(path);
+	}
+	Tracer::Install(nullptr);
+
+	const auto json = tracer.Export();
+	EXPECT_NE(std::string::npos, json.find("\"name\":\"KeyPathCache\""));
+	EXPECT_NE(std::string::npos, json.find("\"args\":{\"hits\":1,\"misses\":1}"));
+}
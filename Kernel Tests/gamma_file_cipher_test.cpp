@@ -0,0 +1,265 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/filesystem/crt_file_system.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+// FUTURE: KAA: remove <windows.h>
+#undef EncryptFile
+#undef DecryptFile
+
+#include "../Kernel/AsyncGammaFileCipher.h"
+#include "../Kernel/CancellationToken.h"
+#include "../Kernel/CompletionQueue.h"
+#include "../Kernel/FileDataHandler.h"
+#include "../Kernel/FileProgressHandler.h"
+#include "../Kernel/FusedGammaFileCipher.h"
+#include "../Kernel/GammaFileCipher.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/MappedGammaFileCipher.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/NativeFile.h"
+#include "../Kernel/ParallelGammaFileCipher.h"
+#include "../Kernel/PipelinedGammaFileCipher.h"
+#include "../Kernel/PooledGammaFileCipher.h"
+#include "../Kernel/WorkStealingPool.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	constexpr size_t chunk_size = 4096;
+	constexpr size_t file_size = 25 * chunk_size + 123; // KAA: the last chunk is a partial one.
+
+	class CancelAtOnce final : public FileProgressHandler
+	{
+		progress_state_t IChunkProcessed(uint64_t) override
+		{
+			return progress_state_t::cancel;
+		}
+	};
+
+	class WrittenChunks final : public FileDataHandler
+	{
+	public:
+		std::vector<std::pair<uint64_t, size_t>> chunks;
+
+	private:
+		void IChunkWritten(const uint64_t offset, const void*, const size_t size) override
+		{
+			chunks.emplace_back(offset, size);
+		}
+	};
+
+	// NOTE: files of the disk, the ciphers other than gamma work on Windows files only. The gamma cipher gives the expected result.
+	class gamma_file_cipher : public testing::Test
+	{
+	protected:
+		gamma_file_cipher() :
+		filesystem(std::make_shared<filesystem::crt_file_system>()),
+		directory(LR"(.\gamma_file_cipher_test)"),
+		path(directory + L"data.bin"),
+		output(directory + L"output.bin"),
+		key_path(directory + L"key.bin"),
+		data(MakeData(file_size, 1))
+		{
+			filesystem->create_directory(directory);
+			WriteFile(*filesystem, key_path, MakeData(file_size, 2));
+			WriteFile(*filesystem, path, data);
+			GammaFileCipher(filesystem, MakePolicy(1)).EncryptFile(path, key_path);
+			expected = ReadFile(*filesystem, path);
+			filesystem->remove_file(path);
+		}
+
+		~gamma_file_cipher()
+		{
+			for(const auto& file : { path, output, key_path })
+				if(filesystem::file_exists(*filesystem, file))
+					filesystem->remove_file(file);
+			filesystem->remove_directory(directory);
+		}
+
+		static std::shared_ptr<IOPolicy> MakePolicy(const unsigned queue_depth)
+		{
+			return std::make_shared<IOPolicy>(io_parameters_t { chunk_size, queue_depth });
+		}
+
+		void ExpectInPlaceRoundTrip(FileCipher& cipher)
+		{
+			WriteFile(*filesystem, path, data);
+			cipher.EncryptFile(path, key_path);
+			EXPECT_EQ(expected, ReadFile(*filesystem, path));
+			cipher.DecryptFile(path, key_path);
+			EXPECT_EQ(data, ReadFile(*filesystem, path));
+			filesystem->remove_file(path);
+		}
+
+		void ExpectOutOfPlaceRoundTrip(FileCipher& cipher)
+		{
+			WriteFile(*filesystem, path, data);
+			cipher.EncryptFile(path, output, key_path);
+			EXPECT_EQ(data, ReadFile(*filesystem, path));
+			EXPECT_EQ(expected, ReadFile(*filesystem, output));
+			filesystem->remove_file(path);
+			cipher.DecryptFile(output, path, key_path);
+			EXPECT_EQ(data, ReadFile(*filesystem, path));
+			filesystem->remove_file(path);
+			filesystem->remove_file(output);
+		}
+
+		std::shared_ptr<filesystem::driver> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+		const filesystem::path::file output;
+		const filesystem::path::file key_path;
+		const std::vector<uint8_t> data;
+		std::vector<uint8_t> expected;
+	};
+}
+
+TEST_F(gamma_file_cipher, async_cipher_matches_gamma_cipher_at_any_queue_depth)
+{
+	ASSERT_NE(data, expected);
+	for(const auto queue_depth : { 1U, 4U, 16U })
+	{
+		SCOPED_TRACE(queue_depth);
+		AsyncGammaFileCipher cipher(filesystem, MakePolicy(queue_depth));
+		ExpectInPlaceRoundTrip(cipher);
+		ExpectOutOfPlaceRoundTrip(cipher);
+	}
+}
+
+// NOTE: requests in flight when the operation is cancelled are completed and reported before the call returns:
+// the file holds what the data handler has seen and nothing is written to it afterwards.
+TEST_F(gamma_file_cipher, async_cipher_leaves_no_request_in_flight_when_cancelled)
+{
+	AsyncGammaFileCipher cipher(filesystem, MakePolicy(16));
+	const auto written = std::make_shared<WrittenChunks>();
+	cipher.SetProgressCallback(std::make_shared<CancelAtOnce>());
+	cipher.SetDataCallback(written);
+	WriteFile(*filesystem, path, data);
+
+	EXPECT_THROW(cipher.EncryptFile(path, key_path), OperationCancelled);
+	uint64_t processed = 0;
+	for(const auto& chunk : written->chunks)
+	{
+		EXPECT_EQ(processed, chunk.first); // KAA: retired in file order.
+		processed += chunk.second;
+	}
+	ASSERT_NE(0U, processed);
+	ASSERT_GT(file_size, processed); // KAA: no chunk is submitted once cancelled.
+
+	auto partial = expected;
+	std::copy(data.begin() + static_cast<ptrdiff_t>(processed), data.end(), partial.begin() + static_cast<ptrdiff_t>(processed));
+	EXPECT_EQ(partial, ReadFile(*filesystem, path));
+}
+
+// NOTE: the reader stage runs ahead of the writer by up to the queue depth of chunks.
+TEST_F(gamma_file_cipher, pipelined_cipher_matches_gamma_cipher_at_any_queue_depth)
+{
+	for(const auto queue_depth : { 1U, 2U, 8U })
+	{
+		SCOPED_TRACE(queue_depth);
+		PipelinedGammaFileCipher cipher(filesystem, MakePolicy(queue_depth));
+		ExpectInPlaceRoundTrip(cipher);
+		ExpectOutOfPlaceRoundTrip(cipher);
+	}
+}
+
+TEST_F(gamma_file_cipher, pipelined_cipher_fails_on_short_key)
+{
+	filesystem->remove_file(key_path);
+	WriteFile(*filesystem, key_path, MakeData(file_size - chunk_size, 2));
+	PipelinedGammaFileCipher cipher(filesystem, MakePolicy(4));
+	WriteFile(*filesystem, path, data);
+	EXPECT_THROW(cipher.EncryptFile(path, output, key_path), operation_failure);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_THROW(cipher.EncryptFile(path, key_path), operation_failure);
+}
+
+TEST_F(gamma_file_cipher, every_cipher_matches_gamma_cipher)
+{
+	{
+		SCOPED_TRACE("mapped");
+		MappedGammaFileCipher cipher(filesystem);
+		ExpectInPlaceRoundTrip(cipher);
+	}
+	{
+		SCOPED_TRACE("parallel");
+		ParallelGammaFileCipher cipher(MakePolicy(4));
+		ExpectInPlaceRoundTrip(cipher);
+	}
+	{
+		SCOPED_TRACE("pooled");
+		WorkStealingPool pool(concurrency_limits_t { 4U, 4U });
+		PooledGammaFileCipher cipher(filesystem, MakePolicy(1), pool, 3 * chunk_size); // KAA: the file is split into ranges.
+		ExpectInPlaceRoundTrip(cipher);
+		ExpectOutOfPlaceRoundTrip(cipher);
+	}
+}
+
+// NOTE: the mapped cipher maps Windows files, it takes no driver it would bypass.
+TEST(mapped_gamma_file_cipher, refuses_drivers_other_than_windows_ones)
+{
+	EXPECT_THROW(MappedGammaFileCipher(std::make_shared<MemoryFileSystem>()), operation_failure);
+	EXPECT_THROW(MappedGammaFileCipher(nullptr), operation_failure);
+}
+
+// NOTE: the fused cipher generates the key, the gamma cipher decrypts with it.
+TEST_F(gamma_file_cipher, fused_cipher_matches_gamma_cipher)
+{
+	filesystem->remove_file(key_path);
+	FusedGammaFileCipher cipher(filesystem, MakePolicy(1));
+	WriteFile(*filesystem, path, data);
+	cipher.EncryptFile(path, key_path);
+	const auto encrypted = ReadFile(*filesystem, path);
+	EXPECT_NE(data, encrypted);
+	EXPECT_EQ(data.size(), filesystem::get_file_size(*filesystem, key_path));
+
+	GammaFileCipher gamma(filesystem, MakePolicy(1));
+	gamma.DecryptFile(path, key_path);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	gamma.EncryptFile(path, key_path);
+	EXPECT_EQ(encrypted, ReadFile(*filesystem, path));
+}
+
+TEST_F(gamma_file_cipher, completion_queue_reaps_every_request)
+{
+	WriteFile(*filesystem, path, data);
+	const NativeFile file(path, NativeFile::read_only, NativeFile::overlapped);
+	CompletionQueue queue(4);
+	queue.Associate(file);
+
+	std::vector<uint8_t> read_back(4 * chunk_size);
+	std::vector<int> tags(4);
+	for(size_t index = 0; index < tags.size(); ++index)
+		queue.SubmitRead(file, index * chunk_size, &read_back[index * chunk_size], chunk_size, &tags[index]);
+	EXPECT_EQ(4U, queue.GetPending());
+	EXPECT_THROW(queue.SubmitRead(file, 0, read_back.data(), chunk_size, nullptr), operation_failure); // KAA: full.
+
+	std::vector<CompletionQueue::completion_t> completions(4);
+	while(0 != queue.GetPending())
+	{
+		const auto reaped = queue.Wait(completions.data(), completions.size());
+		for(size_t index = 0; index < reaped; ++index)
+		{
+			EXPECT_EQ(0U, completions[index].error);
+			EXPECT_EQ(chunk_size, completions[index].bytes);
+			++*static_cast<int*>(completions[index].tag);
+		}
+	}
+	EXPECT_EQ(std::vector<int>(4, 1), tags);
+	EXPECT_EQ(std::vector<uint8_t>(data.begin(), data.begin() + read_back.size()), read_back);
+}
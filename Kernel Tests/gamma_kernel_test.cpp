@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include <vector>
+
+#include "../Kernel/GammaKernel.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	std::vector<uint8_t> MakeSequence(const size_t size, uint8_t seed)
+	{
+		std::vector<uint8_t> sequence(size);
+		for(auto& value : sequence)
+			value = seed = static_cast<uint8_t>(seed * 31U + 7U);
+		return sequence;
+	}
+}
+
+TEST(gamma_kernel, scalar_kernel_is_always_supported)
+{
+	EXPECT_TRUE(IsGammaKernelSupported(gamma_kernel_t::scalar));
+	EXPECT_TRUE(IsGammaKernelSupported(GetPreferredGammaKernel()));
+}
+
+TEST(gamma_kernel, vector_kernels_match_scalar_kernel)
+{
+	// KAA: sizes around vector and unrolled block boundaries, unaligned buffers.
+	const size_t sizes[] = { 0, 1, 15, 16, 17, 63, 64, 65, 255, 256, 257, 4096 + 3 };
+	const gamma_kernel_t kernels[] = { gamma_kernel_t::sse2, gamma_kernel_t::avx2, gamma_kernel_t::avx512 };
+	const auto reference = QueryGammaKernel(gamma_kernel_t::scalar);
+	for(const auto kernel : kernels)
+	{
+		if(!IsGammaKernelSupported(kernel))
+			continue;
+		const auto gamma = QueryGammaKernel(kernel);
+		for(const auto size : sizes)
+		{
+			const auto data = MakeSequence(size + 1, 0x11);
+			const auto key = MakeSequence(size + 1, 0x3C);
+			std::vector<uint8_t> expected(size + 1);
+			std::vector<uint8_t> actual(size + 1);
+			reference(&data[1], &key[1], expected.data() + 1, size);
+			gamma(&data[1], &key[1], actual.data() + 1, size);
+			EXPECT_EQ(expected, actual) << "kernel: " << static_cast<int>(kernel) << ", size: " << size;
+		}
+	}
+}
+
+TEST(gamma_kernel, in_place_gamma_is_reversible)
+{
+	const auto original = MakeSequence(64 * 1024 + 5, 0x01);
+	const auto key = MakeSequence(original.size(), 0x77);
+	auto data = original;
+	Gamma(data.data(), key.data(), data.data(), data.size());
+	EXPECT_NE(original, data);
+	Gamma(data.data(), key.data(), data.data(), data.size());
+	EXPECT_EQ(original, data);
+}
@@ -0,0 +1,102 @@
+#include "gtest/gtest.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "../Kernel/KeyGenerator.h"
+
+using namespace KAA::FileSecurity;
+
+TEST(key_generator, chacha20_block_matches_rfc_7539_test_vector)
+{
+	// KAA: RFC 7539, 2.3.2: counter 1, nonce 00:00:00:09:00:00:00:4a:00:00:00:00 - expressed as 64-bit counter and nonce.
+	uint32_t key[8];
+	for(uint32_t word = 0; word < 8; ++word)
+		key[word] = ( 4 * word ) | ( 4 * word + 1 ) << 8 | ( 4 * word + 2 ) << 16 | ( 4 * word + 3 ) << 24;
+	const uint64_t counter = 0x0900000000000001ULL;
+	const uint64_t nonce = 0x4a000000ULL;
+
+	const uint8_t expected[64] =
+	{
+		0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+		0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+		0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+		0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e
+	};
+	uint8_t block[64];
+	ChaCha20Block(key, counter, nonce, block);
+	EXPECT_EQ(0, std::memcmp(expected, block, sizeof(block)));
+}
+
+TEST(key_generator, requests_do_not_repeat)
+{
+	KeyGenerator generator;
+	constexpr size_t size = 8 * 1024 * 1024 + 17; // KAA: several batches with a ragged tail.
+	std::vector<uint8_t> first(size);
+	std::vector<uint8_t> second(size);
+	generator.Generate(first.size(), first.data());
+	generator.Generate(second.size(), second.data());
+
+	EXPECT_NE(first, second);
+	const auto half = size / 2;
+	EXPECT_NE(0, std::memcmp(first.data(), first.data() + half, 4096));
+	EXPECT_NE(std::vector<uint8_t>(64, 0), std::vector<uint8_t>(first.end() - 64, first.end()));
+}
+
+TEST(key_generator, concurrent_requests_do_not_repeat)
+{
+	KeyGenerator generator(2);
+	constexpr size_t size = 64 * 1024;
+	std::vector<std::vector<uint8_t>> keys(8, std::vector<uint8_t>(size));
+	std::vector<std::thread> requests;
+	for(auto& key : keys)
+		requests.emplace_back([&generator, &key] { generator.Generate(key.size(), key.data()); });
+	for(auto& request : requests)
+		request.join();
+
+	for(size_t index = 0; index < keys.size(); ++index)
+		for(size_t other = index + 1; other < keys.size(); ++other)
+			EXPECT_NE(0, std::memcmp(keys[index].data(), keys[other].data(), 64));
+}
+
+// KAA: slices filled by helper threads start at counter offsets of their own: a slice starting at the counter of another would repeat it.
+TEST(key_generator, slices_of_a_request_do_not_repeat)
+{
+	constexpr size_t slice = 1024 * 1024;
+	for(const auto helpers : { 0U, 1U, 3U, 7U })
+	{
+		KeyGenerator generator(1, helpers);
+		std::vector<uint8_t> key(8 * slice + 100);
+		generator.Generate(key.size(), key.data());
+		for(size_t index = 0; index < key.size() / slice; ++index)
+			for(size_t other = index + 1; other <= key.size() / slice; ++other)
+				EXPECT_NE(0, std::memcmp(&key[index * slice], &key[other * slice], 64)) << "helpers " << helpers << ", slices " << index << " and " << other;
+	}
+}
+
+// KAA: the next key is a keystream block of the stream; had it been given out in the tail of a request,
+// the following request would be the ChaCha20 output of that block. A single stream has nonce 0.
+TEST(key_generator, output_never_holds_the_next_key)
+{
+	for(size_t size = 193; size < 256; ++size)
+	{
+		KeyGenerator generator(1);
+		std::vector<uint8_t> output(size);
+		generator.Generate(output.size(), output.data());
+		uint8_t following[64];
+		generator.Generate(sizeof(following), following);
+
+		for(size_t offset = 0; offset + 32 <= size; offset += 64)
+		{
+			uint32_t key[8];
+			std::memcpy(key, &output[offset], sizeof(key));
+			for(uint64_t counter = 0; counter < 16; ++counter)
+			{
+				uint8_t block[64];
+				ChaCha20Block(key, counter, 0, block);
+				EXPECT_NE(0, std::memcmp(block, following, sizeof(block))) << "size " << size << ", offset " << offset;
+			}
+		}
+	}
+}
@@ -0,0 +1,243 @@
+#include "gtest/gtest.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "KAA/include/dll/module_context.h"
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/AbsoluteSecurityCore.h"
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/GammaFileCipher.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/MD5BasedKeyStorage.h"
+#include "../Kernel/MemoryFileSystem.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+// NOTE: the core loads names of its stages from the module for the progress handler, none is set here.
+KAA::dll::module_context core_dll;
+
+namespace
+{
+	const filesystem::driver::share share_read(true, false);
+	const filesystem::driver::permission read_only_attribute(false, true);
+
+	// RETURNS: system error code of the call, 0 if it has succeeded.
+	template <typename Call>
+	int ErrorOf(Call call)
+	{
+		try
+		{
+			call();
+		}
+		catch(const system_failure& error)
+		{
+			return error;
+		}
+		return 0;
+	}
+
+	class memory_file_system : public testing::Test
+	{
+	protected:
+		memory_file_system() :
+		filesystem(std::make_shared<MemoryFileSystem>()),
+		directory(LR"(C:\data)"),
+		path(directory + L"file.bin")
+		{
+			filesystem->create_directory(directory);
+		}
+
+		std::shared_ptr<filesystem::driver> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+	};
+}
+
+TEST_F(memory_file_system, reads_what_has_been_written)
+{
+	const auto data = MakeData(100000, 1);
+	WriteFile(*filesystem, path, data);
+	EXPECT_TRUE(filesystem::file_exists(*filesystem, path));
+	EXPECT_EQ(data.size(), filesystem::get_file_size(*filesystem, path));
+	EXPECT_EQ(data, ReadFile(*filesystem, filesystem::path::file { LR"(c:\DATA\File.bin)" }));
+}
+
+TEST_F(memory_file_system, creates_files_in_existing_directories_only)
+{
+	EXPECT_EQ(ENOENT, ErrorOf([this] { WriteFile(*filesystem, filesystem::path::file { LR"(C:\missing\file.bin)" }, MakeData(1, 0)); }));
+	WriteFile(*filesystem, path, MakeData(1, 0));
+	EXPECT_EQ(EEXIST, ErrorOf([this] { WriteFile(*filesystem, path, MakeData(1, 0)); }));
+	EXPECT_EQ(ENOENT, ErrorOf([this] { filesystem->open_file(directory + L"missing.bin", read_only, exclusive_access); }));
+}
+
+// NOTE: an existing file is neither opened nor truncated by create_file, the modes doing that are refused rather than ignored.
+TEST_F(memory_file_system, creates_new_files_only)
+{
+	const filesystem::driver::create_mode persistent_truncate_existing(true, true, true);
+	EXPECT_THROW(filesystem->create_file(path, persistent_truncate_existing, write_only, exclusive_access, allow_read_write), std::invalid_argument);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, path));
+
+	const auto data = MakeData(16, 1);
+	WriteFile(*filesystem, path, data);
+	EXPECT_THROW(filesystem->create_file(path, persistent_truncate_existing, write_only, exclusive_access, allow_read_write), std::invalid_argument);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+TEST_F(memory_file_system, honors_sharing)
+{
+	WriteFile(*filesystem, path, MakeData(16, 0));
+	{
+		const auto exclusive = filesystem->open_file(path, read_only, exclusive_access);
+		EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->open_file(path, read_only, share_read); }));
+		EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->remove_file(path); }));
+		EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->rename_file(path, directory + L"renamed.bin"); }));
+	}
+	{
+		const auto reader = filesystem->open_file(path, read_only, share_read);
+		EXPECT_EQ(0, ErrorOf([this] { filesystem->open_file(path, read_only, share_read); }));
+		EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->open_file(path, write_only, share_read); }));
+	}
+	EXPECT_EQ(0, ErrorOf([this] { filesystem->open_file(path, write_only, exclusive_access); }));
+}
+
+TEST_F(memory_file_system, protects_read_only_files)
+{
+	const auto data = MakeData(16, 0);
+	{
+		const auto file = filesystem->create_file(path, persistent_not_exists, write_only, exclusive_access, read_only_attribute);
+		EXPECT_EQ(data.size(), file->write(data.data(), data.size())); // KAA: the creating handle writes a read-only file, as key files are made.
+	}
+	EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->open_file(path, write_only, exclusive_access); }));
+	EXPECT_EQ(EACCES, ErrorOf([this] { filesystem->remove_file(path); }));
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+
+	filesystem->set_file_permissions(path, allow_read_write);
+	filesystem->remove_file(path);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, path));
+}
+
+TEST_F(memory_file_system, gives_unused_temp_names)
+{
+	const auto first = filesystem->get_temp_filename(directory);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, first));
+	WriteFile(*filesystem, first, MakeData(1, 0));
+	const auto second = filesystem->get_temp_filename(directory);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, second));
+	EXPECT_FALSE(first == second);
+	EXPECT_EQ(ENOENT, ErrorOf([this] { filesystem->get_temp_filename(filesystem::path::directory { LR"(C:\missing)" }); }));
+}
+
+TEST_F(memory_file_system, renames_files)
+{
+	const auto data = MakeData(16, 3);
+	const auto renamed = directory + L"renamed.bin";
+	WriteFile(*filesystem, path, data);
+	WriteFile(*filesystem, renamed, MakeData(1, 0));
+	EXPECT_EQ(EEXIST, ErrorOf([this, &renamed] { filesystem->rename_file(path, renamed); }));
+
+	filesystem->remove_file(renamed);
+	filesystem->rename_file(path, renamed);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, path));
+	EXPECT_EQ(data, ReadFile(*filesystem, renamed));
+}
+
+TEST_F(memory_file_system, removes_empty_directories_only)
+{
+	const filesystem::path::directory nested { LR"(C:\data\nested)" };
+	EXPECT_EQ(ENOENT, ErrorOf([this] { filesystem->create_directory(filesystem::path::directory { LR"(C:\missing\nested)" }); }));
+	filesystem->create_directory(nested);
+	EXPECT_EQ(EEXIST, ErrorOf([this, &nested] { filesystem->create_directory(nested); }));
+	EXPECT_EQ(ENOTEMPTY, ErrorOf([this] { filesystem->remove_directory(directory); }));
+
+	filesystem->remove_directory(nested);
+	filesystem->remove_directory(directory);
+	EXPECT_EQ(ENOENT, ErrorOf([this] { filesystem->remove_directory(directory); }));
+}
+
+// NOTE: stages of the absolute security core, key file made read-only and kept in the key storage.
+TEST_F(memory_file_system, runs_encryption_and_decryption)
+{
+	const auto io_policy = std::make_shared<IOPolicy>(io_parameters_t { 4096U, 1U });
+	const filesystem::path::directory key_storage_path { LR"(C:\keys)" };
+	filesystem->create_directory(key_storage_path);
+	GammaFileCipher cipher(filesystem, io_policy);
+	CRC32BasedKeyStorage key_storage(filesystem, key_storage_path);
+
+	const auto data = MakeData(10000, 5);
+	WriteFile(*filesystem, path, data);
+	const auto key_file = filesystem->get_temp_filename(key_storage_path);
+	WriteFile(*filesystem, key_file, MakeData(data.size(), 11), read_only_attribute);
+
+	cipher.EncryptFile(path, key_file);
+	const auto key_path = key_storage.GetKeyPathForSpecifiedPath(path);
+	key_storage.StoreKey(key_file, key_path);
+	EXPECT_NE(data, ReadFile(*filesystem, path));
+	EXPECT_TRUE(key_storage.ContainsKey(key_path));
+
+	const auto loaded_key_file = key_storage.LoadKey(key_path);
+	cipher.DecryptFile(path, loaded_key_file);
+	key_storage.RemoveKey(key_path, loaded_key_file);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_FALSE(key_storage.ContainsKey(key_path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, key_path));
+}
+
+// NOTE: the core the communicator runs: key generation, every key storage the settings select, every cipher over the driver.
+TEST_F(memory_file_system, runs_absolute_security_core)
+{
+	const auto io_policy = std::make_shared<IOPolicy>(io_parameters_t { 4096U, 1U });
+	const filesystem::path::directory key_storage_path { LR"(C:\keys)" };
+	filesystem->create_directory(key_storage_path);
+	const auto data = MakeData(10000, 5);
+	WriteFile(*filesystem, path, data);
+
+	for(const auto key_storage : { key_storage_t::md5_based, key_storage_t::blake3_based, key_storage_t::packed })
+	for(const auto cipher : { gamma_cipher, pipelined_gamma_cipher, mapped_gamma_cipher, parallel_gamma_cipher, fused_gamma_cipher, async_gamma_cipher })
+	{
+		AbsoluteSecurityCore core(filesystem, io_policy, key_storage_path, cipher, key_storage, key_storage_layout_t::flat);
+		core.EncryptFile(path);
+		EXPECT_NE(data, ReadFile(*filesystem, path));
+		EXPECT_TRUE(core.IsFileEncrypted(path));
+
+		core.DecryptFile(path);
+		EXPECT_EQ(data, ReadFile(*filesystem, path));
+		EXPECT_FALSE(core.IsFileEncrypted(path));
+	}
+}
+
+// NOTE: a store written by MD5 naming, then opened with BLAKE3 naming: the key is found by its MD5 name.
+TEST_F(memory_file_system, finds_md5_named_keys_with_blake3_key_storage)
+{
+	const auto io_policy = std::make_shared<IOPolicy>(io_parameters_t { 4096U, 1U });
+	const filesystem::path::directory key_storage_path { LR"(C:\keys)" };
+	filesystem->create_directory(key_storage_path);
+	const auto data = MakeData(10000, 5);
+	WriteFile(*filesystem, path, data);
+
+	AbsoluteSecurityCore(filesystem, io_policy, key_storage_path, gamma_cipher, key_storage_t::md5_based, key_storage_layout_t::flat).EncryptFile(path);
+	const auto legacy_key_path = MD5BasedKeyStorage(filesystem, io_policy, key_storage_path).GetKeyPathForSpecifiedPath(path);
+	ASSERT_TRUE(filesystem::file_exists(*filesystem, legacy_key_path));
+
+	// KAA: without the key path cache of the first session the BLAKE3 storage looks the key up itself.
+	const auto journal_path = key_storage_path + L"key_paths.cache";
+	if(filesystem::file_exists(*filesystem, journal_path))
+		filesystem->remove_file(journal_path);
+
+	AbsoluteSecurityCore core(filesystem, io_policy, key_storage_path, gamma_cipher, key_storage_t::blake3_based, key_storage_layout_t::flat);
+	EXPECT_TRUE(core.IsFileEncrypted(path));
+	core.DecryptFile(path);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_FALSE(core.IsFileEncrypted(path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, legacy_key_path));
+}
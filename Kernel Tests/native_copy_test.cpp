@@ -0,0 +1,100 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/CancellationToken.h"
+#include "../Kernel/NativeCopy.h"
+#include "../Kernel/NativeFileSystem.h"
+
+#include "test_helpers.h"
+
+#include <windows.h>
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	// NOTE: files of the disk through the native driver; the volume of the working directory may or may not clone blocks.
+	class native_copy : public testing::Test
+	{
+	protected:
+		native_copy() :
+		filesystem(false),
+		directory(LR"(.\native_copy_test)"),
+		source(directory + L"source.bin"),
+		destination(directory + L"destination.bin"),
+		data(MakeData(3 * 1024 * 1024 + 17, 1))
+		{
+			filesystem.create_directory(directory);
+			const auto file = filesystem.create_file(source, persistent_not_exists, write_only, exclusive_access, allow_read_write);
+			file->write(data.data(), data.size());
+			file->commit();
+		}
+
+		~native_copy()
+		{
+			for(const auto& file : { source, destination })
+				if(filesystem::file_exists(filesystem, file))
+					filesystem.remove_file(file);
+			filesystem.remove_directory(directory);
+		}
+
+		bool CanCloneBlocks(void) const
+		{
+			DWORD flags = 0;
+			return ( 0 != ::GetVolumeInformationW(nullptr, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0) ) && ( 0 != ( flags & FILE_SUPPORTS_BLOCK_REFCOUNTING ) );
+		}
+
+		std::vector<uint8_t> ReadDestination(void)
+		{
+			const auto file = filesystem.open_file(destination, read_only, exclusive_access);
+			std::vector<uint8_t> read_back(file->get_size());
+			read_back.resize(file->read(read_back.size(), read_back.data()));
+			return read_back;
+		}
+
+		NativeFileSystem filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file source;
+		const filesystem::path::file destination;
+		const std::vector<uint8_t> data;
+	};
+}
+
+// NOTE: a volume without block cloning (NTFS, FAT) leaves the copy to the fallbacks, nothing is created or reported.
+TEST_F(native_copy, clone_leaves_the_copy_to_the_fallback_on_volumes_without_block_cloning)
+{
+	uint64_t reported = 0;
+	const auto cloned = CloneFile(source, destination, [&reported](const uint64_t size) { reported += size; return progress_state_t::proceed; });
+	if(CanCloneBlocks())
+	{
+		ASSERT_TRUE(cloned);
+		EXPECT_EQ(data.size(), reported);
+		EXPECT_EQ(data, ReadDestination());
+		return;
+	}
+	EXPECT_FALSE(cloned);
+	EXPECT_EQ(0U, reported);
+	EXPECT_FALSE(filesystem::file_exists(filesystem, destination));
+}
+
+TEST_F(native_copy, system_copy_reports_every_byte)
+{
+	uint64_t reported = 0;
+	ASSERT_TRUE(SystemCopyFile(source, destination, [&reported](const uint64_t size) { reported += size; return progress_state_t::proceed; }));
+	EXPECT_EQ(data.size(), reported);
+	EXPECT_EQ(data, ReadDestination());
+}
+
+TEST_F(native_copy, system_copy_cancelled_leaves_no_destination)
+{
+	EXPECT_THROW(SystemCopyFile(source, destination, [](uint64_t) { return progress_state_t::cancel; }), OperationCancelled);
+	EXPECT_FALSE(filesystem::file_exists(filesystem, destination));
+}
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/NativeFileSystem.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	// NOTE: unbuffered streams of the native driver on a directory of the disk, sector sizes are those of the volume.
+	class native_file_system : public testing::Test
+	{
+	protected:
+		native_file_system() :
+		filesystem(true),
+		directory(LR"(.\native_file_system_test)"),
+		path(directory + L"file.bin")
+		{
+			filesystem.create_directory(directory);
+		}
+
+		~native_file_system()
+		{
+			if(filesystem::file_exists(filesystem, path))
+				filesystem.remove_file(path);
+			filesystem.remove_directory(directory);
+		}
+
+		NativeFileSystem filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+	};
+}
+
+// NOTE: the stream writes whole sectors, the padding of the tail is cut off: the file is as long as the data written.
+TEST_F(native_file_system, unbuffered_streams_keep_the_size_of_the_data)
+{
+	const auto data = MakeData(10000, 1); // KAA: not a multiple of any sector size.
+	{
+		const auto file = filesystem.create_file(path, persistent_not_exists, write_only, exclusive_access, allow_read_write);
+		EXPECT_EQ(3001U, file->write(data.data(), 3001));
+		EXPECT_EQ(data.size() - 3001, file->write(data.data() + 3001, data.size() - 3001));
+		file->commit();
+	}
+	EXPECT_EQ(data.size(), filesystem::get_file_size(filesystem, path));
+
+	const auto file = filesystem.open_file(path, read_only, exclusive_access);
+	std::vector<uint8_t> read_back(data.size() + 1000);
+	size_t total = 0;
+	for(size_t bytes_read = 1; 0 != bytes_read; total += bytes_read)
+		bytes_read = file->read(std::min<size_t>(777U, read_back.size() - total), read_back.data() + total); // KAA: reads across sector bounds.
+	read_back.resize(total);
+	EXPECT_EQ(data, read_back);
+}
+
+// NOTE: an existing file is neither opened nor truncated by create_file, the modes doing that are refused rather than ignored.
+TEST_F(native_file_system, creates_new_files_only)
+{
+	const filesystem::driver::create_mode persistent_truncate_existing(true, true, true);
+	EXPECT_THROW(filesystem.create_file(path, persistent_truncate_existing, write_only, exclusive_access, allow_read_write), std::invalid_argument);
+	EXPECT_FALSE(filesystem::file_exists(filesystem, path));
+
+	const auto data = MakeData(100, 2);
+	{
+		const auto file = filesystem.create_file(path, persistent_not_exists, write_only, exclusive_access, allow_read_write);
+		file->write(data.data(), data.size());
+		file->commit();
+	}
+	EXPECT_THROW(filesystem.create_file(path, persistent_truncate_existing, write_only, exclusive_access, allow_read_write), std::invalid_argument);
+	EXPECT_EQ(data.size(), filesystem::get_file_size(filesystem, path));
+}
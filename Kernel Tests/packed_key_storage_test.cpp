@@ -0,0 +1,395 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "KAA/include/filesystem/crt_file_system.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/Blake3BasedKeyStorage.h"
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/IOPolicy.h"
+#include "../Kernel/MD5BasedKeyStorage.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/PackedKeyStorage.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	std::vector<uint8_t> ReadStream(filesystem::file& file)
+	{
+		std::vector<uint8_t> data(file.get_size());
+		data.resize(file.read(data.size(), data.data()));
+		return data;
+	}
+
+	class packed_key_storage : public testing::Test
+	{
+	protected:
+		packed_key_storage() :
+		filesystem(std::make_shared<MemoryFileSystem>()),
+		directory(LR"(C:\keys)"),
+		container(directory + L"keys.0.pack")
+		{
+			filesystem->create_directory(directory);
+		}
+
+		std::unique_ptr<PackedKeyStorage> MakeStorage(void) const
+		{
+			return std::make_unique<PackedKeyStorage>(std::make_unique<CRC32BasedKeyStorage>(filesystem, directory), filesystem);
+		}
+
+		// RETURNS: key path of the key, the key file is stored and removed.
+		filesystem::path::file StoreKey(KeyStorage& storage, const wchar_t* name, const std::vector<uint8_t>& key) const
+		{
+			const auto key_file = filesystem->get_temp_filename(directory);
+			WriteFile(*filesystem, key_file, key);
+			const auto key_path = directory + name;
+			storage.StoreKey(key_file, key_path);
+			return key_path;
+		}
+
+		std::vector<uint8_t> LoadKey(KeyStorage& storage, const filesystem::path::file& key_path) const
+		{
+			const auto key_file = storage.LoadKey(key_path);
+			const auto key = ReadFile(*filesystem, key_file);
+			storage.UnloadKey(key_path, key_file);
+			return key;
+		}
+
+		void RemoveKey(KeyStorage& storage, const filesystem::path::file& key_path) const
+		{
+			storage.RemoveKey(key_path, storage.LoadKey(key_path));
+		}
+
+		std::shared_ptr<filesystem::driver> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file container;
+	};
+}
+
+TEST_F(packed_key_storage, keeps_keys_in_the_container)
+{
+	const auto storage = MakeStorage();
+	const auto key = MakeData(5000, 1);
+	const auto key_path = StoreKey(*storage, L"first.bin", key);
+
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, key_path));
+	EXPECT_TRUE(storage->ContainsKey(key_path));
+	EXPECT_EQ(key, ReadFile(*filesystem, container));
+
+	const auto key_file = storage->LoadKey(key_path);
+	EXPECT_NE(key_path.to_wstring(), key_file.to_wstring());
+	EXPECT_EQ(key, ReadFile(*filesystem, key_file));
+	storage->UnloadKey(key_path, key_file);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, key_file));
+}
+
+TEST_F(packed_key_storage, opens_keys_in_place)
+{
+	const auto storage = MakeStorage();
+	const auto first = MakeData(3000, 20);
+	const auto second = MakeData(2000, 21);
+	const auto first_path = StoreKey(*storage, L"first.bin", first);
+	const auto second_path = StoreKey(*storage, L"second.bin", second);
+
+	auto key = storage->OpenKey(second_path);
+	ASSERT_NE(nullptr, key);
+	EXPECT_EQ(second.size(), key->get_size());
+	EXPECT_EQ(second, ReadStream(*key));
+	key->seek(1000, filesystem::file::set);
+	std::vector<uint8_t> tail(2000);
+	EXPECT_EQ(1000U, key->read(tail.size(), tail.data()));
+	EXPECT_TRUE(std::equal(second.begin() + 1000, second.end(), tail.begin()));
+	key.reset();
+
+	// KAA: the key path stands for the key file of a stream.
+	storage->RemoveKey(second_path, second_path);
+	EXPECT_FALSE(storage->ContainsKey(second_path));
+	auto expected = first;
+	expected.insert(expected.end(), second.size(), 0);
+	EXPECT_EQ(expected, ReadFile(*filesystem, container));
+	EXPECT_EQ(nullptr, storage->OpenKey(second_path));
+}
+
+// NOTE: a key read while the container is compacted: the compacted container is removed with the stream.
+TEST_F(packed_key_storage, keeps_the_compacted_container_while_a_key_is_read)
+{
+	const auto storage = MakeStorage();
+	const auto first = MakeData(1000, 22);
+	const auto second = MakeData(4000, 23);
+	const auto first_path = StoreKey(*storage, L"first.bin", first);
+	const auto second_path = StoreKey(*storage, L"second.bin", second);
+
+	auto key = storage->OpenKey(second_path);
+	ASSERT_NE(nullptr, key);
+	RemoveKey(*storage, first_path);
+	EXPECT_EQ(first.size(), storage->Compact());
+	EXPECT_TRUE(filesystem::file_exists(*filesystem, container));
+	EXPECT_EQ(second, ReadStream(*key));
+
+	key.reset();
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, container));
+	EXPECT_EQ(second, LoadKey(*storage, second_path));
+}
+
+TEST_F(packed_key_storage, stores_keys_from_several_threads)
+{
+	constexpr size_t thread_count = 4;
+	constexpr size_t keys_per_thread = 8;
+	const auto storage = MakeStorage();
+	std::vector<std::thread> threads;
+	for(size_t thread = 0; thread < thread_count; ++thread)
+		threads.emplace_back([this, &storage, thread]
+		{
+			for(size_t number = 0; number < keys_per_thread; ++number)
+			{
+				const auto seed = static_cast<uint8_t>(thread * keys_per_thread + number);
+				StoreKey(*storage, ( L"key" + std::to_wstring(seed) + L".bin" ).c_str(), MakeData(1000 + seed, seed));
+			}
+		});
+	for(auto& thread : threads)
+		thread.join();
+
+	uint64_t stored = 0;
+	for(size_t seed = 0; seed < thread_count * keys_per_thread; ++seed)
+	{
+		const auto key = MakeData(1000 + seed, static_cast<uint8_t>(seed));
+		EXPECT_EQ(key, LoadKey(*storage, directory + ( L"key" + std::to_wstring(seed) + L".bin" )));
+		stored += key.size();
+	}
+	EXPECT_EQ(stored, filesystem::get_file_size(*filesystem, container));
+}
+
+TEST_F(packed_key_storage, wipes_removed_keys_at_once)
+{
+	const auto storage = MakeStorage();
+	const auto first = MakeData(3000, 2);
+	const auto second = MakeData(2000, 3);
+	const auto first_path = StoreKey(*storage, L"first.bin", first);
+	const auto second_path = StoreKey(*storage, L"second.bin", second);
+
+	RemoveKey(*storage, first_path);
+	EXPECT_FALSE(storage->ContainsKey(first_path));
+	EXPECT_TRUE(storage->ContainsKey(second_path));
+
+	auto expected = std::vector<uint8_t>(first.size(), 0);
+	expected.insert(expected.end(), second.begin(), second.end());
+	EXPECT_EQ(expected, ReadFile(*filesystem, container));
+	EXPECT_EQ(second, LoadKey(*storage, second_path));
+}
+
+TEST_F(packed_key_storage, wipes_superseded_keys)
+{
+	const auto storage = MakeStorage();
+	const auto older = MakeData(1000, 4);
+	const auto newer = MakeData(1500, 5);
+	StoreKey(*storage, L"key.bin", older);
+	const auto key_path = StoreKey(*storage, L"key.bin", newer);
+
+	auto expected = std::vector<uint8_t>(older.size(), 0);
+	expected.insert(expected.end(), newer.begin(), newer.end());
+	EXPECT_EQ(expected, ReadFile(*filesystem, container));
+	EXPECT_EQ(newer, LoadKey(*storage, key_path));
+}
+
+TEST_F(packed_key_storage, compaction_reclaims_removed_keys)
+{
+	const auto storage = MakeStorage();
+	const auto first = MakeData(1000, 6);
+	const auto second = MakeData(4000, 7);
+	const auto third = MakeData(2000, 8);
+	const auto first_path = StoreKey(*storage, L"first.bin", first);
+	const auto second_path = StoreKey(*storage, L"second.bin", second);
+	const auto third_path = StoreKey(*storage, L"third.bin", third);
+	RemoveKey(*storage, second_path);
+
+	EXPECT_EQ(second.size(), storage->Compact());
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, container));
+	EXPECT_EQ(first.size() + third.size(), filesystem::get_file_size(*filesystem, directory + L"keys.1.pack"));
+	EXPECT_EQ(first, LoadKey(*storage, first_path));
+	EXPECT_EQ(third, LoadKey(*storage, third_path));
+	EXPECT_FALSE(storage->ContainsKey(second_path));
+
+	// KAA: keys stored after the compaction go to the compacted container.
+	const auto fourth = MakeData(500, 9);
+	const auto fourth_path = StoreKey(*storage, L"fourth.bin", fourth);
+	EXPECT_EQ(fourth, LoadKey(*storage, fourth_path));
+}
+
+TEST_F(packed_key_storage, reloads_the_index)
+{
+	const auto first = MakeData(1000, 10);
+	const auto second = MakeData(3000, 11);
+	filesystem::path::file first_path;
+	filesystem::path::file second_path;
+	{
+		const auto storage = MakeStorage();
+		first_path = StoreKey(*storage, L"first.bin", first);
+		second_path = StoreKey(*storage, L"second.bin", second);
+		RemoveKey(*storage, first_path);
+		storage->Compact();
+		StoreKey(*storage, L"third.bin", first);
+		RemoveKey(*storage, directory + L"third.bin");
+	}
+
+	const auto storage = MakeStorage();
+	EXPECT_FALSE(storage->ContainsKey(first_path));
+	EXPECT_FALSE(storage->ContainsKey(directory + L"third.bin"));
+	EXPECT_EQ(second, LoadKey(*storage, second_path));
+}
+
+TEST_F(packed_key_storage, finishes_an_interrupted_compaction)
+{
+	const auto key = MakeData(1000, 12);
+	const auto index_path = directory + L"keys.index";
+	const auto pending_index_path = directory + L"keys.index.new";
+	filesystem::path::file key_path;
+	std::vector<uint8_t> index;
+	std::vector<uint8_t> packed;
+	{
+		const auto storage = MakeStorage();
+		key_path = StoreKey(*storage, L"key.bin", key);
+		index = ReadFile(*filesystem, index_path);
+		packed = ReadFile(*filesystem, container);
+		storage->Compact();
+	}
+
+	// KAA: as if interrupted once the compacted index was complete: the old index and container are still there.
+	filesystem->rename_file(index_path, pending_index_path);
+	WriteFile(*filesystem, index_path, index);
+	WriteFile(*filesystem, container, packed);
+	{
+		const auto storage = MakeStorage();
+		EXPECT_EQ(key, LoadKey(*storage, key_path));
+		EXPECT_FALSE(filesystem::file_exists(*filesystem, pending_index_path));
+		EXPECT_FALSE(filesystem::file_exists(*filesystem, container));
+	}
+
+	// KAA: as if interrupted before: the compacted container is left behind.
+	const auto compacted = directory + L"keys.2.pack";
+	WriteFile(*filesystem, compacted, packed);
+	const auto storage = MakeStorage();
+	EXPECT_EQ(key, LoadKey(*storage, key_path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, compacted));
+}
+
+// NOTE: a directory job opens the key storage of the core again: both instances work with one index.
+TEST_F(packed_key_storage, instances_on_one_directory_share_the_container)
+{
+	const auto first_storage = MakeStorage();
+	const auto second_storage = MakeStorage();
+	const auto first = MakeData(1000, 13);
+	const auto second = MakeData(2000, 14);
+	const auto first_path = StoreKey(*first_storage, L"first.bin", first);
+	const auto second_path = StoreKey(*first_storage, L"second.bin", second);
+
+	EXPECT_TRUE(second_storage->ContainsKey(first_path));
+	EXPECT_EQ(first, LoadKey(*second_storage, first_path));
+	RemoveKey(*second_storage, first_path);
+	EXPECT_FALSE(first_storage->ContainsKey(first_path));
+
+	EXPECT_EQ(first.size(), first_storage->Compact());
+	EXPECT_EQ(second, LoadKey(*second_storage, second_path));
+	const auto third = MakeData(500, 15);
+	const auto third_path = StoreKey(*second_storage, L"third.bin", third);
+	EXPECT_EQ(third, LoadKey(*first_storage, third_path));
+}
+
+TEST_F(packed_key_storage, stores_keys_through_another_instance_while_compacting)
+{
+	constexpr size_t key_count = 20;
+	std::vector<filesystem::path::file> kept;
+	std::vector<filesystem::path::file> removed;
+	{
+		const auto compacting_storage = MakeStorage();
+		const auto storing_storage = MakeStorage();
+		for(size_t number = 0; number < key_count; ++number)
+		{
+			const auto key_path = StoreKey(*compacting_storage, ( L"old" + std::to_wstring(number) + L".bin" ).c_str(), MakeData(3000, static_cast<uint8_t>(number)));
+			( 0 == number % 2 ? kept : removed ).push_back(key_path);
+		}
+		for(const auto& key_path : removed)
+			RemoveKey(*compacting_storage, key_path);
+
+		std::thread compaction([&compacting_storage] { compacting_storage->Compact(); });
+		for(size_t number = 0; number < key_count; ++number)
+		{
+			kept.push_back(StoreKey(*storing_storage, ( L"new" + std::to_wstring(number) + L".bin" ).c_str(), MakeData(3000, static_cast<uint8_t>(key_count + number))));
+			EXPECT_EQ(3000U, LoadKey(*storing_storage, kept[number % kept.size()]).size());
+		}
+		compaction.join();
+	}
+
+	// KAA: the next session sees every key stored meanwhile, whichever container it has gone to.
+	const auto storage = MakeStorage();
+	for(const auto& key_path : kept)
+		EXPECT_TRUE(storage->ContainsKey(key_path));
+	for(const auto& key_path : removed)
+		EXPECT_FALSE(storage->ContainsKey(key_path));
+	EXPECT_EQ(MakeData(3000, static_cast<uint8_t>(key_count)), LoadKey(*storage, directory + L"new0.bin"));
+	EXPECT_EQ(MakeData(3000, 2), LoadKey(*storage, directory + L"old2.bin"));
+}
+
+TEST_F(packed_key_storage, finds_keys_stored_as_files)
+{
+	const auto storage = MakeStorage();
+	const auto key = MakeData(700, 15);
+	const auto key_path = directory + L"loose.bin";
+	WriteFile(*filesystem, key_path, key);
+
+	EXPECT_TRUE(storage->ContainsKey(key_path));
+	EXPECT_EQ(nullptr, storage->OpenKey(key_path));
+	const auto key_file = storage->LoadKey(key_path);
+	EXPECT_EQ(key_path, key_file);
+	EXPECT_EQ(key, ReadFile(*filesystem, key_file));
+	storage->UnloadKey(key_path, key_file);
+	EXPECT_TRUE(filesystem::file_exists(*filesystem, key_path));
+}
+
+// NOTE: BLAKE3 hashing reads Windows files, the key storage directory is on the disk.
+TEST(packed_blake3_key_storage, prefers_packed_keys_to_md5_named_files)
+{
+	const auto filesystem = std::make_shared<filesystem::crt_file_system>();
+	const auto io_policy = std::make_shared<IOPolicy>(io_parameters_t { 4096U, 1U });
+	const filesystem::path::directory directory { LR"(.\packed_key_storage_test)" };
+	filesystem->create_directory(directory);
+	const auto path = directory + L"file.bin";
+	WriteFile(*filesystem, path, MakeData(10000, 16));
+
+	auto naming = std::make_unique<Blake3BasedKeyStorage>(filesystem, io_policy, directory);
+	auto& key_names = *naming;
+	PackedKeyStorage storage(std::move(naming), filesystem);
+	key_names.SetKeyLookup(&storage);
+
+	const auto legacy_key_path = MD5BasedKeyStorage(filesystem, io_policy, directory).GetKeyPathForSpecifiedPath(path);
+	WriteFile(*filesystem, legacy_key_path, MakeData(10000, 17));
+	const auto key_path = storage.GetKeyPathForSpecifiedPath(path);
+	EXPECT_EQ(legacy_key_path, key_path); // KAA: nothing is packed yet.
+	filesystem->remove_file(legacy_key_path);
+
+	const auto packed_key_path = storage.GetKeyPathForSpecifiedPath(path);
+	const auto key_file = filesystem->get_temp_filename(directory);
+	WriteFile(*filesystem, key_file, MakeData(10000, 18));
+	storage.StoreKey(key_file, packed_key_path);
+	WriteFile(*filesystem, legacy_key_path, MakeData(10000, 17));
+	EXPECT_EQ(packed_key_path, storage.GetKeyPathForSpecifiedPath(path));
+
+	storage.RemoveKey(packed_key_path, storage.LoadKey(packed_key_path));
+	storage.Compact();
+	for(const auto& name : { L"keys.index", L"keys.1.pack", L"file.bin" })
+		filesystem->remove_file(directory + name);
+	filesystem->remove_file(legacy_key_path);
+	filesystem->remove_directory(directory);
+}
@@ -0,0 +1,117 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Kernel/CancellationToken.h"
+#include "../Kernel/ProgressCounter.h"
+#include "../Kernel/ProgressRelay.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	constexpr auto interval = std::chrono::milliseconds(1);
+
+	// KAA: records what it gets, called by one thread at a time.
+	class RecordingHandler final : public CommunicatorProgressHandler
+	{
+	public:
+		explicit RecordingHandler(const KAA::progress_state_t reply) :
+		reply(reply),
+		processed(0)
+		{}
+
+		std::vector<std::string> events;
+		uint64_t processed;
+
+	private:
+		const KAA::progress_state_t reply;
+
+		KAA::progress_state_t IOperationStarted(const std::string& name, uint64_t) override
+		{
+			events.push_back(name + " after " + std::to_string(processed));
+			return KAA::progress_state_t::proceed;
+		}
+
+		KAA::progress_state_t IOperationProgress(const uint64_t portion) override
+		{
+			processed += portion;
+			return reply;
+		}
+	};
+}
+
+TEST(progress_relay, delivers_everything_published)
+{
+	const auto consumer = std::make_shared<RecordingHandler>(KAA::progress_state_t::proceed);
+	ProgressRelay relay(consumer, interval);
+	const auto counter = relay.GetCounter();
+
+	std::vector<std::thread> workers;
+	for(int worker = 0; worker < 4; ++worker)
+		workers.emplace_back([&] { for(int chunk = 0; chunk < 1000; ++chunk) counter->Publish(64); });
+	for(auto& worker : workers)
+		worker.join();
+	relay.Flush();
+
+	EXPECT_EQ(4U * 1000U * 64U, consumer->processed);
+}
+
+TEST(progress_relay, reports_stage_after_earlier_progress)
+{
+	const auto consumer = std::make_shared<RecordingHandler>(KAA::progress_state_t::proceed);
+	{
+		ProgressRelay relay(consumer, std::chrono::hours(1)); // KAA: nothing is reported by the interval.
+		CommunicatorProgressHandler& handler = relay;
+		handler.OperationStarted("first", 10);
+		handler.OperationProgress(10);
+		handler.OperationStarted("second", 5);
+		handler.OperationProgress(5);
+	}
+
+	ASSERT_EQ(2U, consumer->events.size());
+	EXPECT_EQ("first after 0", consumer->events[0]);
+	EXPECT_EQ("second after 10", consumer->events[1]);
+	EXPECT_EQ(15U, consumer->processed); // KAA: the rest is reported on destruction.
+}
+
+TEST(progress_relay, passes_consumer_state_to_workers)
+{
+	ProgressRelay relay(std::make_shared<RecordingHandler>(KAA::progress_state_t::cancel), interval);
+	const auto counter = relay.GetCounter();
+
+	EXPECT_EQ(KAA::progress_state_t::proceed, counter->Publish(1));
+	EXPECT_FALSE(relay.GetCancellationToken()->IsCancelled());
+	relay.Flush();
+	EXPECT_EQ(KAA::progress_state_t::cancel, counter->Publish(1));
+	EXPECT_TRUE(relay.GetCancellationToken()->IsCancelled());
+	EXPECT_THROW(relay.GetCancellationToken()->Check(), OperationCancelled);
+}
+
+// NOTE: the consumer wants no portions and nothing is published: the cancellation check alone cancels the workers.
+TEST(progress_relay, cancels_quiet_stages_without_progress)
+{
+	std::atomic<bool> cancelled(false);
+	ProgressRelay relay(std::make_shared<RecordingHandler>(KAA::progress_state_t::quiet), interval, [&cancelled] { return cancelled.load(); });
+	const auto token = relay.GetCancellationToken();
+	CommunicatorProgressHandler& handler = relay;
+	handler.OperationStarted("stage", 10);
+	handler.OperationProgress(1);
+	relay.Flush();
+
+	cancelled = true;
+	while(!token->IsCancelled())
+		std::this_thread::sleep_for(interval);
+	EXPECT_EQ(KAA::progress_state_t::cancel, relay.GetCounter()->Publish(0));
+}
+
+TEST(progress_relay, rejects_invalid_arguments)
+{
+	EXPECT_ANY_THROW(ProgressRelay(nullptr, interval));
+	EXPECT_ANY_THROW(ProgressRelay(std::make_shared<RecordingHandler>(KAA::progress_state_t::proceed), std::chrono::milliseconds::zero()));
+}
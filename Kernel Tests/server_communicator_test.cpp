@@ -0,0 +1,686 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include <windows.h>
+
+// FUTURE: KAA: remove <windows.h>
+#undef EncryptFile
+#undef DecryptFile
+
+#include "../Common/CommunicatorProgressHandler.h"
+
+#include "../Kernel/CancellationToken.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/NativeFileSystem.h"
+#include "../Kernel/ServerCommunicator.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	bool IsInDirectory(const filesystem::path::file& path, const std::wstring& directory)
+	{
+		return 0 == path.to_wstring().compare(0, directory.size(), directory);
+	}
+
+	// NOTE: the memory driver with faults injected: opening the path given for writing fails, so does the rename of a file of the directory given
+	// once as many renames of the directory have been done as it is told. Temporary names handed out are kept to find the files left behind.
+	class FaultyFileSystem final : public filesystem::driver
+	{
+	public:
+		FaultyFileSystem() :
+		volume(std::make_shared<MemoryFileSystem>()),
+		renames_left(0)
+		{}
+
+		void FailWrites(const filesystem::path::file& path)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			write_fault = path.to_wstring();
+		}
+
+		void FailRename(const filesystem::path::directory& directory, const unsigned renames_to_pass)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			rename_fault = directory.to_wstring();
+			renames_left = renames_to_pass + 1;
+		}
+
+		// RETURNS: temporary files of the directory that exist.
+		std::vector<filesystem::path::file> GetTempFilesLeft(const filesystem::path::directory& directory) const
+		{
+			std::vector<filesystem::path::file> left;
+			std::lock_guard<std::mutex> lock(guard);
+			for(const auto& path : temp_names)
+				if(IsInDirectory(path, directory.to_wstring()) && filesystem::file_exists(*volume, path))
+					left.push_back(path);
+			return left;
+		}
+
+	private:
+		std::shared_ptr<filesystem::driver> volume;
+		mutable std::mutex guard;
+		std::wstring write_fault;
+		std::wstring rename_fault;
+		unsigned renames_left;
+		mutable std::vector<filesystem::path::file> temp_names;
+
+		bool IsRenameFault(const filesystem::path::file& path)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			if(( 0 == renames_left ) || !IsInDirectory(path, rename_fault))
+				return false;
+			return 0 == --renames_left;
+		}
+
+		std::unique_ptr<filesystem::file> icreate_file(const filesystem::path::file& path, const create_mode creation, const mode mode, const share share, const permission permission) const override
+		{
+			return volume->create_file(path, creation, mode, share, permission);
+		}
+
+		std::unique_ptr<filesystem::file> iopen_file(const filesystem::path::file& path, const mode mode, const share share) const override
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				if(mode.write && ( path.to_wstring() == write_fault ))
+					throw system_failure { __FUNCTION__, "fault injected", EACCES };
+			}
+			return volume->open_file(path, mode, share);
+		}
+
+		void iremove_file(const filesystem::path::file& path) override
+		{
+			volume->remove_file(path);
+		}
+
+		void irename_file(const filesystem::path::file& old_path, const filesystem::path::file& new_path) override
+		{
+			if(IsRenameFault(new_path))
+				throw system_failure { __FUNCTION__, "fault injected", EACCES };
+			volume->rename_file(old_path, new_path);
+		}
+
+		void iset_file_permissions(const filesystem::path::file& path, const permission permission) override
+		{
+			volume->set_file_permissions(path, permission);
+		}
+
+		bool icheck_access(const filesystem::path::file& path, const access_mode mode) const override
+		{
+			return volume->check_access(path, mode);
+		}
+
+		filesystem::path::directory iget_current_working_directory(void) const override
+		{
+			return volume->get_current_working_directory();
+		}
+
+		void iset_current_working_directory(const filesystem::path::directory& path) override
+		{
+			volume->set_current_working_directory(path);
+		}
+
+		filesystem::path::file iget_temp_filename(const filesystem::path::directory& path) const override
+		{
+			auto temp_name = volume->get_temp_filename(path);
+			std::lock_guard<std::mutex> lock(guard);
+			temp_names.push_back(temp_name);
+			return temp_name;
+		}
+
+		void icreate_directory(const filesystem::path::directory& path) override
+		{
+			volume->create_directory(path);
+		}
+
+		void iremove_directory(const filesystem::path::directory& path) override
+		{
+			volume->remove_directory(path);
+		}
+	};
+
+	// NOTE: cancels the operation at its first portion of progress.
+	class CancellingProgressHandler final : public CommunicatorProgressHandler
+	{
+	private:
+		progress_state_t IOperationStarted(const std::string&, uint64_t) override
+		{
+			return progress_state_t::proceed;
+		}
+
+		progress_state_t IOperationProgress(uint64_t) override
+		{
+			return progress_state_t::cancel;
+		}
+	};
+
+	// NOTE: holds the operation at its start until released, so that operations queued after it wait. The start is answered by reply.
+	class BlockingProgressHandler final : public CommunicatorProgressHandler
+	{
+	public:
+		explicit BlockingProgressHandler(const progress_state_t reply = progress_state_t::proceed) :
+		release_signal(release.get_future().share()),
+		blocked(false),
+		reply(reply)
+		{}
+
+		void WaitStarted(void)
+		{
+			started.get_future().wait();
+		}
+
+		void Release(void)
+		{
+			release.set_value();
+		}
+
+	private:
+		std::promise<void> started;
+		std::promise<void> release;
+		std::shared_future<void> release_signal;
+		std::atomic<bool> blocked;
+		const progress_state_t reply;
+
+		progress_state_t IOperationStarted(const std::string&, uint64_t) override
+		{
+			if(!blocked.exchange(true))
+			{
+				started.set_value();
+				release_signal.wait();
+			}
+			return reply;
+		}
+
+		progress_state_t IOperationProgress(uint64_t) override
+		{
+			return progress_state_t::proceed;
+		}
+	};
+
+	// NOTE: the communicator over the memory driver, faults are injected into its stages.
+	class server_communicator : public testing::Test
+	{
+	protected:
+		server_communicator() :
+		filesystem(std::make_shared<FaultyFileSystem>()),
+		directory(LR"(C:\data)"),
+		path(directory + L"file.bin"),
+		key_storage_path(LR"(C:\keys)"),
+		data(MakeData(10000, 3))
+		{
+			filesystem->create_directory(directory);
+			WriteFile(*filesystem, path, data);
+		}
+
+		std::unique_ptr<ServerCommunicator> MakeCommunicator(const processing_t processing) const
+		{
+			auto settings = GetDefaultSettings(key_storage_path);
+			settings.processing = processing;
+			return std::make_unique<ServerCommunicator>(filesystem, std::move(settings));
+		}
+
+		std::shared_ptr<FaultyFileSystem> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+		const filesystem::path::directory key_storage_path;
+		const std::vector<uint8_t> data;
+	};
+
+	// NOTE: files of the disk, the ciphers given are those of Windows files.
+	class server_communicator_on_disk : public testing::Test
+	{
+	protected:
+		server_communicator_on_disk() :
+		filesystem(std::make_shared<NativeFileSystem>(false)),
+		directory(LR"(.\server_communicator_test)"),
+		path(directory + L"file.bin"),
+		key_storage_path(LR"(.\server_communicator_test\keys)"),
+		data(MakeData(100000, 5))
+		{
+			filesystem->create_directory(directory);
+			WriteFile(*filesystem, path, data);
+		}
+
+		~server_communicator_on_disk()
+		{
+			RemoveTree(LR"(.\server_communicator_test)");
+		}
+
+		// KAA: the drivers cannot list a directory, the key storage leaves files of its own.
+		static void RemoveTree(const std::wstring& path)
+		{
+			WIN32_FIND_DATAW entry = { 0 };
+			const auto search = ::FindFirstFileW(( path + L"\\*" ).c_str(), &entry);
+			if(INVALID_HANDLE_VALUE != search)
+			{
+				do
+				{
+					const std::wstring name(entry.cFileName);
+					if(( L"." == name ) || ( L".." == name ))
+						continue;
+					const auto entry_path = path + L"\\" + name;
+					if(0 != ( entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ))
+						RemoveTree(entry_path);
+					else
+					{
+						::SetFileAttributesW(entry_path.c_str(), FILE_ATTRIBUTE_NORMAL);
+						::DeleteFileW(entry_path.c_str());
+					}
+				} while(0 != ::FindNextFileW(search, &entry));
+				::FindClose(search);
+			}
+			::RemoveDirectoryW(path.c_str());
+		}
+
+		std::shared_ptr<filesystem::driver> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+		const filesystem::path::directory key_storage_path;
+		const std::vector<uint8_t> data;
+	};
+}
+
+// NOTE: mapped and parallel ciphers process files in place only, out-of-place processing runs the gamma cipher instead of failing every file.
+TEST_F(server_communicator_on_disk, processes_out_of_place_with_every_cipher)
+{
+	for(const auto cipher : { gamma_cipher, pipelined_gamma_cipher, mapped_gamma_cipher, parallel_gamma_cipher, fused_gamma_cipher, async_gamma_cipher })
+	{
+		SCOPED_TRACE(static_cast<int>(cipher));
+		auto settings = GetDefaultSettings(key_storage_path);
+		settings.cipher = cipher;
+		settings.processing = processing_t::out_of_place;
+		ServerCommunicator communicator(filesystem, std::move(settings));
+
+		communicator.EncryptFile(path);
+		EXPECT_NE(data, ReadFile(*filesystem, path));
+		EXPECT_TRUE(communicator.IsFileEncrypted(path));
+
+		communicator.DecryptFile(path);
+		EXPECT_EQ(data, ReadFile(*filesystem, path));
+		EXPECT_FALSE(communicator.IsFileEncrypted(path));
+	}
+}
+
+TEST_F(server_communicator, processes_out_of_place)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	communicator->EncryptFile(path);
+	EXPECT_NE(data, ReadFile(*filesystem, path));
+	EXPECT_TRUE(communicator->IsFileEncrypted(path));
+
+	communicator->DecryptFile(path);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_FALSE(communicator->IsFileEncrypted(path));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+// NOTE: block clone and system copy apply to Windows files only, the backup of a file of another driver is copied through the driver.
+TEST_F(server_communicator, backs_up_files_of_other_drivers_through_the_driver)
+{
+	const auto communicator = MakeCommunicator(processing_t::in_place);
+	communicator->EncryptFile(path);
+	EXPECT_NE(data, ReadFile(*filesystem, path));
+	EXPECT_TRUE(communicator->IsFileEncrypted(path));
+
+	communicator->DecryptFile(path);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+// NOTE: the cipher cannot write the file: the backup takes its place again, the backup name is gone.
+TEST_F(server_communicator, restores_the_backup_when_in_place_encryption_fails)
+{
+	const auto communicator = MakeCommunicator(processing_t::in_place);
+	filesystem->FailWrites(path);
+	EXPECT_THROW(communicator->EncryptFile(path), system_failure);
+
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_FALSE(communicator->IsFileEncrypted(path));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+// NOTE: the original is renamed, the ciphertext fails to take its place: the original is put back, the ciphertext and its key are dropped.
+TEST_F(server_communicator, keeps_the_original_when_the_ciphertext_cannot_replace_it)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	filesystem->FailRename(directory, 1);
+	EXPECT_THROW(communicator->EncryptFile(path), system_failure);
+
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_FALSE(communicator->IsFileEncrypted(path));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+// NOTE: the key is gone with the decryption: the decrypted file is kept under its temporary name and the error tells where it is.
+TEST_F(server_communicator, keeps_the_decrypted_file_when_it_cannot_replace_the_ciphertext)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	communicator->EncryptFile(path);
+	filesystem->FailRename(directory, 1);
+	EXPECT_THROW(communicator->DecryptFile(path), std::runtime_error);
+
+	const auto left = filesystem->GetTempFilesLeft(directory);
+	ASSERT_EQ(1U, left.size());
+	EXPECT_EQ(data, ReadFile(*filesystem, left.front()));
+}
+
+// NOTE: a file that fails does not stop the batch, every file gets its result in the order given.
+TEST_F(server_communicator, processes_a_batch_file_by_file)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	const auto second = directory + L"second.bin";
+	const auto second_data = MakeData(5000, 7);
+	WriteFile(*filesystem, second, second_data);
+	const std::vector<filesystem::path::file> paths { path, directory + L"absent.bin", second };
+
+	const auto encrypted = communicator->EncryptFiles(paths);
+	ASSERT_EQ(paths.size(), encrypted.size());
+	for(size_t index = 0; index < paths.size(); ++index)
+		EXPECT_EQ(paths[index].to_wstring(), encrypted[index].path.to_wstring());
+	EXPECT_EQ(file_status_t::succeeded, encrypted[0].status);
+	EXPECT_TRUE(encrypted[0].failure.empty());
+	EXPECT_EQ(file_status_t::failed, encrypted[1].status);
+	EXPECT_FALSE(encrypted[1].failure.empty());
+	EXPECT_EQ(file_status_t::succeeded, encrypted[2].status);
+	EXPECT_TRUE(communicator->IsFileEncrypted(path));
+	EXPECT_TRUE(communicator->IsFileEncrypted(second));
+
+	const auto decrypted = communicator->DecryptFiles(paths);
+	ASSERT_EQ(paths.size(), decrypted.size());
+	EXPECT_EQ(file_status_t::succeeded, decrypted[0].status);
+	EXPECT_EQ(file_status_t::failed, decrypted[1].status);
+	EXPECT_EQ(file_status_t::succeeded, decrypted[2].status);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_EQ(second_data, ReadFile(*filesystem, second));
+}
+
+TEST_F(server_communicator, rolls_back_the_failed_files_of_a_batch)
+{
+	const auto communicator = MakeCommunicator(processing_t::in_place);
+	const auto second = directory + L"second.bin";
+	const auto second_data = MakeData(5000, 7);
+	WriteFile(*filesystem, second, second_data);
+	filesystem->FailWrites(second);
+
+	const auto results = communicator->EncryptFiles({ path, second });
+	ASSERT_EQ(2U, results.size());
+	EXPECT_EQ(file_status_t::succeeded, results[0].status);
+	EXPECT_EQ(file_status_t::failed, results[1].status);
+	EXPECT_FALSE(results[1].failure.empty());
+
+	EXPECT_TRUE(communicator->IsFileEncrypted(path));
+	EXPECT_EQ(second_data, ReadFile(*filesystem, second));
+	EXPECT_FALSE(communicator->IsFileEncrypted(second));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+// NOTE: the handler cancels within the first file: that file is either done or rolled back, the files after it are not touched.
+TEST_F(server_communicator, stops_a_batch_cancelled_by_the_progress_handler)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	const std::vector<filesystem::path::file> rest { directory + L"second.bin", directory + L"third.bin" };
+	for(const auto& file : rest)
+		WriteFile(*filesystem, file, data);
+	communicator->SetProgressHandler(std::make_shared<CancellingProgressHandler>());
+
+	const auto results = communicator->EncryptFiles({ path, rest[0], rest[1] });
+	ASSERT_EQ(3U, results.size());
+	ASSERT_NE(file_status_t::stopped, results[0].status);
+	if(file_status_t::failed == results[0].status)
+	{
+		EXPECT_EQ(data, ReadFile(*filesystem, path));
+		EXPECT_FALSE(communicator->IsFileEncrypted(path));
+	}
+	for(size_t index = 0; index < rest.size(); ++index)
+	{
+		EXPECT_EQ(file_status_t::stopped, results[index + 1].status);
+		EXPECT_EQ(data, ReadFile(*filesystem, rest[index]));
+		EXPECT_FALSE(communicator->IsFileEncrypted(rest[index]));
+	}
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
+
+TEST_F(server_communicator, completes_a_started_batch_with_a_result_per_file)
+{
+	const auto communicator = MakeCommunicator(processing_t::in_place);
+	const auto second = directory + L"second.bin";
+	WriteFile(*filesystem, second, data);
+	filesystem->FailWrites(second);
+
+	const auto operation = communicator->StartEncryptFiles({ path, directory + L"absent.bin", second }, nullptr);
+	const auto results = operation->GetResult();
+	EXPECT_TRUE(operation->IsFinished());
+	ASSERT_EQ(3U, results.size());
+	EXPECT_EQ(file_status_t::succeeded, results[0].status);
+	EXPECT_EQ(file_status_t::failed, results[1].status);
+	EXPECT_EQ(file_status_t::failed, results[2].status);
+	EXPECT_TRUE(communicator->StartIsFileEncrypted(path)->GetResult());
+	EXPECT_FALSE(communicator->StartIsFileEncrypted(second)->GetResult());
+	EXPECT_EQ(data, ReadFile(*filesystem, second));
+
+	const auto decrypted = communicator->StartDecryptFiles({ path }, nullptr)->GetResult();
+	ASSERT_EQ(1U, decrypted.size());
+	EXPECT_EQ(file_status_t::succeeded, decrypted[0].status);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+TEST_F(server_communicator, stops_a_started_batch_cancelled_by_its_progress_handler)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	const auto second = directory + L"second.bin";
+	WriteFile(*filesystem, second, data);
+
+	const auto results = communicator->StartEncryptFiles({ path, second }, std::make_shared<CancellingProgressHandler>())->GetResult();
+	ASSERT_EQ(2U, results.size());
+	ASSERT_NE(file_status_t::stopped, results[0].status);
+	if(file_status_t::failed == results[0].status)
+		EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_EQ(file_status_t::stopped, results[1].status);
+	EXPECT_EQ(data, ReadFile(*filesystem, second));
+	EXPECT_FALSE(communicator->IsFileEncrypted(second));
+}
+
+// NOTE: operations run one at a time: the second one is cancelled while the first holds the strand, it fails without touching its files.
+TEST_F(server_communicator, fails_an_operation_cancelled_before_it_has_started)
+{
+	const auto communicator = MakeCommunicator(processing_t::out_of_place);
+	const auto second = directory + L"second.bin";
+	WriteFile(*filesystem, second, data);
+	const auto blocking = std::make_shared<BlockingProgressHandler>();
+
+	const auto first = communicator->StartEncryptFiles({ path }, blocking);
+	blocking->WaitStarted();
+	const auto queued = communicator->StartEncryptFiles({ second }, nullptr);
+	queued->Cancel();
+	EXPECT_FALSE(queued->IsFinished());
+	blocking->Release();
+
+	const auto results = first->GetResult();
+	ASSERT_EQ(1U, results.size());
+	EXPECT_EQ(file_status_t::succeeded, results[0].status);
+	EXPECT_THROW(queued->GetResult(), OperationCancelled);
+	EXPECT_EQ(data, ReadFile(*filesystem, second));
+	EXPECT_FALSE(communicator->IsFileEncrypted(second));
+}
+
+// NOTE: directory jobs list directories of Windows volumes only.
+TEST_F(server_communicator_on_disk, encrypts_every_file_of_a_directory_tree)
+{
+	ServerCommunicator communicator(filesystem, GetDefaultSettings(key_storage_path));
+	const filesystem::path::directory nested { ( directory + L"nested" ).to_wstring() };
+	filesystem->create_directory(nested);
+	const auto inner = nested + L"inner.bin";
+	const auto inner_data = MakeData(3000, 9);
+	WriteFile(*filesystem, inner, inner_data);
+
+	const auto encrypted = communicator.EncryptDirectory(directory);
+	ASSERT_EQ(2U, encrypted.size()); // KAA: the key storage is left out.
+	for(const auto& result : encrypted)
+	{
+		EXPECT_EQ(file_status_t::succeeded, result.status);
+		EXPECT_TRUE(communicator.IsFileEncrypted(result.path));
+	}
+	EXPECT_NE(data, ReadFile(*filesystem, path));
+	EXPECT_NE(inner_data, ReadFile(*filesystem, inner));
+
+	for(const auto& result : communicator.EncryptDirectory(directory))
+		EXPECT_EQ(file_status_t::skipped, result.status);
+
+	const auto decrypted = communicator.DecryptDirectory(directory);
+	ASSERT_EQ(2U, decrypted.size());
+	for(const auto& result : decrypted)
+		EXPECT_EQ(file_status_t::succeeded, result.status);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_EQ(inner_data, ReadFile(*filesystem, inner));
+
+	for(const auto& result : communicator.DecryptDirectory(directory))
+		EXPECT_EQ(file_status_t::skipped, result.status);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+// NOTE: a file held open exclusively cannot be processed: it fails and keeps its content, the rest of the tree is done.
+TEST_F(server_communicator_on_disk, keeps_the_files_of_a_directory_that_fail)
+{
+	ServerCommunicator communicator(filesystem, GetDefaultSettings(key_storage_path));
+	const auto locked = directory + L"locked.bin";
+	const auto locked_data = MakeData(4000, 11);
+	WriteFile(*filesystem, locked, locked_data);
+
+	std::vector<file_result_t> results;
+	{
+		const auto lock = filesystem->open_file(locked, read_only, exclusive_access);
+		results = communicator.EncryptDirectory(directory);
+	}
+	ASSERT_EQ(2U, results.size());
+	for(const auto& result : results)
+	{
+		const auto is_locked = result.path.to_wstring().find(L"locked.bin") != std::wstring::npos;
+		EXPECT_EQ(is_locked ? file_status_t::failed : file_status_t::succeeded, result.status);
+		EXPECT_EQ(is_locked, !result.failure.empty());
+	}
+	EXPECT_EQ(locked_data, ReadFile(*filesystem, locked));
+	EXPECT_FALSE(communicator.IsFileEncrypted(locked));
+	EXPECT_TRUE(communicator.IsFileEncrypted(path));
+}
+
+TEST_F(server_communicator_on_disk, completes_started_directory_operations)
+{
+	ServerCommunicator communicator(filesystem, GetDefaultSettings(key_storage_path));
+	const auto encrypted = communicator.StartEncryptDirectory(directory, nullptr)->GetResult();
+	ASSERT_EQ(1U, encrypted.size());
+	EXPECT_EQ(file_status_t::succeeded, encrypted[0].status);
+	EXPECT_NE(data, ReadFile(*filesystem, path));
+
+	const auto decrypted = communicator.StartDecryptDirectory(directory, nullptr)->GetResult();
+	ASSERT_EQ(1U, decrypted.size());
+	EXPECT_EQ(file_status_t::succeeded, decrypted[0].status);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+// NOTE: a status query waits for the core held by the job, not in the only I/O slot the listing of the tree takes.
+TEST_F(server_communicator_on_disk, answers_status_queries_during_a_directory_operation)
+{
+	auto settings = GetDefaultSettings(key_storage_path);
+	settings.concurrency = { 0, 1 };
+	ServerCommunicator communicator(filesystem, std::move(settings));
+	const filesystem::path::directory nested { ( directory + L"nested" ).to_wstring() };
+	filesystem->create_directory(nested);
+	WriteFile(*filesystem, nested + L"inner.bin", data);
+
+	const auto operation = communicator.StartEncryptDirectory(directory, nullptr);
+	communicator.StartIsFileEncrypted(path)->GetResult();
+	const auto results = operation->GetResult();
+	ASSERT_EQ(2U, results.size());
+	for(const auto& result : results)
+		EXPECT_EQ(file_status_t::succeeded, result.status);
+	EXPECT_TRUE(communicator.StartIsFileEncrypted(path)->GetResult());
+}
+
+// NOTE: the handler wants no progress, it is never asked again: the operation cancelled while it runs is stopped by its progress relay.
+TEST_F(server_communicator_on_disk, stops_a_directory_operation_cancelled_while_it_runs)
+{
+	auto settings = GetDefaultSettings(key_storage_path);
+	settings.progress_interval = std::chrono::milliseconds(1);
+	ServerCommunicator communicator(filesystem, std::move(settings));
+	const auto large_data = MakeData(1024 * 1024, 7);
+	for(unsigned index = 0; index < 16; ++index)
+		WriteFile(*filesystem, directory + ( L"file" + std::to_wstring(index) + L".bin" ), large_data);
+	const auto blocking = std::make_shared<BlockingProgressHandler>(progress_state_t::quiet);
+
+	const auto operation = communicator.StartEncryptDirectory(directory, blocking);
+	blocking->WaitStarted(); // KAA: the tree is listed, no file is processed yet.
+	operation->Cancel();
+	blocking->Release();
+
+	const auto results = operation->GetResult();
+	ASSERT_EQ(17U, results.size());
+	EXPECT_TRUE(std::any_of(results.begin(), results.end(), [](const file_result_t& result) { return file_status_t::succeeded != result.status; }));
+	for(const auto& result : results)
+	{
+		if(file_status_t::succeeded != result.status)
+			EXPECT_FALSE(communicator.IsFileEncrypted(result.path));
+	}
+}
+
+// NOTE: the handler cancels at the first portion: every file is either done or keeps its content.
+TEST_F(server_communicator_on_disk, keeps_the_files_a_cancelled_directory_operation_has_not_done)
+{
+	ServerCommunicator communicator(filesystem, GetDefaultSettings(key_storage_path));
+	for(unsigned index = 0; index < 8; ++index)
+		WriteFile(*filesystem, directory + ( L"file" + std::to_wstring(index) + L".bin" ), data);
+
+	const auto results = communicator.StartEncryptDirectory(directory, std::make_shared<CancellingProgressHandler>())->GetResult();
+	ASSERT_EQ(9U, results.size());
+	for(const auto& result : results)
+	{
+		if(file_status_t::succeeded == result.status)
+			continue;
+		EXPECT_EQ(data, ReadFile(*filesystem, result.path));
+		EXPECT_FALSE(communicator.IsFileEncrypted(result.path));
+	}
+}
+
+// NOTE: every session writes the trace anew, the trace of the previous session is replaced.
+TEST_F(server_communicator, replaces_the_trace_of_the_previous_session)
+{
+	auto settings = GetDefaultSettings(key_storage_path);
+	settings.processing = processing_t::out_of_place;
+	settings.trace_file = ( directory + L"trace.json" ).to_wstring();
+	const filesystem::path::file trace { settings.trace_file };
+	const auto ReadTrace = [this, &trace]
+	{
+		const auto json = ReadFile(*filesystem, trace);
+		return std::string(json.begin(), json.end());
+	};
+
+	ServerCommunicator(filesystem, settings).EncryptFile(path);
+	const auto first = ReadTrace();
+	EXPECT_NE(std::string::npos, first.find("\"name\":\"EncryptFile\""));
+
+	ServerCommunicator(filesystem, settings).DecryptFile(path);
+	const auto second = ReadTrace();
+	EXPECT_NE(std::string::npos, second.find("\"name\":\"DecryptFile\""));
+	EXPECT_EQ(std::string::npos, second.find("\"name\":\"EncryptFile\""));
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+	EXPECT_TRUE(filesystem->GetTempFilesLeft(directory).empty());
+}
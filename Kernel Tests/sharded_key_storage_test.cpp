@@ -0,0 +1,115 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/CRC32BasedKeyStorage.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/ShardedKeyStorage.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	// NOTE: CRC32 names the keys after the file path: the files themselves are not needed.
+	class sharded_key_storage : public testing::Test
+	{
+	protected:
+		sharded_key_storage() :
+		filesystem(std::make_shared<MemoryFileSystem>()),
+		directory(LR"(C:\keys)"),
+		path(LR"(C:\data\file.bin)"),
+		storage(std::make_unique<CRC32BasedKeyStorage>(filesystem, directory), filesystem),
+		flat_key_path(CRC32BasedKeyStorage(filesystem, directory).GetKeyPathForSpecifiedPath(path)),
+		sharded_key_path(GetShardedKeyPath(directory, flat_key_path))
+		{
+			filesystem->create_directory(directory);
+		}
+
+		void StoreKey(const filesystem::path::file& key_path, const std::vector<uint8_t>& key)
+		{
+			const auto key_file = filesystem->get_temp_filename(directory);
+			WriteFile(*filesystem, key_file, key);
+			storage.StoreKey(key_file, key_path);
+		}
+
+		std::vector<uint8_t> LoadKey(const filesystem::path::file& key_path)
+		{
+			const auto key_file = storage.LoadKey(key_path);
+			const auto key = ReadFile(*filesystem, key_file);
+			storage.UnloadKey(key_path, key_file);
+			return key;
+		}
+
+		std::shared_ptr<MemoryFileSystem> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+		ShardedKeyStorage storage;
+		const filesystem::path::file flat_key_path;
+		const filesystem::path::file sharded_key_path;
+	};
+}
+
+TEST(sharded_key_path, moves_the_key_two_levels_down)
+{
+	const filesystem::path::directory directory { LR"(C:\keys)" };
+	EXPECT_EQ(std::wstring(LR"(C:\keys\12\34\123456.bin)"), GetShardedKeyPath(directory, directory + L"123456.bin").to_wstring());
+	EXPECT_EQ(std::wstring(LR"(C:\keys\a.b)"), GetShardedKeyPath(directory, directory + L"a.b").to_wstring());
+}
+
+TEST_F(sharded_key_storage, stores_and_finds_keys_in_shards)
+{
+	const auto key = MakeData(2000, 1);
+	EXPECT_EQ(sharded_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+	EXPECT_FALSE(storage.ContainsKey(sharded_key_path));
+
+	StoreKey(storage.GetKeyPathForSpecifiedPath(path), key);
+	EXPECT_TRUE(filesystem::file_exists(*filesystem, sharded_key_path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, flat_key_path));
+	EXPECT_TRUE(storage.ContainsKey(sharded_key_path));
+	EXPECT_EQ(sharded_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+	EXPECT_EQ(key, LoadKey(sharded_key_path));
+
+	storage.RemoveKey(sharded_key_path, storage.LoadKey(sharded_key_path));
+	EXPECT_FALSE(storage.ContainsKey(sharded_key_path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, sharded_key_path));
+}
+
+// NOTE: a key stored before the layout was switched to shards stays where it is and is used from there.
+TEST_F(sharded_key_storage, finds_keys_of_the_flat_layout)
+{
+	const auto key = MakeData(1500, 2);
+	WriteFile(*filesystem, flat_key_path, key);
+
+	EXPECT_EQ(flat_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+	EXPECT_TRUE(storage.ContainsKey(flat_key_path));
+	EXPECT_EQ(key, LoadKey(flat_key_path));
+
+	storage.RemoveKey(flat_key_path, storage.LoadKey(flat_key_path));
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, flat_key_path));
+	EXPECT_EQ(sharded_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+}
+
+TEST_F(sharded_key_storage, prefers_the_sharded_key_to_the_flat_one)
+{
+	const auto flat_key = MakeData(1000, 3);
+	const auto sharded_key = MakeData(1000, 4);
+	WriteFile(*filesystem, flat_key_path, flat_key);
+	StoreKey(sharded_key_path, sharded_key);
+
+	EXPECT_EQ(sharded_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+	EXPECT_EQ(sharded_key, LoadKey(storage.GetKeyPathForSpecifiedPath(path)));
+
+	// KAA: once the sharded key is removed, the flat one is found again.
+	storage.RemoveKey(sharded_key_path, storage.LoadKey(sharded_key_path));
+	EXPECT_EQ(flat_key_path.to_wstring(), storage.GetKeyPathForSpecifiedPath(path).to_wstring());
+	EXPECT_EQ(flat_key, LoadKey(flat_key_path));
+}
@@ -0,0 +1,32 @@
+#include "test_helpers.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		namespace Tests
+		{
+			std::vector<uint8_t> MakeData(const size_t size, const uint8_t seed)
+			{
+				std::vector<uint8_t> data(size);
+				for(size_t index = 0; index < size; ++index)
+					data[index] = static_cast<uint8_t>(seed + index * 13U);
+				return data;
+			}
+
+			void WriteFile(filesystem::driver& filesystem, const filesystem::path::file& path, const std::vector<uint8_t>& data, const filesystem::driver::permission& permission)
+			{
+				const auto file = filesystem.create_file(path, persistent_not_exists, write_only, exclusive_access, permission);
+				file->write(data.data(), data.size());
+			}
+
+			std::vector<uint8_t> ReadFile(filesystem::driver& filesystem, const filesystem::path::file& path)
+			{
+				const auto file = filesystem.open_file(path, read_only, exclusive_access);
+				std::vector<uint8_t> data(file->get_size());
+				data.resize(file->read(data.size(), data.data()));
+				return data;
+			}
+		}
+	}
+}
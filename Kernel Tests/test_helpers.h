@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		namespace Tests
+		{
+			const filesystem::driver::mode read_only(false, true);
+			const filesystem::driver::mode write_only(true, false);
+			const filesystem::driver::share exclusive_access(false, false);
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::permission allow_read_write;
+
+			// NOTE: data of a test file, files of different seeds differ in every byte.
+			std::vector<uint8_t> MakeData(size_t size, uint8_t seed);
+
+			void WriteFile(filesystem::driver&, const filesystem::path::file&, const std::vector<uint8_t>& data, const filesystem::driver::permission& = allow_read_write);
+			std::vector<uint8_t> ReadFile(filesystem::driver&, const filesystem::path::file&);
+		}
+	}
+}
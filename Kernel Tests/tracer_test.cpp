@@ -0,0 +1,103 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "../Kernel/Tracer.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	// KAA: installs the tracer for a test, tests must not leave it installed.
+	class ScopedTracer final
+	{
+	public:
+		explicit ScopedTracer(Tracer& tracer)
+		{
+			Tracer::Install(&tracer);
+		}
+
+		ScopedTracer(const ScopedTracer&) = delete;
+		ScopedTracer& operator = (const ScopedTracer&) = delete;
+
+		~ScopedTracer()
+		{
+			Tracer::Install(nullptr);
+		}
+	};
+
+	size_t CountOf(const std::string& text, const std::string& pattern)
+	{
+		size_t count = 0;
+		for(auto position = text.find(pattern); std::string::npos != position; position = text.find(pattern, position + pattern.size()))
+			++count;
+		return count;
+	}
+}
+
+TEST(tracer, records_nothing_unless_installed)
+{
+	Tracer tracer;
+	{
+		TraceSpan span("Cipher", 4096);
+		EXPECT_FALSE(span.IsRecording());
+	}
+	EXPECT_EQ(0U, CountOf(tracer.Export(), "\"ph\":\"X\""));
+}
+
+TEST(tracer, exports_complete_events)
+{
+	Tracer tracer;
+	{
+		const ScopedTracer installed(tracer);
+		{
+			TraceSpan span("GenerateKey");
+			EXPECT_TRUE(span.IsRecording());
+			span.SetBytes(1024);
+		}
+		const TraceSpan span("Cipher", 4096);
+	}
+
+	const auto json = tracer.Export();
+	EXPECT_EQ(0U, json.find("{\"traceEvents\":["));
+	EXPECT_EQ(2U, CountOf(json, "\"ph\":\"X\""));
+	EXPECT_EQ(1U, CountOf(json, "\"name\":\"GenerateKey\""));
+	EXPECT_EQ(1U, CountOf(json, "\"args\":{\"bytes\":1024}"));
+	EXPECT_EQ(1U, CountOf(json, "\"name\":\"Cipher\""));
+	EXPECT_EQ(1U, CountOf(json, "\"args\":{\"bytes\":4096}"));
+}
+
+TEST(tracer, tells_threads_apart)
+{
+	Tracer tracer;
+	{
+		const ScopedTracer installed(tracer);
+		{
+			const TraceSpan span("BackupFile");
+		}
+		std::thread([] { const TraceSpan span("WipeFile"); }).join();
+	}
+
+	const auto json = tracer.Export();
+	const auto first = json.find("\"tid\":");
+	const auto second = json.find("\"tid\":", first + 1);
+	ASSERT_NE(std::string::npos, second);
+	EXPECT_NE(json.substr(first, json.find(',', first) - first), json.substr(second, json.find(',', second) - second));
+}
+
+TEST(tracer, exports_counter_events)
+{
+	Tracer tracer;
+	tracer.Count("KeyPathCache", std::chrono::steady_clock::now(), { { "hits", 3 }, { "misses", 2 } });
+	{
+		const ScopedTracer installed(tracer);
+		const TraceSpan span("Cipher", 4096);
+	}
+
+	const auto json = tracer.Export();
+	EXPECT_EQ(1U, CountOf(json, "\"ph\":\"X\""));
+	EXPECT_EQ(1U, CountOf(json, "\"ph\":\"C\""));
+	EXPECT_EQ(1U, CountOf(json, "\"args\":{\"hits\":3,\"misses\":2}"));
+}
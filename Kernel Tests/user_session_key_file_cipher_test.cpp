@@ -0,0 +1,265 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "../Kernel/CancellationToken.h"
+#include "../Kernel/FileProgressHandler.h"
+#include "../Kernel/MemoryFileSystem.h"
+#include "../Kernel/UserSessionKeyFileCipher.h"
+
+#include "test_helpers.h"
+
+using namespace KAA;
+using namespace KAA::FileSecurity;
+using namespace KAA::FileSecurity::Tests;
+
+namespace
+{
+	constexpr uint32_t chunk_size = 4096;
+	constexpr size_t header_size = 28;
+	constexpr size_t prefix_size = 25; // KAA: identifier of the file, index of the chunk, kind of the frame.
+	constexpr size_t stand_in_overhead = 4;
+	constexpr size_t frame_size = sizeof(uint32_t) + stand_in_overhead + prefix_size + chunk_size;
+	constexpr size_t end_frame_size = sizeof(uint32_t) + stand_in_overhead + prefix_size;
+
+	// NOTE: stands in for the data protection of the system: a marker, then the data inverted; unprotect refuses anything else.
+	// Chunks larger than the cipher gives fail the test: memory use has to stay bounded by the chunk size.
+	session_protection_t GetStandInProtection(void)
+	{
+		const auto protect = [](const void* data, const size_t size)
+		{
+			EXPECT_GE(prefix_size + chunk_size, size);
+			std::vector<uint8_t> result { 'P', 'R', 'O', 'T' };
+			const auto bytes = static_cast<const uint8_t*>(data);
+			for(size_t index = 0; index < size; ++index)
+				result.push_back(static_cast<uint8_t>(~bytes[index]));
+			return result;
+		};
+		const auto unprotect = [](const void* data, const size_t size)
+		{
+			const auto bytes = static_cast<const uint8_t*>(data);
+			if(( size < stand_in_overhead ) || ( 'P' != bytes[0] ) || ( 'R' != bytes[1] ) || ( 'O' != bytes[2] ) || ( 'T' != bytes[3] ))
+				throw std::runtime_error("not protected");
+			std::vector<uint8_t> result;
+			for(size_t index = stand_in_overhead; index < size; ++index)
+				result.push_back(static_cast<uint8_t>(~bytes[index]));
+			return result;
+		};
+		return { protect, unprotect };
+	}
+
+	class CountingProgress final : public FileProgressHandler
+	{
+	public:
+		explicit CountingProgress(const progress_state_t state) :
+		state(state),
+		chunks(0),
+		bytes(0)
+		{}
+
+		const progress_state_t state;
+		unsigned chunks;
+		uint64_t bytes;
+
+	private:
+		progress_state_t IChunkProcessed(const uint64_t size) override
+		{
+			++chunks;
+			bytes += size;
+			return state;
+		}
+	};
+
+	class user_session_key_file_cipher : public testing::Test
+	{
+	protected:
+		user_session_key_file_cipher() :
+		filesystem(std::make_shared<MemoryFileSystem>()),
+		directory(LR"(C:\data)"),
+		path(directory + L"file.bin"),
+		key(directory + L"unused.key"),
+		cipher(filesystem, GetStandInProtection(), chunk_size)
+		{
+			filesystem->create_directory(directory);
+		}
+
+		std::shared_ptr<filesystem::driver> filesystem;
+		const filesystem::path::directory directory;
+		const filesystem::path::file path;
+		const filesystem::path::file key;
+		UserSessionKeyFileCipher cipher;
+	};
+}
+
+TEST_F(user_session_key_file_cipher, restores_files_of_any_size)
+{
+	for(const size_t size : { 0U, 1U, chunk_size - 1U, chunk_size, 3U * chunk_size + 5U })
+	{
+		const auto data = MakeData(size, static_cast<uint8_t>(size));
+		WriteFile(*filesystem, path, data);
+
+		cipher.EncryptFile(path, key);
+		EXPECT_NE(data, ReadFile(*filesystem, path));
+		cipher.DecryptFile(path, key);
+		EXPECT_EQ(data, ReadFile(*filesystem, path));
+
+		filesystem->remove_file(path);
+	}
+}
+
+TEST_F(user_session_key_file_cipher, writes_a_frame_per_chunk)
+{
+	const size_t chunks = 3;
+	WriteFile(*filesystem, path, MakeData(chunks * chunk_size, 1));
+	cipher.EncryptFile(path, key);
+
+	const auto protected_file = ReadFile(*filesystem, path);
+	ASSERT_EQ(header_size + chunks * frame_size + end_frame_size, protected_file.size());
+	EXPECT_EQ(std::vector<uint8_t>({ 'F', 'S', 'U', 'K' }), std::vector<uint8_t>(protected_file.begin(), protected_file.begin() + 4));
+	const std::vector<uint8_t> end_frame_length { static_cast<uint8_t>(end_frame_size - sizeof(uint32_t)), 0, 0, 0 };
+	EXPECT_EQ(end_frame_length, std::vector<uint8_t>(protected_file.end() - end_frame_size, protected_file.end() - end_frame_size + sizeof(uint32_t)));
+}
+
+TEST_F(user_session_key_file_cipher, gives_every_file_an_identifier_of_its_own)
+{
+	const auto data = MakeData(chunk_size, 5);
+	const auto other = directory + L"other.bin";
+	WriteFile(*filesystem, path, data);
+	WriteFile(*filesystem, other, data);
+	cipher.EncryptFile(path, key);
+	cipher.EncryptFile(other, key);
+
+	const auto first = ReadFile(*filesystem, path);
+	const auto second = ReadFile(*filesystem, other);
+	ASSERT_EQ(first.size(), second.size());
+	EXPECT_NE(std::vector<uint8_t>(first.begin() + header_size - 16, first.begin() + header_size), std::vector<uint8_t>(second.begin() + header_size - 16, second.begin() + header_size));
+	EXPECT_NE(first, second);
+}
+
+TEST_F(user_session_key_file_cipher, reports_progress_per_chunk)
+{
+	const size_t size = 3U * chunk_size + 5U;
+	WriteFile(*filesystem, path, MakeData(size, 2));
+	const auto progress = std::make_shared<CountingProgress>(progress_state_t::proceed);
+	cipher.SetProgressCallback(progress);
+
+	cipher.EncryptFile(path, key);
+	EXPECT_EQ(4U, progress->chunks);
+	EXPECT_EQ(size, progress->bytes);
+
+	progress->chunks = 0;
+	progress->bytes = 0;
+	const auto protected_size = filesystem::get_file_size(*filesystem, path);
+	cipher.DecryptFile(path, key);
+	EXPECT_EQ(protected_size, progress->bytes);
+}
+
+TEST_F(user_session_key_file_cipher, keeps_the_original_when_cancelled)
+{
+	const auto data = MakeData(3U * chunk_size, 3);
+	WriteFile(*filesystem, path, data);
+	cipher.SetProgressCallback(std::make_shared<CountingProgress>(progress_state_t::cancel));
+
+	EXPECT_THROW(cipher.EncryptFile(path, key), OperationCancelled);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+
+	const auto destination = directory + L"protected.bin";
+	EXPECT_THROW(cipher.EncryptFile(path, destination, key), OperationCancelled);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, destination));
+}
+
+TEST_F(user_session_key_file_cipher, refuses_damaged_files)
+{
+	const auto data = MakeData(2U * chunk_size, 4);
+	WriteFile(*filesystem, path, data);
+	cipher.EncryptFile(path, key);
+	const auto protected_file = ReadFile(*filesystem, path);
+	const auto damaged = directory + L"damaged.bin";
+	const auto restored = directory + L"restored.bin";
+
+	// KAA: truncated, the end of file frame is missing.
+	WriteFile(*filesystem, damaged, std::vector<uint8_t>(protected_file.begin(), protected_file.end() - 1));
+	EXPECT_THROW(cipher.DecryptFile(damaged, restored, key), operation_failure);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, restored));
+	filesystem->remove_file(damaged);
+
+	// KAA: frames swapped.
+	auto swapped = protected_file;
+	std::copy(protected_file.begin() + header_size, protected_file.begin() + header_size + frame_size, swapped.begin() + header_size + frame_size);
+	std::copy(protected_file.begin() + header_size + frame_size, protected_file.begin() + header_size + 2 * frame_size, swapped.begin() + header_size);
+	WriteFile(*filesystem, damaged, swapped);
+	EXPECT_THROW(cipher.DecryptFile(damaged, restored, key), operation_failure);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, restored));
+	filesystem->remove_file(damaged);
+
+	// KAA: not protected at all.
+	WriteFile(*filesystem, damaged, data);
+	EXPECT_THROW(cipher.DecryptFile(damaged, key), operation_failure);
+	EXPECT_EQ(data, ReadFile(*filesystem, damaged));
+
+	cipher.DecryptFile(path, key);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+TEST_F(user_session_key_file_cipher, refuses_frames_of_another_file)
+{
+	const auto data = MakeData(3U * chunk_size, 6);
+	const auto other = directory + L"other.bin";
+	WriteFile(*filesystem, path, data);
+	WriteFile(*filesystem, other, data);
+	cipher.EncryptFile(path, key);
+	cipher.EncryptFile(other, key);
+	const auto damaged = directory + L"damaged.bin";
+	const auto restored = directory + L"restored.bin";
+
+	// KAA: the same data at the same index, only the identifier of the file tells them apart.
+	auto spliced = ReadFile(*filesystem, path);
+	const auto other_file = ReadFile(*filesystem, other);
+	const auto frame = header_size + frame_size;
+	std::copy(other_file.begin() + frame, other_file.begin() + frame + frame_size, spliced.begin() + frame);
+	WriteFile(*filesystem, damaged, spliced);
+	EXPECT_THROW(cipher.DecryptFile(damaged, restored, key), operation_failure);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, restored));
+	filesystem->remove_file(damaged);
+
+	// KAA: the end frame of another file of fewer chunks.
+	filesystem->remove_file(other);
+	WriteFile(*filesystem, other, MakeData(chunk_size, 7));
+	cipher.EncryptFile(other, directory + L"short.bin", key);
+	const auto short_file = ReadFile(*filesystem, directory + L"short.bin");
+	auto ended = ReadFile(*filesystem, path);
+	ended.resize(header_size + frame_size);
+	ended.insert(ended.end(), short_file.end() - end_frame_size, short_file.end());
+	WriteFile(*filesystem, damaged, ended);
+	EXPECT_THROW(cipher.DecryptFile(damaged, restored, key), operation_failure);
+	EXPECT_FALSE(filesystem::file_exists(*filesystem, restored));
+
+	cipher.DecryptFile(path, key);
+	EXPECT_EQ(data, ReadFile(*filesystem, path));
+}
+
+TEST_F(user_session_key_file_cipher, refuses_files_cut_at_a_frame_boundary)
+{
+	WriteFile(*filesystem, path, MakeData(3U * chunk_size, 8));
+	cipher.EncryptFile(path, key);
+	const auto protected_file = ReadFile(*filesystem, path);
+	const auto damaged = directory + L"damaged.bin";
+	const auto restored = directory + L"restored.bin";
+
+	// KAA: without the end frame, then without the last chunk as well.
+	for(const auto size : { protected_file.size() - end_frame_size, protected_file.size() - end_frame_size - frame_size })
+	{
+		WriteFile(*filesystem, damaged, std::vector<uint8_t>(protected_file.begin(), protected_file.begin() + size));
+		EXPECT_THROW(cipher.DecryptFile(damaged, restored, key), operation_failure);
+		EXPECT_FALSE(filesystem::file_exists(*filesystem, restored));
+		filesystem->remove_file(damaged);
+	}
+}
@@ -0,0 +1,70 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+
+#include "../Kernel/WorkStealingPool.h"
+
+using namespace KAA::FileSecurity;
+
+namespace
+{
+	void UpdateMaximum(std::atomic<unsigned>& maximum, const unsigned value)
+	{
+		auto current = maximum.load();
+		while(value > current && !maximum.compare_exchange_weak(current, value));
+	}
+}
+
+TEST(work_stealing_pool, runs_nested_tasks_within_limits)
+{
+	WorkStealingPool pool({ 2, 3 });
+	std::atomic<unsigned> completed(0);
+	std::atomic<unsigned> running_cpu(0);
+	std::atomic<unsigned> running_cpu_maximum(0);
+
+	// KAA: as a directory job does: I/O tasks list directories, each waits for CPU tasks of its files.
+	WorkStealingPool::TaskGroup directories;
+	for(int directory = 0; directory < 16; ++directory)
+	{
+		pool.Submit(directories, task_kind_t::io, [&]
+		{
+			WorkStealingPool::TaskGroup files;
+			for(int file = 0; file < 16; ++file)
+			{
+				pool.Submit(files, task_kind_t::cpu, [&]
+				{
+					UpdateMaximum(running_cpu_maximum, ++running_cpu);
+					for(volatile int work = 0; work < 1000; ++work);
+					--running_cpu;
+					++completed;
+				});
+			}
+			pool.Wait(files);
+		});
+	}
+	pool.Wait(directories);
+
+	EXPECT_EQ(16U * 16U, completed.load());
+	EXPECT_LE(running_cpu_maximum.load(), 2U);
+}
+
+TEST(work_stealing_pool, wait_rethrows_task_failure)
+{
+	WorkStealingPool pool({ 1, 1 });
+	std::atomic<unsigned> completed(0);
+
+	WorkStealingPool::TaskGroup group;
+	pool.Submit(group, task_kind_t::cpu, [] { throw std::runtime_error("task failure"); });
+	for(int task = 0; task < 8; ++task)
+		pool.Submit(group, task_kind_t::io, [&] { ++completed; });
+
+	EXPECT_THROW(pool.Wait(group), std::runtime_error);
+	EXPECT_EQ(8U, completed.load()); // KAA: the rest of the group still runs.
+}
+
+TEST(work_stealing_pool, rejects_zero_limits)
+{
+	EXPECT_ANY_THROW(WorkStealingPool({ 0, 1 }));
+	EXPECT_ANY_THROW(WorkStealingPool({ 1, 0 }));
+}
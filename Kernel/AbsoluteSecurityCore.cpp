@@ -1,12 +1,12 @@
 #include "AbsoluteSecurityCore.h"
 
 // FIX: TODO: throw operation_failure.
+#include <algorithm>
 #include <stdexcept>
 #include <cerrno>
 
 #include "KAA/include/load_string.h"
 #include "KAA/include/unicode.h"
-#include "KAA/include/cryptography/cryptography.h"
 #include "KAA/include/cryptography/random.h"
 #include "KAA/include/dll/module_context.h"
 #include "KAA/include/exception/operation_failure.h"
@@ -15,6 +15,7 @@
 #include "KAA/include/filesystem/filesystem.h"
 
 #include "./Core/CoreProgressHandler.h"
+#include "CancellationToken.h"
 #include "CipherProgressDispatcher.h"
 
 // FUTURE: KAA: remove <windows.h>
@@ -23,8 +24,15 @@
 
 #include "FileCipher.h"
 #include "FileCipherFactory.h"
+#include "IOPolicy.h"
+#include "KeyGenerator.h"
+#include "KeyPathDigest.h"
 #include "KeyStorage.h"
 #include "KeyStorageFactory.h"
+#include "LooseKeyFiles.h"
+#include "NativeFileSystem.h"
+#include "ProgressCounter.h"
+#include "Tracer.h"
 
 #include "resource.h"
 
@@ -32,11 +40,38 @@ extern KAA::dll::module_context core_dll;
 
 namespace
 {
-	void RemoveKeyFile(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	constexpr size_t key_generation_slab = 16U * 1024U * 1024U; // 16 MiB : memory only, bounds progress granularity.
+
+	class ScopedDataCallback final
 	{
-		KAA::filesystem::driver::permission write_only(true, false);
-		filesystem.set_file_permissions(path, write_only);
-		filesystem.remove_file(path);
+	public:
+		ScopedDataCallback(KAA::FileSecurity::FileCipher& cipher, std::shared_ptr<KAA::FileSecurity::FileDataHandler> handler) :
+		cipher(cipher),
+		previous(cipher.SetDataCallback(std::move(handler)))
+		{}
+
+		ScopedDataCallback(const ScopedDataCallback&) = delete;
+		ScopedDataCallback& operator = (const ScopedDataCallback&) = delete;
+
+		~ScopedDataCallback()
+		{
+			cipher.SetDataCallback(std::move(previous));
+		}
+
+	private:
+		KAA::FileSecurity::FileCipher& cipher;
+		std::shared_ptr<KAA::FileSecurity::FileDataHandler> previous;
+	};
+
+	// NOTE: rollback of an encryption that has not completed, the key file may not have been created yet.
+	void DiscardKeyFile(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		try
+		{
+			KAA::FileSecurity::RemoveKeyFile(filesystem, path);
+		}
+		catch(...)
+		{}
 	}
 }
 
@@ -45,18 +80,50 @@ namespace KAA
 	using namespace unicode;
 	namespace FileSecurity
 	{
-		AbsoluteSecurityCore::AbsoluteSecurityCore(std::shared_ptr<filesystem::driver> filesystem, filesystem::path::directory key_storage_path) :
+		AbsoluteSecurityCore::AbsoluteSecurityCore(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, filesystem::path::directory key_storage_path, const cipher_t cipher, const key_storage_t key_storage, const key_storage_layout_t key_storage_layout) :
+		m_filesystem(std::move(filesystem)),
+		m_io_policy(std::move(io_policy)),
+		m_cipher_generates_key(fused_gamma_cipher == cipher), // KAA: fused cipher generates the key while encrypting.
+		m_cipher(CreateFileCipher(cipher, m_filesystem, m_io_policy)),
+		m_key_storage(OpenKeyStorage(m_filesystem, m_io_policy, std::move(key_storage_path), key_storage, key_storage_layout)),
+		m_key_generator(std::make_unique<KeyGenerator>()),
+		cipher_progress(new CipherProgressDispatcher),
+		core_progress(nullptr),
+		progress_counter(nullptr),
+		cancellation(nullptr)
+		{
+			// KAA: filesystem and I/O policy already verified by cipher and key storage.
+		}
+
+		AbsoluteSecurityCore::AbsoluteSecurityCore(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, std::shared_ptr<KeyStorage> key_storage, std::unique_ptr<FileCipher> cipher) :
 		m_filesystem(std::move(filesystem)),
-		m_cipher(CreateFileCipher(gamma_cipher, m_filesystem)),
-		m_key_storage(CreateKeyStorage(key_storage_t::md5_based, m_filesystem, std::move(key_storage_path))),
+		m_io_policy(std::move(io_policy)),
+		m_cipher_generates_key(false),
+		m_cipher(std::move(cipher)),
+		m_key_storage(std::move(key_storage)),
+		m_key_generator(std::make_unique<KeyGenerator>()),
 		cipher_progress(new CipherProgressDispatcher),
-		core_progress(nullptr)
+		core_progress(nullptr),
+		progress_counter(nullptr),
+		cancellation(nullptr)
 		{
-			// KAA: filesystem already verified by cipher and key storage.
+			if(!m_filesystem || !m_io_policy || !m_cipher || !m_key_storage)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create absolute security core class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
 		}
 
 		AbsoluteSecurityCore::~AbsoluteSecurityCore() = default;
 
+		std::shared_ptr<KeyStorage> AbsoluteSecurityCore::OpenKeyStorage(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, filesystem::path::directory key_storage_path, const key_storage_t key_storage, const key_storage_layout_t key_storage_layout)
+		{
+			return CreateKeyStorage(key_storage, key_storage_layout, std::move(filesystem), std::move(io_policy), std::move(key_storage_path));
+		}
+
 		filesystem::path::directory AbsoluteSecurityCore::IGetKeyStoragePath(void) const
 		{
 			return m_key_storage->GetPath();
@@ -70,45 +137,123 @@ namespace KAA
 		void AbsoluteSecurityCore::IEncryptFile(const filesystem::path::file& path)
 		{
 			// TODO: KAA: #SubOperationStarted
-			OperationStarted(to_UTF8(resources::load_string(IDS_RETRIEVING_KEY_PATH, core_dll.get_module_handle())), 0);
+			OperationStarted(IDS_RETRIEVING_KEY_PATH, 0);
 
 			const auto file_to_encrypt_size = get_file_size(*m_filesystem, path);
 
-			auto key_path = m_filesystem->get_temp_filename(m_key_storage->GetPath());
+			const auto key_path = PrepareKeyFile(file_to_encrypt_size);
+			try
 			{
-				OperationStarted(to_UTF8(resources::load_string(IDS_GENERATING_KEY, core_dll.get_module_handle())), file_to_encrypt_size);
-				// DEFECT: KAA: what if 1 GiB size?
-				const auto key_data = GenerateKey(file_to_encrypt_size);
-				CreateKeyFile(key_path, key_data);
+				const auto digest = m_key_storage->StartKeyPathDigest();
+				{
+					OperationStarted(IDS_ENCRYPTING_FILE, file_to_encrypt_size);
+					const ScopedDataCallback digest_feed(*m_cipher, digest);
+					const TraceSpan span("Cipher", file_to_encrypt_size);
+					m_cipher->EncryptFile(path, key_path);
+				}
+				StoreKey(key_path, GetKeyPathForEncryptedFile(digest, path));
 			}
+			catch(...)
 			{
-				OperationStarted(to_UTF8(resources::load_string(IDS_ENCRYPTING_FILE, core_dll.get_module_handle())), file_to_encrypt_size);
-				m_cipher->EncryptFile(path, key_path);
+				DiscardKeyFile(*m_filesystem, key_path);
+				throw;
 			}
-			m_filesystem->rename_file(key_path, m_key_storage->GetKeyPathForSpecifiedPath(path));
 		}
 
 		void AbsoluteSecurityCore::IDecryptFile(const filesystem::path::file& path)
 		{
 			// TODO: KAA: #SubOperationStarted
-			OperationStarted(to_UTF8(resources::load_string(IDS_RETRIEVING_KEY_PATH, core_dll.get_module_handle())), 0);
+			OperationStarted(IDS_RETRIEVING_KEY_PATH, 0);
 
-			const auto key_path = m_key_storage->GetKeyPathForSpecifiedPath(path);
+			const auto key_path = GetKeyPathForSpecifiedPath(path);
 			const auto size = get_file_size(*m_filesystem, path);
+			auto key = OpenKey(key_path);
+			const auto key_file = nullptr == key ? LoadKey(key_path) : key_path;
+			try
+			{
+				OperationStarted(IDS_DECRYPTING_FILE, size);
+				const TraceSpan span("Cipher", size);
+				if(nullptr == key)
+					m_cipher->DecryptFile(path, key_file);
+				else
+					m_cipher->DecryptFile(path, *key);
+			}
+			catch(...)
 			{
-				OperationStarted(to_UTF8(resources::load_string(IDS_DECRYPTING_FILE, core_dll.get_module_handle())), size);
-				m_cipher->DecryptFile(path, key_path);
+				key.reset();
+				m_key_storage->UnloadKey(key_path, key_file);
+				throw;
 			}
+			key.reset();
 			{
-				OperationStarted(to_UTF8(resources::load_string(IDS_REMOVING_KEY, core_dll.get_module_handle())), size);
-				RemoveKeyFile(*m_filesystem, key_path);
+				OperationStarted(IDS_REMOVING_KEY, size);
+				const TraceSpan span("RemoveKey", size);
+				m_key_storage->RemoveKey(key_path, key_file);
+			}
+		}
+
+		void AbsoluteSecurityCore::IEncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination)
+		{
+			// TODO: KAA: #SubOperationStarted
+			OperationStarted(IDS_RETRIEVING_KEY_PATH, 0);
+
+			const auto file_to_encrypt_size = get_file_size(*m_filesystem, source);
+
+			const auto key_path = PrepareKeyFile(file_to_encrypt_size);
+			try
+			{
+				const auto digest = m_key_storage->StartKeyPathDigest();
+				{
+					OperationStarted(IDS_ENCRYPTING_FILE, file_to_encrypt_size);
+					const ScopedDataCallback digest_feed(*m_cipher, digest);
+					const TraceSpan span("Cipher", file_to_encrypt_size);
+					m_cipher->EncryptFile(source, destination, key_path);
+				}
+				StoreKey(key_path, GetKeyPathForEncryptedFile(digest, destination));
+			}
+			catch(...)
+			{
+				DiscardKeyFile(*m_filesystem, key_path);
+				throw;
+			}
+		}
+
+		void AbsoluteSecurityCore::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination)
+		{
+			// TODO: KAA: #SubOperationStarted
+			OperationStarted(IDS_RETRIEVING_KEY_PATH, 0);
+
+			const auto key_path = GetKeyPathForSpecifiedPath(source);
+			const auto size = get_file_size(*m_filesystem, source);
+			auto key = OpenKey(key_path);
+			const auto key_file = nullptr == key ? LoadKey(key_path) : key_path;
+			try
+			{
+				OperationStarted(IDS_DECRYPTING_FILE, size);
+				const TraceSpan span("Cipher", size);
+				if(nullptr == key)
+					m_cipher->DecryptFile(source, destination, key_file);
+				else
+					m_cipher->DecryptFile(source, destination, *key);
+			}
+			catch(...)
+			{
+				key.reset();
+				m_key_storage->UnloadKey(key_path, key_file);
+				throw;
+			}
+			key.reset();
+			{
+				OperationStarted(IDS_REMOVING_KEY, size);
+				const TraceSpan span("RemoveKey", size);
+				m_key_storage->RemoveKey(key_path, key_file);
 			}
 		}
 
 		bool AbsoluteSecurityCore::IIsFileEncrypted(const filesystem::path::file& path) const
 		{
-			const auto key_file_path = m_key_storage->GetKeyPathForSpecifiedPath(path);
-			return filesystem::file_exists(*m_filesystem, key_file_path);
+			const auto key_file_path = GetKeyPathForSpecifiedPath(path);
+			return m_key_storage->ContainsKey(key_file_path);
 		}
 
 		std::shared_ptr<CoreProgressHandler> AbsoluteSecurityCore::ISetProgressHandler(std::shared_ptr<CoreProgressHandler> handler)
@@ -119,25 +264,98 @@ namespace KAA
 			return handler;
 		}
 
-		std::vector<uint8_t> AbsoluteSecurityCore::GenerateKey(const size_t bytes_to_generate)
+		// NOTE: the cipher keeps reporting to the dispatcher, the dispatcher passes chunks to the counter.
+		std::shared_ptr<ProgressCounter> AbsoluteSecurityCore::ISetProgressCounter(std::shared_ptr<ProgressCounter> counter)
 		{
-			std::vector<uint8_t> buffer(bytes_to_generate, 0U);
+			progress_counter.swap(counter);
+			cipher_progress->SetProgressCounter(progress_counter);
+			m_cipher->SetProgressCallback(cipher_progress);
+			return counter;
+		}
+
+		// NOTE: key storage hashes whole files to find keys, it checks the token too.
+		std::shared_ptr<CancellationToken> AbsoluteSecurityCore::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			cancellation.swap(token);
+			m_key_storage->SetCancellationToken(cancellation);
+			return token;
+		}
+
+		// RETURNS: temporary key path in the key storage, the key itself is written there unless the cipher generates it.
+		filesystem::path::file AbsoluteSecurityCore::PrepareKeyFile(const uint64_t file_size)
+		{
+			auto key_path = m_filesystem->get_temp_filename(m_key_storage->GetPath());
+			if(!m_cipher_generates_key)
 			{
-				constexpr auto chunk_size = 64U * 1024U; // 64 KiB
-				const auto chunks_total = bytes_to_generate / chunk_size;
-				for(auto chunk = 0U; chunk < chunks_total; ++chunk)
+				OperationStarted(IDS_GENERATING_KEY, file_size);
+				try
 				{
-					KAA::cryptography::generate(chunk_size, &buffer[chunk * chunk_size]);
-					ChunkProcessed(chunk_size);
+					// DEFECT: KAA: what if 1 GiB size?
+					const auto key_data = GenerateKey(file_size);
+					CreateKeyFile(key_path, key_data);
 				}
-
-				size_t last_chunk_size = bytes_to_generate % chunk_size;
-				if(0 < last_chunk_size)
+				catch(...)
 				{
-					KAA::cryptography::generate(last_chunk_size, &buffer[chunks_total * chunk_size]);
-					ChunkProcessed(last_chunk_size);
+					DiscardKeyFile(*m_filesystem, key_path);
+					throw;
 				}
 			}
+			return key_path;
+		}
+
+		// NOTE: the digest fed during encryption spares reading the whole file again unless the cipher has not reported all of it.
+		filesystem::path::file AbsoluteSecurityCore::GetKeyPathForEncryptedFile(const std::shared_ptr<KeyPathDigest>& digest, const filesystem::path::file& path)
+		{
+			if(( nullptr != digest ) && digest->IsComplete(get_file_size(*m_filesystem, path)))
+			{
+				auto key_path = digest->GetKeyPath();
+				m_key_storage->RememberKeyPath(path, key_path);
+				return key_path;
+			}
+			return GetKeyPathForSpecifiedPath(path);
+		}
+
+		// NOTE: may read and hash the whole file.
+		filesystem::path::file AbsoluteSecurityCore::GetKeyPathForSpecifiedPath(const filesystem::path::file& path) const
+		{
+			TraceSpan span("KeyPathHash");
+			if(span.IsRecording())
+				span.SetBytes(get_file_size(*m_filesystem, path)); // KAA: not queried unless tracing.
+			return m_key_storage->GetKeyPathForSpecifiedPath(path);
+		}
+
+		filesystem::path::file AbsoluteSecurityCore::LoadKey(const filesystem::path::file& key_path)
+		{
+			const TraceSpan span("LoadKey");
+			return m_key_storage->LoadKey(key_path);
+		}
+
+		std::unique_ptr<filesystem::file> AbsoluteSecurityCore::OpenKey(const filesystem::path::file& key_path)
+		{
+			if(!m_cipher->ReadsKeyStreams())
+				return nullptr;
+			const TraceSpan span("OpenKey");
+			return m_key_storage->OpenKey(key_path);
+		}
+
+		void AbsoluteSecurityCore::StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			const TraceSpan span("StoreKey");
+			m_key_storage->StoreKey(key_file, key_path);
+		}
+
+		std::vector<uint8_t> AbsoluteSecurityCore::GenerateKey(const size_t bytes_to_generate)
+		{
+			const TraceSpan span("GenerateKey", bytes_to_generate);
+			std::vector<uint8_t> buffer(bytes_to_generate, 0U);
+			for(size_t offset = 0; offset < bytes_to_generate; offset += key_generation_slab)
+			{
+				const auto slab_size = std::min(key_generation_slab, bytes_to_generate - offset);
+				if(nullptr != cancellation)
+					cancellation->Check();
+				m_key_generator->Generate(slab_size, &buffer[offset]);
+				CheckProgressState(ChunkProcessed(slab_size));
+			}
 			return buffer;
 		}
 
@@ -147,7 +365,9 @@ namespace KAA
 			const KAA::filesystem::driver::mode sequential_write_only(true, false);
 			const KAA::filesystem::driver::share exclusive_access(false, false);
 			const KAA::filesystem::driver::permission read_only_attribute(false, true);
+			const TraceSpan span("CreateKeyFile", data.size());
 			auto key = m_filesystem->create_file(path, persistent_not_exist, sequential_write_only, exclusive_access, read_only_attribute);
+			PreallocateFile(*key, data.size());
 			const size_t bytes_written = key->write(&data[0], data.size());
 			if(bytes_written != data.size())
 			{
@@ -155,17 +375,21 @@ namespace KAA
 				RemoveKeyFile(*m_filesystem, path);
 				throw std::runtime_error(__FUNCTION__); // FUTURE: KAA: remove incomplete file : whose responsibility?
 			}
+			FinishFile(*key); // KAA: an unbuffered stream writes its tail here, a failure is reported rather than lost on close.
 		}
 
-		progress_state_t AbsoluteSecurityCore::OperationStarted(const std::string& name, uint64_t file_size)
+		// NOTE: the name of the stage is loaded for the progress handler only.
+		progress_state_t AbsoluteSecurityCore::OperationStarted(const unsigned stage_name, uint64_t file_size)
 		{
 			if(nullptr != core_progress)
-				return core_progress->ProcessingStarted(name, file_size);
+				return core_progress->ProcessingStarted(to_UTF8(resources::load_string(stage_name, core_dll.get_module_handle())), file_size);
 			return progress_state_t::quiet;
 		}
 
 		progress_state_t AbsoluteSecurityCore::ChunkProcessed(uint64_t size)
 		{
+			if(nullptr != progress_counter)
+				return progress_counter->Publish(size);
 			if(nullptr != core_progress)
 				return core_progress->ChunkProcessed(size);
 			return progress_state_t::quiet;
@@ -7,26 +7,37 @@
 
 #include "./Core/Core.h"
 
+#include "FileCipherFactory.h"
+#include "KeyStorageFactory.h"
+
 namespace KAA
 {
 	namespace filesystem
 	{
 		class driver;
+		class file;
 	}
 
 	namespace FileSecurity
 	{
 		class FileCipher;
+		class IOPolicy;
+		class KeyGenerator;
+		class KeyPathDigest;
 		class KeyStorage;
 
 		class CoreProgressHandler;
+		class CancellationToken;
 		class CipherProgressDispatcher;
+		class ProgressCounter;
 
 		// NOTE: Vernam Cipher / One-Time Pad
 		class AbsoluteSecurityCore final : public Core
 		{
 		public:
-			AbsoluteSecurityCore(std::shared_ptr<filesystem::driver>, filesystem::path::directory key_storage_path);
+			AbsoluteSecurityCore(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory key_storage_path, cipher_t, key_storage_t, key_storage_layout_t);
+			// NOTE: cores sharing a key storage may process files at once, each from a thread of its own; the cipher has to take the key from the key file.
+			AbsoluteSecurityCore(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, std::shared_ptr<KeyStorage>, std::unique_ptr<FileCipher>);
 			AbsoluteSecurityCore(const AbsoluteSecurityCore&) = delete;
 			AbsoluteSecurityCore(AbsoluteSecurityCore&&) = delete;
 			~AbsoluteSecurityCore();
@@ -34,13 +45,20 @@ namespace KAA
 			AbsoluteSecurityCore& operator = (const AbsoluteSecurityCore&) = delete;
 			AbsoluteSecurityCore& operator = (AbsoluteSecurityCore&&) = delete;
 
+			static std::shared_ptr<KeyStorage> OpenKeyStorage(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory key_storage_path, key_storage_t, key_storage_layout_t);
+
 		private:
 			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
+			bool m_cipher_generates_key;
 			std::unique_ptr<FileCipher> m_cipher;
-			std::unique_ptr<KeyStorage> m_key_storage;
+			std::shared_ptr<KeyStorage> m_key_storage;
+			std::unique_ptr<KeyGenerator> m_key_generator;
 			std::shared_ptr<CipherProgressDispatcher> cipher_progress;
 
 			std::shared_ptr<CoreProgressHandler> core_progress;
+			std::shared_ptr<ProgressCounter> progress_counter;
+			std::shared_ptr<CancellationToken> cancellation;
 
 			filesystem::path::directory IGetKeyStoragePath(void) const override;
 			void ISetKeyStoragePath(filesystem::path::directory) override;
@@ -48,14 +66,26 @@ namespace KAA
 			void IEncryptFile(const filesystem::path::file&) override;
 			void IDecryptFile(const filesystem::path::file&) override;
 
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+
 			bool IIsFileEncrypted(const filesystem::path::file&) const override;
 
 			std::shared_ptr<CoreProgressHandler> ISetProgressHandler(std::shared_ptr<CoreProgressHandler>) override;
-
+			std::shared_ptr<ProgressCounter> ISetProgressCounter(std::shared_ptr<ProgressCounter>) override;
+			std::shared_ptr<CancellationToken> ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			filesystem::path::file PrepareKeyFile(uint64_t file_size);
+			filesystem::path::file GetKeyPathForEncryptedFile(const std::shared_ptr<KeyPathDigest>&, const filesystem::path::file&);
+			filesystem::path::file GetKeyPathForSpecifiedPath(const filesystem::path::file&) const;
+			filesystem::path::file LoadKey(const filesystem::path::file& key_path);
+			// RETURNS: stream of the key kept in place, nullptr if the cipher or the key storage works with key files only.
+			std::unique_ptr<filesystem::file> OpenKey(const filesystem::path::file& key_path);
+			void StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path);
 			std::vector<uint8_t> GenerateKey(size_t bytes_to_generate);
 			void CreateKeyFile(const filesystem::path::file& path, const std::vector<uint8_t>& data);
 
-			progress_state_t OperationStarted(const std::string& name, uint64_t file_size);
+			progress_state_t OperationStarted(unsigned stage_name, uint64_t file_size);
 			progress_state_t ChunkProcessed(uint64_t size);
 		};
 	}
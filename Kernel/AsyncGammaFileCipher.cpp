@@ -0,0 +1,190 @@
+#include "AsyncGammaFileCipher.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include "CancellationToken.h"
+#include "CompletionQueue.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+#include "NativeFile.h"
+
+namespace
+{
+	struct chunk_t
+	{
+		enum state_t
+		{
+			idle,
+			reading,
+			writing,
+			written
+		};
+
+		uint8_t* data;
+		uint8_t* key;
+		uint64_t offset;
+		size_t size;
+		unsigned reads_pending;
+		state_t state;
+	};
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		AsyncGammaFileCipher::AsyncGammaFileCipher(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy) :
+		m_filesystem(std::move(filesystem)),
+		m_io_policy(std::move(io_policy))
+		{
+			if(!m_filesystem || !m_io_policy)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create asynchronous gamma file cipher class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void AsyncGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			const NativeFile master(path, NativeFile::read_write, NativeFile::overlapped);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::overlapped);
+
+			const auto parameters = m_io_policy->GetParameters(path);
+			Process(master, master, key, parameters.chunk_size, parameters.queue_depth);
+		}
+
+		void AsyncGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
+
+		void AsyncGammaFileCipher::IEncryptFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const filesystem::path::file& key_path)
+		{
+			{
+				// KAA: the destination is created through the driver, so that an existing file is reported as the other ciphers do.
+				const filesystem::driver::create_mode persistent_not_exists;
+				const filesystem::driver::mode sequential_write_only(true, false);
+				const filesystem::driver::share exclusive_access(false, false);
+				const filesystem::driver::permission allow_read_write;
+				m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+			}
+
+			const NativeFile source(source_path, NativeFile::read_only, NativeFile::overlapped);
+			const NativeFile destination(destination_path, NativeFile::read_write, NativeFile::overlapped);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::overlapped);
+
+			const auto parameters = m_io_policy->GetParameters(destination_path);
+			Process(source, destination, key, parameters.chunk_size, parameters.queue_depth);
+			destination.Flush();
+		}
+
+		void AsyncGammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return EncryptFile(source, destination, key);
+		}
+
+		void AsyncGammaFileCipher::Process(const NativeFile& input, const NativeFile& output, const NativeFile& key, const size_t chunk_size, const unsigned queue_depth)
+		{
+			const auto size = input.GetSize();
+			if(0 == size)
+				return;
+
+			if(key.GetSize() < size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to apply gamma: key is shorter than the file";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			const auto depth = static_cast<size_t>(std::min<uint64_t>(std::max(1U, queue_depth), ( size + chunk_size - 1 ) / chunk_size));
+			if(buffers.size() < 2 * depth * chunk_size)
+				buffers.resize(2 * depth * chunk_size);
+
+			std::vector<chunk_t> chunks(depth);
+			for(size_t index = 0; index < depth; ++index)
+			{
+				chunks[index].data = &buffers[2 * index * chunk_size];
+				chunks[index].key = chunks[index].data + chunk_size;
+				chunks[index].state = chunk_t::idle;
+			}
+
+			// KAA: declared after the chunks and their buffers: requests in flight are waited for before these go away.
+			CompletionQueue queue(2 * depth);
+			queue.Associate(input);
+			if(&output != &input)
+				queue.Associate(output);
+			queue.Associate(key);
+
+			uint64_t next_offset = 0;
+			const auto submit = [&](chunk_t& chunk)
+			{
+				chunk.offset = next_offset;
+				chunk.size = static_cast<size_t>(std::min<uint64_t>(chunk_size, size - next_offset));
+				chunk.reads_pending = 2;
+				chunk.state = chunk_t::reading;
+				next_offset += chunk.size;
+				queue.SubmitRead(input, chunk.offset, chunk.data, chunk.size, &chunk);
+				queue.SubmitRead(key, chunk.offset, chunk.key, chunk.size, &chunk);
+			};
+
+			for(auto& chunk : chunks)
+				submit(chunk);
+
+			std::vector<CompletionQueue::completion_t> completions(2 * depth);
+			size_t retired = 0;
+			bool stop = false;
+			auto progress = progress_state_t::proceed;
+			while(0 != queue.GetPending())
+			{
+				const auto reaped = queue.Wait(completions.data(), completions.size());
+				for(size_t index = 0; index < reaped; ++index)
+				{
+					const auto& completion = completions[index];
+					auto& chunk = *static_cast<chunk_t*>(completion.tag);
+					if(0 != completion.error)
+						throw windows_api_failure { __FUNCTION__, chunk_t::reading == chunk.state ? "unable to read file" : "unable to write file", completion.error };
+					if(completion.bytes != chunk.size)
+						throw std::runtime_error(__FUNCTION__); // DEFECT: KAA: short transfer of a local file, the file has been changed by someone else.
+
+					if(chunk_t::reading == chunk.state)
+					{
+						if(0 == --chunk.reads_pending)
+						{
+							Gamma(chunk.data, chunk.key, chunk.data, chunk.size);
+							chunk.state = chunk_t::writing;
+							queue.SubmitWrite(output, chunk.offset, chunk.data, chunk.size, &chunk);
+						}
+					}
+					else
+					{
+						chunk.state = chunk_t::written;
+					}
+				}
+
+				// KAA: chunks are retired in file order, so that progress and data handlers see the file from start to end.
+				for(auto chunk = &chunks[retired % depth]; chunk_t::written == chunk->state; chunk = &chunks[retired % depth])
+				{
+					chunk->state = chunk_t::idle;
+					++retired;
+					ChunkWritten(chunk->offset, chunk->data, chunk->size);
+					if(progress_state_t::quiet != progress)
+						progress = ChunkProcessed(chunk->size);
+					stop = stop || ( progress_state_t::cancel == progress ) || ( progress_state_t::stop == progress );
+					if(!stop && ( next_offset < size ))
+						submit(*chunk);
+				}
+			}
+			CheckProgressState(progress);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "FileCipher.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		class IOPolicy;
+		class NativeFile;
+
+		// NOTE: keeps queue depth chunks of the file in flight from the calling thread, local files only.
+		// Reads of the data and the key of a chunk are submitted together, the chunk is written back as soon as both have arrived;
+		// completions are reaped in batches from an I/O completion port. Chunks are retired in file order.
+		class AsyncGammaFileCipher final : public FileCipher
+		{
+		public:
+			AsyncGammaFileCipher(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>);
+			AsyncGammaFileCipher(const AsyncGammaFileCipher&) = delete;
+			AsyncGammaFileCipher(AsyncGammaFileCipher&&) = delete;
+			~AsyncGammaFileCipher() = default;
+
+			AsyncGammaFileCipher& operator = (const AsyncGammaFileCipher&) = delete;
+			AsyncGammaFileCipher& operator = (AsyncGammaFileCipher&&) = delete;
+
+		private:
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
+			std::vector<uint8_t> buffers; // NOTE: data and key buffers of every chunk in flight, kept for the following files.
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+
+			// NOTE: input and output may be the same file; throws OperationCancelled if processing was cancelled or stopped.
+			void Process(const NativeFile& input, const NativeFile& output, const NativeFile& key, size_t chunk_size, unsigned queue_depth);
+		};
+	}
+}
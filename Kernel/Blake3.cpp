@@ -0,0 +1,337 @@
+#include "Blake3.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <emmintrin.h>
+
+namespace
+{
+	using chaining_value_t = KAA::FileSecurity::Blake3::chaining_value_t;
+
+	constexpr size_t block_size = 64U;
+	constexpr size_t chunk_size = KAA::FileSecurity::Blake3::chunk_size;
+	constexpr size_t blocks_per_chunk = chunk_size / block_size;
+	constexpr size_t lanes = 4U;
+
+	enum flags_t : uint32_t
+	{
+		chunk_start = 1U << 0,
+		chunk_end = 1U << 1,
+		parent = 1U << 2,
+		root = 1U << 3
+	};
+
+	constexpr uint32_t iv[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+	// NOTE: message word order of every round: the BLAKE3 permutation applied round times.
+	constexpr uint8_t schedule[7][16] =
+	{
+		{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+		{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+		{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+		{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+		{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+		{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+		{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+	};
+
+	inline uint32_t RotateRight(const uint32_t value, const int bits)
+	{
+		return ( value >> bits ) | ( value << ( 32 - bits ) );
+	}
+
+	inline uint32_t LoadWord(const uint8_t* data)
+	{
+		return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 | static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+	}
+
+	inline void Mix(uint32_t (&v)[16], const size_t a, const size_t b, const size_t c, const size_t d, const uint32_t x, const uint32_t y)
+	{
+		v[a] = v[a] + v[b] + x; v[d] = RotateRight(v[d] ^ v[a], 16);
+		v[c] = v[c] + v[d]; v[b] = RotateRight(v[b] ^ v[c], 12);
+		v[a] = v[a] + v[b] + y; v[d] = RotateRight(v[d] ^ v[a], 8);
+		v[c] = v[c] + v[d]; v[b] = RotateRight(v[b] ^ v[c], 7);
+	}
+
+	// RETURNS: the whole 16 word state, the first 8 words are the chaining value (and the first 32 bytes of the root output).
+	void Compress(const chaining_value_t& cv, const uint8_t* block, const uint32_t block_length, const uint64_t counter, const uint32_t flags, uint32_t (&v)[16])
+	{
+		uint32_t m[16];
+		for(size_t word = 0; word < 16; ++word)
+			m[word] = LoadWord(block + 4 * word);
+
+		std::copy(cv.begin(), cv.end(), v);
+		std::copy(iv, iv + 4, v + 8);
+		v[12] = static_cast<uint32_t>(counter);
+		v[13] = static_cast<uint32_t>(counter >> 32);
+		v[14] = block_length;
+		v[15] = flags;
+		for(const auto& s : schedule)
+		{
+			Mix(v, 0, 4, 8, 12, m[s[0]], m[s[1]]); Mix(v, 1, 5, 9, 13, m[s[2]], m[s[3]]); Mix(v, 2, 6, 10, 14, m[s[4]], m[s[5]]); Mix(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+			Mix(v, 0, 5, 10, 15, m[s[8]], m[s[9]]); Mix(v, 1, 6, 11, 12, m[s[10]], m[s[11]]); Mix(v, 2, 7, 8, 13, m[s[12]], m[s[13]]); Mix(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+		}
+		for(size_t word = 0; word < 8; ++word)
+		{
+			v[word] ^= v[word + 8];
+			v[word + 8] ^= cv[word];
+		}
+	}
+
+	chaining_value_t ChainingValue(const chaining_value_t& cv, const uint8_t* block, const uint32_t block_length, const uint64_t counter, const uint32_t flags)
+	{
+		uint32_t v[16];
+		Compress(cv, block, block_length, counter, flags, v);
+		chaining_value_t result;
+		std::copy(v, v + 8, result.begin());
+		return result;
+	}
+
+	chaining_value_t Key(void)
+	{
+		chaining_value_t key;
+		std::copy(iv, iv + 8, key.begin());
+		return key;
+	}
+
+	void StoreChainingValue(const chaining_value_t& cv, uint8_t* output)
+	{
+		for(size_t word = 0; word < cv.size(); ++word)
+			for(size_t byte = 0; byte < 4; ++byte)
+				output[4 * word + byte] = static_cast<uint8_t>(cv[word] >> ( 8 * byte ));
+	}
+
+	chaining_value_t ParentChainingValue(const chaining_value_t& left, const chaining_value_t& right)
+	{
+		uint8_t block[block_size];
+		StoreChainingValue(left, block);
+		StoreChainingValue(right, block + block_size / 2);
+		return ChainingValue(Key(), block, block_size, 0, parent);
+	}
+
+	template <int bits>
+	inline __m128i RotateRight(const __m128i value)
+	{
+		return _mm_or_si128(_mm_srli_epi32(value, bits), _mm_slli_epi32(value, 32 - bits));
+	}
+
+	template <>
+	inline __m128i RotateRight<16>(const __m128i value)
+	{
+		return _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, 0xB1), 0xB1); // KAA: swap 16-bit halves.
+	}
+
+	inline void Mix(__m128i (&v)[16], const size_t a, const size_t b, const size_t c, const size_t d, const __m128i x, const __m128i y)
+	{
+		v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), x); v[d] = RotateRight<16>(_mm_xor_si128(v[d], v[a]));
+		v[c] = _mm_add_epi32(v[c], v[d]); v[b] = RotateRight<12>(_mm_xor_si128(v[b], v[c]));
+		v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), y); v[d] = RotateRight<8>(_mm_xor_si128(v[d], v[a]));
+		v[c] = _mm_add_epi32(v[c], v[d]); v[b] = RotateRight<7>(_mm_xor_si128(v[b], v[c]));
+	}
+
+	// NOTE: four consecutive full chunks at once, register i holds word i of every chunk state (SSE2 is the x86 baseline).
+	// Message words are little-endian, as is every Windows target.
+	void HashFourChunks(const uint8_t* input, const uint64_t counter, chaining_value_t* output)
+	{
+		__m128i cv[8];
+		for(size_t word = 0; word < 8; ++word)
+			cv[word] = _mm_set1_epi32(static_cast<int>(iv[word]));
+		uint32_t counter_low[lanes];
+		uint32_t counter_high[lanes];
+		for(size_t lane = 0; lane < lanes; ++lane)
+		{
+			counter_low[lane] = static_cast<uint32_t>(counter + lane);
+			counter_high[lane] = static_cast<uint32_t>(( counter + lane ) >> 32);
+		}
+
+		for(size_t block = 0; block < blocks_per_chunk; ++block)
+		{
+			__m128i m[16];
+			for(size_t quarter = 0; quarter < 4; ++quarter)
+			{
+				const auto offset = block * block_size + quarter * 16;
+				const auto row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + offset));
+				const auto row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + chunk_size + offset));
+				const auto row2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 2 * chunk_size + offset));
+				const auto row3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 3 * chunk_size + offset));
+				const auto low01 = _mm_unpacklo_epi32(row0, row1);
+				const auto low23 = _mm_unpacklo_epi32(row2, row3);
+				const auto high01 = _mm_unpackhi_epi32(row0, row1);
+				const auto high23 = _mm_unpackhi_epi32(row2, row3);
+				m[4 * quarter + 0] = _mm_unpacklo_epi64(low01, low23);
+				m[4 * quarter + 1] = _mm_unpackhi_epi64(low01, low23);
+				m[4 * quarter + 2] = _mm_unpacklo_epi64(high01, high23);
+				m[4 * quarter + 3] = _mm_unpackhi_epi64(high01, high23);
+			}
+			const uint32_t flags = ( 0 == block ? chunk_start : 0U ) | ( blocks_per_chunk - 1 == block ? chunk_end : 0U );
+
+			__m128i v[16];
+			std::copy(cv, cv + 8, v);
+			for(size_t word = 0; word < 4; ++word)
+				v[8 + word] = _mm_set1_epi32(static_cast<int>(iv[word]));
+			v[12] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter_low));
+			v[13] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter_high));
+			v[14] = _mm_set1_epi32(static_cast<int>(block_size));
+			v[15] = _mm_set1_epi32(static_cast<int>(flags));
+			for(const auto& s : schedule)
+			{
+				Mix(v, 0, 4, 8, 12, m[s[0]], m[s[1]]); Mix(v, 1, 5, 9, 13, m[s[2]], m[s[3]]); Mix(v, 2, 6, 10, 14, m[s[4]], m[s[5]]); Mix(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+				Mix(v, 0, 5, 10, 15, m[s[8]], m[s[9]]); Mix(v, 1, 6, 11, 12, m[s[10]], m[s[11]]); Mix(v, 2, 7, 8, 13, m[s[12]], m[s[13]]); Mix(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+			}
+			for(size_t word = 0; word < 8; ++word)
+				cv[word] = _mm_xor_si128(v[word], v[word + 8]);
+		}
+
+		uint32_t words[8][lanes];
+		for(size_t word = 0; word < 8; ++word)
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(words[word]), cv[word]);
+		for(size_t lane = 0; lane < lanes; ++lane)
+			for(size_t word = 0; word < 8; ++word)
+				output[lane][word] = words[word][lane];
+	}
+
+	chaining_value_t HashChunk(const uint8_t* input, const uint64_t counter)
+	{
+		auto cv = Key();
+		for(size_t block = 0; block < blocks_per_chunk; ++block)
+		{
+			const uint32_t flags = ( 0 == block ? chunk_start : 0U ) | ( blocks_per_chunk - 1 == block ? chunk_end : 0U );
+			cv = ChainingValue(cv, input + block * block_size, block_size, counter, flags);
+		}
+		return cv;
+	}
+
+	// RETURNS: chaining values of full chunks.
+	void HashChunks(const uint8_t* input, const uint64_t chunks, const uint64_t counter, chaining_value_t* output)
+	{
+		uint64_t chunk = 0;
+		for(; chunk + lanes <= chunks; chunk += lanes)
+			HashFourChunks(input + chunk * chunk_size, counter + chunk, output + chunk);
+		for(; chunk < chunks; ++chunk)
+			output[chunk] = HashChunk(input + chunk * chunk_size, counter + chunk);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		Blake3::Blake3() :
+		chunk_chaining_value(Key()),
+		chunk_counter(0),
+		block_length(0),
+		blocks_compressed(0),
+		stack_size(0)
+		{}
+
+		void Blake3::Update(const void* data, size_t size)
+		{
+			auto input = static_cast<const uint8_t*>(data);
+			while(0 != size)
+			{
+				if(( blocks_per_chunk == blocks_compressed + 1 ) && ( block_size == block_length ))
+					FinishChunk(); // KAA: more input follows: the chunk is not the root.
+
+				if(( 0 == blocks_compressed ) && ( 0 == block_length ) && ( size > lanes * chunk_size ))
+				{
+					chaining_value_t chunks[lanes];
+					HashFourChunks(input, chunk_counter, chunks);
+					for(size_t lane = 0; lane < lanes; ++lane)
+						PushChainingValue(chunks[lane], chunk_counter + lane + 1);
+					StartChunk(chunk_counter + lanes);
+					input += lanes * chunk_size;
+					size -= lanes * chunk_size;
+					continue;
+				}
+
+				if(block_size == block_length)
+					CompressBlock();
+				const auto bytes = std::min(block_size - block_length, size);
+				std::memcpy(block + block_length, input, bytes);
+				block_length += bytes;
+				input += bytes;
+				size -= bytes;
+			}
+		}
+
+		void Blake3::AddSubtree(const chaining_value_t& cv, const uint64_t chunks)
+		{
+			if(( blocks_per_chunk == blocks_compressed + 1 ) && ( block_size == block_length ))
+				FinishChunk();
+			PushChainingValue(cv, ( chunk_counter + chunks ) / chunks);
+			StartChunk(chunk_counter + chunks);
+		}
+
+		Blake3::digest_t Blake3::Complete(void) const
+		{
+			uint8_t last_block[block_size] = { 0 };
+			std::memcpy(last_block, block, block_length);
+			auto input_cv = chunk_chaining_value;
+			auto counter = chunk_counter;
+			auto length = static_cast<uint32_t>(block_length);
+			uint32_t flags = ( 0 == blocks_compressed ? chunk_start : 0U ) | chunk_end;
+			for(auto parents = stack_size; 0 != parents; --parents)
+			{
+				const auto right = ChainingValue(input_cv, last_block, length, counter, flags);
+				StoreChainingValue(stack[parents - 1], last_block);
+				StoreChainingValue(right, last_block + block_size / 2);
+				input_cv = Key();
+				counter = 0;
+				length = block_size;
+				flags = parent;
+			}
+
+			uint32_t v[16];
+			Compress(input_cv, last_block, length, counter, flags | root, v);
+			chaining_value_t output;
+			std::copy(v, v + 8, output.begin());
+			digest_t digest;
+			StoreChainingValue(output, digest.data());
+			return digest;
+		}
+
+		Blake3::chaining_value_t Blake3::HashSubtree(const void* data, const uint64_t chunks, const uint64_t counter)
+		{
+			std::vector<chaining_value_t> level(static_cast<size_t>(chunks));
+			HashChunks(static_cast<const uint8_t*>(data), chunks, counter, level.data());
+			for(auto nodes = level.size(); nodes > 1; nodes /= 2)
+				for(size_t node = 0; node < nodes / 2; ++node)
+					level[node] = ParentChainingValue(level[2 * node], level[2 * node + 1]);
+			return level.front();
+		}
+
+		// NOTE: total - number of subtrees of the same size as the pushed one, including it: merges complete pairs like a binary counter.
+		void Blake3::PushChainingValue(chaining_value_t cv, uint64_t total)
+		{
+			for(; 0 == ( total & 1 ); total >>= 1)
+				cv = ParentChainingValue(stack[--stack_size], cv);
+			stack[stack_size++] = cv;
+		}
+
+		void Blake3::CompressBlock(void)
+		{
+			const uint32_t flags = 0 == blocks_compressed ? chunk_start : 0U;
+			chunk_chaining_value = ChainingValue(chunk_chaining_value, block, block_size, chunk_counter, flags);
+			++blocks_compressed;
+			block_length = 0;
+		}
+
+		void Blake3::FinishChunk(void)
+		{
+			const uint32_t flags = ( 0 == blocks_compressed ? chunk_start : 0U ) | chunk_end;
+			const auto cv = ChainingValue(chunk_chaining_value, block, block_size, chunk_counter, flags);
+			PushChainingValue(cv, chunk_counter + 1);
+			StartChunk(chunk_counter + 1);
+		}
+
+		void Blake3::StartChunk(const uint64_t counter)
+		{
+			chunk_chaining_value = Key();
+			chunk_counter = counter;
+			block_length = 0;
+			blocks_compressed = 0;
+		}
+	}
+}
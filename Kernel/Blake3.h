@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: BLAKE3 hash (default mode, 256-bit output).
+		// The input is split into 1 KiB chunks hashed independently (four at once with SSE2) and joined as a binary tree,
+		// so aligned ranges of a file can be hashed on different threads with HashSubtree and joined in order with AddSubtree.
+		class Blake3 final
+		{
+		public:
+			static constexpr size_t chunk_size = 1024U;
+
+			using digest_t = std::array<uint8_t, 32>;
+			using chaining_value_t = std::array<uint32_t, 8>;
+
+			Blake3();
+			Blake3(const Blake3&) = delete;
+			Blake3(Blake3&&) = delete;
+			~Blake3() = default;
+
+			Blake3& operator = (const Blake3&) = delete;
+			Blake3& operator = (Blake3&&) = delete;
+
+			void Update(const void* data, size_t size);
+			// NOTE: the subtree has to start at a multiple of its own size, nothing may be pending from Update and more input has to follow.
+			void AddSubtree(const chaining_value_t&, uint64_t chunks);
+			digest_t Complete(void) const;
+
+			// RETURNS: chaining value of chunks, their number has to be a power of two (two at least), chunk_counter - index of the first one.
+			static chaining_value_t HashSubtree(const void* data, uint64_t chunks, uint64_t chunk_counter);
+
+		private:
+			static constexpr size_t block_size = 64U;
+			static constexpr size_t max_depth = 54U; // KAA: 2^64 bytes of input.
+
+			chaining_value_t chunk_chaining_value;
+			uint64_t chunk_counter;
+			uint8_t block[block_size];
+			size_t block_length;
+			size_t blocks_compressed;
+
+			chaining_value_t stack[max_depth];
+			size_t stack_size;
+
+			void PushChainingValue(chaining_value_t, uint64_t total_chunks);
+			void CompressBlock(void);
+			void FinishChunk(void);
+			void StartChunk(uint64_t counter);
+		};
+	}
+}
@@ -0,0 +1,334 @@
+#include "Blake3BasedKeyStorage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cwctype>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include <windows.h>
+
+#include "Blake3.h"
+#include "CancellationToken.h"
+#include "IOPolicy.h"
+#include "KeyPathDigest.h"
+#include "NativeFile.h"
+#include "NativeFileSystem.h"
+
+namespace
+{
+	constexpr uint64_t subtree_chunks = 4096U;
+	constexpr uint64_t subtree_size = subtree_chunks * KAA::FileSecurity::Blake3::chunk_size; // 4 MiB : a unit of work for a thread.
+
+	KAA::filesystem::path::file MakeKeyPath(const KAA::filesystem::path::directory& storage_path, const KAA::FileSecurity::Blake3::digest_t& digest)
+	{
+		constexpr wchar_t digits[] = L"0123456789abcdef";
+		std::wstring filename;
+		for(const auto byte : digest)
+		{
+			filename.push_back(digits[byte >> 4]);
+			filename.push_back(digits[byte & 0x0F]);
+		}
+		return storage_path + ( filename + L".bin" );
+	}
+
+	// NOTE: token is checked once per chunk, nullptr if the hashing is not cancellable.
+	void CheckCancellation(const KAA::FileSecurity::CancellationToken* token)
+	{
+		if(nullptr != token)
+			token->Check();
+	}
+
+	void HashRange(const KAA::FileSecurity::NativeFile& file, uint64_t offset, const uint64_t end, const size_t chunk_size, const KAA::FileSecurity::CancellationToken* token, KAA::FileSecurity::Blake3& hash)
+	{
+		std::vector<uint8_t> data(chunk_size);
+		while(offset < end)
+		{
+			CheckCancellation(token);
+			const auto bytes_read = file.ReadAt(offset, data.data(), static_cast<size_t>(std::min<uint64_t>(chunk_size, end - offset)));
+			if(0 == bytes_read)
+				break;
+			hash.Update(data.data(), bytes_read);
+			offset += bytes_read;
+		}
+	}
+
+	// NOTE: whole subtrees are hashed by worker threads and joined in order, the tail (at least the last subtree) is hashed sequentially: the root has to be last.
+	// A cancelled token stops the workers at their next chunk, OperationCancelled is rethrown once they are joined.
+	KAA::FileSecurity::Blake3::digest_t HashFile(const KAA::filesystem::path::file& path, const size_t chunk_size, const KAA::FileSecurity::CancellationToken* token)
+	{
+		using KAA::FileSecurity::Blake3;
+		using KAA::FileSecurity::NativeFile;
+		const NativeFile file(path, NativeFile::read_only, NativeFile::overlapped);
+		const auto size = file.GetSize();
+		const auto subtrees = ( 0 == size ) ? 0 : ( size - 1 ) / subtree_size;
+
+		std::vector<Blake3::chaining_value_t> chaining_values(static_cast<size_t>(subtrees));
+		if(0 != subtrees)
+		{
+			std::atomic<uint64_t> next_subtree(0);
+			std::atomic<bool> stop(false);
+			std::mutex guard;
+			std::exception_ptr failure;
+
+			const auto work = [&]
+			{
+				try
+				{
+					std::vector<uint8_t> data(static_cast<size_t>(subtree_size));
+					for(auto subtree = next_subtree++; subtree < subtrees && !stop; subtree = next_subtree++)
+					{
+						const auto offset = subtree * subtree_size;
+						for(size_t filled = 0; filled < data.size();)
+						{
+							CheckCancellation(token);
+							const auto bytes_read = file.ReadAt(offset + filled, data.data() + filled, std::min(chunk_size, data.size() - filled));
+							if(0 == bytes_read)
+							{
+								constexpr auto source = __FUNCTION__;
+								constexpr auto description = "unable to hash file: file has been truncated";
+								constexpr auto reason = KAA::operation_failure::status_code_t::invalid_argument;
+								constexpr auto severity = KAA::operation_failure::severity_t::error;
+								throw KAA::operation_failure(source, description, reason, severity);
+							}
+							filled += bytes_read;
+						}
+						chaining_values[static_cast<size_t>(subtree)] = Blake3::HashSubtree(data.data(), subtree_chunks, subtree * subtree_chunks);
+					}
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(guard);
+					if(!failure)
+						failure = std::current_exception();
+					stop = true;
+				}
+			};
+
+			const auto hardware = std::max(1U, std::thread::hardware_concurrency());
+			std::vector<std::thread> workers;
+			for(auto count = std::min<uint64_t>(subtrees, hardware); 0 != count; --count)
+				workers.emplace_back(work);
+			for(auto& worker : workers)
+				worker.join();
+
+			if(failure)
+				std::rethrow_exception(failure);
+		}
+
+		Blake3 hash;
+		for(const auto& chaining_value : chaining_values)
+			hash.AddSubtree(chaining_value, subtree_chunks);
+		HashRange(file, subtrees * subtree_size, size, chunk_size, token, hash);
+		return hash.Complete();
+	}
+
+	// NOTE: files of other drivers (e.g. in-memory filesystem) are read through the driver, chunk after chunk by one thread.
+	KAA::FileSecurity::Blake3::digest_t HashDriverFile(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const size_t chunk_size, const KAA::FileSecurity::CancellationToken* token)
+	{
+		const KAA::filesystem::driver::mode sequential_read_only { false };
+		const KAA::filesystem::driver::share share_read { false };
+		const auto file = filesystem.open_file(path, sequential_read_only, share_read);
+		KAA::FileSecurity::Blake3 hash;
+		std::vector<uint8_t> data(chunk_size);
+		for(;;)
+		{
+			CheckCancellation(token);
+			const auto bytes_read = file->read(chunk_size, data.data());
+			if(0 == bytes_read)
+				break;
+			hash.Update(data.data(), bytes_read);
+		}
+		return hash.Complete();
+	}
+
+	bool IsHexName(const std::wstring& name, const size_t digits)
+	{
+		return digits == name.size() && std::all_of(name.begin(), name.end(), [](const wchar_t digit) { return 0 != std::iswxdigit(digit); });
+	}
+
+	// NOTE: MD5 names are 32 hex digits; keys are looked for in the directory and in shard directories (two hex digits) two levels down.
+	// RETURNS: true unless the directory is known to hold no MD5 named key: a directory failing to list may hold some.
+	bool MayHoldLegacyKeyFiles(std::wstring directory, const unsigned shard_levels)
+	{
+		if(!directory.empty() && L'\\' != directory.back())
+			directory.push_back(L'\\');
+
+		WIN32_FIND_DATAW entry = { 0 };
+		std::unique_ptr<void, decltype(&::FindClose)> search(::FindFirstFileExW(( directory + L"*" ).c_str(), FindExInfoBasic, &entry, FindExSearchNameMatch, nullptr, 0), &::FindClose);
+		if(INVALID_HANDLE_VALUE == search.get())
+		{
+			const auto error = ::GetLastError();
+			search.release(); // KAA: nothing to close.
+			return ERROR_FILE_NOT_FOUND != error && ERROR_PATH_NOT_FOUND != error;
+		}
+
+		do
+		{
+			const std::wstring name(entry.cFileName);
+			if(0 == ( entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ))
+			{
+				const auto extension = name.rfind(L'.');
+				if(std::wstring::npos != extension && L".bin" == name.substr(extension) && IsHexName(name.substr(0, extension), 32U))
+					return true;
+			}
+			else if(0 != shard_levels && IsHexName(name, 2U) && MayHoldLegacyKeyFiles(directory + name, shard_levels - 1))
+				return true;
+		} while(0 != ::FindNextFileW(search.get(), &entry));
+		return ERROR_NO_MORE_FILES != ::GetLastError();
+	}
+
+	class Blake3KeyPathDigest final : public KAA::FileSecurity::KeyPathDigest
+	{
+	public:
+		explicit Blake3KeyPathDigest(KAA::filesystem::path::directory storage) :
+		storage_path(std::move(storage)),
+		bytes_hashed(0),
+		in_order(true)
+		{}
+
+		Blake3KeyPathDigest(const Blake3KeyPathDigest&) = delete;
+		Blake3KeyPathDigest& operator = (const Blake3KeyPathDigest&) = delete;
+
+	private:
+		KAA::filesystem::path::directory storage_path;
+		KAA::FileSecurity::Blake3 hash;
+		uint64_t bytes_hashed;
+		bool in_order;
+
+		void IChunkWritten(const uint64_t offset, const void* data, const size_t size) override
+		{
+			if(!in_order)
+				return;
+			if(offset != bytes_hashed)
+			{
+				in_order = false; // KAA: rewritten or skipped range: the file has to be read again.
+				return;
+			}
+			hash.Update(data, size);
+			bytes_hashed += size;
+		}
+
+		bool IIsComplete(const uint64_t file_size) const override
+		{
+			return in_order && ( file_size == bytes_hashed );
+		}
+
+		KAA::filesystem::path::file IGetKeyPath(void) override
+		{
+			return MakeKeyPath(storage_path, hash.Complete());
+		}
+	};
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		Blake3BasedKeyStorage::Blake3BasedKeyStorage(std::shared_ptr<filesystem::driver> driver, std::shared_ptr<IOPolicy> policy, filesystem::path::directory path) :
+		filesystem(driver),
+		io_policy(policy),
+		storage_path(path),
+		legacy_storage(driver, std::move(policy), std::move(path)),
+		key_files(std::move(driver)),
+		key_lookup(nullptr),
+		legacy_keys(legacy_keys_t::unknown)
+		{
+			// KAA: filesystem and I/O policy already verified by legacy storage.
+		}
+
+		void Blake3BasedKeyStorage::SetKeyLookup(const KeyStorage* storage)
+		{
+			key_lookup = storage;
+		}
+
+		void Blake3BasedKeyStorage::ISetPath(filesystem::path::directory path)
+		{
+			storage_path = path;
+			legacy_storage.SetPath(std::move(path));
+			std::lock_guard<std::mutex> lock(legacy_guard);
+			legacy_keys = legacy_keys_t::unknown;
+		}
+
+		filesystem::path::directory Blake3BasedKeyStorage::IGetPath(void) const
+		{
+			return storage_path;
+		}
+
+		filesystem::path::file Blake3BasedKeyStorage::IGetKeyPathForSpecifiedPath(const filesystem::path::file& path) const
+		{
+			const auto chunk_size = io_policy->GetParameters(path).chunk_size;
+			const auto digest = IsWindowsFileSystem(filesystem.get()) ? HashFile(path, chunk_size, cancellation.get()) : HashDriverFile(*filesystem, path, chunk_size, cancellation.get());
+			auto key_path = MakeKeyPath(storage_path, digest);
+			if(IsKnownKey(key_path))
+				return key_path;
+
+			// KAA: migration: a key made before BLAKE3 naming is used while it exists, new keys get BLAKE3 names.
+			if(!MayHoldLegacyKeys())
+				return key_path;
+			auto legacy_key_path = legacy_storage.GetKeyPathForSpecifiedPath(path);
+			if(IsKnownKey(legacy_key_path))
+				return legacy_key_path;
+			return key_path;
+		}
+
+		std::shared_ptr<KeyPathDigest> Blake3BasedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			return std::make_shared<Blake3KeyPathDigest>(storage_path);
+		}
+
+		void Blake3BasedKeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			cancellation = token;
+			legacy_storage.SetCancellationToken(std::move(token));
+		}
+
+		void Blake3BasedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			return key_files.StoreKey(key_file, key_path);
+		}
+
+		bool Blake3BasedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			return key_files.ContainsKey(key_path);
+		}
+
+		filesystem::path::file Blake3BasedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			return key_files.LoadKey(key_path);
+		}
+
+		void Blake3BasedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.UnloadKey(key_path, key_file);
+		}
+
+		void Blake3BasedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.RemoveKey(key_path, key_file);
+		}
+
+		// NOTE: a store without MD5 named keys does not get any: the directory is looked over once, a miss then costs one hash of the file instead of two.
+		// Directories of other drivers cannot be listed, they may always hold some.
+		bool Blake3BasedKeyStorage::MayHoldLegacyKeys(void) const
+		{
+			std::lock_guard<std::mutex> lock(legacy_guard);
+			if(legacy_keys_t::unknown == legacy_keys)
+			{
+				const auto present = !IsWindowsFileSystem(filesystem.get()) || MayHoldLegacyKeyFiles(storage_path.to_wstring(), 2U);
+				legacy_keys = present ? legacy_keys_t::present : legacy_keys_t::absent;
+			}
+			return legacy_keys_t::present == legacy_keys;
+		}
+
+		bool Blake3BasedKeyStorage::IsKnownKey(const filesystem::path::file& key_path) const
+		{
+			return nullptr == key_lookup ? key_files.ContainsKey(key_path) : key_lookup->ContainsKey(key_path);
+		}
+	}
+}
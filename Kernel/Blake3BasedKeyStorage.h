@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include "KeyStorage.h"
+#include "LooseKeyFiles.h"
+#include "MD5BasedKeyStorage.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		class IOPolicy;
+
+		// NOTE: key is named after the BLAKE3 hash of the file, large files of Windows volumes are hashed by several threads; files of other drivers are read through the driver.
+		// Keys named by MD5BasedKeyStorage are still found, so existing stores keep working while new keys get BLAKE3 names;
+		// a key storage directory of a Windows volume without such keys is not looked up for them: the file is not hashed by MD5 as well.
+		class Blake3BasedKeyStorage final : public KeyStorage
+		{
+		public:
+			Blake3BasedKeyStorage(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory storage_path);
+			Blake3BasedKeyStorage(const Blake3BasedKeyStorage&) = delete;
+			Blake3BasedKeyStorage(Blake3BasedKeyStorage&&) = delete;
+			~Blake3BasedKeyStorage() = default;
+
+			Blake3BasedKeyStorage& operator = (const Blake3BasedKeyStorage&) = delete;
+			Blake3BasedKeyStorage& operator = (Blake3BasedKeyStorage&&) = delete;
+
+			// NOTE: keys are looked up in a storage wrapping this one that keeps keys elsewhere, it has to outlive this one; nullptr: the key files.
+			void SetKeyLookup(const KeyStorage*);
+
+		private:
+			void ISetPath(filesystem::path::directory) override;
+			filesystem::path::directory IGetPath(void) const override;
+
+			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+			void ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			std::shared_ptr<filesystem::driver> filesystem;
+			std::shared_ptr<IOPolicy> io_policy;
+			filesystem::path::directory storage_path;
+			std::shared_ptr<CancellationToken> cancellation;
+			MD5BasedKeyStorage legacy_storage;
+			LooseKeyFiles key_files;
+			const KeyStorage* key_lookup;
+
+			enum class legacy_keys_t { unknown, absent, present };
+			mutable std::mutex legacy_guard;
+			mutable legacy_keys_t legacy_keys;
+
+			bool MayHoldLegacyKeys(void) const;
+			bool IsKnownKey(const filesystem::path::file& key_path) const;
+		};
+	}
+}
@@ -3,12 +3,15 @@
 #include "KAA/include/convert.h"
 #include "KAA/include/checksum.h"
 
+#include "KeyPathDigest.h"
+
 namespace KAA
 {
 	namespace FileSecurity
 	{
-		CRC32BasedKeyStorage::CRC32BasedKeyStorage(filesystem::path::directory path) :
-		storage_path(std::move(path))
+		CRC32BasedKeyStorage::CRC32BasedKeyStorage(std::shared_ptr<filesystem::driver> driver, filesystem::path::directory path) :
+		storage_path(std::move(path)),
+		key_files(std::move(driver))
 		{}
 
 		void CRC32BasedKeyStorage::ISetPath(filesystem::path::directory path)
@@ -29,5 +32,35 @@ namespace KAA
 			const auto filename = convert::to_wstring(checksum) + std::wstring{ L".bin" };
 			return storage_path + filename;
 		}
+
+		std::shared_ptr<KeyPathDigest> CRC32BasedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			return nullptr; // KAA: key path is derived from the file name only.
+		}
+
+		void CRC32BasedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			return key_files.StoreKey(key_file, key_path);
+		}
+
+		bool CRC32BasedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			return key_files.ContainsKey(key_path);
+		}
+
+		filesystem::path::file CRC32BasedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			return key_files.LoadKey(key_path);
+		}
+
+		void CRC32BasedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.UnloadKey(key_path, key_file);
+		}
+
+		void CRC32BasedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.RemoveKey(key_path, key_file);
+		}
 	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "KeyStorage.h"
+#include "LooseKeyFiles.h"
 
 namespace KAA
 {
@@ -9,7 +10,7 @@ namespace KAA
 		class CRC32BasedKeyStorage final : public KeyStorage
 		{
 		public:
-			explicit CRC32BasedKeyStorage(filesystem::path::directory storage_path);
+			CRC32BasedKeyStorage(std::shared_ptr<filesystem::driver>, filesystem::path::directory storage_path);
 			~CRC32BasedKeyStorage() = default;
 
 		private:
@@ -17,8 +18,16 @@ namespace KAA
 			filesystem::path::directory IGetPath(void) const override;
 
 			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
 
 			filesystem::path::directory storage_path;
+			LooseKeyFiles key_files;
 		};
 	}
 }
@@ -0,0 +1,384 @@
+#include "CachedKeyStorage.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include "FileInformation.h"
+#include "KeyPathDigest.h"
+#include "NativeFileSystem.h"
+#include "Tracer.h"
+
+namespace
+{
+	constexpr auto journal_name = L"key_paths.cache";
+	constexpr uint8_t journal_signature[] = { 'F', 'S', 'K', 'C' };
+	constexpr uint32_t journal_version = 3; // KAA: records of version 1 had no file path, those of version 2 had the creation time for the change time.
+	constexpr size_t journal_header_size = sizeof(journal_signature) + sizeof(uint32_t);
+	constexpr size_t compaction_slack = 64U; // KAA: stale records tolerated on top of twice the live ones.
+
+	// NOTE: journal: signature, version, then records: volume serial number, file index, size, last write time, change time,
+	// file path length in characters, file path, key path length in characters, key path.
+	constexpr size_t record_header_size = sizeof(uint32_t) + 4 * sizeof(uint64_t) + sizeof(uint32_t);
+
+	template <typename T>
+	void Append(std::vector<uint8_t>& record, const T& value)
+	{
+		const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		record.insert(record.end(), bytes, bytes + sizeof(value));
+	}
+
+	void Append(std::vector<uint8_t>& record, const std::wstring& text)
+	{
+		Append(record, static_cast<uint32_t>(text.length()));
+		const auto characters = reinterpret_cast<const uint8_t*>(text.data());
+		record.insert(record.end(), characters, characters + text.length() * sizeof(wchar_t));
+	}
+
+	template <typename T>
+	T Extract(const uint8_t*& data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(value));
+		data += sizeof(value);
+		return value;
+	}
+
+	// RETURNS: false if the journal ends within the text: torn write at the end of the journal.
+	bool Extract(const uint8_t*& data, const uint8_t* end, std::wstring& text)
+	{
+		if(static_cast<size_t>(end - data) < sizeof(uint32_t))
+			return false;
+		const auto length = Extract<uint32_t>(data);
+		if(static_cast<size_t>(end - data) / sizeof(wchar_t) < length)
+			return false;
+		text.resize(length);
+		if(0 != length)
+			std::memcpy(&text[0], data, length * sizeof(wchar_t));
+		data += length * sizeof(wchar_t);
+		return true;
+	}
+
+	std::vector<uint8_t> ReadJournal(const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		if(!filesystem.check_access(path, KAA::filesystem::driver::existence))
+			return {};
+
+		const KAA::filesystem::driver::mode sequential_read_only { false };
+		const KAA::filesystem::driver::share allow_read { true, false };
+		const auto journal = filesystem.open_file(path, sequential_read_only, allow_read);
+		std::vector<uint8_t> data;
+		std::vector<uint8_t> chunk(64U * 1024U);
+		for(;;)
+		{
+			const auto bytes_read = journal->read(chunk.size(), chunk.data());
+			if(0 == bytes_read)
+				return data;
+			data.insert(data.end(), chunk.begin(), chunk.begin() + bytes_read);
+		}
+	}
+
+	void AppendJournal(const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const std::vector<uint8_t>& records)
+	{
+		const KAA::filesystem::driver::mode random_read_write(true, true, true, true);
+		const KAA::filesystem::driver::share allow_read { true, false };
+		const auto journal = filesystem.open_file(path, random_read_write, allow_read);
+		journal->seek(0, KAA::filesystem::file::end);
+		if(journal->write(records.data(), records.size()) != records.size())
+			throw KAA::system_failure { __FUNCTION__, "unable to write key path cache", EIO };
+	}
+
+	// NOTE: the journal is written aside and put in place then; a failure in between loses the cache, not the keys.
+	void RewriteJournal(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const std::vector<uint8_t>& records)
+	{
+		const auto rewritten = filesystem.get_temp_filename(path.get_directory());
+		try
+		{
+			{
+				const KAA::filesystem::driver::create_mode persistent_not_exists;
+				const KAA::filesystem::driver::mode sequential_write_only(true, false);
+				const KAA::filesystem::driver::share exclusive_access(false, false);
+				const KAA::filesystem::driver::permission allow_read_write;
+				const auto journal = filesystem.create_file(rewritten, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+				if(journal->write(records.data(), records.size()) != records.size())
+					throw KAA::system_failure { __FUNCTION__, "unable to write key path cache", EIO };
+				journal->commit();
+			}
+			if(filesystem.check_access(path, KAA::filesystem::driver::existence))
+				filesystem.remove_file(path);
+			filesystem.rename_file(rewritten, path);
+		}
+		catch(...)
+		{
+			if(filesystem.check_access(rewritten, KAA::filesystem::driver::existence))
+				filesystem.remove_file(rewritten);
+			throw;
+		}
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool CachedKeyStorage::file_identity_t::operator < (const file_identity_t& other) const
+		{
+			return std::tie(volume_serial_number, file_index) < std::tie(other.volume_serial_number, other.file_index);
+		}
+
+		bool CachedKeyStorage::file_version_t::operator == (const file_version_t& other) const
+		{
+			return ( size == other.size ) && ( last_write_time == other.last_write_time ) && ( change_time == other.change_time );
+		}
+
+		CachedKeyStorage::CachedKeyStorage(std::unique_ptr<KeyStorage> storage, std::shared_ptr<filesystem::driver> filesystem) :
+		m_storage(std::move(storage)),
+		m_filesystem(std::move(filesystem)),
+		journal_records(0),
+		journal_outdated(true),
+		hits(0),
+		misses(0)
+		{
+			if(( !m_storage ) || ( !m_filesystem ))
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create cached key storage class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+			LoadJournal();
+		}
+
+		key_path_cache_statistics_t CachedKeyStorage::GetStatistics(void) const
+		{
+			return { hits.load(), misses.load() };
+		}
+
+		void CachedKeyStorage::ISetPath(filesystem::path::directory path)
+		{
+			m_storage->SetPath(std::move(path));
+			LoadJournal();
+		}
+
+		filesystem::path::directory CachedKeyStorage::IGetPath(void) const
+		{
+			return m_storage->GetPath();
+		}
+
+		filesystem::path::file CachedKeyStorage::IGetKeyPathForSpecifiedPath(const filesystem::path::file& path) const
+		{
+			file_identity_t identity = { 0 };
+			file_version_t version = { 0 };
+			if(!QueryFile(path, identity, version))
+			{
+				CountLookup(false);
+				return m_storage->GetKeyPathForSpecifiedPath(path);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(entries_guard);
+				const auto entry = entries.find(identity);
+				if(( entries.end() != entry ) && ( entry->second.version == version ))
+				{
+					CountLookup(true);
+					return filesystem::path::file { entry->second.key_path };
+				}
+			}
+
+			CountLookup(false);
+			auto key_path = m_storage->GetKeyPathForSpecifiedPath(path);
+			Remember(identity, version, path, key_path.to_wstring());
+			return key_path;
+		}
+
+		std::shared_ptr<KeyPathDigest> CachedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			return m_storage->StartKeyPathDigest();
+		}
+
+		void CachedKeyStorage::IRememberKeyPath(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			file_identity_t identity = { 0 };
+			file_version_t version = { 0 };
+			if(QueryFile(path, identity, version))
+				Remember(identity, version, path, key_path.to_wstring());
+		}
+
+		void CachedKeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			m_storage->SetCancellationToken(std::move(token));
+		}
+
+		// RETURNS: false if the file information is not available, the file is then left to the underlying storage.
+		bool CachedKeyStorage::QueryFile(const filesystem::path::file& path, file_identity_t& identity, file_version_t& version) const
+		{
+			file_information_t information = { 0 };
+			if(const auto source = dynamic_cast<const FileInformationSource*>(m_filesystem.get()))
+			{
+				if(!source->QueryFileInformation(path, information))
+					return false;
+			}
+			else if(!IsWindowsFileSystem(m_filesystem.get()) || !QueryWindowsFileInformation(path, information))
+				return false; // KAA: the driver does not tell file identity, the path may not even name a file of a Windows volume.
+
+			identity.volume_serial_number = information.volume_serial_number;
+			identity.file_index = information.file_index;
+			version.size = information.size;
+			version.last_write_time = information.last_write_time;
+			version.change_time = information.change_time;
+			return true;
+		}
+
+		void CachedKeyStorage::CountLookup(const bool hit) const
+		{
+			const auto hit_count = hit ? ++hits : hits.load();
+			const auto miss_count = hit ? misses.load() : ++misses;
+			if(const auto tracer = Tracer::GetActive())
+			{
+				try
+				{
+					tracer->Count("KeyPathCache", std::chrono::steady_clock::now(), { { "hits", hit_count }, { "misses", miss_count } });
+				}
+				catch(...)
+				{} // KAA: a counter lost is better than a lookup failed.
+			}
+		}
+
+		void CachedKeyStorage::LoadJournal(void)
+		{
+			std::lock_guard<std::mutex> lock(entries_guard);
+			entries.clear();
+			journal_records = 0;
+			journal_outdated = true;
+
+			std::vector<uint8_t> journal;
+			try
+			{
+				journal = ReadJournal(*m_filesystem, m_storage->GetPath() + journal_name);
+			}
+			catch(const failure&)
+			{
+				return; // KAA: the cache is an optimization: start empty.
+			}
+			auto record = static_cast<const uint8_t*>(journal.data());
+			if(( journal.size() < journal_header_size ) || ( !std::equal(std::begin(journal_signature), std::end(journal_signature), record) ))
+				return;
+			record += sizeof(journal_signature);
+			if(journal_version != Extract<uint32_t>(record))
+				return;
+			journal_outdated = false;
+
+			const auto end = journal.data() + journal.size();
+			while(static_cast<size_t>(end - record) >= record_header_size)
+			{
+				file_identity_t identity = { 0 };
+				entry_t entry;
+				identity.volume_serial_number = Extract<uint32_t>(record);
+				identity.file_index = Extract<uint64_t>(record);
+				entry.version.size = Extract<uint64_t>(record);
+				entry.version.last_write_time = Extract<uint64_t>(record);
+				entry.version.change_time = Extract<uint64_t>(record);
+				if(( !Extract(record, end, entry.path) ) || ( !Extract(record, end, entry.key_path) ))
+					break;
+
+				entries[identity] = std::move(entry); // KAA: later records supersede earlier ones.
+				++journal_records;
+			}
+		}
+
+		void CachedKeyStorage::Remember(const file_identity_t& identity, const file_version_t& version, const filesystem::path::file& path, const std::wstring& key_path) const
+		{
+			const auto record = [](const file_identity_t& identity, const entry_t& entry)
+			{
+				std::vector<uint8_t> data;
+				Append(data, identity.volume_serial_number);
+				Append(data, identity.file_index);
+				Append(data, entry.version.size);
+				Append(data, entry.version.last_write_time);
+				Append(data, entry.version.change_time);
+				Append(data, entry.path);
+				Append(data, entry.key_path);
+				return data;
+			};
+
+			std::lock_guard<std::mutex> lock(entries_guard);
+			const entry_t entry = { version, path.to_wstring(), key_path };
+			entries[identity] = entry;
+
+			const auto journal_path = m_storage->GetPath() + journal_name;
+			try
+			{
+				if(( !journal_outdated ) && ( journal_records < 2 * entries.size() + compaction_slack ))
+				{
+					AppendJournal(*m_filesystem, journal_path, record(identity, entry));
+					++journal_records;
+					return;
+				}
+
+				// KAA: rewrite the journal with live entries only, files removed meanwhile are dropped.
+				for(auto live = entries.begin(); entries.end() != live;)
+				{
+					if(m_filesystem->check_access(filesystem::path::file { live->second.path }, filesystem::driver::existence))
+						++live;
+					else
+						live = entries.erase(live);
+				}
+				std::vector<uint8_t> records(std::begin(journal_signature), std::end(journal_signature));
+				Append(records, journal_version);
+				for(const auto& live : entries)
+				{
+					const auto data = record(live.first, live.second);
+					records.insert(records.end(), data.begin(), data.end());
+				}
+				RewriteJournal(*m_filesystem, journal_path, records);
+				journal_records = entries.size();
+				journal_outdated = false;
+			}
+			catch(const failure&)
+			{
+				// KAA: read-only key storage: the entry is still kept for this session, the journal is not rewritten again before it has grown.
+				journal_records = 0;
+				journal_outdated = false;
+			}
+		}
+
+		void CachedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			return m_storage->StoreKey(key_file, key_path);
+		}
+
+		bool CachedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			return m_storage->ContainsKey(key_path);
+		}
+
+		filesystem::path::file CachedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			return m_storage->LoadKey(key_path);
+		}
+
+		std::unique_ptr<filesystem::file> CachedKeyStorage::IOpenKey(const filesystem::path::file& key_path)
+		{
+			return m_storage->OpenKey(key_path);
+		}
+
+		void CachedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return m_storage->UnloadKey(key_path, key_file);
+		}
+
+		void CachedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return m_storage->RemoveKey(key_path, key_file);
+		}
+	}
+}
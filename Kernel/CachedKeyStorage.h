@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "KeyStorage.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		struct key_path_cache_statistics_t
+		{
+			uint64_t hits;
+			uint64_t misses;
+		};
+
+		// NOTE: remembers key paths of content based storages by file identity: volume serial number, file index, size, last write and change time.
+		// A known unchanged file costs one file information query instead of reading the whole file. Entries are appended to a journal in the key storage,
+		// entries of files which no longer exist are dropped when the journal is compacted. File identity is known for drivers that tell file information and for Windows volumes:
+		// on other drivers every request is left to the underlying storage. Lookups are counted, the counters are traced while a tracer is installed.
+		class CachedKeyStorage final : public KeyStorage
+		{
+		public:
+			CachedKeyStorage(std::unique_ptr<KeyStorage>, std::shared_ptr<filesystem::driver>);
+			CachedKeyStorage(const CachedKeyStorage&) = delete;
+			CachedKeyStorage(CachedKeyStorage&&) = delete;
+			~CachedKeyStorage() = default;
+
+			CachedKeyStorage& operator = (const CachedKeyStorage&) = delete;
+			CachedKeyStorage& operator = (CachedKeyStorage&&) = delete;
+
+			key_path_cache_statistics_t GetStatistics(void) const;
+
+		private:
+			struct file_identity_t
+			{
+				uint32_t volume_serial_number;
+				uint64_t file_index;
+
+				bool operator < (const file_identity_t&) const;
+			};
+
+			struct file_version_t
+			{
+				uint64_t size;
+				uint64_t last_write_time;
+				uint64_t change_time;
+
+				bool operator == (const file_version_t&) const;
+			};
+
+			struct entry_t
+			{
+				file_version_t version;
+				std::wstring path;
+				std::wstring key_path;
+			};
+
+			std::unique_ptr<KeyStorage> m_storage;
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			mutable std::mutex entries_guard;
+			mutable std::map<file_identity_t, entry_t> entries;
+			mutable size_t journal_records;
+			mutable bool journal_outdated; // KAA: missing, of an earlier format, or holding too many superseded records: rewritten on the next entry.
+			mutable std::atomic<uint64_t> hits;
+			mutable std::atomic<uint64_t> misses;
+
+			void ISetPath(filesystem::path::directory) override;
+			filesystem::path::directory IGetPath(void) const override;
+
+			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+			void IRememberKeyPath(const filesystem::path::file&, const filesystem::path::file&) override;
+			void ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			std::unique_ptr<filesystem::file> IOpenKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			bool QueryFile(const filesystem::path::file&, file_identity_t&, file_version_t&) const;
+			void CountLookup(bool hit) const;
+			void LoadJournal(void);
+			void Remember(const file_identity_t&, const file_version_t&, const filesystem::path::file&, const std::wstring& key_path) const;
+		};
+	}
+}
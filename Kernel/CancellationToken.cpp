@@ -0,0 +1,37 @@
+#include "CancellationToken.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		OperationCancelled::OperationCancelled() :
+		std::runtime_error("the operation has been cancelled")
+		{}
+
+		CancellationToken::CancellationToken() :
+		cancelled(false)
+		{}
+
+		void CancellationToken::Cancel(void)
+		{
+			cancelled = true;
+		}
+
+		bool CancellationToken::IsCancelled(void) const
+		{
+			return cancelled;
+		}
+
+		void CancellationToken::Check(void) const
+		{
+			if(cancelled)
+				throw OperationCancelled();
+		}
+
+		void CheckProgressState(const progress_state_t state)
+		{
+			if(( progress_state_t::cancel == state ) || ( progress_state_t::stop == state ))
+				throw OperationCancelled();
+		}
+	}
+}
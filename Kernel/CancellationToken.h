@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <stdexcept>
+
+#include "KAA/include/progress_state.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: thrown by a stage that has seen its operation cancelled, the stages above roll back what they have done for the file.
+		class OperationCancelled final : public std::runtime_error
+		{
+		public:
+			OperationCancelled();
+		};
+
+		// NOTE: shared by every stage of an operation, each checks it once per chunk. Set from any thread.
+		class CancellationToken final
+		{
+		public:
+			CancellationToken();
+			CancellationToken(const CancellationToken&) = delete;
+			CancellationToken(CancellationToken&&) = delete;
+			~CancellationToken() = default;
+
+			CancellationToken& operator = (const CancellationToken&) = delete;
+			CancellationToken& operator = (CancellationToken&&) = delete;
+
+			void Cancel(void);
+			bool IsCancelled(void) const;
+			// NOTE: throws OperationCancelled.
+			void Check(void) const;
+
+		private:
+			std::atomic<bool> cancelled;
+		};
+
+		// NOTE: for stages told by the state a progress report returns; throws OperationCancelled on cancel and stop.
+		void CheckProgressState(progress_state_t);
+	}
+}
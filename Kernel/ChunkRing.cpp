@@ -0,0 +1,84 @@
+#include "ChunkRing.h"
+
+#include "KAA/include/exception/operation_failure.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		ChunkRing::ChunkRing(const size_t slots_count, const size_t chunk_size) :
+		slots(slots_count),
+		produced(0),
+		consumed(0),
+		closed(false),
+		cancelled(false)
+		{
+			if(0 == slots_count || 0 == chunk_size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create chunk ring class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			for(auto& slot : slots)
+			{
+				slot.data.resize(chunk_size);
+				slot.key.resize(chunk_size);
+				slot.size = 0;
+			}
+		}
+
+		ChunkRing::chunk_t* ChunkRing::AcquireEmpty(void)
+		{
+			std::unique_lock<std::mutex> lock(guard);
+			slot_released.wait(lock, [this] { return cancelled || produced - consumed < slots.size(); });
+			return cancelled ? nullptr : &slots[produced % slots.size()];
+		}
+
+		void ChunkRing::PublishFilled(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				++produced;
+			}
+			slot_filled.notify_one();
+		}
+
+		void ChunkRing::Close(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				closed = true;
+			}
+			slot_filled.notify_one();
+		}
+
+		ChunkRing::chunk_t* ChunkRing::AcquireFilled(void)
+		{
+			std::unique_lock<std::mutex> lock(guard);
+			slot_filled.wait(lock, [this] { return cancelled || closed || consumed != produced; });
+			return ( cancelled || consumed == produced ) ? nullptr : &slots[consumed % slots.size()];
+		}
+
+		void ChunkRing::ReleaseEmpty(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				++consumed;
+			}
+			slot_released.notify_one();
+		}
+
+		void ChunkRing::Cancel(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				cancelled = true;
+			}
+			slot_released.notify_one();
+			slot_filled.notify_one();
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: bounded ring of reusable chunk buffers between a single producer and a single consumer.
+		// Producer: AcquireEmpty -> fill -> PublishFilled, Close when there is no more data.
+		// Consumer: AcquireFilled -> drain -> ReleaseEmpty, Cancel to abandon the producer.
+		class ChunkRing final
+		{
+		public:
+			struct chunk_t
+			{
+				std::vector<uint8_t> data;
+				std::vector<uint8_t> key;
+				size_t size;
+			};
+
+			ChunkRing(size_t slots, size_t chunk_size);
+			ChunkRing(const ChunkRing&) = delete;
+			ChunkRing(ChunkRing&&) = delete;
+			~ChunkRing() = default;
+
+			ChunkRing& operator = (const ChunkRing&) = delete;
+			ChunkRing& operator = (ChunkRing&&) = delete;
+
+			// RETURNS: nullptr if the consumer cancelled the ring.
+			chunk_t* AcquireEmpty(void);
+			void PublishFilled(void);
+			void Close(void);
+
+			// RETURNS: nullptr if the ring is closed and drained or cancelled.
+			chunk_t* AcquireFilled(void);
+			void ReleaseEmpty(void);
+			void Cancel(void);
+
+		private:
+			std::vector<chunk_t> slots;
+			size_t produced;
+			size_t consumed;
+			bool closed;
+			bool cancelled;
+
+			std::mutex guard;
+			std::condition_variable slot_released;
+			std::condition_variable slot_filled;
+		};
+	}
+}
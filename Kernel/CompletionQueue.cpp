@@ -0,0 +1,185 @@
+#include "CompletionQueue.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+
+#include <windows.h>
+
+#include "NativeFile.h"
+
+namespace
+{
+	// KAA: OVERLAPPED comes first, the completion gives its address back.
+	struct request_t
+	{
+		OVERLAPPED position;
+		HANDLE file;
+		void* tag;
+	};
+
+	void ThrowQueueFull(const char* source)
+	{
+		constexpr auto description = "unable to submit I/O request: completion queue is full";
+		constexpr auto reason = KAA::operation_failure::status_code_t::invalid_argument;
+		constexpr auto severity = KAA::operation_failure::severity_t::error;
+		throw KAA::operation_failure(source, description, reason, severity);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		struct CompletionQueue::port_t
+		{
+			HANDLE handle;
+			std::vector<request_t> requests;
+			std::vector<request_t*> free_requests;
+			std::vector<OVERLAPPED_ENTRY> entries;
+
+			explicit port_t(const size_t capacity) :
+			handle(::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1)),
+			requests(capacity),
+			entries(capacity)
+			{
+				if(nullptr == handle)
+				{
+					const auto error = ::GetLastError();
+					throw windows_api_failure { __FUNCTION__, "unable to create I/O completion port", error };
+				}
+				free_requests.reserve(capacity);
+				for(auto& request : requests)
+					free_requests.push_back(&request);
+			}
+
+			port_t(const port_t&) = delete;
+			port_t& operator = (const port_t&) = delete;
+
+			~port_t()
+			{
+				::CloseHandle(handle);
+			}
+
+			size_t GetPending(void) const
+			{
+				return requests.size() - free_requests.size();
+			}
+
+			request_t& Acquire(const NativeFile& file, const uint64_t offset, void* tag)
+			{
+				if(free_requests.empty())
+					ThrowQueueFull(__FUNCTION__);
+				auto& request = *free_requests.back();
+				free_requests.pop_back();
+				request.position = OVERLAPPED { 0 };
+				request.position.Offset = static_cast<DWORD>(offset);
+				request.position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				request.file = file.GetHandle();
+				request.tag = tag;
+				return request;
+			}
+
+			// NOTE: a request which has failed at once has not got a completion, it is given back here.
+			void CheckSubmitted(request_t& request, const BOOL submitted, const char* source, const char* description)
+			{
+				if(0 == submitted)
+				{
+					const auto error = ::GetLastError();
+					if(ERROR_IO_PENDING != error)
+					{
+						free_requests.push_back(&request);
+						throw windows_api_failure { source, description, error };
+					}
+				}
+			}
+		};
+
+		CompletionQueue::CompletionQueue(const size_t capacity) :
+		port(nullptr)
+		{
+			if(0 == capacity)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create completion queue class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+			port = std::make_unique<port_t>(capacity);
+		}
+
+		CompletionQueue::~CompletionQueue()
+		{
+			// KAA: the kernel writes to the buffers and OVERLAPPED structures until a request completes: all of them are waited for.
+			std::vector<bool> pending(port->requests.size(), true);
+			for(const auto request : port->free_requests)
+				pending[request - port->requests.data()] = false;
+			for(size_t index = 0; index < pending.size(); ++index)
+				if(pending[index])
+					::CancelIoEx(port->requests[index].file, &port->requests[index].position);
+
+			while(0 != port->GetPending())
+			{
+				ULONG removed = 0;
+				if(0 == ::GetQueuedCompletionStatusEx(port->handle, port->entries.data(), static_cast<ULONG>(port->entries.size()), &removed, INFINITE, FALSE))
+					break; // DEFECT: KAA: the port is broken, requests cannot be waited for.
+				for(ULONG index = 0; index < removed; ++index)
+					port->free_requests.push_back(reinterpret_cast<request_t*>(port->entries[index].lpOverlapped));
+			}
+		}
+
+		void CompletionQueue::Associate(const NativeFile& file)
+		{
+			if(nullptr == ::CreateIoCompletionPort(file.GetHandle(), port->handle, 0, 0))
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to associate file with I/O completion port", error };
+			}
+			::SetFileCompletionNotificationModes(file.GetHandle(), FILE_SKIP_SET_EVENT_ON_HANDLE); // KAA: nobody waits on the handle, its event is not signalled.
+		}
+
+		void CompletionQueue::SubmitRead(const NativeFile& file, const uint64_t offset, void* buffer, const size_t size, void* tag)
+		{
+			auto& request = port->Acquire(file, offset, tag);
+			const auto submitted = ::ReadFile(request.file, buffer, static_cast<DWORD>(size), nullptr, &request.position);
+			port->CheckSubmitted(request, submitted, __FUNCTION__, "unable to read file");
+		}
+
+		void CompletionQueue::SubmitWrite(const NativeFile& file, const uint64_t offset, const void* buffer, const size_t size, void* tag)
+		{
+			auto& request = port->Acquire(file, offset, tag);
+			const auto submitted = ::WriteFile(request.file, buffer, static_cast<DWORD>(size), nullptr, &request.position);
+			port->CheckSubmitted(request, submitted, __FUNCTION__, "unable to write file");
+		}
+
+		size_t CompletionQueue::GetPending(void) const
+		{
+			return port->GetPending();
+		}
+
+		size_t CompletionQueue::Wait(completion_t* completions, const size_t capacity)
+		{
+			const auto count = static_cast<ULONG>(std::min(capacity, port->entries.size()));
+			ULONG removed = 0;
+			if(0 == ::GetQueuedCompletionStatusEx(port->handle, port->entries.data(), count, &removed, INFINITE, FALSE))
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to dequeue I/O completions", error };
+			}
+
+			for(ULONG index = 0; index < removed; ++index)
+			{
+				auto& request = *reinterpret_cast<request_t*>(port->entries[index].lpOverlapped);
+				DWORD bytes = 0;
+				// KAA: the request has completed, its status is read from the OVERLAPPED structure without waiting.
+				const auto error = ( 0 == ::GetOverlappedResult(request.file, &request.position, &bytes, FALSE) ) ? ::GetLastError() : ERROR_SUCCESS;
+				completions[index] = completion_t { request.tag, bytes, error };
+				port->free_requests.push_back(&request);
+			}
+			return removed;
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		class NativeFile;
+
+		// NOTE: I/O completion port for overlapped files: requests are submitted without waiting for them,
+		// their completions are reaped in batches by a single thread. Up to capacity requests may be in flight.
+		// Requests still in flight are cancelled and waited for on destruction: their files and buffers have to outlive the queue.
+		class CompletionQueue final
+		{
+		public:
+			struct completion_t
+			{
+				void* tag;
+				size_t bytes;
+				unsigned long error; // NOTE: Windows error code, 0 if the request has succeeded.
+			};
+
+			explicit CompletionQueue(size_t capacity);
+			CompletionQueue(const CompletionQueue&) = delete;
+			CompletionQueue(CompletionQueue&&) = delete;
+			~CompletionQueue();
+
+			CompletionQueue& operator = (const CompletionQueue&) = delete;
+			CompletionQueue& operator = (CompletionQueue&&) = delete;
+
+			// NOTE: a file is bound to one queue for the lifetime of its handle.
+			void Associate(const NativeFile&);
+
+			void SubmitRead(const NativeFile&, uint64_t offset, void* buffer, size_t size, void* tag);
+			void SubmitWrite(const NativeFile&, uint64_t offset, const void* buffer, size_t size, void* tag);
+
+			size_t GetPending(void) const;
+
+			// NOTE: blocks until at least one request has completed.
+			// RETURNS: number of completions stored, up to capacity.
+			size_t Wait(completion_t* completions, size_t capacity);
+
+		private:
+			struct port_t;
+			std::unique_ptr<port_t> port;
+		};
+	}
+}
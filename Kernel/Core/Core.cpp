@@ -33,6 +33,16 @@ namespace KAA
 			return IDecryptFile(path);
 		}
 
+		void Core::EncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination)
+		{
+			return IEncryptFile(source, destination);
+		}
+
+		void Core::DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination)
+		{
+			return IDecryptFile(source, destination);
+		}
+
 		bool Core::IsFileEncrypted(const filesystem::path::file& path) const
 		{
 			return IIsFileEncrypted(path);
@@ -42,5 +52,15 @@ namespace KAA
 		{
 			return ISetProgressHandler(std::move(handler));
 		}
+
+		std::shared_ptr<ProgressCounter> Core::SetProgressCounter(std::shared_ptr<ProgressCounter> counter)
+		{
+			return ISetProgressCounter(std::move(counter));
+		}
+
+		std::shared_ptr<CancellationToken> Core::SetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			return ISetCancellationToken(std::move(token));
+		}
 	}
 }
@@ -17,7 +17,9 @@ namespace KAA
 {
 	namespace FileSecurity
 	{
+		class CancellationToken;
 		class CoreProgressHandler;
+		class ProgressCounter;
 
 		class Core
 		{
@@ -30,9 +32,17 @@ namespace KAA
 			void EncryptFile(const filesystem::path::file&);
 			void DecryptFile(const filesystem::path::file&);
 
+			// NOTE: out-of-place: result goes to destination, source stays intact.
+			void EncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination);
+			void DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination);
+
 			bool IsFileEncrypted(const filesystem::path::file&) const;
 
 			std::shared_ptr<CoreProgressHandler> SetProgressHandler(std::shared_ptr<CoreProgressHandler>);
+			// NOTE: chunks processed are published to the counter while it is set, stages still go to the progress handler.
+			std::shared_ptr<ProgressCounter> SetProgressCounter(std::shared_ptr<ProgressCounter>);
+			// NOTE: checked by the stages that report no progress (e.g. key path hashing), the file is left as it was when cancelled.
+			std::shared_ptr<CancellationToken> SetCancellationToken(std::shared_ptr<CancellationToken>);
 
 		private:
 			virtual filesystem::path::directory IGetKeyStoragePath(void) const = 0;
@@ -41,9 +51,14 @@ namespace KAA
 			virtual void IEncryptFile(const filesystem::path::file&) = 0;
 			virtual void IDecryptFile(const filesystem::path::file&) = 0;
 
+			virtual void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) = 0;
+			virtual void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) = 0;
+
 			virtual bool IIsFileEncrypted(const filesystem::path::file&) const = 0;
 
 			virtual std::shared_ptr<CoreProgressHandler> ISetProgressHandler(std::shared_ptr<CoreProgressHandler>) = 0;
+			virtual std::shared_ptr<ProgressCounter> ISetProgressCounter(std::shared_ptr<ProgressCounter>) = 0;
+			virtual std::shared_ptr<CancellationToken> ISetCancellationToken(std::shared_ptr<CancellationToken>) = 0;
 		};
 	}
 }
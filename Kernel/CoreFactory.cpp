@@ -3,20 +3,48 @@
 #include <stdexcept>
 
 #include "AbsoluteSecurityCore.h"
+#include "FileCipher.h"
+#include "KeyStorage.h"
 #include "StrongSecurityCore.h"
 
 namespace KAA
 {
 	namespace FileSecurity
 	{
-		std::unique_ptr<Core> QueryCore(const core_t interface_identifier, std::shared_ptr<filesystem::driver> filesystem, filesystem::path::directory key_storage_path)
+		std::unique_ptr<Core> QueryCore(const core_t interface_identifier, std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, filesystem::path::directory key_storage_path, const cipher_t cipher, const key_storage_t key_storage, const key_storage_layout_t key_storage_layout)
 		{
 			switch (interface_identifier)
 			{
 			case core_t::strong_security:
 				throw std::invalid_argument(__FUNCTION__);
 			case core_t::absolute_security:
-				return std::make_unique<AbsoluteSecurityCore>(std::move(filesystem), std::move(key_storage_path));
+				return std::make_unique<AbsoluteSecurityCore>(std::move(filesystem), std::move(io_policy), std::move(key_storage_path), cipher, key_storage, key_storage_layout);
+			default:
+				throw std::invalid_argument(__FUNCTION__);
+			}
+		}
+
+		std::shared_ptr<KeyStorage> QueryKeyStorage(const core_t interface_identifier, std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, filesystem::path::directory key_storage_path, const key_storage_t key_storage, const key_storage_layout_t key_storage_layout)
+		{
+			switch (interface_identifier)
+			{
+			case core_t::strong_security:
+				throw std::invalid_argument(__FUNCTION__);
+			case core_t::absolute_security:
+				return AbsoluteSecurityCore::OpenKeyStorage(std::move(filesystem), std::move(io_policy), std::move(key_storage_path), key_storage, key_storage_layout);
+			default:
+				throw std::invalid_argument(__FUNCTION__);
+			}
+		}
+
+		std::unique_ptr<Core> QueryCore(const core_t interface_identifier, std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, std::shared_ptr<KeyStorage> key_storage, std::unique_ptr<FileCipher> cipher)
+		{
+			switch (interface_identifier)
+			{
+			case core_t::strong_security:
+				throw std::invalid_argument(__FUNCTION__);
+			case core_t::absolute_security:
+				return std::make_unique<AbsoluteSecurityCore>(std::move(filesystem), std::move(io_policy), std::move(key_storage), std::move(cipher));
 			default:
 				throw std::invalid_argument(__FUNCTION__);
 			}
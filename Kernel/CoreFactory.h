@@ -3,6 +3,9 @@
 #include <memory>
 //#include <unknwn.h>
 
+#include "FileCipherFactory.h"
+#include "KeyStorageFactory.h"
+
 namespace KAA
 {
 	namespace filesystem
@@ -17,13 +20,20 @@ namespace KAA
 	namespace FileSecurity
 	{
 		class Core;
+		class FileCipher;
+		class IOPolicy;
+		class KeyStorage;
 		enum class core_t
 		{
 			strong_security,
 			absolute_security
 		};
 
-		std::unique_ptr<Core> QueryCore(core_t, std::shared_ptr<filesystem::driver>, filesystem::path::directory key_storage_path);
+		std::unique_ptr<Core> QueryCore(core_t, std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory key_storage_path, cipher_t, key_storage_t, key_storage_layout_t);
+
+		// NOTE: cores created over one key storage may process files at once, a directory job creates one per worker thread.
+		std::shared_ptr<KeyStorage> QueryKeyStorage(core_t, std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory key_storage_path, key_storage_t, key_storage_layout_t);
+		std::unique_ptr<Core> QueryCore(core_t, std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, std::shared_ptr<KeyStorage>, std::unique_ptr<FileCipher>);
 
 		/*class CoreFactory : public IUnknown
 		{
@@ -0,0 +1,18 @@
+#include "CreateMode.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool IsCreateNew(const filesystem::driver::create_mode& creation)
+		{
+			static_assert(std::is_trivially_copyable<filesystem::driver::create_mode>::value, "create mode is compared bytewise");
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::create_mode persistent_not_exist(true, false, false);
+			return ( 0 == std::memcmp(&creation, &persistent_not_exists, sizeof(creation)) ) || ( 0 == std::memcmp(&creation, &persistent_not_exist, sizeof(creation)) );
+		}
+	}
+}
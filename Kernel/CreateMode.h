@@ -0,0 +1,13 @@
+#pragma once
+
+#include "KAA/include/filesystem/driver.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// RETURNS: true for the modes files are created new with (the default one and persistent_not_exist), the only ones the drivers of the kernel support.
+		// KAA: a mode is compared as a whole, a file is never opened or truncated by create_file.
+		bool IsCreateNew(const filesystem::driver::create_mode&);
+	}
+}
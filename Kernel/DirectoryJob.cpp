@@ -0,0 +1,416 @@
+#include "DirectoryJob.h"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+#include "KAA/include/exception/failure.h"
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+#include "KAA/include/filesystem/wiper.h"
+
+#include <windows.h>
+
+// FUTURE: KAA: remove <windows.h>
+#undef EncryptFile
+#undef DecryptFile
+
+#include "Core/Core.h"
+#include "Core/CoreProgressHandler.h"
+
+#include "NativeCopy.h"
+#include "Tracer.h"
+
+#include "../Common/CommunicatorProgressHandler.h"
+
+namespace
+{
+	class FindHandle final
+	{
+	public:
+		explicit FindHandle(const HANDLE handle) :
+		handle(handle)
+		{}
+
+		FindHandle(const FindHandle&) = delete;
+		FindHandle& operator = (const FindHandle&) = delete;
+
+		~FindHandle()
+		{
+			if(INVALID_HANDLE_VALUE != handle)
+				::FindClose(handle);
+		}
+
+		HANDLE get(void) const
+		{
+			return handle;
+		}
+
+		bool valid(void) const
+		{
+			return INVALID_HANDLE_VALUE != handle;
+		}
+
+	private:
+		HANDLE handle;
+	};
+
+	// RETURNS: absolute path without trailing separator, except for a volume root.
+	std::wstring GetFullPath(const std::wstring& path)
+	{
+		const auto length = ::GetFullPathNameW(path.c_str(), 0, nullptr, nullptr);
+		if(0 == length)
+		{
+			const auto error = ::GetLastError();
+			throw KAA::windows_api_failure { __FUNCTION__, "unable to retrieve full path name", error };
+		}
+		std::wstring full_path(length, L'\0');
+		full_path.resize(::GetFullPathNameW(path.c_str(), length, &full_path[0], nullptr));
+		while(full_path.length() > 3 && ( L'\\' == full_path.back() || L'/' == full_path.back() ))
+			full_path.pop_back();
+		return full_path;
+	}
+
+	std::wstring Join(const std::wstring& directory, const std::wstring& name)
+	{
+		if(!directory.empty() && ( L'\\' == directory.back() || L'/' == directory.back() ))
+			return directory + name;
+		return directory + L'\\' + name;
+	}
+
+	bool IsSamePath(const std::wstring& left, const std::wstring& right)
+	{
+		return CSTR_EQUAL == ::CompareStringOrdinal(left.c_str(), static_cast<int>(left.length()), right.c_str(), static_cast<int>(right.length()), TRUE);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: the operation as a whole, files of every lane advance it.
+		class DirectoryJob::JobProgress final
+		{
+		public:
+			explicit JobProgress(std::shared_ptr<CommunicatorProgressHandler> session) :
+			session(std::move(session)),
+			state(nullptr == this->session ? progress_state_t::quiet : progress_state_t::proceed),
+			stopped(false)
+			{}
+
+			JobProgress(const JobProgress&) = delete;
+			JobProgress& operator = (const JobProgress&) = delete;
+
+			void Advance(const uint64_t portion)
+			{
+				if(nullptr == session)
+					return;
+				std::lock_guard<std::mutex> lock(guard);
+				const auto session_state = session->OperationProgress(portion);
+				if(progress_state_t::quiet != session_state)
+					state = session_state;
+				if(( progress_state_t::cancel == state ) || ( progress_state_t::stop == state ))
+					stopped = true;
+			}
+
+			progress_state_t GetState(void)
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				return state;
+			}
+
+			bool IsStopped(void) const
+			{
+				return stopped;
+			}
+
+		private:
+			std::shared_ptr<CommunicatorProgressHandler> session;
+			std::mutex guard;
+			progress_state_t state;
+			std::atomic<bool> stopped;
+		};
+
+		// NOTE: a file advances the job by the furthest any of its stages has got, as a file of a batch does.
+		class DirectoryJob::LaneProgress final : public CoreProgressHandler
+		{
+		public:
+			LaneProgress() :
+			file_size(0),
+			file_reported(0),
+			stage_processed(0)
+			{}
+
+			LaneProgress(const LaneProgress&) = delete;
+			LaneProgress& operator = (const LaneProgress&) = delete;
+
+			void FileStarted(std::shared_ptr<JobProgress> value, const uint64_t size)
+			{
+				job = std::move(value);
+				file_size = size;
+				file_reported = 0;
+				stage_processed = 0;
+			}
+
+			// KAA: failed files count as done, so the operation still ends at its full size.
+			void FileFinished(void)
+			{
+				Report(file_size);
+			}
+
+		private:
+			std::shared_ptr<JobProgress> job;
+			uint64_t file_size;
+			uint64_t file_reported;
+			uint64_t stage_processed;
+
+			progress_state_t IProcessingStarted(const std::string&, uint64_t) override
+			{
+				stage_processed = 0;
+				return job->GetState();
+			}
+
+			progress_state_t IChunkProcessed(const uint64_t size) override
+			{
+				stage_processed += size;
+				Report(std::min(stage_processed, file_size));
+				return job->GetState();
+			}
+
+			void Report(const uint64_t reached)
+			{
+				if(reached <= file_reported)
+					return;
+				const auto portion = reached - file_reported;
+				file_reported = reached;
+				job->Advance(portion);
+			}
+		};
+
+		DirectoryJob::DirectoryJob(std::shared_ptr<filesystem::driver> filesystem, lane_factory_t create_lane, WorkStealingPool& pool) :
+		m_filesystem(std::move(filesystem)),
+		m_create_lane(std::move(create_lane)),
+		m_pool(pool)
+		{
+			if(!m_filesystem || !m_create_lane)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create directory job class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		DirectoryJob::~DirectoryJob() = default;
+
+		std::vector<file_result_t> DirectoryJob::EncryptDirectory(const filesystem::path::directory& path, const std::vector<filesystem::path::directory>& excluded, std::shared_ptr<CommunicatorProgressHandler> session, const std::string& operation_name)
+		{
+			return Run(path, excluded, session, operation_name, &DirectoryJob::Encrypt);
+		}
+
+		std::vector<file_result_t> DirectoryJob::DecryptDirectory(const filesystem::path::directory& path, const std::vector<filesystem::path::directory>& excluded, std::shared_ptr<CommunicatorProgressHandler> session, const std::string& operation_name)
+		{
+			return Run(path, excluded, session, operation_name, &DirectoryJob::Decrypt);
+		}
+
+		std::vector<file_result_t> DirectoryJob::Run(const filesystem::path::directory& path, const std::vector<filesystem::path::directory>& excluded, const std::shared_ptr<CommunicatorProgressHandler>& session, const std::string& operation_name, file_status_t (DirectoryJob::*process)(lane_t&, const filesystem::path::file&))
+		{
+			const auto root = GetFullPath(path.to_wstring());
+			excluded_paths.clear();
+			for(const auto& directory : excluded)
+				excluded_paths.push_back(GetFullPath(directory.to_wstring()));
+
+			entries.clear();
+			if(!IsExcluded(root))
+			{
+				WorkStealingPool::TaskGroup listing;
+				m_pool.Submit(listing, task_kind_t::io, [this, &listing, &root] { ListDirectory(listing, root); }); // KAA: the root failing to list fails the job.
+				m_pool.Wait(listing);
+			}
+			std::sort(entries.begin(), entries.end(), [] (const entry_t& left, const entry_t& right) { return left.path < right.path; });
+
+			std::vector<file_result_t> results;
+			results.reserve(entries.size());
+			uint64_t total_size = 0;
+			for(const auto& entry : entries)
+			{
+				results.push_back({ filesystem::path::file { entry.path }, entry.failure.empty() ? file_status_t::stopped : file_status_t::failed, entry.failure }); // KAA: stopped until processed.
+				total_size += entry.size;
+			}
+
+			const auto progress = std::make_shared<JobProgress>(session);
+			if(nullptr != session)
+				session->OperationStarted(operation_name, total_size);
+
+			// KAA: the largest files are started first, so that the tail of the job is made of small ones.
+			std::vector<size_t> order(entries.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::stable_sort(order.begin(), order.end(), [this] (const size_t left, const size_t right) { return entries[left].size > entries[right].size; });
+
+			WorkStealingPool::TaskGroup files;
+			for(const auto index : order)
+			{
+				if(file_status_t::failed == results[index].status)
+					continue;
+
+				m_pool.Submit(files, task_kind_t::cpu, [this, process, progress, index, &results]
+				{
+					auto& result = results[index];
+					if(progress->IsStopped())
+						return;
+
+					auto& lane = GetLane();
+					lane.progress->FileStarted(progress, entries[index].size);
+					try
+					{
+						result.status = ( this->*process )(lane.lane, result.path);
+					}
+					catch(const failure& error)
+					{
+						result.status = file_status_t::failed;
+						result.failure = error.get_system_message();
+					}
+					catch(const std::exception& error)
+					{
+						result.status = file_status_t::failed;
+						result.failure = error.what();
+					}
+					lane.progress->FileFinished();
+				});
+			}
+			m_pool.Wait(files);
+			return results;
+		}
+
+		// NOTE: links and junctions are not followed: they may lead out of the tree or back into it.
+		void DirectoryJob::ListDirectory(WorkStealingPool::TaskGroup& listing, const std::wstring& path)
+		{
+			WIN32_FIND_DATAW entry = { 0 };
+			const FindHandle search(::FindFirstFileExW(Join(path, L"*").c_str(), FindExInfoBasic, &entry, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH));
+			if(!search.valid())
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to list directory", error };
+			}
+
+			std::vector<entry_t> files;
+			do
+			{
+				const std::wstring name(entry.cFileName);
+				if(L"." == name || L".." == name || 0 != ( entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ))
+					continue;
+
+				auto entry_path = Join(path, name);
+				if(0 == ( entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ))
+				{
+					const auto size = ( static_cast<uint64_t>(entry.nFileSizeHigh) << 32 ) | entry.nFileSizeLow;
+					files.push_back({ std::move(entry_path), size, std::string() });
+				}
+				else if(!IsExcluded(entry_path))
+				{
+					m_pool.Submit(listing, task_kind_t::io, [this, &listing, entry_path]
+					{
+						try
+						{
+							ListDirectory(listing, entry_path);
+						}
+						catch(const failure& error)
+						{
+							std::lock_guard<std::mutex> lock(entries_guard);
+							entries.push_back({ entry_path, 0, error.get_system_message() });
+						}
+					});
+				}
+			} while(0 != ::FindNextFileW(search.get(), &entry));
+
+			const auto error = ::GetLastError();
+			if(ERROR_NO_MORE_FILES != error)
+				throw windows_api_failure { __FUNCTION__, "unable to list directory", error };
+
+			std::lock_guard<std::mutex> lock(entries_guard);
+			std::move(files.begin(), files.end(), std::back_inserter(entries));
+		}
+
+		bool DirectoryJob::IsExcluded(const std::wstring& path) const
+		{
+			return excluded_paths.end() != std::find_if(excluded_paths.begin(), excluded_paths.end(), [&path] (const std::wstring& excluded) { return IsSamePath(path, excluded); });
+		}
+
+		DirectoryJob::lane_state_t& DirectoryJob::GetLane(void)
+		{
+			const auto thread = std::this_thread::get_id();
+			{
+				std::lock_guard<std::mutex> lock(lanes_guard);
+				const auto lane = lanes.find(thread);
+				if(lanes.end() != lane)
+					return *lane->second;
+			}
+
+			// KAA: created outside of the lock, the key storage may take a while to open.
+			auto state = std::make_unique<lane_state_t>();
+			state->lane = m_create_lane(m_pool);
+			state->progress = std::make_shared<LaneProgress>();
+			state->lane.core->SetProgressHandler(state->progress);
+
+			std::lock_guard<std::mutex> lock(lanes_guard);
+			auto& lane = lanes[thread];
+			lane = std::move(state);
+			return *lane;
+		}
+
+		filesystem::path::file DirectoryJob::PutInPlace(const filesystem::path::file& path, const filesystem::path::file& replacement)
+		{
+			const TraceSpan span("ReplaceFile");
+			return ReplaceOriginal(*m_filesystem, path, replacement);
+		}
+
+		file_status_t DirectoryJob::Encrypt(lane_t& lane, const filesystem::path::file& path)
+		{
+			const TraceSpan span("EncryptFile");
+			if(lane.core->IsFileEncrypted(path))
+				return file_status_t::skipped; // KAA: encrypting it again would leave it encrypted twice, with its first key lost to the user.
+
+			const auto encrypted = m_filesystem->get_temp_filename(path.get_directory());
+			try
+			{
+				lane.core->EncryptFile(path, encrypted);
+			}
+			catch(...)
+			{
+				if(filesystem::file_exists(*m_filesystem, encrypted)) // KAA: the core may have failed before creating it, its error is the one to report.
+					m_filesystem->remove_file(encrypted); // KAA: ciphertext only, the original is intact.
+				throw;
+			}
+			const auto plain = PutInPlace(path, encrypted);
+			const TraceSpan wipe_span("WipeFile");
+			lane.wiper->wipe_file(plain);
+			return file_status_t::succeeded;
+		}
+
+		file_status_t DirectoryJob::Decrypt(lane_t& lane, const filesystem::path::file& path)
+		{
+			const TraceSpan span("DecryptFile");
+			if(!lane.core->IsFileEncrypted(path))
+				return file_status_t::skipped; // KAA: a plain file has no key to decrypt it with, it is left as it is.
+
+			const auto decrypted = m_filesystem->get_temp_filename(path.get_directory());
+			try
+			{
+				lane.core->DecryptFile(path, decrypted);
+			}
+			catch(...)
+			{
+				if(filesystem::file_exists(*m_filesystem, decrypted)) // KAA: the core may have failed before creating it, its error is the one to report.
+					lane.wiper->wipe_file(decrypted); // KAA: may hold plain text already.
+				throw;
+			}
+			const auto encrypted = PutInPlace(path, decrypted);
+			const TraceSpan remove_span("RemoveFile");
+			m_filesystem->remove_file(encrypted);
+			return file_status_t::succeeded;
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../Common/Communicator.h"
+
+#include "WorkStealingPool.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+		class wiper;
+	}
+
+	namespace FileSecurity
+	{
+		class Core;
+		class CommunicatorProgressHandler;
+
+		// NOTE: encrypts or decrypts every file of a directory tree, local files only. The tree is listed first by I/O tasks of the work stealing pool
+		// (a task per directory), then every file is processed out-of-place by a task of its own, the largest first; files encrypted already are skipped by encryption, plain files by decryption.
+		// A thread processes its files with a core and a wiper of its own (lane), created on its first file.
+		// The pool is the executor of the communicator, shared with other work; it has to outlive the job.
+		class DirectoryJob final
+		{
+		public:
+			struct lane_t
+			{
+				std::unique_ptr<Core> core;
+				std::unique_ptr<filesystem::wiper> wiper;
+			};
+
+			// NOTE: called from the thread the lane is for; lanes of a job should share the key storage.
+			typedef std::function<lane_t(WorkStealingPool&)> lane_factory_t;
+
+			DirectoryJob(std::shared_ptr<filesystem::driver>, lane_factory_t, WorkStealingPool&);
+			DirectoryJob(const DirectoryJob&) = delete;
+			DirectoryJob(DirectoryJob&&) = delete;
+			~DirectoryJob();
+
+			DirectoryJob& operator = (const DirectoryJob&) = delete;
+			DirectoryJob& operator = (DirectoryJob&&) = delete;
+
+			// NOTE: excluded directories are skipped with their content (the key storage).
+			std::vector<file_result_t> EncryptDirectory(const filesystem::path::directory&, const std::vector<filesystem::path::directory>& excluded, std::shared_ptr<CommunicatorProgressHandler>, const std::string& operation_name);
+			std::vector<file_result_t> DecryptDirectory(const filesystem::path::directory&, const std::vector<filesystem::path::directory>& excluded, std::shared_ptr<CommunicatorProgressHandler>, const std::string& operation_name);
+
+		private:
+			struct entry_t
+			{
+				std::wstring path;
+				uint64_t size;
+				std::string failure; // KAA: a directory that could not be listed.
+			};
+
+			class JobProgress;
+			class LaneProgress;
+
+			struct lane_state_t
+			{
+				lane_t lane;
+				std::shared_ptr<LaneProgress> progress;
+			};
+
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			lane_factory_t m_create_lane;
+			WorkStealingPool& m_pool;
+
+			std::mutex lanes_guard;
+			std::map<std::thread::id, std::unique_ptr<lane_state_t>> lanes;
+
+			std::mutex entries_guard;
+			std::vector<entry_t> entries;
+			std::vector<std::wstring> excluded_paths;
+
+			std::vector<file_result_t> Run(const filesystem::path::directory&, const std::vector<filesystem::path::directory>& excluded, const std::shared_ptr<CommunicatorProgressHandler>&, const std::string& operation_name, file_status_t (DirectoryJob::*)(lane_t&, const filesystem::path::file&));
+			void ListDirectory(WorkStealingPool::TaskGroup&, const std::wstring& path);
+			bool IsExcluded(const std::wstring& path) const;
+			lane_state_t& GetLane(void);
+
+			filesystem::path::file PutInPlace(const filesystem::path::file& path, const filesystem::path::file& replacement);
+			file_status_t Encrypt(lane_t&, const filesystem::path::file&);
+			file_status_t Decrypt(lane_t&, const filesystem::path::file&);
+		};
+	}
+}
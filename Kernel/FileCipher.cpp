@@ -1,5 +1,10 @@
 #include "FileCipher.h"
 
+#include "KAA/include/exception/operation_failure.h"
+
+#include "FileDataHandler.h"
+#include "FileProgressHandler.h"
+
 namespace KAA
 {
 	namespace FileSecurity
@@ -14,9 +19,105 @@ namespace KAA
 			return IDecryptFile(path, key);
 		}
 
+		void FileCipher::EncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return IEncryptFile(source, destination, key);
+		}
+
+		void FileCipher::DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return IDecryptFile(source, destination, key);
+		}
+
+		bool FileCipher::ReadsKeyStreams(void) const
+		{
+			return IReadsKeyStreams();
+		}
+
+		void FileCipher::DecryptFile(const filesystem::path::file& path, filesystem::file& key)
+		{
+			return IDecryptFile(path, key);
+		}
+
+		void FileCipher::DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, filesystem::file& key)
+		{
+			return IDecryptFile(source, destination, key);
+		}
+
 		std::shared_ptr<FileProgressHandler> FileCipher::SetProgressCallback(std::shared_ptr<FileProgressHandler> handler)
 		{
 			return ISetProgressCallback(handler);
 		}
+
+		std::shared_ptr<FileDataHandler> FileCipher::SetDataCallback(std::shared_ptr<FileDataHandler> handler)
+		{
+			return ISetDataCallback(handler);
+		}
+
+		progress_state_t FileCipher::ChunkProcessed(const uint64_t size)
+		{
+			if(nullptr != cipher_progress)
+				return cipher_progress->ChunkProcessed(size);
+			return progress_state_t::quiet;
+		}
+
+		void FileCipher::ChunkWritten(const uint64_t offset, const void* data, const size_t size)
+		{
+			if(nullptr != cipher_data)
+				cipher_data->ChunkWritten(offset, data, size);
+		}
+
+		std::shared_ptr<FileProgressHandler> FileCipher::ISetProgressCallback(std::shared_ptr<FileProgressHandler> handler)
+		{
+			cipher_progress.swap(handler);
+			return handler;
+		}
+
+		std::shared_ptr<FileDataHandler> FileCipher::ISetDataCallback(std::shared_ptr<FileDataHandler> handler)
+		{
+			cipher_data.swap(handler);
+			return handler;
+		}
+
+		void FileCipher::IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&)
+		{
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "out-of-place encryption is not supported by the cipher";
+			constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = operation_failure::severity_t::error;
+			throw operation_failure(source, description, reason, severity);
+		}
+
+		void FileCipher::IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&)
+		{
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "out-of-place decryption is not supported by the cipher";
+			constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = operation_failure::severity_t::error;
+			throw operation_failure(source, description, reason, severity);
+		}
+
+		bool FileCipher::IReadsKeyStreams(void) const
+		{
+			return false;
+		}
+
+		void FileCipher::IDecryptFile(const filesystem::path::file&, filesystem::file&)
+		{
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "decryption with a key stream is not supported by the cipher";
+			constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = operation_failure::severity_t::error;
+			throw operation_failure(source, description, reason, severity);
+		}
+
+		void FileCipher::IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, filesystem::file&)
+		{
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "out-of-place decryption with a key stream is not supported by the cipher";
+			constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = operation_failure::severity_t::error;
+			throw operation_failure(source, description, reason, severity);
+		}
 	}
 }
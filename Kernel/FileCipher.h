@@ -1,11 +1,16 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 
+#include "KAA/include/progress_state.h"
+
 namespace KAA
 {
 	namespace filesystem
 	{
+		class file;
 		namespace path
 		{
 			class file;
@@ -14,6 +19,7 @@ namespace KAA
 
 	namespace FileSecurity
 	{
+		class FileDataHandler;
 		class FileProgressHandler;
 
 		// FUTURE: KAA: consider to improve progress callback design.
@@ -25,13 +31,41 @@ namespace KAA
 			void EncryptFile(const filesystem::path::file& path, const filesystem::path::file& key);
 			void DecryptFile(const filesystem::path::file& path, const filesystem::path::file& key);
 
+			// NOTE: out-of-place: result goes to destination, source stays intact. Not every cipher supports it.
+			void EncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key);
+			void DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key);
+
+			// NOTE: the key is read from a stream (e.g. a view of a key container) instead of a key file. Not every cipher supports it.
+			bool ReadsKeyStreams(void) const;
+			void DecryptFile(const filesystem::path::file& path, filesystem::file& key);
+			void DecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, filesystem::file& key);
+
 			std::shared_ptr<FileProgressHandler> SetProgressCallback(std::shared_ptr<FileProgressHandler>);
+			// NOTE: receives the data the cipher has written to the file (destination, if out-of-place).
+			std::shared_ptr<FileDataHandler> SetDataCallback(std::shared_ptr<FileDataHandler>);
+
+		protected:
+			// NOTE: report to the handlers set, if any; progress is quiet without a handler.
+			progress_state_t ChunkProcessed(uint64_t size);
+			void ChunkWritten(uint64_t offset, const void* data, size_t size);
+
+			// NOTE: keep the handler; a cipher delegating to another cipher passes the handler on as well.
+			virtual std::shared_ptr<FileProgressHandler> ISetProgressCallback(std::shared_ptr<FileProgressHandler>);
+			virtual std::shared_ptr<FileDataHandler> ISetDataCallback(std::shared_ptr<FileDataHandler>);
 
 		private:
+			std::shared_ptr<FileProgressHandler> cipher_progress;
+			std::shared_ptr<FileDataHandler> cipher_data;
+
 			virtual void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) = 0;
 			virtual void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) = 0;
 
-			virtual std::shared_ptr<FileProgressHandler> ISetProgressCallback(std::shared_ptr<FileProgressHandler>) = 0;
+			virtual void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&);
+			virtual void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&);
+
+			virtual bool IReadsKeyStreams(void) const;
+			virtual void IDecryptFile(const filesystem::path::file&, filesystem::file&);
+			virtual void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, filesystem::file&);
 		};
 	}
 }
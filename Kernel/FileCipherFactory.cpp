@@ -1,7 +1,13 @@
 #include "FileCipherFactory.h"
 #include <stdexcept>
 #include "KAA/include/exception/operation_failure.h"
+#include "AsyncGammaFileCipher.h"
+#include "FusedGammaFileCipher.h"
 #include "GammaFileCipher.h"
+#include "MappedGammaFileCipher.h"
+#include "NativeFileSystem.h"
+#include "ParallelGammaFileCipher.h"
+#include "PipelinedGammaFileCipher.h"
 
 namespace KAA
 {
@@ -12,12 +18,28 @@ namespace KAA
 
 	namespace FileSecurity
 	{
-		std::unique_ptr<FileCipher> CreateFileCipher(const cipher_t type, std::shared_ptr<filesystem::driver> filesystem)
+		std::unique_ptr<FileCipher> CreateFileCipher(const cipher_t type, std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy)
 		{
 			switch(type)
 			{
 			case gamma_cipher:
-				return std::make_unique<GammaFileCipher>(std::move(filesystem));
+				return std::make_unique<GammaFileCipher>(std::move(filesystem), std::move(io_policy));
+			case pipelined_gamma_cipher:
+				return std::make_unique<PipelinedGammaFileCipher>(std::move(filesystem), std::move(io_policy));
+			case mapped_gamma_cipher:
+				if(IsWindowsFileSystem(filesystem.get()))
+					return std::make_unique<MappedGammaFileCipher>(std::move(filesystem)); // KAA: maps local files directly, bypasses filesystem driver.
+				return std::make_unique<GammaFileCipher>(std::move(filesystem), std::move(io_policy)); // KAA: nothing to map but Windows files.
+			case parallel_gamma_cipher:
+				if(IsWindowsFileSystem(filesystem.get()))
+					return std::make_unique<ParallelGammaFileCipher>(std::move(io_policy)); // KAA: positional I/O on local files, bypasses filesystem driver.
+				return std::make_unique<GammaFileCipher>(std::move(filesystem), std::move(io_policy)); // KAA: positional I/O needs Windows files.
+			case fused_gamma_cipher:
+				return std::make_unique<FusedGammaFileCipher>(std::move(filesystem), std::move(io_policy));
+			case async_gamma_cipher:
+				if(IsWindowsFileSystem(filesystem.get()))
+					return std::make_unique<AsyncGammaFileCipher>(std::move(filesystem), std::move(io_policy)); // KAA: overlapped I/O on local files, bypasses filesystem driver.
+				return std::make_unique<GammaFileCipher>(std::move(filesystem), std::move(io_policy)); // KAA: completion ports need Windows files, synchronous I/O through the driver otherwise.
 			default:
 					constexpr auto source = __FUNCTION__;
 					constexpr auto description = "cannot create file cipher class instance: specified type is not supported";
@@ -13,11 +13,18 @@ namespace KAA
 	namespace FileSecurity
 	{
 		class FileCipher;
+		class IOPolicy;
+		// NOTE: mapped, parallel and asynchronous ciphers work on Windows files, gamma cipher takes their place for other drivers.
 		enum cipher_t
 		{
 			gamma_cipher,
+			pipelined_gamma_cipher,
+			mapped_gamma_cipher,
+			parallel_gamma_cipher,
+			fused_gamma_cipher, // NOTE: creates the key file itself.
+			async_gamma_cipher,
 		};
 
-		std::unique_ptr<FileCipher> CreateFileCipher(cipher_t, std::shared_ptr<filesystem::driver>);
+		std::unique_ptr<FileCipher> CreateFileCipher(cipher_t, std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>);
 	}
 }
@@ -0,0 +1,12 @@
+#include "FileDataHandler.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		void FileDataHandler::ChunkWritten(const uint64_t offset, const void* data, const size_t size)
+		{
+			return IChunkWritten(offset, data, size);
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: observes the data a cipher has written to the file: offset within the file, data and its size.
+		class FileDataHandler
+		{
+		public:
+			virtual ~FileDataHandler() = default;
+
+			void ChunkWritten(uint64_t offset, const void* data, size_t size);
+
+		private:
+			virtual void IChunkWritten(uint64_t offset, const void* data, size_t size) = 0;
+		};
+	}
+}
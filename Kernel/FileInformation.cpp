@@ -0,0 +1,12 @@
+#include "FileInformation.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool FileInformationSource::QueryFileInformation(const filesystem::path::file& path, file_information_t& information) const
+		{
+			return IQueryFileInformation(path, information);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "KAA/include/filesystem/path.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: what the volume tells of a file without the file being read. The index is kept while the file exists (renames included);
+		// the last write time moves with every write of the data, the change time with every write and every change of the metadata.
+		struct file_information_t
+		{
+			uint32_t volume_serial_number;
+			uint64_t file_index;
+			uint64_t size;
+			uint64_t last_write_time;
+			uint64_t change_time;
+		};
+
+		// NOTE: implemented by drivers that tell file information.
+		class FileInformationSource
+		{
+		public:
+			virtual ~FileInformationSource() = default;
+
+			// RETURNS: false if the path does not name a file or the volume does not tell its information.
+			bool QueryFileInformation(const filesystem::path::file&, file_information_t&) const;
+
+		private:
+			virtual bool IQueryFileInformation(const filesystem::path::file&, file_information_t&) const = 0;
+		};
+	}
+}
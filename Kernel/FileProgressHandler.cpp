@@ -1,12 +1,22 @@
 #include "FileProgressHandler.h"
 
+#include "ProgressCounter.h"
+
 namespace KAA
 {
 	namespace FileSecurity
 	{
 		progress_state_t FileProgressHandler::ChunkProcessed(uint64_t size)
 		{
+			if(nullptr != progress_counter)
+				return progress_counter->Publish(size);
 			return IChunkProcessed(size);
 		}
+
+		std::shared_ptr<ProgressCounter> FileProgressHandler::SetProgressCounter(std::shared_ptr<ProgressCounter> counter)
+		{
+			progress_counter.swap(counter);
+			return counter;
+		}
 	}
 }
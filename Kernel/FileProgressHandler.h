@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 
 #include "KAA/include/progress_state.h"
 
@@ -8,12 +9,19 @@ namespace KAA
 {
 	namespace FileSecurity
 	{
+		class ProgressCounter;
+
 		class FileProgressHandler
 		{
 		public:
 			progress_state_t ChunkProcessed(uint64_t size);
 
+			// NOTE: chunks processed go to the counter instead while it is set: no virtual call per chunk, the consumer reads the counter at a rate of its own.
+			std::shared_ptr<ProgressCounter> SetProgressCounter(std::shared_ptr<ProgressCounter>);
+
 		private:
+			std::shared_ptr<ProgressCounter> progress_counter;
+
 			virtual progress_state_t IChunkProcessed(uint64_t size) = 0;
 		};
 	}
@@ -0,0 +1,28 @@
+#include "FileSystemFactory.h"
+
+#include <stdexcept>
+
+#include "KAA/include/filesystem/crt_file_system.h"
+
+#include "NativeFileSystem.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		std::shared_ptr<filesystem::driver> QueryFileSystem(const filesystem_t interface_identifier)
+		{
+			switch (interface_identifier)
+			{
+			case filesystem_t::crt_runtime:
+				return std::make_shared<filesystem::crt_file_system>();
+			case filesystem_t::native:
+				return std::make_shared<NativeFileSystem>(false);
+			case filesystem_t::native_unbuffered:
+				return std::make_shared<NativeFileSystem>(true);
+			default:
+				throw std::invalid_argument(__FUNCTION__);
+			}
+		}
+	}
+}
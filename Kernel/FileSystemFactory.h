@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		enum class filesystem_t
+		{
+			crt_runtime,
+			native,
+			native_unbuffered
+		};
+
+		std::shared_ptr<filesystem::driver> QueryFileSystem(filesystem_t);
+	}
+}
@@ -0,0 +1,139 @@
+#include "FusedGammaFileCipher.h"
+
+#include <stdexcept>
+#include <vector>
+
+#include "KAA/include/filesystem/driver.h"
+
+#include "CancellationToken.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+#include "KeyGenerator.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		FusedGammaFileCipher::FusedGammaFileCipher(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy) :
+		m_filesystem(filesystem),
+		m_io_policy(io_policy),
+		m_gamma(std::move(filesystem), std::move(io_policy)),
+		m_key_generator(std::make_unique<KeyGenerator>())
+		{
+			// KAA: filesystem and I/O policy already verified by gamma cipher.
+		}
+
+		FusedGammaFileCipher::~FusedGammaFileCipher() = default;
+
+		void FusedGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			const filesystem::driver::mode random_read_write(true, true, true, true);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto master = m_filesystem->open_file(path, random_read_write, exclusive_access);
+
+			const filesystem::driver::create_mode persistent_not_exist(true, false, false);
+			const filesystem::driver::mode sequential_write_only(true, false);
+			const filesystem::driver::permission read_only_attribute(false, true);
+			const auto key = m_filesystem->create_file(key_path, persistent_not_exist, sequential_write_only, exclusive_access, read_only_attribute);
+
+			const auto chunk_size = m_io_policy->GetParameters(path).chunk_size;
+			std::vector<uint8_t> master_buffer(chunk_size);
+			std::vector<uint8_t> key_buffer(chunk_size);
+
+			uint64_t offset = 0;
+			auto progress = progress_state_t::proceed;
+			for(auto bytes_read = master->read(chunk_size, &master_buffer[0]); 0 != bytes_read; bytes_read = master->read(chunk_size, &master_buffer[0]))
+			{
+				m_key_generator->Generate(bytes_read, &key_buffer[0]);
+				if(key->write(&key_buffer[0], bytes_read) != bytes_read)
+					throw std::runtime_error(__FUNCTION__); // FUTURE: KAA: remove incomplete file : whose responsibility?
+
+				key->commit(); // KAA: the data is overwritten in place, the key material of the chunk has to be on the disk before it is.
+
+				Gamma(&master_buffer[0], &key_buffer[0], &master_buffer[0], bytes_read);
+				master->seek(-static_cast<_off_t>(bytes_read), filesystem::file::current);
+				const auto bytes_written = master->write(&master_buffer[0], bytes_read);
+				if(bytes_written != bytes_read)
+					throw std::runtime_error(__FUNCTION__);
+				ChunkWritten(offset, &master_buffer[0], bytes_written);
+				offset += bytes_written;
+
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(bytes_written);
+				CheckProgressState(progress);
+			}
+		}
+
+		void FusedGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return m_gamma.DecryptFile(path, key);
+		}
+
+		void FusedGammaFileCipher::IEncryptFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const filesystem::path::file& key_path)
+		{
+			const filesystem::driver::mode sequential_read_only(false);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto source = m_filesystem->open_file(source_path, sequential_read_only, exclusive_access);
+
+			const filesystem::driver::create_mode persistent_not_exist(true, false, false);
+			const filesystem::driver::mode sequential_write_only(true, false);
+			const filesystem::driver::permission read_only_attribute(false, true);
+			const auto key = m_filesystem->create_file(key_path, persistent_not_exist, sequential_write_only, exclusive_access, read_only_attribute);
+
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::permission allow_read_write;
+			const auto destination = m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+
+			const auto chunk_size = m_io_policy->GetParameters(destination_path).chunk_size;
+			std::vector<uint8_t> data_buffer(chunk_size);
+			std::vector<uint8_t> key_buffer(chunk_size);
+
+			uint64_t offset = 0;
+			auto progress = progress_state_t::proceed;
+			for(auto bytes_read = source->read(chunk_size, &data_buffer[0]); 0 != bytes_read; bytes_read = source->read(chunk_size, &data_buffer[0]))
+			{
+				m_key_generator->Generate(bytes_read, &key_buffer[0]);
+				if(key->write(&key_buffer[0], bytes_read) != bytes_read)
+					throw std::runtime_error(__FUNCTION__); // FUTURE: KAA: remove incomplete file : whose responsibility?
+
+				Gamma(&data_buffer[0], &key_buffer[0], &data_buffer[0], bytes_read);
+				const auto bytes_written = destination->write(&data_buffer[0], bytes_read);
+				if(bytes_written != bytes_read)
+					throw std::runtime_error(__FUNCTION__);
+				ChunkWritten(offset, &data_buffer[0], bytes_written);
+				offset += bytes_written;
+
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(bytes_written);
+				CheckProgressState(progress);
+			}
+			destination->commit();
+		}
+
+		void FusedGammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return m_gamma.DecryptFile(source, destination, key);
+		}
+
+		bool FusedGammaFileCipher::IReadsKeyStreams(void) const
+		{
+			return m_gamma.ReadsKeyStreams();
+		}
+
+		void FusedGammaFileCipher::IDecryptFile(const filesystem::path::file& path, filesystem::file& key)
+		{
+			return m_gamma.DecryptFile(path, key);
+		}
+
+		void FusedGammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, filesystem::file& key)
+		{
+			return m_gamma.DecryptFile(source, destination, key);
+		}
+
+		std::shared_ptr<FileProgressHandler> FusedGammaFileCipher::ISetProgressCallback(std::shared_ptr<FileProgressHandler> handler)
+		{
+			m_gamma.SetProgressCallback(handler);
+			return FileCipher::ISetProgressCallback(std::move(handler));
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FileCipher.h"
+#include "GammaFileCipher.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		class FileProgressHandler;
+		class IOPolicy;
+		class KeyGenerator;
+
+		// NOTE: creates the key file itself: key material is generated a chunk at a time, appended to the key file and applied to the data in the same pass.
+		// Decryption is ordinary gamma.
+		class FusedGammaFileCipher final : public FileCipher
+		{
+		public:
+			FusedGammaFileCipher(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>);
+			FusedGammaFileCipher(const FusedGammaFileCipher&) = delete;
+			FusedGammaFileCipher(FusedGammaFileCipher&&) = delete;
+			~FusedGammaFileCipher();
+
+			FusedGammaFileCipher& operator = (const FusedGammaFileCipher&) = delete;
+			FusedGammaFileCipher& operator = (FusedGammaFileCipher&&) = delete;
+
+		private:
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
+			GammaFileCipher m_gamma;
+			std::unique_ptr<KeyGenerator> m_key_generator;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+
+			bool IReadsKeyStreams(void) const override;
+			void IDecryptFile(const filesystem::path::file&, filesystem::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, filesystem::file&) override;
+
+			std::shared_ptr<FileProgressHandler> ISetProgressCallback(std::shared_ptr<FileProgressHandler>) override;
+		};
+	}
+}
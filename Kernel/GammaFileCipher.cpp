@@ -5,21 +5,38 @@
 #include <vector>
 
 #include "KAA/include/convert.h"
-#include "KAA/include/cryptography/cryptography.h"
 #include "KAA/include/exception/operation_failure.h"
 #include "KAA/include/filesystem/driver.h"
 
-#include "FileProgressHandler.h"
+#include "CancellationToken.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+
+namespace
+{
+	void ReadKey(KAA::filesystem::file& key, const size_t size, uint8_t* buffer)
+	{
+		if(key.read(size, buffer) != size)
+		{
+			// KAA: stale key bytes would make the chunk undecryptable.
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "unable to apply gamma: key is shorter than the file";
+			constexpr auto reason = KAA::operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = KAA::operation_failure::severity_t::error;
+			throw KAA::operation_failure(source, description, reason, severity);
+		}
+	}
+}
 
 namespace KAA
 {
 	namespace FileSecurity
 	{
-		GammaFileCipher::GammaFileCipher(std::shared_ptr<filesystem::driver> filesystem) :
+		GammaFileCipher::GammaFileCipher(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy) :
 		m_filesystem(std::move(filesystem)),
-		cipher_progress(nullptr)
+		m_io_policy(std::move(io_policy))
 		{
-			if(!m_filesystem)
+			if(!m_filesystem || !m_io_policy)
 			{
 				constexpr auto source = __FUNCTION__;
 				constexpr auto description = "unable to create gamma file cipher class instance";
@@ -31,27 +48,68 @@ namespace KAA
 
 		void GammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
 		{
-			const filesystem::driver::mode random_read_write(true, true, true, true);
+			const filesystem::driver::mode sequential_read_only(false);
 			const filesystem::driver::share exclusive_access(false, false);
-			const auto master = m_filesystem->open_file(path, random_read_write, exclusive_access);
+			const auto key = m_filesystem->open_file(key_path, sequential_read_only, exclusive_access);
+			ApplyGamma(path, *key);
+		}
+
+		void GammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
 
+		void GammaFileCipher::IEncryptFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const filesystem::path::file& key_path)
+		{
 			const filesystem::driver::mode sequential_read_only(false);
+			const filesystem::driver::share exclusive_access(false, false);
 			const auto key = m_filesystem->open_file(key_path, sequential_read_only, exclusive_access);
+			ApplyGamma(source_path, destination_path, *key);
+		}
+
+		void GammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return EncryptFile(source, destination, key);
+		}
+
+		bool GammaFileCipher::IReadsKeyStreams(void) const
+		{
+			return true;
+		}
 
-			constexpr auto chunk_size = 64U * 1024U; // 64 KiB
+		void GammaFileCipher::IDecryptFile(const filesystem::path::file& path, filesystem::file& key)
+		{
+			return ApplyGamma(path, key);
+		}
+
+		void GammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, filesystem::file& key)
+		{
+			return ApplyGamma(source, destination, key);
+		}
+
+		void GammaFileCipher::ApplyGamma(const filesystem::path::file& path, filesystem::file& key)
+		{
+			const filesystem::driver::mode random_read_write(true, true, true, true);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto master = m_filesystem->open_file(path, random_read_write, exclusive_access);
+
+			const auto chunk_size = m_io_policy->GetParameters(path).chunk_size;
 			std::vector<uint8_t> master_buffer(chunk_size);
 			std::vector<uint8_t> key_buffer(chunk_size);
 
+			uint64_t offset = 0;
 			bool stop = false;
 			bool chunk_processed = false;
 			auto progress = progress_state_t::proceed;
 			do
 			{
 				const auto bytes_read = master->read(chunk_size, &master_buffer[0]);
-				key->read(bytes_read, &key_buffer[0]);
-				cryptography::gamma(&master_buffer[0], &key_buffer[0], &master_buffer[0], bytes_read);
+				ReadKey(key, bytes_read, &key_buffer[0]);
+				Gamma(&master_buffer[0], &key_buffer[0], &master_buffer[0], bytes_read);
 				master->seek(-static_cast<_off_t>(bytes_read), filesystem::file::current);
 				const auto bytes_written = master->write(&master_buffer[0], bytes_read);
+				ChunkWritten(offset, &master_buffer[0], bytes_written);
+				offset += bytes_written;
 				{
 					chunk_processed = ( 0 != bytes_read );
 					if(chunk_processed && ( progress_state_t::quiet != progress ))
@@ -59,24 +117,41 @@ namespace KAA
 					stop = ( !chunk_processed ) || ( progress_state_t::cancel == progress ) || ( progress_state_t::stop == progress );
 				}
 			} while(!stop);
+			CheckProgressState(progress);
 		}
 
-		void GammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		void GammaFileCipher::ApplyGamma(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, filesystem::file& key)
 		{
-			return EncryptFile(path, key);
-		}
+			const filesystem::driver::mode sequential_read_only(false);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto source = m_filesystem->open_file(source_path, sequential_read_only, exclusive_access);
 
-		std::shared_ptr<FileProgressHandler> GammaFileCipher::ISetProgressCallback(std::shared_ptr<FileProgressHandler> handler)
-		{
-			cipher_progress.swap(handler);
-			return handler;
-		}
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::mode sequential_write_only(true, false);
+			const filesystem::driver::permission allow_read_write;
+			const auto destination = m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
 
-		progress_state_t GammaFileCipher::ChunkProcessed(uint64_t size)
-		{
-			if(nullptr != cipher_progress)
-				return cipher_progress->ChunkProcessed(size);
-			return progress_state_t::quiet;
+			const auto chunk_size = m_io_policy->GetParameters(destination_path).chunk_size;
+			std::vector<uint8_t> data_buffer(chunk_size);
+			std::vector<uint8_t> key_buffer(chunk_size);
+
+			uint64_t offset = 0;
+			auto progress = progress_state_t::proceed;
+			for(auto bytes_read = source->read(chunk_size, &data_buffer[0]); 0 != bytes_read; bytes_read = source->read(chunk_size, &data_buffer[0]))
+			{
+				ReadKey(key, bytes_read, &key_buffer[0]);
+				Gamma(&data_buffer[0], &key_buffer[0], &data_buffer[0], bytes_read);
+				const auto bytes_written = destination->write(&data_buffer[0], bytes_read);
+				if(bytes_written != bytes_read)
+					throw std::runtime_error(__FUNCTION__);
+				ChunkWritten(offset, &data_buffer[0], bytes_written);
+				offset += bytes_written;
+
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(bytes_written);
+				CheckProgressState(progress);
+			}
+			destination->commit();
 		}
 	}
 }
@@ -2,8 +2,6 @@
 
 #include <cstdint>
 
-#include "KAA/include/progress_state.h"
-
 #include "FileCipher.h"
 
 namespace KAA
@@ -11,16 +9,17 @@ namespace KAA
 	namespace filesystem
 	{
 		class driver;
+		class file;
 	}
 
 	namespace FileSecurity
 	{
-		class FileProgressHandler;
+		class IOPolicy;
 
 		class GammaFileCipher final : public FileCipher
 		{
 		public:
-			explicit GammaFileCipher(std::shared_ptr<filesystem::driver>);
+			GammaFileCipher(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>);
 			GammaFileCipher(const GammaFileCipher&) = delete;
 			GammaFileCipher(GammaFileCipher&&) = delete;
 			~GammaFileCipher() = default;
@@ -30,14 +29,20 @@ namespace KAA
 
 		private:
 			std::shared_ptr<filesystem::driver> m_filesystem;
-			std::shared_ptr<FileProgressHandler> cipher_progress;
+			std::shared_ptr<IOPolicy> m_io_policy;
 
 			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
 			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
 
-			std::shared_ptr<FileProgressHandler> ISetProgressCallback(std::shared_ptr<FileProgressHandler>) override;
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+
+			bool IReadsKeyStreams(void) const override;
+			void IDecryptFile(const filesystem::path::file&, filesystem::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, filesystem::file&) override;
 
-			progress_state_t ChunkProcessed(uint64_t size);
+			void ApplyGamma(const filesystem::path::file& path, filesystem::file& key);
+			void ApplyGamma(const filesystem::path::file& source, const filesystem::path::file& destination, filesystem::file& key);
 		};
 	}
 }
@@ -0,0 +1,191 @@
+#include "GammaKernel.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+#include "KAA/include/exception/operation_failure.h"
+
+namespace
+{
+	using KAA::FileSecurity::gamma_kernel_t;
+
+	struct processor_features_t
+	{
+		bool sse2;
+		bool avx2;
+		bool avx512;
+	};
+
+	processor_features_t QueryProcessorFeatures(void)
+	{
+		processor_features_t features = { false, false, false };
+
+		int registers[4] = { 0 }; // EAX, EBX, ECX, EDX
+		__cpuid(registers, 0);
+		const auto highest_function = registers[0];
+
+		__cpuid(registers, 1);
+		features.sse2 = 0 != (registers[3] & (1 << 26));
+		const bool os_saves_extended_state = 0 != (registers[2] & (1 << 27)); // OSXSAVE
+		const bool avx = 0 != (registers[2] & (1 << 28));
+
+		if(os_saves_extended_state && avx && 7 <= highest_function)
+		{
+			// KAA: the operating system has to preserve the wide registers across context switches.
+			const auto enabled_state = _xgetbv(0);
+			constexpr auto ymm_state = 0x06ULL; // XMM | YMM
+			constexpr auto zmm_state = 0xE6ULL; // XMM | YMM | opmask | ZMM_Hi256 | Hi16_ZMM
+
+			__cpuidex(registers, 7, 0);
+			features.avx2 = ( ymm_state == (enabled_state & ymm_state) ) && ( 0 != (registers[1] & (1 << 5)) );
+			features.avx512 = ( zmm_state == (enabled_state & zmm_state) ) && ( 0 != (registers[1] & (1 << 16)) ); // AVX512F
+		}
+
+		return features;
+	}
+
+	const processor_features_t& GetProcessorFeatures(void)
+	{
+		static const auto features = QueryProcessorFeatures();
+		return features;
+	}
+
+	void ScalarGamma(const uint8_t* data, const uint8_t* key, uint8_t* result, const size_t size)
+	{
+		for(size_t position = 0; position < size; ++position)
+			result[position] = data[position] ^ key[position];
+	}
+
+	// NOTE: every vector kernel processes four registers per iteration and leaves the tail to the scalar kernel.
+	void SSE2Gamma(const uint8_t* data, const uint8_t* key, uint8_t* result, const size_t size)
+	{
+		constexpr size_t block_size = 4 * sizeof(__m128i);
+		const size_t blocks_size = size - size % block_size;
+		for(size_t position = 0; position < blocks_size; position += block_size)
+		{
+			const auto source = reinterpret_cast<const __m128i*>(data + position);
+			const auto gamma = reinterpret_cast<const __m128i*>(key + position);
+			const auto destination = reinterpret_cast<__m128i*>(result + position);
+			const auto a = _mm_xor_si128(_mm_loadu_si128(source + 0), _mm_loadu_si128(gamma + 0));
+			const auto b = _mm_xor_si128(_mm_loadu_si128(source + 1), _mm_loadu_si128(gamma + 1));
+			const auto c = _mm_xor_si128(_mm_loadu_si128(source + 2), _mm_loadu_si128(gamma + 2));
+			const auto d = _mm_xor_si128(_mm_loadu_si128(source + 3), _mm_loadu_si128(gamma + 3));
+			_mm_storeu_si128(destination + 0, a);
+			_mm_storeu_si128(destination + 1, b);
+			_mm_storeu_si128(destination + 2, c);
+			_mm_storeu_si128(destination + 3, d);
+		}
+		ScalarGamma(data + blocks_size, key + blocks_size, result + blocks_size, size - blocks_size);
+	}
+
+	void AVX2Gamma(const uint8_t* data, const uint8_t* key, uint8_t* result, const size_t size)
+	{
+		constexpr size_t block_size = 4 * sizeof(__m256i);
+		const size_t blocks_size = size - size % block_size;
+		for(size_t position = 0; position < blocks_size; position += block_size)
+		{
+			const auto source = reinterpret_cast<const __m256i*>(data + position);
+			const auto gamma = reinterpret_cast<const __m256i*>(key + position);
+			const auto destination = reinterpret_cast<__m256i*>(result + position);
+			const auto a = _mm256_xor_si256(_mm256_loadu_si256(source + 0), _mm256_loadu_si256(gamma + 0));
+			const auto b = _mm256_xor_si256(_mm256_loadu_si256(source + 1), _mm256_loadu_si256(gamma + 1));
+			const auto c = _mm256_xor_si256(_mm256_loadu_si256(source + 2), _mm256_loadu_si256(gamma + 2));
+			const auto d = _mm256_xor_si256(_mm256_loadu_si256(source + 3), _mm256_loadu_si256(gamma + 3));
+			_mm256_storeu_si256(destination + 0, a);
+			_mm256_storeu_si256(destination + 1, b);
+			_mm256_storeu_si256(destination + 2, c);
+			_mm256_storeu_si256(destination + 3, d);
+		}
+		_mm256_zeroupper(); // KAA: avoid SSE transition penalty in the caller.
+		SSE2Gamma(data + blocks_size, key + blocks_size, result + blocks_size, size - blocks_size);
+	}
+
+	void AVX512Gamma(const uint8_t* data, const uint8_t* key, uint8_t* result, const size_t size)
+	{
+		constexpr size_t block_size = 4 * sizeof(__m512i);
+		const size_t blocks_size = size - size % block_size;
+		for(size_t position = 0; position < blocks_size; position += block_size)
+		{
+			const auto source = data + position;
+			const auto gamma = key + position;
+			const auto destination = result + position;
+			const auto a = _mm512_xor_si512(_mm512_loadu_si512(source + 0 * sizeof(__m512i)), _mm512_loadu_si512(gamma + 0 * sizeof(__m512i)));
+			const auto b = _mm512_xor_si512(_mm512_loadu_si512(source + 1 * sizeof(__m512i)), _mm512_loadu_si512(gamma + 1 * sizeof(__m512i)));
+			const auto c = _mm512_xor_si512(_mm512_loadu_si512(source + 2 * sizeof(__m512i)), _mm512_loadu_si512(gamma + 2 * sizeof(__m512i)));
+			const auto d = _mm512_xor_si512(_mm512_loadu_si512(source + 3 * sizeof(__m512i)), _mm512_loadu_si512(gamma + 3 * sizeof(__m512i)));
+			_mm512_storeu_si512(destination + 0 * sizeof(__m512i), a);
+			_mm512_storeu_si512(destination + 1 * sizeof(__m512i), b);
+			_mm512_storeu_si512(destination + 2 * sizeof(__m512i), c);
+			_mm512_storeu_si512(destination + 3 * sizeof(__m512i), d);
+		}
+		_mm256_zeroupper();
+		SSE2Gamma(data + blocks_size, key + blocks_size, result + blocks_size, size - blocks_size);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool IsGammaKernelSupported(const gamma_kernel_t kernel)
+		{
+			const auto& features = GetProcessorFeatures();
+			switch(kernel)
+			{
+			case gamma_kernel_t::scalar:
+				return true;
+			case gamma_kernel_t::sse2:
+				return features.sse2;
+			case gamma_kernel_t::avx2:
+				return features.sse2 && features.avx2;
+			case gamma_kernel_t::avx512:
+				return features.sse2 && features.avx512;
+			default:
+				return false;
+			}
+		}
+
+		gamma_kernel_t GetPreferredGammaKernel(void)
+		{
+			if(IsGammaKernelSupported(gamma_kernel_t::avx512))
+				return gamma_kernel_t::avx512;
+			if(IsGammaKernelSupported(gamma_kernel_t::avx2))
+				return gamma_kernel_t::avx2;
+			if(IsGammaKernelSupported(gamma_kernel_t::sse2))
+				return gamma_kernel_t::sse2;
+			return gamma_kernel_t::scalar;
+		}
+
+		gamma_function_t QueryGammaKernel(const gamma_kernel_t kernel)
+		{
+			if(IsGammaKernelSupported(kernel))
+			{
+				switch(kernel)
+				{
+				case gamma_kernel_t::scalar:
+					return ScalarGamma;
+				case gamma_kernel_t::sse2:
+					return SSE2Gamma;
+				case gamma_kernel_t::avx2:
+					return AVX2Gamma;
+				case gamma_kernel_t::avx512:
+					return AVX512Gamma;
+				default:
+					break;
+				}
+			}
+
+			constexpr auto source = __FUNCTION__;
+			constexpr auto description = "cannot query gamma kernel: specified kernel is not supported by the processor";
+			constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+			constexpr auto severity = operation_failure::severity_t::error;
+			throw operation_failure(source, description, reason, severity);
+		}
+
+		void Gamma(const uint8_t* data, const uint8_t* key, uint8_t* result, const size_t size)
+		{
+			static const auto gamma = QueryGammaKernel(GetPreferredGammaKernel());
+			return gamma(data, key, result, size);
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		enum class gamma_kernel_t
+		{
+			scalar,
+			sse2,
+			avx2,
+			avx512
+		};
+
+		// NOTE: result may alias data or key (in-place processing), buffers do not have to be aligned.
+		typedef void (*gamma_function_t)(const uint8_t* data, const uint8_t* key, uint8_t* result, size_t size);
+
+		bool IsGammaKernelSupported(gamma_kernel_t);
+		gamma_kernel_t GetPreferredGammaKernel(void);
+		gamma_function_t QueryGammaKernel(gamma_kernel_t);
+
+		// NOTE: the widest kernel supported by the processor is selected once per process.
+		void Gamma(const uint8_t* data, const uint8_t* key, uint8_t* result, size_t size);
+	}
+}
@@ -0,0 +1,389 @@
+#include "IOPolicy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "KAA/include/registry.h"
+#include "KAA/include/registry_key.h"
+#include "KAA/include/unicode.h"
+#include "KAA/include/exception/failure.h"
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/path.h"
+
+#include <windows.h>
+
+#include "NativeFile.h"
+#include "RegistryFactory.h"
+#include "Tracer.h"
+
+namespace
+{
+	constexpr auto registry_io_policy_sub_key = R"(Software\Hyperlink Software\File Security\IOPolicy)";
+	constexpr auto registry_chunk_size_value_name = "ChunkSize";
+	constexpr auto registry_queue_depth_value_name = "QueueDepth";
+
+	constexpr KAA::FileSecurity::io_parameters_t default_parameters = { 64U * 1024U, 4U }; // 64 KiB
+	constexpr size_t candidate_chunk_sizes[] = { 64U * 1024U, 256U * 1024U, 1024U * 1024U, 4U * 1024U * 1024U };
+	constexpr unsigned candidate_queue_depths[] = { 1U, 2U, 4U, 8U };
+	constexpr uint64_t probe_size = 16U * 1024U * 1024U; // 16 MiB
+	constexpr double good_enough = 0.9; // KAA: the smaller value wins if it is within 10% of the best throughput.
+
+	// KAA: bounds of the values kept in the registry, the buffers of every chunk in flight are sized from them.
+	constexpr size_t min_chunk_size = 4U * 1024U; // 4 KiB
+	constexpr size_t max_chunk_size = 16U * 1024U * 1024U; // 16 MiB
+	constexpr unsigned max_queue_depth = 64U;
+
+	class AlignedBuffer final
+	{
+	public:
+		explicit AlignedBuffer(const size_t size) :
+		buffer(::VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))
+		{
+			if(nullptr == buffer)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to allocate probe buffer", error };
+			}
+		}
+
+		AlignedBuffer(const AlignedBuffer&) = delete;
+		AlignedBuffer& operator = (const AlignedBuffer&) = delete;
+
+		~AlignedBuffer()
+		{
+			::VirtualFree(buffer, 0, MEM_RELEASE);
+		}
+
+		void* get(void) const
+		{
+			return buffer;
+		}
+
+	private:
+		void* buffer;
+	};
+
+	class ProbeFile final
+	{
+	public:
+		explicit ProbeFile(const std::wstring& directory) :
+		name(MAX_PATH, L'\0')
+		{
+			if(0 == ::GetTempFileNameW(directory.c_str(), L"fsp", 0, &name[0]))
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to create probe file", error };
+			}
+			name.resize(name.find(L'\0'));
+		}
+
+		ProbeFile(const ProbeFile&) = delete;
+		ProbeFile& operator = (const ProbeFile&) = delete;
+
+		~ProbeFile()
+		{
+			::DeleteFileW(name.c_str());
+		}
+
+		KAA::filesystem::path::file get(void) const
+		{
+			return KAA::filesystem::path::file { name };
+		}
+
+	private:
+		std::wstring name;
+	};
+
+	// RETURNS: bytes per second, queue_depth threads keep one request in flight each.
+	double MeasureThroughput(const KAA::FileSecurity::NativeFile& file, const size_t chunk_size, const unsigned queue_depth, const bool write)
+	{
+		const auto started = std::chrono::steady_clock::now();
+		{
+			// KAA: a failure of a stream is passed to the caller, an exception leaving a thread terminates the process.
+			std::mutex failure_guard;
+			std::exception_ptr failure;
+			std::vector<std::thread> streams;
+			try
+			{
+				for(auto stream = 0U; stream < queue_depth; ++stream)
+				{
+					streams.emplace_back([&file, &failure_guard, &failure, chunk_size, queue_depth, write, stream]
+					{
+						try
+						{
+							const AlignedBuffer buffer(chunk_size);
+							for(uint64_t offset = stream * chunk_size; offset < probe_size; offset += queue_depth * chunk_size)
+							{
+								if(write)
+									file.WriteAt(offset, buffer.get(), chunk_size);
+								else
+									file.ReadAt(offset, buffer.get(), chunk_size);
+							}
+						}
+						catch(...)
+						{
+							std::lock_guard<std::mutex> lock(failure_guard);
+							failure = std::current_exception();
+						}
+					});
+				}
+			}
+			catch(...)
+			{
+				for(auto& stream : streams)
+					stream.join();
+				throw;
+			}
+			for(auto& stream : streams)
+				stream.join();
+			if(failure)
+				std::rethrow_exception(failure);
+		}
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+		return probe_size / std::max(elapsed.count(), 1e-9);
+	}
+
+	template <typename T, size_t N, typename Measure>
+	T ChooseCandidate(const T (&candidates)[N], Measure measure)
+	{
+		double throughput[N] = { 0 };
+		double best = 0;
+		for(size_t index = 0; index < N; ++index)
+		{
+			throughput[index] = measure(candidates[index]);
+			best = std::max(best, throughput[index]);
+		}
+		for(size_t index = 0; index < N; ++index)
+			if(throughput[index] >= best * good_enough)
+				return candidates[index];
+		return candidates[N - 1];
+	}
+
+	// NOTE: uncached I/O on a scratch file next to the data: the cache would measure memory, not the volume.
+	KAA::FileSecurity::io_parameters_t ProbeVolume(const std::wstring& directory)
+	{
+		using KAA::FileSecurity::NativeFile;
+		const ProbeFile probe(directory);
+		const NativeFile file(probe.get(), NativeFile::read_write, NativeFile::unbuffered);
+		MeasureThroughput(file, candidate_chunk_sizes[0], 1U, true); // KAA: allocate the file before timing anything.
+
+		KAA::FileSecurity::io_parameters_t parameters = default_parameters;
+		parameters.chunk_size = ChooseCandidate(candidate_chunk_sizes, [&file](const size_t chunk_size)
+		{
+			const auto write = MeasureThroughput(file, chunk_size, 1U, true);
+			const auto read = MeasureThroughput(file, chunk_size, 1U, false);
+			return 2 / ( 1 / write + 1 / read );
+		});
+		parameters.queue_depth = ChooseCandidate(candidate_queue_depths, [&file, &parameters](const unsigned queue_depth)
+		{
+			return MeasureThroughput(file, parameters.chunk_size, queue_depth, false);
+		});
+		return parameters;
+	}
+
+	std::wstring GetVolumeRoot(const std::wstring& directory)
+	{
+		std::wstring root(MAX_PATH + 1, L'\0');
+		if(0 == ::GetVolumePathNameW(directory.c_str(), &root[0], static_cast<DWORD>(root.size())))
+		{
+			const auto error = ::GetLastError();
+			throw KAA::windows_api_failure { __FUNCTION__, "unable to retrieve volume path", error };
+		}
+		root.resize(root.find(L'\0'));
+		return root;
+	}
+
+	std::string GetVolumeSerialNumber(const std::wstring& root)
+	{
+		DWORD serial_number = 0;
+		if(0 == ::GetVolumeInformationW(root.c_str(), nullptr, 0, &serial_number, nullptr, nullptr, nullptr, 0))
+		{
+			const auto error = ::GetLastError();
+			throw KAA::windows_api_failure { __FUNCTION__, "unable to retrieve volume information", error };
+		}
+		std::ostringstream serial;
+		serial << std::hex << std::uppercase << std::setw(8) << std::setfill('0') << serial_number;
+		return serial.str();
+	}
+
+	const wchar_t* ToString(const KAA::FileSecurity::io_parameters_origin_t origin)
+	{
+		switch(origin)
+		{
+		case KAA::FileSecurity::io_parameters_origin_t::fixed: return L"fixed";
+		case KAA::FileSecurity::io_parameters_origin_t::registry: return L"cached";
+		case KAA::FileSecurity::io_parameters_origin_t::probed: return L"probed";
+		case KAA::FileSecurity::io_parameters_origin_t::defaults: return L"default";
+		default: return L"unknown";
+		}
+	}
+
+	void ReportParameters(const KAA::FileSecurity::io_volume_report_t& report)
+	{
+		std::wostringstream message;
+		message << L"File Security: I/O policy for " << report.volume << L": chunk size " << report.parameters.chunk_size / 1024U << L" KiB, queue depth " << report.parameters.queue_depth << L" (" << ToString(report.origin) << L")";
+		if(!report.failure.empty())
+			message << L", probe failed: " << KAA::unicode::to_UTF16(report.failure);
+		message << L"\n";
+		::OutputDebugStringW(message.str().c_str());
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		IOPolicy::IOPolicy() :
+		m_registry(QueryRegistry(windows_registry)),
+		probe_volumes(true),
+		fixed_parameters(default_parameters)
+		{}
+
+		IOPolicy::IOPolicy(const io_parameters_t parameters) :
+		m_registry(nullptr),
+		probe_volumes(false),
+		fixed_parameters(parameters)
+		{
+			if(( 0 == parameters.chunk_size ) || ( 0 == parameters.queue_depth ))
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create I/O policy class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		IOPolicy::~IOPolicy() = default;
+
+		io_parameters_t IOPolicy::GetParameters(const filesystem::path::file& path)
+		{
+			return GetParameters(path.get_directory());
+		}
+
+		io_parameters_t IOPolicy::GetParameters(const filesystem::path::directory& path)
+		{
+			if(!probe_volumes)
+				return fixed_parameters;
+			const auto directory = path.to_wstring().empty() ? std::wstring { L"." } : path.to_wstring();
+			const auto volume = GetVolumeRoot(directory);
+
+			// KAA: a volume is probed outside the lock, requests for other volumes are not held up meanwhile.
+			std::unique_lock<std::mutex> lock(volumes_guard);
+			for(;;)
+			{
+				const auto cached = volumes.find(volume);
+				if(volumes.end() != cached)
+					return cached->second.parameters;
+				if(0 == volumes_probed.count(volume))
+					break;
+				volume_probed.wait(lock);
+			}
+			volumes_probed.insert(volume);
+			lock.unlock();
+
+			io_volume_report_t report;
+			try
+			{
+				report = QueryParameters(volume, directory);
+			}
+			catch(...)
+			{
+				lock.lock();
+				volumes_probed.erase(volume);
+				lock.unlock();
+				volume_probed.notify_all();
+				throw;
+			}
+
+			ReportParameters(report);
+			lock.lock();
+			volumes_probed.erase(volume);
+			volumes.emplace(volume, report);
+			lock.unlock();
+			volume_probed.notify_all();
+			return report.parameters;
+		}
+
+		std::vector<io_volume_report_t> IOPolicy::GetReport(void) const
+		{
+			if(!probe_volumes)
+				return { { std::wstring(), fixed_parameters, io_parameters_origin_t::fixed, std::string() } };
+			std::vector<io_volume_report_t> report;
+			std::lock_guard<std::mutex> lock(volumes_guard);
+			for(const auto& volume : volumes)
+				report.push_back(volume.second);
+			return report;
+		}
+
+		io_volume_report_t IOPolicy::QueryParameters(const std::wstring& volume, const std::wstring& probe_directory)
+		{
+			const auto volume_sub_key = std::string { registry_io_policy_sub_key } + '\\' + GetVolumeSerialNumber(volume);
+			try
+			{
+				const system::registry::key_access query_value = { false, false, false, false, true, false };
+				const auto volume_key = m_registry->open_key(system::registry::current_user, volume_sub_key, query_value);
+				io_parameters_t parameters = default_parameters;
+				parameters.chunk_size = volume_key->query_dword_value(registry_chunk_size_value_name);
+				parameters.queue_depth = volume_key->query_dword_value(registry_queue_depth_value_name);
+				if(( 0 != parameters.chunk_size ) && ( 0 != parameters.queue_depth ))
+				{
+					// NOTE: advanced setting, the values may have been edited by hand.
+					parameters.chunk_size = std::min(std::max(parameters.chunk_size, min_chunk_size), max_chunk_size) & ~( min_chunk_size - 1 );
+					parameters.queue_depth = std::min(parameters.queue_depth, max_queue_depth);
+					return { volume, parameters, io_parameters_origin_t::registry, std::string() };
+				}
+			}
+			catch(const windows_api_failure& error)
+			{
+				if(ERROR_FILE_NOT_FOUND != error)
+					throw;
+			}
+
+			// KAA: read-only or unbuffered I/O not supported (e.g. some network shares), out of memory or threads: keep defaults, probe again next session.
+			io_volume_report_t report = { volume, default_parameters, io_parameters_origin_t::defaults, std::string() };
+			try
+			{
+				const TraceSpan span("ProbeVolume");
+				report.parameters = ProbeVolume(probe_directory);
+			}
+			catch(const failure& error)
+			{
+				report.failure = error.get_system_message();
+				return report;
+			}
+			catch(const std::exception& error)
+			{
+				report.failure = error.what();
+				return report;
+			}
+			catch(...)
+			{
+				report.failure = "unknown error";
+				return report;
+			}
+			report.origin = io_parameters_origin_t::probed;
+			const auto& parameters = report.parameters;
+
+			try
+			{
+				const system::registry::key_access set_value = { false, false, false, false, false, true };
+				const auto volume_key = m_registry->create_key(system::registry::current_user, volume_sub_key, system::registry::persistent, set_value);
+				volume_key->set_dword_value(registry_chunk_size_value_name, static_cast<DWORD>(parameters.chunk_size));
+				volume_key->set_dword_value(registry_queue_depth_value_name, parameters.queue_depth);
+			}
+			catch(const windows_api_failure&)
+			{
+				// KAA: the probed values are used this session anyway.
+			}
+			return report;
+		}
+	}
+}
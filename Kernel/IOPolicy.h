@@ -0,0 +1,85 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace KAA
+{
+	namespace system
+	{
+		class registry;
+	}
+
+	namespace filesystem
+	{
+		namespace path
+		{
+			class directory;
+			class file;
+		}
+	}
+
+	namespace FileSecurity
+	{
+		struct io_parameters_t
+		{
+			size_t chunk_size;
+			unsigned queue_depth;
+		};
+
+		enum class io_parameters_origin_t
+		{
+			fixed, // NOTE: given to the policy, nothing probed.
+			registry, // NOTE: probed in an earlier session.
+			probed,
+			defaults // NOTE: the probe has failed, it is run again next session.
+		};
+
+		// NOTE: diagnostics: what has been chosen for a volume and why.
+		struct io_volume_report_t
+		{
+			std::wstring volume;
+			io_parameters_t parameters;
+			io_parameters_origin_t origin;
+			std::string failure; // KAA: empty unless the probe has failed.
+		};
+
+		// NOTE: chooses I/O chunk size and queue depth per volume. A volume is probed once, the result is kept in the registry.
+		class IOPolicy final
+		{
+		public:
+			IOPolicy();
+			// NOTE: the same parameters for every volume, nothing is probed nor kept in the registry (e.g. in-memory filesystem).
+			explicit IOPolicy(io_parameters_t);
+			IOPolicy(const IOPolicy&) = delete;
+			IOPolicy(IOPolicy&&) = delete;
+			~IOPolicy();
+
+			IOPolicy& operator = (const IOPolicy&) = delete;
+			IOPolicy& operator = (IOPolicy&&) = delete;
+
+			io_parameters_t GetParameters(const filesystem::path::file&);
+			io_parameters_t GetParameters(const filesystem::path::directory&);
+
+			// RETURNS: volumes whose parameters have been chosen so far, each is also written to the debugger output once chosen.
+			std::vector<io_volume_report_t> GetReport(void) const;
+
+		private:
+			std::unique_ptr<system::registry> m_registry;
+			const bool probe_volumes;
+			const io_parameters_t fixed_parameters;
+			mutable std::mutex volumes_guard;
+			std::map<std::wstring, io_volume_report_t> volumes;
+			std::set<std::wstring> volumes_probed; // NOTE: volumes being probed right now.
+			std::condition_variable volume_probed;
+
+			io_volume_report_t QueryParameters(const std::wstring& volume, const std::wstring& probe_directory);
+		};
+	}
+}
@@ -8,17 +8,87 @@
 //
 
 #include "Kernel.h"
-#include "KAA/include/filesystem/crt_file_system.h"
+
+#include <stdexcept>
+
+#include "KAA/include/registry.h"
+#include "KAA/include/registry_key.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#undef EncryptFile
+#undef DecryptFile
+#undef CopyFile
+#include "KAA/include/filesystem/driver.h"
+
+#include "FileSystemFactory.h"
+#include "RegistryFactory.h"
 #include "ServerCommunicator.h"
 
+namespace
+{
+	constexpr auto registry_software_sub_key = R"(Software\Hyperlink Software\File Security)";
+	constexpr auto registry_filesystem_value_name = "FileSystem";
+
+	constexpr auto default_filesystem = KAA::FileSecurity::filesystem_t::crt_runtime;
+
+	DWORD ToFileSystemID(const KAA::FileSecurity::filesystem_t filesystem)
+	{
+		switch(filesystem)
+		{
+		case KAA::FileSecurity::filesystem_t::crt_runtime: return 0x01;
+		case KAA::FileSecurity::filesystem_t::native: return 0x02;
+		case KAA::FileSecurity::filesystem_t::native_unbuffered: return 0x03;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	// RETURNS: the default for an unknown value (e.g. set by hand), the kernel is created whatever the advanced setting is.
+	KAA::FileSecurity::filesystem_t ToFileSystemType(const DWORD value)
+	{
+		switch(value)
+		{
+		case 0x01: return KAA::FileSecurity::filesystem_t::crt_runtime;
+		case 0x02: return KAA::FileSecurity::filesystem_t::native;
+		case 0x03: return KAA::FileSecurity::filesystem_t::native_unbuffered;
+		default:
+			return default_filesystem;
+		}
+	}
+
+	// NOTE: advanced setting, there is no user interface for it.
+	KAA::FileSecurity::filesystem_t QueryFileSystemType(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return ToFileSystemType(software_root->query_dword_value(registry_filesystem_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_filesystem_value_name, ToFileSystemID(default_filesystem));
+			return default_filesystem;
+		}
+		throw;
+	}
+}
+
 namespace KAA
 {
 	namespace FileSecurity
 	{
 		std::unique_ptr<Communicator> GetClassObject(void)
 		{
-			auto filesystem = std::make_shared<filesystem::crt_file_system>();
+			auto filesystem = QueryFileSystem(QueryFileSystemType(*QueryRegistry(windows_registry)));
 			return std::make_unique<ServerCommunicator>(std::move(filesystem));
 		}
+
+		std::unique_ptr<Communicator> GetClassObject(const filesystem::path::directory& key_storage_path)
+		{
+			return std::make_unique<ServerCommunicator>(QueryFileSystem(default_filesystem), GetDefaultSettings(key_storage_path));
+		}
 	}
 }
@@ -27,7 +27,11 @@ namespace KAA
 {
 	namespace FileSecurity
 	{
+		// NOTE: works with the settings of the current user.
 		KERNEL_API std::unique_ptr<Communicator> GetClassObject(void);
+		// NOTE: works with the settings of a new installation and the key storage given, the settings of the current user are neither read nor changed:
+		// the results do not depend on who runs it (e.g. benchmarks).
+		KERNEL_API std::unique_ptr<Communicator> GetClassObject(const filesystem::path::directory& key_storage_path);
 
 		//STDAPI DllCanUnloadNow(void);
 		//STDAPI DllGetClassObject(REFCLSID, REFIID, LPVOID*);
@@ -0,0 +1,233 @@
+#include "KeyGenerator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+#include <emmintrin.h>
+
+#include "KAA/include/cryptography/cryptography.h"
+
+namespace
+{
+	constexpr size_t block_size = 64U;
+	constexpr size_t lanes = 4U;
+	constexpr size_t batch_size = lanes * block_size;
+	constexpr size_t minimal_slice = 1024U * 1024U; // 1 MiB : a smaller slice is not worth a thread.
+
+	template <int bits>
+	inline __m128i RotateLeft(const __m128i value)
+	{
+		return _mm_or_si128(_mm_slli_epi32(value, bits), _mm_srli_epi32(value, 32 - bits));
+	}
+
+	template <size_t a, size_t b, size_t c, size_t d>
+	inline void QuarterRound(__m128i (&x)[16])
+	{
+		x[a] = _mm_add_epi32(x[a], x[b]); x[d] = RotateLeft<16>(_mm_xor_si128(x[d], x[a]));
+		x[c] = _mm_add_epi32(x[c], x[d]); x[b] = RotateLeft<12>(_mm_xor_si128(x[b], x[c]));
+		x[a] = _mm_add_epi32(x[a], x[b]); x[d] = RotateLeft<8>(_mm_xor_si128(x[d], x[a]));
+		x[c] = _mm_add_epi32(x[c], x[d]); x[b] = RotateLeft<7>(_mm_xor_si128(x[b], x[c]));
+	}
+
+	// NOTE: four consecutive blocks at once, register i holds word i of every block (SSE2 is the x86 baseline).
+	void ChaCha20Blocks(const uint32_t (&key)[8], const uint64_t counter, const uint64_t nonce, uint8_t* output)
+	{
+		__m128i input[16];
+		input[0] = _mm_set1_epi32(0x61707865); input[1] = _mm_set1_epi32(0x3320646e); input[2] = _mm_set1_epi32(0x79622d32); input[3] = _mm_set1_epi32(0x6b206574); // "expand 32-byte k"
+		for(size_t word = 0; word < 8; ++word)
+			input[4 + word] = _mm_set1_epi32(static_cast<int>(key[word]));
+		uint32_t counter_low[lanes];
+		uint32_t counter_high[lanes];
+		for(size_t lane = 0; lane < lanes; ++lane)
+		{
+			counter_low[lane] = static_cast<uint32_t>(counter + lane);
+			counter_high[lane] = static_cast<uint32_t>(( counter + lane ) >> 32);
+		}
+		input[12] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter_low));
+		input[13] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(counter_high));
+		input[14] = _mm_set1_epi32(static_cast<int>(nonce));
+		input[15] = _mm_set1_epi32(static_cast<int>(nonce >> 32));
+
+		__m128i x[16];
+		for(size_t word = 0; word < 16; ++word)
+			x[word] = input[word];
+		for(auto round = 0; round < 10; ++round)
+		{
+			QuarterRound<0, 4, 8, 12>(x); QuarterRound<1, 5, 9, 13>(x); QuarterRound<2, 6, 10, 14>(x); QuarterRound<3, 7, 11, 15>(x);
+			QuarterRound<0, 5, 10, 15>(x); QuarterRound<1, 6, 11, 12>(x); QuarterRound<2, 7, 8, 13>(x); QuarterRound<3, 4, 9, 14>(x);
+		}
+
+		// KAA: transpose 4x4 word groups back to block order.
+		for(size_t group = 0; group < 16; group += 4)
+		{
+			const auto a = _mm_add_epi32(x[group + 0], input[group + 0]);
+			const auto b = _mm_add_epi32(x[group + 1], input[group + 1]);
+			const auto c = _mm_add_epi32(x[group + 2], input[group + 2]);
+			const auto d = _mm_add_epi32(x[group + 3], input[group + 3]);
+			const auto ab_low = _mm_unpacklo_epi32(a, b);
+			const auto ab_high = _mm_unpackhi_epi32(a, b);
+			const auto cd_low = _mm_unpacklo_epi32(c, d);
+			const auto cd_high = _mm_unpackhi_epi32(c, d);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 0 * block_size + group * 4), _mm_unpacklo_epi64(ab_low, cd_low));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 1 * block_size + group * 4), _mm_unpackhi_epi64(ab_low, cd_low));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 2 * block_size + group * 4), _mm_unpacklo_epi64(ab_high, cd_high));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(output + 3 * block_size + group * 4), _mm_unpackhi_epi64(ab_high, cd_high));
+		}
+	}
+
+	void Seed(uint32_t (&key)[8])
+	{
+		uint32_t entropy[8];
+		KAA::cryptography::generate(sizeof(entropy), entropy);
+		for(size_t word = 0; word < 8; ++word)
+			key[word] ^= entropy[word];
+		std::memset(entropy, 0, sizeof(entropy)); // FUTURE: KAA: use SecureZeroMemory.
+	}
+
+	// NOTE: batches [first, last) of the keystream from the counter on, the batch is the unit of the counter offsets of slices.
+	void FillKeystream(const uint32_t (&key)[8], const uint64_t counter, const uint64_t nonce, uint8_t* output, const size_t first, const size_t last)
+	{
+		for(auto batch = first; batch < last; ++batch)
+			ChaCha20Blocks(key, counter + batch * lanes, nonce, output + batch * batch_size);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		KeyGenerator::KeyGenerator() :
+		KeyGenerator(std::max(1U, std::thread::hardware_concurrency()))
+		{}
+
+		KeyGenerator::KeyGenerator(const size_t streams) :
+		KeyGenerator(streams, std::max(1U, std::thread::hardware_concurrency()) - 1)
+		{}
+
+		KeyGenerator::KeyGenerator(const size_t streams, const unsigned helpers) :
+		stream_count(std::max<size_t>(1U, streams)),
+		streams(new stream_t[stream_count]),
+		next_stream(0),
+		helper_count(helpers)
+		{
+			for(size_t index = 0; index < stream_count; ++index)
+			{
+				auto& stream = this->streams[index];
+				std::memset(stream.key, 0, sizeof(stream.key));
+				Seed(stream.key);
+				stream.counter = 0;
+				stream.nonce = index;
+				stream.produced = 0;
+			}
+		}
+
+		KeyGenerator::~KeyGenerator()
+		{
+			for(size_t index = 0; index < stream_count; ++index)
+				std::memset(streams[index].key, 0, sizeof(streams[index].key));
+		}
+
+		// NOTE: a stream busy with another request is passed over; the first one is waited for if every stream is busy.
+		void KeyGenerator::Generate(const size_t size, void* buffer)
+		{
+			auto* const output = static_cast<uint8_t*>(buffer);
+			const auto first = next_stream++ % stream_count;
+			for(size_t index = 0; index < stream_count; ++index)
+			{
+				auto& stream = streams[( first + index ) % stream_count];
+				std::unique_lock<std::mutex> lock(stream.guard, std::try_to_lock);
+				if(lock.owns_lock())
+					return Fill(stream, output, size);
+			}
+
+			auto& stream = streams[first];
+			std::lock_guard<std::mutex> lock(stream.guard);
+			Fill(stream, output, size);
+		}
+
+		void KeyGenerator::Fill(stream_t& stream, uint8_t* output, const size_t size)
+		{
+			const auto whole_batches = size / batch_size;
+			FillBatches(stream, output, whole_batches);
+			stream.counter += whole_batches * lanes;
+			output += whole_batches * batch_size;
+
+			uint8_t batch[batch_size];
+			const auto tail = size % batch_size;
+			ChaCha20Blocks(stream.key, stream.counter, stream.nonce, batch);
+			stream.counter += lanes;
+			std::memcpy(output, batch, tail);
+
+			// KAA: key erasure - a block never given out becomes the next key, earlier output cannot be recomputed from the state.
+			// The last block of the batch is used unless the tail has reached into it, then a batch of its own.
+			if(( lanes - 1 ) * block_size < tail)
+			{
+				ChaCha20Blocks(stream.key, stream.counter, stream.nonce, batch);
+				stream.counter += lanes;
+			}
+			std::memcpy(stream.key, batch + ( lanes - 1 ) * block_size, sizeof(stream.key));
+			std::memset(batch, 0, sizeof(batch));
+
+			stream.produced += size;
+			if(stream.produced >= reseed_interval)
+			{
+				Seed(stream.key);
+				stream.produced = 0;
+			}
+		}
+
+		// NOTE: the stream is locked by the caller, its key and counter stay as they are until every slice is filled.
+		void KeyGenerator::FillBatches(const stream_t& stream, uint8_t* output, const size_t batches)
+		{
+			const auto wanted = std::min<size_t>(batches * batch_size / minimal_slice, helper_count + 1U);
+			if(wanted < 2)
+				return FillKeystream(stream.key, stream.counter, stream.nonce, output, 0, batches);
+
+			WorkStealingPool* pool = nullptr;
+			try
+			{
+				pool = &GetHelpers();
+			}
+			catch(...)
+			{
+				return FillKeystream(stream.key, stream.counter, stream.nonce, output, 0, batches); // KAA: out of threads, no helpers to share.
+			}
+
+			const auto slice = ( batches + wanted - 1 ) / wanted;
+			WorkStealingPool::TaskGroup slices;
+			size_t next = slice; // KAA: the first slice is filled by the calling thread.
+			try
+			{
+				for(; next < batches; next += slice)
+				{
+					const auto last = std::min(batches, next + slice);
+					pool->Submit(slices, task_kind_t::cpu, [&stream, output, next, last] { FillKeystream(stream.key, stream.counter, stream.nonce, output, next, last); });
+				}
+			}
+			catch(...)
+			{
+				// KAA: out of memory, the calling thread fills the slices left.
+			}
+			FillKeystream(stream.key, stream.counter, stream.nonce, output, 0, std::min(batches, slice));
+			FillKeystream(stream.key, stream.counter, stream.nonce, output, next, batches);
+			pool->Wait(slices);
+		}
+
+		// KAA: a helper pool has an I/O worker as well, it stays idle.
+		WorkStealingPool& KeyGenerator::GetHelpers(void)
+		{
+			std::call_once(helpers_started, [this] { helpers = std::make_unique<WorkStealingPool>(concurrency_limits_t { helper_count, 1U }); });
+			return *helpers;
+		}
+
+		void ChaCha20Block(const uint32_t key[8], const uint64_t counter, const uint64_t nonce, uint8_t block[64])
+		{
+			uint32_t stream_key[8];
+			std::memcpy(stream_key, key, sizeof(stream_key));
+			uint8_t batch[lanes * block_size];
+			ChaCha20Blocks(stream_key, counter, nonce, batch);
+			std::memcpy(block, batch, block_size);
+		}
+	}
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "WorkStealingPool.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: ChaCha20 deterministic random bit generator for key material.
+		// A request draws from a stream no other request uses at the same time, so that concurrent requests do not wait for each other;
+		// each stream is seeded independently from the operating system entropy source. A large request is split into slices filled on
+		// several cores at once, each slice from its own counter offset of the stream: the output does not depend on how it has been split.
+		// Helper threads are shared by all requests: they are started with the first request large enough to be split and kept, a request queues
+		// its slices to them and fills slices on the calling thread as well while it waits.
+		// Reseed schedule: after every request a stream replaces its key with the next keystream block (key erasure),
+		// after every reseed_interval bytes of output it mixes fresh operating system entropy into the key.
+		class KeyGenerator final
+		{
+		public:
+			static constexpr uint64_t reseed_interval = 1024U * 1024U * 1024U; // 1 GiB
+
+			KeyGenerator();
+			explicit KeyGenerator(size_t streams);
+			// NOTE: helpers - threads a request may take beyond the calling one, 0 fills every request on the calling thread.
+			KeyGenerator(size_t streams, unsigned helpers);
+			KeyGenerator(const KeyGenerator&) = delete;
+			KeyGenerator(KeyGenerator&&) = delete;
+			~KeyGenerator();
+
+			KeyGenerator& operator = (const KeyGenerator&) = delete;
+			KeyGenerator& operator = (KeyGenerator&&) = delete;
+
+			void Generate(size_t size, void* buffer);
+
+		private:
+			struct stream_t
+			{
+				std::mutex guard;
+				uint32_t key[8];
+				uint64_t counter;
+				uint64_t nonce;
+				uint64_t produced;
+			};
+
+			const size_t stream_count;
+			std::unique_ptr<stream_t[]> streams;
+			std::atomic<size_t> next_stream;
+			const unsigned helper_count;
+			std::once_flag helpers_started;
+			std::unique_ptr<WorkStealingPool> helpers; // KAA: nullptr until a request is split.
+
+			void Fill(stream_t&, uint8_t* output, size_t size);
+			void FillBatches(const stream_t&, uint8_t* output, size_t batches);
+			WorkStealingPool& GetHelpers(void);
+		};
+
+		// NOTE: original ChaCha20 block function (64-bit block counter, 64-bit nonce).
+		void ChaCha20Block(const uint32_t key[8], uint64_t counter, uint64_t nonce, uint8_t block[64]);
+	}
+}
@@ -0,0 +1,17 @@
+#include "KeyPathDigest.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool KeyPathDigest::IsComplete(const uint64_t file_size) const
+		{
+			return IIsComplete(file_size);
+		}
+
+		filesystem::path::file KeyPathDigest::GetKeyPath(void)
+		{
+			return IGetKeyPath();
+		}
+	}
+}
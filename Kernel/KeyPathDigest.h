@@ -0,0 +1,24 @@
+#pragma once
+
+#include "KAA/include/filesystem/path.h"
+
+#include "FileDataHandler.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: computes the key path of the data written by a cipher while it is being written, sparing a read of the whole file afterwards.
+		// The digest is valid only if the chunks have arrived in order and cover the whole file.
+		class KeyPathDigest : public FileDataHandler
+		{
+		public:
+			bool IsComplete(uint64_t file_size) const;
+			filesystem::path::file GetKeyPath(void);
+
+		private:
+			virtual bool IIsComplete(uint64_t file_size) const = 0;
+			virtual filesystem::path::file IGetKeyPath(void) = 0;
+		};
+	}
+}
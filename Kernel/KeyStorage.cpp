@@ -1,5 +1,7 @@
 #include "KeyStorage.h"
 
+#include "KAA/include/filesystem/driver.h"
+
 namespace KAA
 {
 	namespace FileSecurity
@@ -18,5 +20,61 @@ namespace KAA
 		{
 			return IGetKeyPathForSpecifiedPath(path);
 		};
+
+		std::shared_ptr<KeyPathDigest> KeyStorage::StartKeyPathDigest(void) const
+		{
+			return IStartKeyPathDigest();
+		}
+
+		void KeyStorage::RememberKeyPath(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			return IRememberKeyPath(path, key_path);
+		}
+
+		void KeyStorage::SetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			return ISetCancellationToken(std::move(token));
+		}
+
+		void KeyStorage::StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			return IStoreKey(key_file, key_path);
+		}
+
+		bool KeyStorage::ContainsKey(const filesystem::path::file& key_path) const
+		{
+			return IContainsKey(key_path);
+		}
+
+		filesystem::path::file KeyStorage::LoadKey(const filesystem::path::file& key_path)
+		{
+			return ILoadKey(key_path);
+		}
+
+		std::unique_ptr<filesystem::file> KeyStorage::OpenKey(const filesystem::path::file& key_path)
+		{
+			return IOpenKey(key_path);
+		}
+
+		void KeyStorage::UnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return IUnloadKey(key_path, key_file);
+		}
+
+		void KeyStorage::RemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return IRemoveKey(key_path, key_file);
+		}
+
+		void KeyStorage::IRememberKeyPath(const filesystem::path::file&, const filesystem::path::file&)
+		{}
+
+		void KeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken>)
+		{}
+
+		std::unique_ptr<filesystem::file> KeyStorage::IOpenKey(const filesystem::path::file&)
+		{
+			return nullptr;
+		}
 	}
 }
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <memory>
+
 #include "KAA/include/filesystem/path.h"
 
 namespace KAA
 {
+	namespace filesystem
+	{
+		class file;
+	}
+
 	namespace FileSecurity
 	{
+		class CancellationToken;
+		class KeyPathDigest;
+
 		class KeyStorage
 		{
 		public:
@@ -16,11 +26,39 @@ namespace KAA
 
 			filesystem::path::file GetKeyPathForSpecifiedPath(const filesystem::path::file&) const;
 
+			// RETURNS: digest to be fed with the data being written to a file or nullptr if the key path does not depend on the file data.
+			std::shared_ptr<KeyPathDigest> StartKeyPathDigest(void) const;
+			// NOTE: key path of the file has been computed elsewhere (e.g. by a digest), storages that keep track of files may use it.
+			void RememberKeyPath(const filesystem::path::file& path, const filesystem::path::file& key_path);
+			// NOTE: storages reading whole files (e.g. to hash them) check the token once per chunk, nullptr means not cancellable.
+			void SetCancellationToken(std::shared_ptr<CancellationToken>);
+
+			// NOTE: key life cycle. A new key is written to a file and handed over with StoreKey.
+			// LoadKey returns a file the cipher can read the key from, it is given back with UnloadKey or RemoveKey (the key is deleted).
+			void StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path);
+			bool ContainsKey(const filesystem::path::file& key_path) const;
+			filesystem::path::file LoadKey(const filesystem::path::file& key_path);
+			// NOTE: a stream of the key where the storage keeps it, spares LoadKey its copy; nullptr if the key is handed out as a file only.
+			// The key is given back with UnloadKey or RemoveKey as well, its key path being the key file.
+			std::unique_ptr<filesystem::file> OpenKey(const filesystem::path::file& key_path);
+			void UnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file);
+			void RemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file);
+
 		private:
 			virtual void ISetPath(filesystem::path::directory) = 0;
 			virtual filesystem::path::directory IGetPath(void) const = 0;
 
 			virtual filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const = 0;
+			virtual std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const = 0;
+			virtual void IRememberKeyPath(const filesystem::path::file&, const filesystem::path::file&);
+			virtual void ISetCancellationToken(std::shared_ptr<CancellationToken>);
+
+			virtual void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) = 0;
+			virtual bool IContainsKey(const filesystem::path::file&) const = 0;
+			virtual filesystem::path::file ILoadKey(const filesystem::path::file&) = 0;
+			virtual std::unique_ptr<filesystem::file> IOpenKey(const filesystem::path::file&);
+			virtual void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) = 0;
+			virtual void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) = 0;
 		};
 	}
 }
@@ -2,21 +2,55 @@
 
 #include "KAA/include/exception/operation_failure.h"
 
+#include "Blake3BasedKeyStorage.h"
+#include "CachedKeyStorage.h"
 #include "CRC32BasedKeyStorage.h"
 #include "MD5BasedKeyStorage.h"
+#include "PackedKeyStorage.h"
+#include "ShardedKeyStorage.h"
 
 namespace KAA
 {
 	namespace FileSecurity
 	{
-		std::unique_ptr<KeyStorage> CreateKeyStorage(const key_storage_t type, std::shared_ptr<filesystem::driver> filesystem, filesystem::path::directory path)
+		namespace
+		{
+			std::unique_ptr<KeyStorage> ApplyLayout(std::unique_ptr<KeyStorage> storage, const key_storage_layout_t layout, std::shared_ptr<filesystem::driver> filesystem)
+			{
+				switch(layout)
+				{
+				case key_storage_layout_t::flat:
+					return storage;
+				case key_storage_layout_t::sharded:
+					return std::make_unique<ShardedKeyStorage>(std::move(storage), std::move(filesystem));
+				default:
+					constexpr auto source = __FUNCTION__;
+					constexpr auto description = "cannot create key storage class instance: specified layout is not supported";
+					constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+					constexpr auto severity = operation_failure::severity_t::error;
+					throw operation_failure(source, description, reason, severity);
+				}
+			}
+		}
+
+		std::unique_ptr<KeyStorage> CreateKeyStorage(const key_storage_t type, const key_storage_layout_t layout, std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, filesystem::path::directory path)
 		{
 			switch(type)
 			{
 			case key_storage_t::md5_based:
-				return std::make_unique<MD5BasedKeyStorage>(std::move(filesystem), std::move(path));
+				return std::make_unique<CachedKeyStorage>(ApplyLayout(std::make_unique<MD5BasedKeyStorage>(filesystem, std::move(io_policy), std::move(path)), layout, filesystem), filesystem);
+			case key_storage_t::blake3_based:
+				return std::make_unique<CachedKeyStorage>(ApplyLayout(std::make_unique<Blake3BasedKeyStorage>(filesystem, std::move(io_policy), std::move(path)), layout, filesystem), filesystem);
+			case key_storage_t::packed:
+				{
+					auto naming = std::make_unique<Blake3BasedKeyStorage>(filesystem, std::move(io_policy), std::move(path));
+					auto& key_names = *naming;
+					auto packed = std::make_unique<PackedKeyStorage>(ApplyLayout(std::move(naming), layout, filesystem), filesystem);
+					key_names.SetKeyLookup(packed.get()); // KAA: BLAKE3 named keys are looked for in the container, not only among the key files.
+					return std::make_unique<CachedKeyStorage>(std::move(packed), filesystem);
+				}
 			case key_storage_t::crc32_based:
-				return std::make_unique<CRC32BasedKeyStorage>(std::move(path));
+				return ApplyLayout(std::make_unique<CRC32BasedKeyStorage>(filesystem, std::move(path)), layout, filesystem);
 			default:
 					constexpr auto source = __FUNCTION__;
 					constexpr auto description = "cannot create key storage class instance: specified type is not supported";
@@ -16,13 +16,22 @@ namespace KAA
 
 	namespace FileSecurity
 	{
+		class IOPolicy;
 		class KeyStorage;
 		enum class key_storage_t
 		{
 			md5_based,
-			crc32_based
+			crc32_based,
+			blake3_based,
+			packed
 		};
 
-		std::unique_ptr<KeyStorage> CreateKeyStorage(key_storage_t, std::shared_ptr<filesystem::driver>, filesystem::path::directory);
+		enum class key_storage_layout_t
+		{
+			flat,
+			sharded
+		};
+
+		std::unique_ptr<KeyStorage> CreateKeyStorage(key_storage_t, key_storage_layout_t, std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory);
 	}
 }
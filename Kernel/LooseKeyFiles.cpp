@@ -0,0 +1,54 @@
+#include "LooseKeyFiles.h"
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/filesystem.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		LooseKeyFiles::LooseKeyFiles(std::shared_ptr<filesystem::driver> driver) :
+		filesystem(std::move(driver))
+		{
+			if(!filesystem)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create loose key files class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void LooseKeyFiles::StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			filesystem->rename_file(key_file, key_path);
+		}
+
+		bool LooseKeyFiles::ContainsKey(const filesystem::path::file& key_path) const
+		{
+			return filesystem::file_exists(*filesystem, key_path);
+		}
+
+		filesystem::path::file LooseKeyFiles::LoadKey(const filesystem::path::file& key_path) const
+		{
+			return key_path;
+		}
+
+		void LooseKeyFiles::UnloadKey(const filesystem::path::file&, const filesystem::path::file&) const
+		{}
+
+		void LooseKeyFiles::RemoveKey(const filesystem::path::file& key_path, const filesystem::path::file&)
+		{
+			RemoveKeyFile(*filesystem, key_path);
+		}
+
+		void RemoveKeyFile(filesystem::driver& filesystem, const filesystem::path::file& path)
+		{
+			filesystem::driver::permission write_only(true, false);
+			filesystem.set_file_permissions(path, write_only);
+			filesystem.remove_file(path);
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+
+#include "KAA/include/filesystem/path.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: one read-only file per key in the key storage directory: the key path is the key file itself.
+		class LooseKeyFiles final
+		{
+		public:
+			explicit LooseKeyFiles(std::shared_ptr<filesystem::driver>);
+			LooseKeyFiles(const LooseKeyFiles&) = delete;
+			LooseKeyFiles(LooseKeyFiles&&) = delete;
+			~LooseKeyFiles() = default;
+
+			LooseKeyFiles& operator = (const LooseKeyFiles&) = delete;
+			LooseKeyFiles& operator = (LooseKeyFiles&&) = delete;
+
+			void StoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path);
+			bool ContainsKey(const filesystem::path::file& key_path) const;
+			filesystem::path::file LoadKey(const filesystem::path::file& key_path) const;
+			void UnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file) const;
+			void RemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file);
+
+		private:
+			std::shared_ptr<filesystem::driver> filesystem;
+		};
+
+		// NOTE: key files are created read-only.
+		void RemoveKeyFile(filesystem::driver&, const filesystem::path::file&);
+	}
+}
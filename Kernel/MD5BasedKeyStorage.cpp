@@ -6,15 +6,70 @@
 #include "KAA/include/exception/operation_failure.h"
 #include "KAA/include/filesystem/driver.h"
 
+#include "CancellationToken.h"
+#include "IOPolicy.h"
+#include "KeyPathDigest.h"
+
+namespace
+{
+	class MD5KeyPathDigest final : public KAA::FileSecurity::KeyPathDigest
+	{
+	public:
+		explicit MD5KeyPathDigest(KAA::filesystem::path::directory storage) :
+		storage_path(std::move(storage)),
+		bytes_hashed(0),
+		in_order(true)
+		{}
+
+		MD5KeyPathDigest(const MD5KeyPathDigest&) = delete;
+		MD5KeyPathDigest& operator = (const MD5KeyPathDigest&) = delete;
+
+	private:
+		KAA::filesystem::path::directory storage_path;
+		KAA::cryptography::md5 hash;
+		std::vector<uint8_t> chunk;
+		uint64_t bytes_hashed;
+		bool in_order;
+
+		void IChunkWritten(const uint64_t offset, const void* data, const size_t size) override
+		{
+			if(!in_order)
+				return;
+			if(offset != bytes_hashed)
+			{
+				in_order = false; // KAA: rewritten or skipped range: the file has to be read again.
+				return;
+			}
+			const auto bytes = static_cast<const uint8_t*>(data);
+			chunk.assign(bytes, bytes + size);
+			hash.add_data(chunk);
+			bytes_hashed += size;
+		}
+
+		bool IIsComplete(const uint64_t file_size) const override
+		{
+			return in_order && ( file_size == bytes_hashed );
+		}
+
+		KAA::filesystem::path::file IGetKeyPath(void) override
+		{
+			auto filename = KAA::convert::to_wstring(hash.complete()) + L".bin";
+			return storage_path + std::move(filename);
+		}
+	};
+}
+
 namespace KAA
 {
 	namespace FileSecurity
 	{
-		MD5BasedKeyStorage::MD5BasedKeyStorage(std::shared_ptr<filesystem::driver> driver, filesystem::path::directory path) :
-		filesystem(std::move(driver)),
-		storage_path(std::move(path))
+		MD5BasedKeyStorage::MD5BasedKeyStorage(std::shared_ptr<filesystem::driver> driver, std::shared_ptr<IOPolicy> policy, filesystem::path::directory path) :
+		filesystem(driver),
+		io_policy(std::move(policy)),
+		storage_path(std::move(path)),
+		key_files(std::move(driver))
 		{
-			if (!filesystem)
+			if (!filesystem || !io_policy)
 			{
 				constexpr auto source = __FUNCTION__;
 				constexpr auto description = "unable to create MD5 based key storage class instance";
@@ -42,10 +97,14 @@ namespace KAA
 			cryptography::md5 hash;
 			{
 				auto last_chunk = false;
-				constexpr auto chunk_size = 64U * 1024U; // 64 KiB
+				const auto chunk_size = io_policy->GetParameters(path).chunk_size;
 				std::vector<uint8_t> data(chunk_size);
 				do
 				{
+					if (cancellation)
+					{
+						cancellation->Check();
+					}
 					const auto bytes_read = file->read(chunk_size, data.data());
 					last_chunk = bytes_read < chunk_size;
 					if (last_chunk)
@@ -58,5 +117,40 @@ namespace KAA
 			auto filename = convert::to_wstring(hash.complete()) + L".bin";
 			return storage_path + std::move(filename);
 		}
+
+		std::shared_ptr<KeyPathDigest> MD5BasedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			return std::make_shared<MD5KeyPathDigest>(storage_path);
+		}
+
+		void MD5BasedKeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			cancellation = std::move(token);
+		}
+
+		void MD5BasedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			return key_files.StoreKey(key_file, key_path);
+		}
+
+		bool MD5BasedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			return key_files.ContainsKey(key_path);
+		}
+
+		filesystem::path::file MD5BasedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			return key_files.LoadKey(key_path);
+		}
+
+		void MD5BasedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.UnloadKey(key_path, key_file);
+		}
+
+		void MD5BasedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return key_files.RemoveKey(key_path, key_file);
+		}
 	}
 }
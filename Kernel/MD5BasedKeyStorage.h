@@ -3,6 +3,7 @@
 #include <memory>
 
 #include "KeyStorage.h"
+#include "LooseKeyFiles.h"
 
 namespace KAA
 {
@@ -13,10 +14,12 @@ namespace KAA
 
 	namespace FileSecurity
 	{
+		class IOPolicy;
+
 		class MD5BasedKeyStorage final : public KeyStorage
 		{
 		public:
-			MD5BasedKeyStorage(std::shared_ptr<filesystem::driver>, filesystem::path::directory storage_path);
+			MD5BasedKeyStorage(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, filesystem::path::directory storage_path);
 			MD5BasedKeyStorage(const MD5BasedKeyStorage&) = delete;
 			MD5BasedKeyStorage(MD5BasedKeyStorage&&) = delete;
 			~MD5BasedKeyStorage() = default;
@@ -29,9 +32,20 @@ namespace KAA
 			filesystem::path::directory IGetPath(void) const override;
 
 			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+			void ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
 
 			std::shared_ptr<filesystem::driver> filesystem;
+			std::shared_ptr<IOPolicy> io_policy;
 			filesystem::path::directory storage_path;
+			std::shared_ptr<CancellationToken> cancellation;
+			LooseKeyFiles key_files;
 		};
 	}
 }
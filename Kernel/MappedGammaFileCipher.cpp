@@ -0,0 +1,164 @@
+#include "MappedGammaFileCipher.h"
+
+#include <algorithm>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+
+#include <windows.h>
+
+#include "CancellationToken.h"
+#include "GammaKernel.h"
+#include "NativeFile.h"
+#include "NativeFileSystem.h"
+
+namespace
+{
+	class FileMapping final
+	{
+	public:
+		FileMapping(const HANDLE file, const DWORD protection) :
+		mapping(::CreateFileMappingW(file, nullptr, protection, 0, 0, nullptr))
+		{
+			if(nullptr == mapping)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to create file mapping", error };
+			}
+		}
+
+		FileMapping(const FileMapping&) = delete;
+		FileMapping& operator = (const FileMapping&) = delete;
+
+		~FileMapping()
+		{
+			::CloseHandle(mapping);
+		}
+
+		HANDLE get(void) const
+		{
+			return mapping;
+		}
+
+	private:
+		HANDLE mapping;
+	};
+
+	class MappedView final
+	{
+	public:
+		MappedView(const FileMapping& mapping, const DWORD access, const uint64_t offset, const size_t size) :
+		view(::MapViewOfFile(mapping.get(), access, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size))
+		{
+			if(nullptr == view)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to map view of file", error };
+			}
+		}
+
+		MappedView(const MappedView&) = delete;
+		MappedView& operator = (const MappedView&) = delete;
+
+		~MappedView()
+		{
+			::UnmapViewOfFile(view);
+		}
+
+		uint8_t* get(void) const
+		{
+			return static_cast<uint8_t*>(view);
+		}
+
+	private:
+		void* view;
+	};
+
+	// KAA: a view has to start at a multiple of the allocation granularity.
+	uint64_t GetWindowSize(void)
+	{
+		constexpr uint64_t preferred_window_size = 64U * 1024U * 1024U; // 64 MiB
+		SYSTEM_INFO system = { 0 };
+		::GetSystemInfo(&system);
+		const uint64_t granularity = system.dwAllocationGranularity;
+		return std::max(granularity, preferred_window_size - preferred_window_size % granularity);
+	}
+
+	// NOTE: an I/O error on a page of a view is raised as a structured exception, not returned: it is turned into a status here.
+	// KAA: no objects to unwind in a function with __try.
+	// RETURNS: false if a page of a view could not be read in or written back.
+	bool ApplyGamma(uint8_t* data, const uint8_t* gamma, const size_t size)
+	{
+		__try
+		{
+			KAA::FileSecurity::Gamma(data, gamma, data, size);
+		}
+		__except(EXCEPTION_IN_PAGE_ERROR == ::GetExceptionCode() ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+		{
+			return false;
+		}
+		return true;
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		MappedGammaFileCipher::MappedGammaFileCipher(std::shared_ptr<filesystem::driver> filesystem)
+		{
+			if(!IsWindowsFileSystem(filesystem.get()))
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create mapped gamma file cipher class instance: files of Windows volumes only";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void MappedGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			const NativeFile master(path, NativeFile::read_write, NativeFile::synchronous);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::synchronous);
+
+			const auto size = master.GetSize();
+			if(0 == size)
+				return;
+
+			if(key.GetSize() < size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to apply gamma: key is shorter than the file";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			const FileMapping master_mapping(master.GetHandle(), PAGE_READWRITE);
+			const FileMapping key_mapping(key.GetHandle(), PAGE_READONLY);
+
+			const auto window_size = GetWindowSize();
+			auto progress = progress_state_t::proceed;
+			for(uint64_t offset = 0; offset < size; offset += window_size)
+			{
+				const auto window = static_cast<size_t>(std::min(window_size, size - offset));
+				{
+					const MappedView data(master_mapping, FILE_MAP_WRITE, offset, window);
+					const MappedView gamma(key_mapping, FILE_MAP_READ, offset, window);
+					if(!ApplyGamma(data.get(), gamma.get(), window))
+						throw windows_api_failure { __FUNCTION__, "unable to apply gamma: mapped file is not accessible", ERROR_IO_DEVICE };
+					ChunkWritten(offset, data.get(), window);
+				}
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(window);
+				CheckProgressState(progress);
+			}
+		}
+
+		void MappedGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
+	}
+}
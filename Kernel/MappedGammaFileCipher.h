@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "FileCipher.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: maps the file and the key a window at a time and applies gamma in place.
+		// Files of Windows volumes only: the files are mapped through Windows handles, bypassing the driver; the driver given has to be a Windows one.
+		// A page that cannot be read in (e.g. removable or network volume gone) fails the operation, the rest of the window is left as it is.
+		class MappedGammaFileCipher final : public FileCipher
+		{
+		public:
+			explicit MappedGammaFileCipher(std::shared_ptr<filesystem::driver>);
+			MappedGammaFileCipher(const MappedGammaFileCipher&) = delete;
+			MappedGammaFileCipher(MappedGammaFileCipher&&) = delete;
+			~MappedGammaFileCipher() = default;
+
+			MappedGammaFileCipher& operator = (const MappedGammaFileCipher&) = delete;
+			MappedGammaFileCipher& operator = (MappedGammaFileCipher&&) = delete;
+
+		private:
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+		};
+	}
+}
@@ -0,0 +1,388 @@
+#include "MemoryFileSystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cwctype>
+#include <iomanip>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "CreateMode.h"
+
+namespace
+{
+	struct handle_t
+	{
+		bool read;
+		bool write;
+		bool share_read;
+		bool share_write;
+	};
+
+	struct node_t
+	{
+		node_t(const bool read_only, const uint64_t index) :
+		read_only(read_only),
+		index(index),
+		write_count(0),
+		change_count(0)
+		{}
+
+		std::mutex guard; // NOTE: data and handles, open files only take this one.
+		std::vector<uint8_t> data;
+		bool read_only;
+		std::list<handle_t> handles;
+		const uint64_t index;
+		uint64_t write_count;
+		uint64_t change_count; // KAA: writes and changes of the metadata.
+	};
+
+	// RETURNS: lower case path with backslashes and without trailing separator unless it is a root.
+	std::wstring GetKey(std::wstring path)
+	{
+		std::replace(path.begin(), path.end(), L'/', L'\\');
+		while(( 1U < path.size() ) && ( L'\\' == path.back() ) && ( L':' != path[path.size() - 2] ))
+			path.pop_back();
+		std::transform(path.begin(), path.end(), path.begin(), [] (const wchar_t symbol) { return static_cast<wchar_t>(std::towlower(symbol)); });
+		return path;
+	}
+
+	std::wstring GetParentKey(const std::wstring& key)
+	{
+		const auto separator = key.find_last_of(L'\\');
+		if(std::wstring::npos == separator)
+			return std::wstring { };
+		if(( 0 == separator ) || ( L':' == key[separator - 1] ))
+			return key.substr(0, separator + 1);
+		return key.substr(0, separator);
+	}
+
+	// NOTE: the current directory, a drive or the root of the current drive.
+	bool IsRoot(const std::wstring& key)
+	{
+		return key.empty() || ( L"." == key ) || ( L"\\" == key ) || ( ( 2U <= key.size() ) && ( key.size() <= 3U ) && ( L':' == key[1] ) );
+	}
+
+	bool IsShared(const std::list<handle_t>& handles, const handle_t& request)
+	{
+		for(const auto& handle : handles)
+			if(( request.read && !handle.share_read ) || ( request.write && !handle.share_write ) || ( handle.read && !request.share_read ) || ( handle.write && !request.share_write ))
+				return false;
+		return true;
+	}
+
+	bool HasChildren(const std::map<std::wstring, std::shared_ptr<node_t>>& files, const std::set<std::wstring>& directories, const std::wstring& key)
+	{
+		const auto prefix = key + L'\\';
+		const auto file = files.lower_bound(prefix);
+		const auto directory = directories.lower_bound(prefix);
+		return ( ( files.end() != file ) && ( 0 == file->first.compare(0, prefix.size(), prefix) ) ) ||
+			( ( directories.end() != directory ) && ( 0 == directory->compare(0, prefix.size(), prefix) ) );
+	}
+
+	class MemoryFile final : public KAA::filesystem::file
+	{
+	public:
+		MemoryFile(std::shared_ptr<node_t> node, const std::list<handle_t>::iterator handle) :
+		node(std::move(node)),
+		handle(handle),
+		position(0)
+		{}
+
+		MemoryFile(const MemoryFile&) = delete;
+		MemoryFile(MemoryFile&&) = delete;
+		MemoryFile& operator = (const MemoryFile&) = delete;
+		MemoryFile& operator = (MemoryFile&&) = delete;
+
+		~MemoryFile()
+		{
+			std::lock_guard<std::mutex> lock(node->guard);
+			node->handles.erase(handle);
+		}
+
+	private:
+		std::shared_ptr<node_t> node;
+		const std::list<handle_t>::iterator handle;
+		uint64_t position;
+
+		size_t iread(const size_t size, void* buffer) override
+		{
+			std::lock_guard<std::mutex> lock(node->guard);
+			if(!handle->read)
+				throw KAA::system_failure { __FUNCTION__, "unable to read file", EBADF };
+			const auto available = position < node->data.size() ? node->data.size() - static_cast<size_t>(position) : 0U;
+			const auto bytes_read = std::min(size, available);
+			if(0 != bytes_read)
+				std::memcpy(buffer, &node->data[static_cast<size_t>(position)], bytes_read);
+			position += bytes_read;
+			return bytes_read;
+		}
+
+		size_t iwrite(const void* buffer, const size_t size) override
+		{
+			std::lock_guard<std::mutex> lock(node->guard);
+			if(!handle->write)
+				throw KAA::system_failure { __FUNCTION__, "unable to write file", EBADF };
+			if(0 == size)
+				return 0;
+			const auto end = static_cast<size_t>(position) + size;
+			if(node->data.size() < end)
+				node->data.resize(end, 0U); // KAA: a gap after a seek past the end reads as zeros.
+			std::memcpy(&node->data[static_cast<size_t>(position)], buffer, size);
+			++node->write_count;
+			++node->change_count;
+			position = end;
+			return size;
+		}
+
+		_off_t iseek(const _off_t offset, const origin whence) override
+		{
+			int64_t base = 0;
+			if(current == whence)
+				base = static_cast<int64_t>(position);
+			else if(end == whence)
+				base = static_cast<int64_t>(iget_size());
+			if(base + offset < 0)
+				throw KAA::system_failure { __FUNCTION__, "unable to seek file", EINVAL };
+			position = static_cast<uint64_t>(base + offset);
+			return static_cast<_off_t>(position);
+		}
+
+		_off_t itell(void) const override
+		{
+			return static_cast<_off_t>(position);
+		}
+
+		size_t iget_size(void) const override
+		{
+			std::lock_guard<std::mutex> lock(node->guard);
+			return node->data.size();
+		}
+
+		void icommit(void) override
+		{}
+	};
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		struct MemoryFileSystem::volume_t
+		{
+			std::mutex guard; // NOTE: names; taken before the guard of a file.
+			std::map<std::wstring, std::shared_ptr<node_t>> files;
+			std::set<std::wstring> directories;
+			filesystem::path::directory current_directory;
+			unsigned long temp_names;
+			uint32_t serial_number;
+			uint64_t file_indices;
+
+			bool DirectoryExists(const std::wstring& key) const
+			{
+				return IsRoot(key) || ( 0 != directories.count(key) );
+			}
+
+			bool Exists(const std::wstring& key) const
+			{
+				return ( 0 != files.count(key) ) || DirectoryExists(key);
+			}
+
+			std::shared_ptr<node_t> Find(const std::wstring& key, const char* source) const
+			{
+				const auto file = files.find(key);
+				if(files.end() == file)
+					throw system_failure { source, "file not found", ENOENT };
+				return file->second;
+			}
+
+			std::unique_ptr<filesystem::file> Open(std::shared_ptr<node_t> node, const driver::mode& mode, const driver::share& share, const char* source) const
+			{
+				const handle_t request = { mode.read, mode.write, share.read, share.write };
+				std::lock_guard<std::mutex> lock(node->guard);
+				if(!IsShared(node->handles, request))
+					throw system_failure { source, "file is used by another handle", EACCES }; // KAA: sharing violation as the CRT reports it.
+				const auto handle = node->handles.insert(node->handles.end(), request);
+				return std::make_unique<MemoryFile>(std::move(node), handle);
+			}
+		};
+
+		MemoryFileSystem::MemoryFileSystem() :
+		volume(std::make_unique<volume_t>())
+		{
+			volume->current_directory = filesystem::path::directory { L"C:\\" };
+			volume->temp_names = 0;
+			static std::atomic<uint32_t> serial_numbers { 0 };
+			volume->serial_number = ++serial_numbers;
+			volume->file_indices = 0;
+		}
+
+		MemoryFileSystem::~MemoryFileSystem() = default;
+
+		// NOTE: the kernel creates files that do not exist only, create mode is not taken into account.
+		// The creating handle may write the file even if it has been created read-only.
+		// NOTE: creates new files only; other create modes (truncating or opening an existing file) throw std::invalid_argument.
+		std::unique_ptr<filesystem::file> MemoryFileSystem::icreate_file(const filesystem::path::file& path, const create_mode creation, const mode mode, const share share, const permission permission) const
+		{
+			if(!IsCreateNew(creation))
+				throw std::invalid_argument { "memory file system creates new files only" };
+			const auto key = GetKey(path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			if(volume->Exists(key))
+				throw system_failure { __FUNCTION__, "file already exists", EEXIST };
+			if(!volume->DirectoryExists(GetParentKey(key)))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			auto node = std::make_shared<node_t>(!permission.write, ++volume->file_indices);
+			volume->files.emplace(key, node);
+			return volume->Open(std::move(node), mode, share, __FUNCTION__);
+		}
+
+		// NOTE: times are counters: of writes and of changes.
+		bool MemoryFileSystem::IQueryFileInformation(const filesystem::path::file& path, file_information_t& information) const
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			const auto file = volume->files.find(GetKey(path.to_wstring()));
+			if(volume->files.end() == file)
+				return false;
+			std::lock_guard<std::mutex> file_lock(file->second->guard);
+			information.volume_serial_number = volume->serial_number;
+			information.file_index = file->second->index;
+			information.size = file->second->data.size();
+			information.last_write_time = file->second->write_count;
+			information.change_time = file->second->change_count;
+			return true;
+		}
+
+		std::unique_ptr<filesystem::file> MemoryFileSystem::iopen_file(const filesystem::path::file& path, const mode mode, const share share) const
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			auto node = volume->Find(GetKey(path.to_wstring()), __FUNCTION__);
+			if(mode.write && node->read_only)
+				throw system_failure { __FUNCTION__, "file is read-only", EACCES };
+			return volume->Open(std::move(node), mode, share, __FUNCTION__);
+		}
+
+		void MemoryFileSystem::iremove_file(const filesystem::path::file& path)
+		{
+			const auto key = GetKey(path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			const auto node = volume->Find(key, __FUNCTION__);
+			{
+				std::lock_guard<std::mutex> file_lock(node->guard);
+				if(node->read_only || !node->handles.empty())
+					throw system_failure { __FUNCTION__, "unable to remove file", EACCES };
+			}
+			volume->files.erase(key);
+		}
+
+		void MemoryFileSystem::irename_file(const filesystem::path::file& old_path, const filesystem::path::file& new_path)
+		{
+			const auto old_key = GetKey(old_path.to_wstring());
+			const auto new_key = GetKey(new_path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			const auto node = volume->Find(old_key, __FUNCTION__);
+			if(old_key == new_key)
+				return;
+			if(volume->Exists(new_key))
+				throw system_failure { __FUNCTION__, "file already exists", EEXIST };
+			if(!volume->DirectoryExists(GetParentKey(new_key)))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			{
+				std::lock_guard<std::mutex> file_lock(node->guard);
+				if(!node->handles.empty())
+					throw system_failure { __FUNCTION__, "unable to rename file", EACCES };
+			}
+			volume->files.erase(old_key);
+			volume->files.emplace(new_key, node);
+		}
+
+		// NOTE: a file is either read-only or not, write only permission leaves it writable.
+		void MemoryFileSystem::iset_file_permissions(const filesystem::path::file& path, const permission permission)
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			const auto node = volume->Find(GetKey(path.to_wstring()), __FUNCTION__);
+			std::lock_guard<std::mutex> file_lock(node->guard);
+			node->read_only = !permission.write;
+			++node->change_count;
+		}
+
+		bool MemoryFileSystem::icheck_access(const filesystem::path::file& path, const access_mode mode) const
+		{
+			const auto key = GetKey(path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			const auto file = volume->files.find(key);
+			if(volume->files.end() == file)
+				return volume->DirectoryExists(key);
+			if(( write == mode ) || ( read_write == mode ))
+			{
+				std::lock_guard<std::mutex> file_lock(file->second->guard);
+				return !file->second->read_only;
+			}
+			return true;
+		}
+
+		// NOTE: relative paths are not resolved against the current directory, they are names of their own.
+		filesystem::path::directory MemoryFileSystem::iget_current_working_directory(void) const
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			return volume->current_directory;
+		}
+
+		void MemoryFileSystem::iset_current_working_directory(const filesystem::path::directory& path)
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			if(!volume->DirectoryExists(GetKey(path.to_wstring())))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			volume->current_directory = path;
+		}
+
+		// RETURNS: name of a file that does not exist in the directory, the file is not created.
+		filesystem::path::file MemoryFileSystem::iget_temp_filename(const filesystem::path::directory& path) const
+		{
+			std::lock_guard<std::mutex> lock(volume->guard);
+			if(!volume->DirectoryExists(GetKey(path.to_wstring())))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			for(;;)
+			{
+				std::wostringstream name;
+				name << L"fs" << std::hex << std::setw(6) << std::setfill(L'0') << ++volume->temp_names << L".tmp";
+				auto temp_path = path + name.str();
+				if(!volume->Exists(GetKey(temp_path.to_wstring())))
+					return temp_path;
+			}
+		}
+
+		void MemoryFileSystem::icreate_directory(const filesystem::path::directory& path)
+		{
+			const auto key = GetKey(path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			if(volume->Exists(key))
+				throw system_failure { __FUNCTION__, "directory already exists", EEXIST };
+			if(!volume->DirectoryExists(GetParentKey(key)))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			volume->directories.insert(key);
+		}
+
+		void MemoryFileSystem::iremove_directory(const filesystem::path::directory& path)
+		{
+			const auto key = GetKey(path.to_wstring());
+			std::lock_guard<std::mutex> lock(volume->guard);
+			if(0 == volume->directories.count(key))
+				throw system_failure { __FUNCTION__, "directory not found", ENOENT };
+			if(HasChildren(volume->files, volume->directories, key))
+				throw system_failure { __FUNCTION__, "directory is not empty", ENOTEMPTY };
+			volume->directories.erase(key);
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "KAA/include/filesystem/driver.h"
+
+#include "FileInformation.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: volume kept in memory, for tests and benchmarks free of disk noise. Follows the CRT driver on Windows:
+		// paths are case insensitive, open files cannot be removed or renamed, sharing violations and read-only files fail with EACCES.
+		// A file is created in an existing directory only and only if it does not exist, other create modes are not supported; drive roots and the current directory always exist.
+		// File information tells counters of writes and changes for times, the serial number is that of the driver.
+		class MemoryFileSystem final : public filesystem::driver, public FileInformationSource
+		{
+		public:
+			MemoryFileSystem();
+			MemoryFileSystem(const MemoryFileSystem&) = delete;
+			MemoryFileSystem(MemoryFileSystem&&) = delete;
+			~MemoryFileSystem();
+
+			MemoryFileSystem& operator = (const MemoryFileSystem&) = delete;
+			MemoryFileSystem& operator = (MemoryFileSystem&&) = delete;
+
+		private:
+			struct volume_t;
+			std::unique_ptr<volume_t> volume; // NOTE: open files keep their data, they may outlive the driver.
+
+			std::unique_ptr<filesystem::file> icreate_file(const filesystem::path::file&, create_mode, mode, share, permission) const override;
+			std::unique_ptr<filesystem::file> iopen_file(const filesystem::path::file&, mode, share) const override;
+			void iremove_file(const filesystem::path::file&) override;
+			void irename_file(const filesystem::path::file& old_path, const filesystem::path::file& new_path) override;
+			void iset_file_permissions(const filesystem::path::file&, permission) override;
+			bool icheck_access(const filesystem::path::file&, access_mode) const override;
+
+			filesystem::path::directory iget_current_working_directory(void) const override;
+			void iset_current_working_directory(const filesystem::path::directory&) override;
+			filesystem::path::file iget_temp_filename(const filesystem::path::directory&) const override;
+			void icreate_directory(const filesystem::path::directory&) override;
+			void iremove_directory(const filesystem::path::directory&) override;
+
+			bool IQueryFileInformation(const filesystem::path::file&, file_information_t&) const override;
+		};
+	}
+}
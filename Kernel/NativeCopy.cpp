@@ -0,0 +1,210 @@
+#include "NativeCopy.h"
+
+#include <algorithm>
+
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+
+#include "CancellationToken.h"
+#include "NativeFileSystem.h"
+
+#include <windows.h>
+#include <winioctl.h>
+
+namespace
+{
+	constexpr uint64_t clone_range_size = 1024U * 1024U * 1024U; // 1 GiB : a single request has to stay below 4 GiB.
+
+	class Handle final
+	{
+	public:
+		explicit Handle(const HANDLE handle) :
+		handle(handle)
+		{}
+
+		Handle(const Handle&) = delete;
+		Handle& operator = (const Handle&) = delete;
+
+		~Handle()
+		{
+			if(INVALID_HANDLE_VALUE != handle)
+				::CloseHandle(handle);
+		}
+
+		HANDLE get(void) const
+		{
+			return handle;
+		}
+
+		bool valid(void) const
+		{
+			return INVALID_HANDLE_VALUE != handle;
+		}
+
+	private:
+		HANDLE handle;
+	};
+
+	bool SupportsBlockCloning(const HANDLE file)
+	{
+		DWORD flags = 0;
+		return ( 0 != ::GetVolumeInformationByHandleW(file, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0) ) && ( 0 != ( flags & FILE_SUPPORTS_BLOCK_REFCOUNTING ) );
+	}
+
+	// NOTE: progress gets the bytes of the file every range covers, throws OperationCancelled if it returns cancel or stop.
+	bool Clone(const HANDLE source, const HANDLE destination, const std::function<KAA::progress_state_t(uint64_t)>& progress)
+	{
+		BY_HANDLE_FILE_INFORMATION information = { 0 };
+		if(0 == ::GetFileInformationByHandle(source, &information))
+			return false;
+
+		DWORD bytes_returned = 0;
+		if(0 != ( information.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE ))
+		{
+			if(0 == ::DeviceIoControl(destination, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &bytes_returned, nullptr))
+				return false;
+		}
+
+		FSCTL_GET_INTEGRITY_INFORMATION_BUFFER integrity = { 0 };
+		if(0 == ::DeviceIoControl(source, FSCTL_GET_INTEGRITY_INFORMATION, nullptr, 0, &integrity, sizeof(integrity), &bytes_returned, nullptr))
+			return false;
+
+		// KAA: destination has to be allocated up front, ranges are whole clusters - the last one may pass the end of file.
+		const uint64_t size = ( static_cast<uint64_t>(information.nFileSizeHigh) << 32 ) | information.nFileSizeLow;
+		FILE_END_OF_FILE_INFO end_of_file = { 0 };
+		end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+		if(0 == ::SetFileInformationByHandle(destination, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+			return false;
+
+		const uint64_t cluster_size = integrity.ClusterSizeInBytes;
+		const auto clone_size = ( size + cluster_size - 1 ) / cluster_size * cluster_size;
+		for(uint64_t offset = 0; offset < clone_size; offset += clone_range_size)
+		{
+			DUPLICATE_EXTENTS_DATA extents = { 0 };
+			extents.FileHandle = source;
+			extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+			extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+			extents.ByteCount.QuadPart = static_cast<LONGLONG>(std::min(clone_range_size, clone_size - offset));
+			if(0 == ::DeviceIoControl(destination, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents), nullptr, 0, &bytes_returned, nullptr))
+			{
+				// KAA: the volume clones, a range failing later is an I/O error: the ranges cloned have been reported already, a copy would report them again.
+				if(0 == offset)
+					return false;
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to clone file range", error };
+			}
+			const auto progress_state = progress(std::min(clone_range_size, size - offset));
+			if(( KAA::progress_state_t::cancel == progress_state ) || ( KAA::progress_state_t::stop == progress_state ))
+				throw KAA::FileSecurity::OperationCancelled();
+		}
+		return true;
+	}
+
+	struct copy_progress_t
+	{
+		const std::function<KAA::progress_state_t(uint64_t)>* progress;
+		uint64_t reported;
+		bool cancelled;
+	};
+
+	DWORD CALLBACK CopyProgressRoutine(LARGE_INTEGER, const LARGE_INTEGER transferred, LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD, HANDLE, HANDLE, LPVOID context)
+	{
+		auto& state = *static_cast<copy_progress_t*>(context);
+		const auto total = static_cast<uint64_t>(transferred.QuadPart);
+		if(total > state.reported)
+		{
+			const auto progress_state = (*state.progress)(total - state.reported);
+			state.reported = total;
+			if(( KAA::progress_state_t::cancel == progress_state ) || ( KAA::progress_state_t::stop == progress_state ))
+			{
+				state.cancelled = true;
+				return PROGRESS_CANCEL; // KAA: the system deletes the destination.
+			}
+		}
+		return PROGRESS_CONTINUE;
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		bool CloneFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const std::function<progress_state_t(uint64_t)>& progress)
+		{
+			const Handle source(::CreateFileW(source_path.to_wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+			if(!source.valid() || !SupportsBlockCloning(source.get()))
+				return false;
+
+			auto cloned = false;
+			try
+			{
+				const Handle destination(::CreateFileW(destination_path.to_wstring().c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr));
+				if(!destination.valid())
+					return false;
+				cloned = Clone(source.get(), destination.get(), progress);
+			}
+			catch(...)
+			{
+				::DeleteFileW(destination_path.to_wstring().c_str());
+				throw;
+			}
+			if(!cloned)
+				::DeleteFileW(destination_path.to_wstring().c_str());
+			return cloned;
+		}
+
+		bool SystemCopyFile(const filesystem::path::file& source, const filesystem::path::file& destination, const std::function<progress_state_t(uint64_t)>& progress)
+		{
+			copy_progress_t state = { &progress, 0, false };
+			if(0 == ::CopyFileExW(source.to_wstring().c_str(), destination.to_wstring().c_str(), CopyProgressRoutine, &state, nullptr, 0))
+			{
+				::DeleteFileW(destination.to_wstring().c_str());
+				if(state.cancelled)
+					throw OperationCancelled();
+				return false;
+			}
+			// KAA: the system copies attributes as well, the backup has to stay writable to be wiped.
+			::SetFileAttributesW(destination.to_wstring().c_str(), FILE_ATTRIBUTE_NORMAL);
+			return true;
+		}
+
+		filesystem::path::file ReplaceOriginal(filesystem::driver& filesystem, const filesystem::path::file& path, const filesystem::path::file& replacement)
+		{
+			auto previous = filesystem.get_temp_filename(path.get_directory());
+			if(IsWindowsFileSystem(&filesystem))
+			{
+				// KAA: a single call, the replacement keeps attributes and ACL of the original.
+				if(0 == ::ReplaceFileW(path.to_wstring().c_str(), replacement.to_wstring().c_str(), previous.to_wstring().c_str(), REPLACEFILE_IGNORE_MERGE_ERRORS | REPLACEFILE_IGNORE_ACL_ERRORS, nullptr, nullptr))
+				{
+					const auto error = ::GetLastError();
+					// KAA: the original has been moved to the backup name already, but the replacement has not taken its place.
+					if(ERROR_UNABLE_TO_MOVE_REPLACEMENT_2 == error)
+						::MoveFileExW(previous.to_wstring().c_str(), path.to_wstring().c_str(), 0);
+					throw windows_api_failure { __FUNCTION__, "unable to replace file", error };
+				}
+				return previous;
+			}
+
+			// KAA: other drivers have no atomic replace, two renames are done.
+			filesystem.rename_file(path, previous);
+			try
+			{
+				filesystem.rename_file(replacement, path);
+			}
+			catch(...)
+			{
+				try
+				{
+					filesystem.rename_file(previous, path);
+				}
+				catch(...)
+				{
+					// KAA: the previous content stays under its temporary name, the caller learns why the replace failed.
+				}
+				throw;
+			}
+			return previous;
+		}
+	}
+}
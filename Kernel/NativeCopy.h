@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "KAA/include/progress_state.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+
+		namespace path
+		{
+			class file;
+		}
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: copy fast paths for local files, progress receives the number of bytes copied since the previous call.
+		// RETURNS: false if the path does not apply, the destination is left absent then and a buffered copy has to be done.
+
+		// NOTE: copy-on-write block clone (ReFS), only metadata is written; progress is reported per cloned range (1 GiB).
+		// Throws OperationCancelled if progress returns cancel or stop, windows_api_failure if a range fails after the first one; the destination is left absent.
+		bool CloneFile(const filesystem::path::file& source, const filesystem::path::file& destination, const std::function<progress_state_t(uint64_t)>& progress);
+		// NOTE: copy done by the system, no user-space buffer; offloaded to the server on SMB shares.
+		// Throws OperationCancelled if progress returns cancel or stop, the destination is left absent.
+		bool SystemCopyFile(const filesystem::path::file& source, const filesystem::path::file& destination, const std::function<progress_state_t(uint64_t)>& progress);
+
+		// NOTE: replacement takes the place of path, the previous content is kept under the returned name;
+		// the previous content is put back if the replacement cannot take its place.
+		// Windows drivers replace in one ReplaceFileW call, other drivers rename twice.
+		filesystem::path::file ReplaceOriginal(filesystem::driver&, const filesystem::path::file& path, const filesystem::path::file& replacement);
+	}
+}
@@ -0,0 +1,150 @@
+#include "NativeFile.h"
+
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/path.h"
+
+#include <windows.h>
+
+namespace
+{
+	class Event final
+	{
+	public:
+		Event() :
+		event(::CreateEventW(nullptr, TRUE, FALSE, nullptr))
+		{
+			if(nullptr == event)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to create event", error };
+			}
+		}
+
+		Event(const Event&) = delete;
+		Event& operator = (const Event&) = delete;
+
+		~Event()
+		{
+			::CloseHandle(event);
+		}
+
+		HANDLE get(void) const
+		{
+			return event;
+		}
+
+	private:
+		HANDLE event;
+	};
+
+	OVERLAPPED MakeOverlapped(const uint64_t offset, const HANDLE event)
+	{
+		OVERLAPPED position = { 0 };
+		position.Offset = static_cast<DWORD>(offset);
+		position.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		position.hEvent = event;
+		return position;
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		NativeFile::NativeFile(const filesystem::path::file& path, const access_t access, const io_t io) :
+		handle(INVALID_HANDLE_VALUE)
+		{
+			const DWORD desired_access = ( read_write == access ) ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+			constexpr DWORD exclusive_access = 0;
+			DWORD flags = FILE_ATTRIBUTE_NORMAL;
+			if(synchronous != io)
+				flags |= FILE_FLAG_OVERLAPPED;
+			if(unbuffered == io)
+				flags |= FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH;
+			handle = ::CreateFileW(path.to_wstring().c_str(), desired_access, exclusive_access, nullptr, OPEN_EXISTING, flags, nullptr);
+			if(INVALID_HANDLE_VALUE == handle)
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to open file", error };
+			}
+		}
+
+		NativeFile::~NativeFile()
+		{
+			::CloseHandle(handle);
+		}
+
+		uint64_t NativeFile::GetSize(void) const
+		{
+			LARGE_INTEGER size = { 0 };
+			if(0 == ::GetFileSizeEx(handle, &size))
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to retrieve file size", error };
+			}
+			return static_cast<uint64_t>(size.QuadPart);
+		}
+
+		void* NativeFile::GetHandle(void) const
+		{
+			return handle;
+		}
+
+		size_t NativeFile::ReadAt(const uint64_t offset, void* buffer, const size_t size) const
+		{
+			const Event completion;
+			auto position = MakeOverlapped(offset, completion.get());
+			DWORD bytes_read = 0;
+			if(0 == ::ReadFile(handle, buffer, static_cast<DWORD>(size), nullptr, &position))
+			{
+				const auto error = ::GetLastError();
+				if(ERROR_HANDLE_EOF == error)
+					return 0;
+				if(ERROR_IO_PENDING != error)
+					throw windows_api_failure { __FUNCTION__, "unable to read file", error };
+			}
+			if(0 == ::GetOverlappedResult(handle, &position, &bytes_read, TRUE))
+			{
+				const auto error = ::GetLastError();
+				if(ERROR_HANDLE_EOF == error)
+					return 0;
+				throw windows_api_failure { __FUNCTION__, "unable to read file", error };
+			}
+			return bytes_read;
+		}
+
+		size_t NativeFile::WriteAt(const uint64_t offset, const void* buffer, const size_t size) const
+		{
+			const Event completion;
+			auto position = MakeOverlapped(offset, completion.get());
+			DWORD bytes_written = 0;
+			if(0 == ::WriteFile(handle, buffer, static_cast<DWORD>(size), nullptr, &position))
+			{
+				const auto error = ::GetLastError();
+				if(ERROR_IO_PENDING != error)
+					throw windows_api_failure { __FUNCTION__, "unable to write file", error };
+			}
+			if(0 == ::GetOverlappedResult(handle, &position, &bytes_written, TRUE))
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to write file", error };
+			}
+			return bytes_written;
+		}
+
+		void NativeFile::ReadExactlyAt(const uint64_t offset, void* buffer, const size_t size) const
+		{
+			if(ReadAt(offset, buffer, size) != size)
+				throw windows_api_failure { __FUNCTION__, "unable to read file: the file is shorter than expected", ERROR_HANDLE_EOF };
+		}
+
+		void NativeFile::Flush(void) const
+		{
+			if(0 == ::FlushFileBuffers(handle))
+			{
+				const auto error = ::GetLastError();
+				throw windows_api_failure { __FUNCTION__, "unable to flush file buffers", error };
+			}
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		namespace path
+		{
+			class file;
+		}
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: exclusive Windows file handle for the code paths that cannot be expressed through filesystem::driver.
+		// Overlapped handles support concurrent positional reads and writes from several threads.
+		class NativeFile final
+		{
+		public:
+			enum access_t
+			{
+				read_only,
+				read_write
+			};
+
+			enum io_t
+			{
+				synchronous,
+				overlapped,
+				unbuffered // NOTE: overlapped, bypasses the system cache: offsets, sizes and buffers have to be sector aligned.
+			};
+
+			NativeFile(const filesystem::path::file&, access_t, io_t);
+			NativeFile(const NativeFile&) = delete;
+			NativeFile(NativeFile&&) = delete;
+			~NativeFile();
+
+			NativeFile& operator = (const NativeFile&) = delete;
+			NativeFile& operator = (NativeFile&&) = delete;
+
+			uint64_t GetSize(void) const;
+			void* GetHandle(void) const;
+
+			// NOTE: positional I/O, the file pointer is neither used nor updated; requires overlapped handle.
+			size_t ReadAt(uint64_t offset, void* buffer, size_t size) const;
+			size_t WriteAt(uint64_t offset, const void* buffer, size_t size) const;
+			// NOTE: throws if the file ends before size bytes have been read.
+			void ReadExactlyAt(uint64_t offset, void* buffer, size_t size) const;
+
+			// NOTE: writes data cached by the system to the disk.
+			void Flush(void) const;
+
+		private:
+			void* handle;
+		};
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "KAA/include/filesystem/driver.h"
+
+#include "FileInformation.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: filesystem driver on Windows file handles rather than the CRT, errors are reported with the errno the CRT driver would give.
+		// Handles get the cache hint of their mode: sequential scan, or random access. With unbuffered streams, sequential read-only and
+		// write-only handles bypass the system cache through a sector aligned buffer; they are the data, key and backup streams.
+		class NativeFileSystem final : public filesystem::driver, public FileInformationSource
+		{
+		public:
+			explicit NativeFileSystem(bool unbuffered_streams);
+			NativeFileSystem(const NativeFileSystem&) = delete;
+			NativeFileSystem(NativeFileSystem&&) = delete;
+			~NativeFileSystem() = default;
+
+			NativeFileSystem& operator = (const NativeFileSystem&) = delete;
+			NativeFileSystem& operator = (NativeFileSystem&&) = delete;
+
+		private:
+			const bool unbuffered_streams;
+
+			std::unique_ptr<filesystem::file> icreate_file(const filesystem::path::file&, create_mode, mode, share, permission) const override;
+			std::unique_ptr<filesystem::file> iopen_file(const filesystem::path::file&, mode, share) const override;
+			void iremove_file(const filesystem::path::file&) override;
+			void irename_file(const filesystem::path::file& old_path, const filesystem::path::file& new_path) override;
+			void iset_file_permissions(const filesystem::path::file&, permission) override;
+			bool icheck_access(const filesystem::path::file&, access_mode) const override;
+
+			filesystem::path::directory iget_current_working_directory(void) const override;
+			void iset_current_working_directory(const filesystem::path::directory&) override;
+			filesystem::path::file iget_temp_filename(const filesystem::path::directory&) const override;
+			void icreate_directory(const filesystem::path::directory&) override;
+			void iremove_directory(const filesystem::path::directory&) override;
+
+			bool IQueryFileInformation(const filesystem::path::file&, file_information_t&) const override;
+		};
+
+		// NOTE: reserves room for a file about to be written: the volume allocates it at once rather than on every write.
+		// A hint only, files of other drivers and volumes refusing it are left as they are.
+		void PreallocateFile(filesystem::file&, uint64_t size);
+
+		// NOTE: writes the tail an unbuffered stream keeps in its buffer, a failure is reported rather than lost on close; the file is not flushed to the disk.
+		// Files of other drivers are written through already, they are left as they are.
+		void FinishFile(filesystem::file&);
+
+		// RETURNS: true if paths of the driver are files of Windows volumes: native code paths apply to them.
+		bool IsWindowsFileSystem(const filesystem::driver*);
+
+		// NOTE: information of a file of a Windows volume, for the drivers of Windows volumes that do not tell it themselves (CRT).
+		// RETURNS: false if the path does not name a file or the volume does not tell its information.
+		bool QueryWindowsFileInformation(const filesystem::path::file&, file_information_t&);
+	}
+}
@@ -0,0 +1,1084 @@
+#include "PackedKeyStorage.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include <windows.h>
+
+#include "KeyPathDigest.h"
+#include "LooseKeyFiles.h"
+#include "NativeFileSystem.h"
+
+namespace
+{
+	constexpr auto index_name = L"keys.index";
+	constexpr auto pending_index_name = L"keys.index.new";
+	constexpr uint32_t index_signature = 0x494B5346; // KAA: 'FSKI'
+	constexpr uint64_t compaction_threshold = 64U * 1024U * 1024U; // 64 MiB of removed keys
+	constexpr size_t copy_chunk_size = 4U * 1024U * 1024U; // 4 MiB
+
+	const KAA::filesystem::driver::create_mode persistent_not_exists;
+	const KAA::filesystem::driver::mode sequential_read_only(false, true);
+	const KAA::filesystem::driver::mode sequential_write_only(true, false);
+	const KAA::filesystem::driver::mode random_read_write(true, true, true, true);
+	const KAA::filesystem::driver::share exclusive_access(false, false);
+	const KAA::filesystem::driver::share share_all(true, true); // KAA: the container is read, appended and wiped by several handles at once.
+	const KAA::filesystem::driver::permission allow_read_write;
+
+	enum class record_t : uint8_t
+	{
+		stored = 0x01,
+		removed = 0x02
+	};
+
+	class Handle final
+	{
+	public:
+		explicit Handle(const HANDLE handle) :
+		handle(handle)
+		{}
+
+		Handle(const Handle&) = delete;
+		Handle& operator = (const Handle&) = delete;
+
+		~Handle()
+		{
+			if(INVALID_HANDLE_VALUE != handle)
+				::CloseHandle(handle);
+		}
+
+		HANDLE get(void) const
+		{
+			return handle;
+		}
+
+		bool valid(void) const
+		{
+			return INVALID_HANDLE_VALUE != handle;
+		}
+
+	private:
+		HANDLE handle;
+	};
+
+	class FileMapping final
+	{
+	public:
+		explicit FileMapping(const HANDLE file) :
+		mapping(::CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr))
+		{
+			if(nullptr == mapping)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to create key container mapping", error };
+			}
+		}
+
+		FileMapping(const FileMapping&) = delete;
+		FileMapping& operator = (const FileMapping&) = delete;
+
+		~FileMapping()
+		{
+			::CloseHandle(mapping);
+		}
+
+		HANDLE get(void) const
+		{
+			return mapping;
+		}
+
+	private:
+		HANDLE mapping;
+	};
+
+	class MappedView final
+	{
+	public:
+		MappedView(const FileMapping& mapping, const uint64_t offset, const size_t size) :
+		view(::MapViewOfFile(mapping.get(), FILE_MAP_READ, static_cast<DWORD>(offset >> 32), static_cast<DWORD>(offset), size))
+		{
+			if(nullptr == view)
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to map view of key container", error };
+			}
+		}
+
+		MappedView(const MappedView&) = delete;
+		MappedView& operator = (const MappedView&) = delete;
+
+		~MappedView()
+		{
+			::UnmapViewOfFile(view);
+		}
+
+		const uint8_t* get(void) const
+		{
+			return static_cast<const uint8_t*>(view);
+		}
+
+	private:
+		void* view;
+	};
+
+	// KAA: a view has to start at a multiple of the allocation granularity.
+	uint64_t GetWindowSize(void)
+	{
+		constexpr uint64_t preferred_window_size = 64U * 1024U * 1024U; // 64 MiB
+		SYSTEM_INFO system = { 0 };
+		::GetSystemInfo(&system);
+		const uint64_t granularity = system.dwAllocationGranularity;
+		return std::max(granularity, preferred_window_size - preferred_window_size % granularity);
+	}
+
+	// RETURNS: name of the key inside of the container - file name of its key path.
+	std::wstring GetKeyName(const KAA::filesystem::path::file& key_path)
+	{
+		const auto path = key_path.to_wstring();
+		const auto separator = path.find_last_of(L"\\/");
+		return std::wstring::npos == separator ? path : path.substr(separator + 1);
+	}
+
+	// NOTE: a key handed out by LoadKey is a temporary copy unless the key is stored as a file on its own; a stream of the key comes back as its key path.
+	bool IsExtracted(const KAA::filesystem::path::file& key_path, const KAA::filesystem::path::file& key_file)
+	{
+		return key_file.to_wstring() != key_path.to_wstring();
+	}
+
+	bool Exists(const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		return filesystem.check_access(path, KAA::filesystem::driver::existence);
+	}
+
+	std::unique_ptr<KAA::filesystem::file> OpenForAppend(const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		if(!Exists(filesystem, path))
+			return filesystem.create_file(path, persistent_not_exists, random_read_write, share_all, allow_read_write);
+		auto file = filesystem.open_file(path, random_read_write, share_all);
+		file->seek(0, KAA::filesystem::file::end);
+		return file;
+	}
+
+	// NOTE: the offset of a driver seek is a long: positions past 2 GiB are reached in steps.
+	void SeekTo(KAA::filesystem::file& file, uint64_t offset)
+	{
+		constexpr auto max_step = static_cast<uint64_t>(std::numeric_limits<_off_t>::max());
+		file.seek(0, KAA::filesystem::file::set);
+		for(; 0 != offset; offset -= std::min(offset, max_step))
+			file.seek(static_cast<_off_t>(std::min(offset, max_step)), KAA::filesystem::file::current);
+	}
+
+	void Write(KAA::filesystem::file& file, const void* data, const size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		for(size_t left = size; 0 != left;)
+		{
+			const auto portion = std::min(left, copy_chunk_size);
+			if(file.write(bytes, portion) != portion)
+				throw KAA::system_failure { __FUNCTION__, "unable to write key container", EIO };
+			bytes += portion;
+			left -= portion;
+		}
+	}
+
+	// RETURNS: bytes read, less than requested only at the end of the file.
+	size_t Read(KAA::filesystem::file& file, void* data, const size_t size)
+	{
+		auto bytes = static_cast<uint8_t*>(data);
+		size_t total = 0;
+		for(size_t bytes_read = 1; ( total < size ) && ( 0 != bytes_read ); total += bytes_read)
+			bytes_read = file.read(size - total, bytes + total);
+		return total;
+	}
+
+	// RETURNS: bytes copied from the current position of the source to the current position of the destination.
+	uint64_t Copy(KAA::filesystem::file& from, KAA::filesystem::file& to, const uint64_t size, std::vector<uint8_t>& buffer)
+	{
+		uint64_t copied = 0;
+		while(copied < size)
+		{
+			const auto portion = static_cast<size_t>(std::min<uint64_t>(size - copied, buffer.size()));
+			const auto bytes_read = Read(from, buffer.data(), portion);
+			if(bytes_read != portion)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "key container is truncated";
+				constexpr auto reason = KAA::operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = KAA::operation_failure::severity_t::error;
+				throw KAA::operation_failure(source, description, reason, severity);
+			}
+			Write(to, buffer.data(), bytes_read);
+			copied += bytes_read;
+		}
+		return copied;
+	}
+
+	void Overwrite(KAA::filesystem::file& file, const uint64_t offset, const uint64_t size)
+	{
+		const std::vector<uint8_t> zeros(static_cast<size_t>(std::min<uint64_t>(size, copy_chunk_size)), 0);
+		SeekTo(file, offset);
+		for(uint64_t left = size; 0 != left;)
+		{
+			const auto portion = static_cast<size_t>(std::min<uint64_t>(left, zeros.size()));
+			Write(file, zeros.data(), portion);
+			left -= portion;
+		}
+	}
+
+	template <typename T>
+	void Append(std::vector<uint8_t>& data, const T& value)
+	{
+		const auto bytes = reinterpret_cast<const uint8_t*>(&value);
+		data.insert(data.end(), bytes, bytes + sizeof(value));
+	}
+
+	template <typename T>
+	T Extract(const uint8_t*& data)
+	{
+		T value;
+		std::memcpy(&value, data, sizeof(value));
+		data += sizeof(value);
+		return value;
+	}
+
+	// NOTE: index header: signature, generation of the container; index record: type, key name length in characters, key name, offset, length.
+	constexpr size_t header_size = 2 * sizeof(uint32_t);
+	constexpr size_t record_header_size = sizeof(uint8_t) + sizeof(uint16_t);
+
+	std::vector<uint8_t> MakeHeader(const uint32_t generation)
+	{
+		std::vector<uint8_t> data;
+		Append(data, index_signature);
+		Append(data, generation);
+		return data;
+	}
+
+	std::vector<uint8_t> MakeRecord(const record_t type, const std::wstring& name, const uint64_t offset, const uint64_t length)
+	{
+		std::vector<uint8_t> data;
+		Append(data, static_cast<uint8_t>(type));
+		Append(data, static_cast<uint16_t>(name.length()));
+		const auto characters = reinterpret_cast<const uint8_t*>(name.data());
+		data.insert(data.end(), characters, characters + name.length() * sizeof(wchar_t));
+		Append(data, offset);
+		Append(data, length);
+		return data;
+	}
+
+	void AppendIndex(const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const uint32_t generation, const std::vector<uint8_t>& record)
+	{
+		const auto index = OpenForAppend(filesystem, path);
+		if(0 == index->get_size())
+		{
+			const auto header = MakeHeader(generation);
+			Write(*index, header.data(), header.size());
+		}
+		Write(*index, record.data(), record.size());
+		index->commit();
+	}
+
+	void RemoveIfExists(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		if(Exists(filesystem, path))
+			KAA::FileSecurity::RemoveKeyFile(filesystem, path);
+	}
+
+	// NOTE: tells the container its stream is closed; kept by the base of a key stream, so that the container file is closed by then.
+	class StreamGuard final
+	{
+	public:
+		explicit StreamGuard(std::function<void()> closed) :
+		closed(std::move(closed))
+		{}
+
+		StreamGuard(const StreamGuard&) = delete;
+		StreamGuard& operator = (const StreamGuard&) = delete;
+
+		~StreamGuard()
+		{
+			closed();
+		}
+
+	private:
+		const std::function<void()> closed;
+	};
+
+	// NOTE: read-only stream of a key: a range of the container, positions are relative to the key.
+	class KeyStream : public KAA::filesystem::file
+	{
+	public:
+		KeyStream(std::unique_ptr<StreamGuard> guard, const uint64_t offset, const uint64_t length) :
+		offset(offset),
+		length(length),
+		position(0),
+		guard(std::move(guard))
+		{}
+
+	protected:
+		const uint64_t offset;
+		const uint64_t length;
+		uint64_t position;
+
+		// RETURNS: bytes of the key left from the current position, as many as requested at most.
+		size_t GetBytesToRead(const size_t size) const
+		{
+			return static_cast<size_t>(std::min<uint64_t>(size, position < length ? length - position : 0));
+		}
+
+	private:
+		const std::unique_ptr<StreamGuard> guard;
+
+		size_t iwrite(const void*, size_t) override
+		{
+			throw KAA::system_failure { __FUNCTION__, "unable to write key stream", EBADF };
+		}
+
+		_off_t iseek(const _off_t distance, const origin whence) override
+		{
+			int64_t base = 0;
+			if(current == whence)
+				base = static_cast<int64_t>(position);
+			else if(end == whence)
+				base = static_cast<int64_t>(length);
+			if(base + distance < 0)
+				throw KAA::system_failure { __FUNCTION__, "unable to seek key stream", EINVAL };
+			position = static_cast<uint64_t>(base + distance);
+			Moved();
+			return static_cast<_off_t>(position);
+		}
+
+		_off_t itell(void) const override
+		{
+			return static_cast<_off_t>(position);
+		}
+
+		size_t iget_size(void) const override
+		{
+			return static_cast<size_t>(length);
+		}
+
+		void icommit(void) override
+		{}
+
+		// NOTE: the position has been changed by a seek.
+		virtual void Moved(void)
+		{}
+	};
+
+	// NOTE: reads the key through views of the container mapping, a window at a time.
+	class MappedKeyStream final : public KeyStream
+	{
+	public:
+		MappedKeyStream(std::unique_ptr<StreamGuard> guard, const KAA::filesystem::path::file& path, const uint64_t offset, const uint64_t length) :
+		KeyStream(std::move(guard), offset, length),
+		container(::CreateFileW(path.to_wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)),
+		mapping(OpenMapping(container)),
+		window_size(GetWindowSize()),
+		window(0),
+		window_length(0)
+		{}
+
+	private:
+		const Handle container;
+		const std::unique_ptr<FileMapping> mapping;
+		const uint64_t window_size;
+		std::unique_ptr<MappedView> view;
+		uint64_t window;
+		uint64_t window_length;
+
+		static std::unique_ptr<FileMapping> OpenMapping(const Handle& container)
+		{
+			if(!container.valid())
+			{
+				const auto error = ::GetLastError();
+				throw KAA::windows_api_failure { __FUNCTION__, "unable to open key container", error };
+			}
+			return std::make_unique<FileMapping>(container.get());
+		}
+
+		size_t iread(const size_t size, void* buffer) override
+		{
+			const auto bytes_to_read = GetBytesToRead(size);
+			auto bytes = static_cast<uint8_t*>(buffer);
+			for(size_t bytes_read = 0; bytes_read < bytes_to_read;)
+			{
+				const auto at = offset + position;
+				if(( nullptr == view ) || ( at < window ) || ( at >= window + window_length ))
+				{
+					view.reset();
+					window = at - at % window_size;
+					window_length = std::min(window + window_size, offset + length) - window;
+					view = std::make_unique<MappedView>(*mapping, window, static_cast<size_t>(window_length));
+				}
+				const auto portion = static_cast<size_t>(std::min<uint64_t>(bytes_to_read - bytes_read, window + window_length - at));
+				std::memcpy(bytes + bytes_read, view->get() + static_cast<size_t>(at - window), portion);
+				bytes_read += portion;
+				position += portion;
+			}
+			return bytes_to_read;
+		}
+	};
+
+	// NOTE: reads the key through the driver: files of other drivers cannot be mapped.
+	class DriverKeyStream final : public KeyStream
+	{
+	public:
+		DriverKeyStream(std::unique_ptr<StreamGuard> guard, const KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path, const uint64_t offset, const uint64_t length) :
+		KeyStream(std::move(guard), offset, length),
+		container(filesystem.open_file(path, sequential_read_only, share_all))
+		{
+			SeekTo(*container, offset);
+		}
+
+	private:
+		const std::unique_ptr<KAA::filesystem::file> container;
+
+		size_t iread(const size_t size, void* buffer) override
+		{
+			const auto bytes_read = Read(*container, buffer, GetBytesToRead(size));
+			position += bytes_read;
+			return bytes_read;
+		}
+
+		void Moved(void) override
+		{
+			SeekTo(*container, offset + std::min(position, length));
+		}
+	};
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		class PackedKeyStorage::Container final : public std::enable_shared_from_this<Container>
+		{
+		public:
+			Container(std::shared_ptr<filesystem::driver>, filesystem::path::directory);
+			Container(const Container&) = delete;
+			Container(Container&&) = delete;
+			~Container();
+
+			Container& operator = (const Container&) = delete;
+			Container& operator = (Container&&) = delete;
+
+			void StoreKey(const filesystem::path::file& key_file, const std::wstring& name);
+			bool ContainsKey(const std::wstring& name) const;
+			// RETURNS: stream of the key in the container, nullptr if the key is not there.
+			std::unique_ptr<filesystem::file> OpenKey(const std::wstring& name);
+			void RemoveKey(const std::wstring& name);
+			uint64_t Compact(void);
+
+		private:
+			struct entry_t
+			{
+				uint64_t offset;
+				uint64_t length;
+			};
+
+			const std::shared_ptr<filesystem::driver> m_filesystem;
+			const filesystem::path::directory directory;
+
+			struct readers_t
+			{
+				size_t streams;
+				bool retired; // KAA: compacted meanwhile, the container file is removed with the last stream.
+			};
+
+			// KAA: container_guard protects the index, append_guard serializes reservations of container ranges and the compaction.
+			// Code holding container_guard does not take append_guard.
+			mutable std::shared_timed_mutex container_guard;
+			std::mutex append_guard;
+			std::map<std::wstring, entry_t> index;
+			uint32_t generation;
+			uint64_t append_offset; // KAA: end of the reserved ranges, under append_guard.
+			uint64_t live_bytes;
+			uint64_t dead_bytes;
+
+			// KAA: keys are copied into their ranges without a lock held, the compaction waits for the copies in flight.
+			std::mutex writes_guard;
+			std::condition_variable writes_done;
+			size_t writes_in_flight;
+
+			std::mutex readers_guard;
+			std::map<uint32_t, readers_t> readers; // KAA: by generation of the container.
+
+			std::mutex compaction_guard;
+			std::thread compaction;
+			std::atomic<bool> compaction_running;
+
+			void LoadIndex(void);
+			void WriteFinished(void);
+			void CloseStream(uint32_t generation);
+			// NOTE: the compaction is done with the container of the generation.
+			void RetireContainer(uint32_t generation);
+			void StartCompaction(void);
+			void WaitForCompaction(void);
+			// NOTE: overwrites the key in the container of the generation, unless the container has been compacted meanwhile.
+			void WipeKey(uint32_t generation, const entry_t&) const;
+			filesystem::path::file GetContainerPath(uint32_t generation) const;
+			filesystem::path::file GetIndexPath(void) const;
+			filesystem::path::file GetPendingIndexPath(void) const;
+		};
+
+		PackedKeyStorage::PackedKeyStorage(std::unique_ptr<KeyStorage> storage, std::shared_ptr<filesystem::driver> driver) :
+		m_storage(std::move(storage)),
+		m_filesystem(std::move(driver))
+		{
+			if(!m_storage || !m_filesystem)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create packed key storage class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+			m_container = OpenContainer(m_filesystem, m_storage->GetPath());
+		}
+
+		uint64_t PackedKeyStorage::Compact(void)
+		{
+			return m_container->Compact();
+		}
+
+		void PackedKeyStorage::ISetPath(filesystem::path::directory path)
+		{
+			auto container = OpenContainer(m_filesystem, path);
+			m_storage->SetPath(std::move(path));
+			m_container.swap(container);
+		}
+
+		filesystem::path::directory PackedKeyStorage::IGetPath(void) const
+		{
+			return m_storage->GetPath();
+		}
+
+		filesystem::path::file PackedKeyStorage::IGetKeyPathForSpecifiedPath(const filesystem::path::file& path) const
+		{
+			return m_storage->GetKeyPathForSpecifiedPath(path);
+		}
+
+		std::shared_ptr<KeyPathDigest> PackedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			return m_storage->StartKeyPathDigest();
+		}
+
+		void PackedKeyStorage::IRememberKeyPath(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			m_storage->RememberKeyPath(path, key_path);
+		}
+
+		void PackedKeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			m_storage->SetCancellationToken(std::move(token));
+		}
+
+		void PackedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			m_container->StoreKey(key_file, GetKeyName(key_path));
+			RemoveKeyFile(*m_filesystem, key_file);
+		}
+
+		bool PackedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			if(m_container->ContainsKey(GetKeyName(key_path)))
+				return true;
+			return m_storage->ContainsKey(key_path); // KAA: keys stored as files before the container was introduced.
+		}
+
+		// NOTE: a copy for ciphers reading key files; a cipher reading key streams opens the key in place.
+		filesystem::path::file PackedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			const auto key = m_container->OpenKey(GetKeyName(key_path));
+			if(nullptr == key)
+				return m_storage->LoadKey(key_path);
+
+			auto key_file = m_filesystem->get_temp_filename(m_storage->GetPath());
+			try
+			{
+				const auto copy = m_filesystem->create_file(key_file, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+				std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(key->get_size(), copy_chunk_size)));
+				Copy(*key, *copy, key->get_size(), buffer);
+				copy->commit();
+			}
+			catch(...)
+			{
+				RemoveIfExists(*m_filesystem, key_file);
+				throw;
+			}
+			return key_file;
+		}
+
+		std::unique_ptr<filesystem::file> PackedKeyStorage::IOpenKey(const filesystem::path::file& key_path)
+		{
+			auto key = m_container->OpenKey(GetKeyName(key_path));
+			return nullptr == key ? m_storage->OpenKey(key_path) : std::move(key);
+		}
+
+		// NOTE: a key file that is the key path is either a stream of the container or a key stored as a file.
+		void PackedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			if(IsExtracted(key_path, key_file))
+				RemoveKeyFile(*m_filesystem, key_file);
+			else if(!m_container->ContainsKey(GetKeyName(key_path)))
+				m_storage->UnloadKey(key_path, key_file);
+		}
+
+		void PackedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			const auto name = GetKeyName(key_path);
+			if(IsExtracted(key_path, key_file))
+				RemoveKeyFile(*m_filesystem, key_file);
+			else if(!m_container->ContainsKey(name))
+				return m_storage->RemoveKey(key_path, key_file);
+			m_container->RemoveKey(name);
+		}
+
+		std::shared_ptr<PackedKeyStorage::Container> PackedKeyStorage::OpenContainer(std::shared_ptr<filesystem::driver> filesystem, const filesystem::path::directory& directory)
+		{
+			// KAA: the last instance of a container removes it from here once it is closed; until then the directory is not opened again.
+			using container_key_t = std::pair<const filesystem::driver*, std::wstring>;
+			static std::mutex registry_guard;
+			static std::condition_variable container_closed;
+			static std::map<container_key_t, std::weak_ptr<Container>> containers;
+
+			const container_key_t key(filesystem.get(), directory.to_wstring());
+			std::unique_lock<std::mutex> lock(registry_guard);
+			for(auto found = containers.find(key); containers.end() != found; found = containers.find(key))
+			{
+				if(auto container = found->second.lock())
+					return container;
+				container_closed.wait(lock);
+			}
+
+			const auto close = [key] (Container* container)
+			{
+				delete container;
+				std::lock_guard<std::mutex> lock(registry_guard);
+				containers.erase(key);
+				container_closed.notify_all();
+			};
+			std::shared_ptr<Container> container(new Container(std::move(filesystem), directory), close);
+			containers[key] = container;
+			return container;
+		}
+
+		PackedKeyStorage::Container::Container(std::shared_ptr<filesystem::driver> driver, filesystem::path::directory path) :
+		m_filesystem(std::move(driver)),
+		directory(std::move(path)),
+		generation(0),
+		append_offset(0),
+		live_bytes(0),
+		dead_bytes(0),
+		writes_in_flight(0),
+		compaction_running(false)
+		{
+			LoadIndex();
+		}
+
+		PackedKeyStorage::Container::~Container()
+		{
+			WaitForCompaction();
+		}
+
+		// NOTE: the range of the key is reserved under append_guard, the key is copied into it outside of the lock: keys are stored at once.
+		void PackedKeyStorage::Container::StoreKey(const filesystem::path::file& key_file, const std::wstring& name)
+		{
+			const auto key = m_filesystem->open_file(key_file, sequential_read_only, exclusive_access);
+			const uint64_t length = key->get_size();
+			uint32_t key_generation = 0;
+			uint64_t offset = 0;
+			{
+				std::lock_guard<std::mutex> append_lock(append_guard);
+				key_generation = generation; // KAA: generation changes under append_guard only.
+				const auto container_path = GetContainerPath(key_generation);
+				if(!Exists(*m_filesystem, container_path))
+					m_filesystem->create_file(container_path, persistent_not_exists, random_read_write, share_all, allow_read_write);
+				offset = append_offset;
+				append_offset += length;
+				std::lock_guard<std::mutex> lock(writes_guard);
+				++writes_in_flight;
+			}
+
+			bool superseded = false;
+			entry_t previous = { 0 };
+			try
+			{
+				{
+					const auto container = m_filesystem->open_file(GetContainerPath(key_generation), random_read_write, share_all);
+					SeekTo(*container, offset);
+					std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(length, copy_chunk_size)));
+					Copy(*key, *container, length, buffer);
+					container->commit(); // KAA: key data has to be durable before the index refers to it.
+				}
+
+				std::lock_guard<std::shared_timed_mutex> lock(container_guard);
+				AppendIndex(*m_filesystem, GetIndexPath(), key_generation, MakeRecord(record_t::stored, name, offset, length));
+				const auto entry = index.find(name);
+				if(index.end() != entry)
+				{
+					// KAA: the same content encrypted again: the older copy of the key is superseded.
+					superseded = true;
+					previous = entry->second;
+					live_bytes -= previous.length;
+					dead_bytes += previous.length;
+				}
+				index[name] = { offset, length };
+				live_bytes += length;
+			}
+			catch(...)
+			{
+				{
+					std::lock_guard<std::shared_timed_mutex> lock(container_guard);
+					dead_bytes += length; // KAA: the range stays unused until the compaction.
+				}
+				WriteFinished();
+				throw;
+			}
+			WriteFinished();
+			if(superseded)
+				WipeKey(key_generation, previous);
+		}
+
+		void PackedKeyStorage::Container::WriteFinished(void)
+		{
+			std::lock_guard<std::mutex> lock(writes_guard);
+			--writes_in_flight;
+			writes_done.notify_all();
+		}
+
+		bool PackedKeyStorage::Container::ContainsKey(const std::wstring& name) const
+		{
+			std::shared_lock<std::shared_timed_mutex> lock(container_guard);
+			return index.end() != index.find(name);
+		}
+
+		std::unique_ptr<filesystem::file> PackedKeyStorage::Container::OpenKey(const std::wstring& name)
+		{
+			std::shared_lock<std::shared_timed_mutex> lock(container_guard);
+			const auto found = index.find(name);
+			if(index.end() == found)
+				return nullptr;
+			const auto entry = found->second;
+			const auto key_generation = generation;
+			{
+				std::lock_guard<std::mutex> readers_lock(readers_guard);
+				++readers[key_generation].streams;
+			}
+
+			// KAA: the container the stream reads is not removed by a compaction until the stream is closed.
+			const auto self = shared_from_this();
+			auto guard = std::make_unique<StreamGuard>([self, key_generation] { self->CloseStream(key_generation); });
+			if(( 0 != entry.length ) && IsWindowsFileSystem(m_filesystem.get()))
+				return std::make_unique<MappedKeyStream>(std::move(guard), GetContainerPath(key_generation), entry.offset, entry.length);
+			return std::make_unique<DriverKeyStream>(std::move(guard), *m_filesystem, GetContainerPath(key_generation), entry.offset, entry.length);
+		}
+
+		void PackedKeyStorage::Container::CloseStream(const uint32_t key_generation)
+		{
+			std::lock_guard<std::mutex> lock(readers_guard);
+			auto& generation_readers = readers[key_generation];
+			if(( 0 != --generation_readers.streams ) || !generation_readers.retired)
+				return;
+			readers.erase(key_generation);
+			try
+			{
+				RemoveIfExists(*m_filesystem, GetContainerPath(key_generation));
+			}
+			catch(...)
+			{
+				// KAA: the next session removes what the compaction has left behind.
+			}
+		}
+
+		void PackedKeyStorage::Container::RetireContainer(const uint32_t container_generation)
+		{
+			std::lock_guard<std::mutex> lock(readers_guard);
+			const auto found = readers.find(container_generation);
+			if(( readers.end() != found ) && ( 0 != found->second.streams ))
+			{
+				found->second.retired = true;
+				return;
+			}
+			readers.erase(container_generation);
+			RemoveKeyFile(*m_filesystem, GetContainerPath(container_generation));
+		}
+
+		void PackedKeyStorage::Container::RemoveKey(const std::wstring& name)
+		{
+			entry_t removed = { 0 };
+			uint32_t removed_generation = 0;
+			bool compact = false;
+			{
+				std::lock_guard<std::shared_timed_mutex> lock(container_guard);
+				const auto entry = index.find(name);
+				if(index.end() == entry)
+					return;
+
+				AppendIndex(*m_filesystem, GetIndexPath(), generation, MakeRecord(record_t::removed, name, entry->second.offset, entry->second.length));
+				removed = entry->second;
+				removed_generation = generation;
+				live_bytes -= removed.length;
+				dead_bytes += removed.length;
+				index.erase(entry);
+				compact = ( dead_bytes > live_bytes ) && ( dead_bytes > compaction_threshold );
+			}
+
+			WipeKey(removed_generation, removed);
+			if(compact)
+				StartCompaction();
+		}
+
+		void PackedKeyStorage::Container::WipeKey(const uint32_t key_generation, const entry_t& entry) const
+		{
+			if(0 == entry.length)
+				return;
+
+			std::shared_lock<std::shared_timed_mutex> lock(container_guard);
+			if(key_generation != generation)
+				return; // KAA: the compaction has left the key behind in the removed container, or wiped its copy.
+
+			const auto container = m_filesystem->open_file(GetContainerPath(key_generation), random_read_write, share_all);
+			Overwrite(*container, entry.offset, entry.length);
+			container->commit();
+		}
+
+		void PackedKeyStorage::Container::StartCompaction(void)
+		{
+			std::lock_guard<std::mutex> lock(compaction_guard);
+			if(compaction_running)
+				return;
+			if(compaction.joinable())
+				compaction.join();
+
+			compaction_running = true;
+			try
+			{
+				compaction = std::thread([this]
+				{
+					try
+					{
+						Compact();
+					}
+					catch(...)
+					{
+						// KAA: the keys are removed already, the space is reclaimed by a later compaction.
+					}
+					compaction_running = false;
+				});
+			}
+			catch(const std::system_error&)
+			{
+				compaction_running = false;
+			}
+		}
+
+		void PackedKeyStorage::Container::WaitForCompaction(void)
+		{
+			std::lock_guard<std::mutex> lock(compaction_guard);
+			if(compaction.joinable())
+				compaction.join();
+		}
+
+		// NOTE: called from the constructor, before the container is shared.
+		void PackedKeyStorage::Container::LoadIndex(void)
+		{
+			const auto index_path = GetIndexPath();
+			const auto pending_index_path = GetPendingIndexPath();
+			if(Exists(*m_filesystem, pending_index_path))
+			{
+				// KAA: the compaction has been interrupted after its index was complete: the compacted container is the valid one.
+				if(Exists(*m_filesystem, index_path))
+					m_filesystem->remove_file(index_path);
+				m_filesystem->rename_file(pending_index_path, index_path);
+			}
+			if(!Exists(*m_filesystem, index_path))
+				return; // KAA: nothing has been stored yet, the index is created with the first key.
+
+			std::vector<uint8_t> data;
+			{
+				const auto index_file = m_filesystem->open_file(index_path, sequential_read_only, share_all);
+				data.resize(index_file->get_size());
+				data.resize(Read(*index_file, data.data(), data.size()));
+			}
+			if(data.empty())
+				return; // KAA: torn write of the first key.
+
+			auto record = static_cast<const uint8_t*>(data.data());
+			const auto end = record + data.size();
+			if(( static_cast<size_t>(end - record) < header_size ) || ( index_signature != Extract<uint32_t>(record) ))
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "key container index is damaged";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+			generation = Extract<uint32_t>(record);
+
+			while(static_cast<size_t>(end - record) >= record_header_size)
+			{
+				const auto type = static_cast<record_t>(Extract<uint8_t>(record));
+				const auto length = Extract<uint16_t>(record);
+				if(static_cast<size_t>(end - record) < length * sizeof(wchar_t) + 2 * sizeof(uint64_t))
+					break; // KAA: torn write at the end of the index.
+				std::wstring name(length, L'\0');
+				std::memcpy(&name[0], record, length * sizeof(wchar_t));
+				record += length * sizeof(wchar_t);
+				const auto offset = Extract<uint64_t>(record);
+				const auto size = Extract<uint64_t>(record);
+
+				const auto previous = index.find(name);
+				if(index.end() != previous)
+				{
+					live_bytes -= previous->second.length;
+					dead_bytes += previous->second.length;
+					index.erase(previous);
+				}
+				if(record_t::stored == type)
+				{
+					index[name] = { offset, size };
+					live_bytes += size;
+				}
+			}
+
+			// KAA: leftovers of a compaction: the previous container, if interrupted after the switch; the next one, if before it.
+			if(0 != generation)
+				RemoveIfExists(*m_filesystem, GetContainerPath(generation - 1));
+			RemoveIfExists(*m_filesystem, GetContainerPath(generation + 1));
+			const auto container_path = GetContainerPath(generation);
+			if(Exists(*m_filesystem, container_path))
+				append_offset = m_filesystem->open_file(container_path, sequential_read_only, share_all)->get_size();
+		}
+
+		uint64_t PackedKeyStorage::Container::Compact(void)
+		{
+			std::lock_guard<std::mutex> append_lock(append_guard);
+			{
+				std::unique_lock<std::mutex> lock(writes_guard);
+				writes_done.wait(lock, [this] { return 0 == writes_in_flight; });
+			}
+
+			std::map<std::wstring, entry_t> snapshot;
+			uint32_t current = 0;
+			{
+				std::shared_lock<std::shared_timed_mutex> lock(container_guard);
+				snapshot = index;
+				current = generation;
+			}
+
+			const auto container_path = GetContainerPath(current);
+			const auto compacted_path = GetContainerPath(current + 1);
+			if(!Exists(*m_filesystem, container_path))
+				return 0; // KAA: nothing has been stored yet.
+
+			// KAA: the keys are copied without the index lock: keys are loaded and removed meanwhile, nothing else writes the container.
+			std::map<std::wstring, entry_t> compacted;
+			uint64_t compacted_size = 0;
+			uint64_t reclaimed = 0;
+			try
+			{
+				const auto container = m_filesystem->open_file(container_path, sequential_read_only, share_all);
+				const auto destination = m_filesystem->create_file(compacted_path, persistent_not_exists, random_read_write, share_all, allow_read_write);
+				std::vector<uint8_t> buffer(copy_chunk_size);
+				uint64_t offset = 0;
+				for(const auto& entry : snapshot)
+				{
+					SeekTo(*container, entry.second.offset);
+					const auto length = Copy(*container, *destination, entry.second.length, buffer);
+					compacted[entry.first] = { offset, length };
+					offset += length;
+				}
+				destination->commit();
+				compacted_size = offset;
+				reclaimed = container->get_size() - offset;
+			}
+			catch(...)
+			{
+				RemoveIfExists(*m_filesystem, compacted_path);
+				throw;
+			}
+
+			std::lock_guard<std::shared_timed_mutex> lock(container_guard);
+			try
+			{
+				// KAA: keys removed while copying are dropped, and their copies wiped.
+				auto records = MakeHeader(current + 1);
+				for(auto entry = compacted.begin(); compacted.end() != entry;)
+				{
+					if(index.end() != index.find(entry->first))
+					{
+						const auto record = MakeRecord(record_t::stored, entry->first, entry->second.offset, entry->second.length);
+						records.insert(records.end(), record.begin(), record.end());
+						++entry;
+						continue;
+					}
+					if(0 != entry->second.length)
+					{
+						const auto destination = m_filesystem->open_file(compacted_path, random_read_write, share_all);
+						Overwrite(*destination, entry->second.offset, entry->second.length);
+						destination->commit();
+					}
+					reclaimed += entry->second.length;
+					entry = compacted.erase(entry);
+				}
+
+				const auto temporary_index_path = m_filesystem->get_temp_filename(directory);
+				{
+					const auto compacted_index = m_filesystem->create_file(temporary_index_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+					Write(*compacted_index, records.data(), records.size());
+					compacted_index->commit();
+				}
+				m_filesystem->rename_file(temporary_index_path, GetPendingIndexPath());
+			}
+			catch(...)
+			{
+				RemoveIfExists(*m_filesystem, compacted_path);
+				throw;
+			}
+
+			// KAA: the pending index is complete: from here on LoadIndex finishes the switch, should it be interrupted.
+			m_filesystem->remove_file(GetIndexPath());
+			m_filesystem->rename_file(GetPendingIndexPath(), GetIndexPath());
+			index.swap(compacted);
+			generation = current + 1;
+			append_offset = compacted_size;
+			dead_bytes = 0;
+			RetireContainer(current);
+			return reclaimed;
+		}
+
+		filesystem::path::file PackedKeyStorage::Container::GetContainerPath(const uint32_t generation) const
+		{
+			return directory + ( L"keys." + std::to_wstring(generation) + L".pack" );
+		}
+
+		filesystem::path::file PackedKeyStorage::Container::GetIndexPath(void) const
+		{
+			return directory + index_name;
+		}
+
+		filesystem::path::file PackedKeyStorage::Container::GetPendingIndexPath(void) const
+		{
+			return directory + pending_index_name;
+		}
+	}
+}
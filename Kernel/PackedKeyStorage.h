@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "KeyStorage.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: keeps keys in one append-only container in the key storage directory instead of a file per key, key names come from the wrapped storage.
+		// keys.<generation>.pack holds key data, keys.index is an append-only log of stored (name, offset, length) and removed keys.
+		// A key is read in place: through views of the container mapping on Windows volumes, through the driver otherwise; LoadKey copies it to a temporary file
+		// for ciphers reading key files only. Keys are stored at once, each into a range reserved for it. Keys stored as files are still found.
+		// A removed or superseded key is overwritten in the container at once; its space is reclaimed by a compaction in the background.
+		// Instances opened on one directory of one driver share the container: its index, its writers and its compaction.
+		class PackedKeyStorage final : public KeyStorage
+		{
+		public:
+			PackedKeyStorage(std::unique_ptr<KeyStorage>, std::shared_ptr<filesystem::driver>);
+			PackedKeyStorage(const PackedKeyStorage&) = delete;
+			PackedKeyStorage(PackedKeyStorage&&) = delete;
+			~PackedKeyStorage() = default;
+
+			PackedKeyStorage& operator = (const PackedKeyStorage&) = delete;
+			PackedKeyStorage& operator = (PackedKeyStorage&&) = delete;
+
+			// NOTE: rewrites the container without removed keys; also done in the background once removed keys outweigh the stored ones.
+			// Keys are loaded and removed meanwhile, storing waits for the compaction.
+			// RETURNS: bytes reclaimed.
+			uint64_t Compact(void);
+
+		private:
+			class Container;
+
+			std::unique_ptr<KeyStorage> m_storage;
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<Container> m_container;
+
+			void ISetPath(filesystem::path::directory) override;
+			filesystem::path::directory IGetPath(void) const override;
+
+			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+			void IRememberKeyPath(const filesystem::path::file&, const filesystem::path::file&) override;
+			void ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			std::unique_ptr<filesystem::file> IOpenKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			// RETURNS: the container of the directory, opened unless another instance has it open already.
+			// A container given up by its last instance is closed - its compaction joined - before the directory is opened again.
+			static std::shared_ptr<Container> OpenContainer(std::shared_ptr<filesystem::driver>, const filesystem::path::directory&);
+		};
+	}
+}
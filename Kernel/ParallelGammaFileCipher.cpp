@@ -0,0 +1,159 @@
+#include "ParallelGammaFileCipher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+
+#include "CancellationToken.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+#include "NativeFile.h"
+
+namespace
+{
+	constexpr uint64_t range_size = 16U * 1024U * 1024U; // 16 MiB
+	constexpr std::chrono::milliseconds progress_interval(50);
+
+	// KAA: every worker keeps one request in flight, so the queue depth of the volume bounds the worker count.
+	unsigned GetWorkerCount(const uint64_t ranges, const unsigned queue_depth)
+	{
+		const auto hardware = std::max(1U, std::thread::hardware_concurrency());
+		return static_cast<unsigned>(std::min<uint64_t>(ranges, std::min(hardware, queue_depth)));
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		ParallelGammaFileCipher::ParallelGammaFileCipher(std::shared_ptr<IOPolicy> io_policy) :
+		m_io_policy(std::move(io_policy))
+		{
+			if(!m_io_policy)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create parallel gamma file cipher class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void ParallelGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			const NativeFile master(path, NativeFile::read_write, NativeFile::overlapped);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::overlapped);
+
+			const auto size = master.GetSize();
+			if(0 == size)
+				return;
+
+			if(key.GetSize() < size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to apply gamma: key is shorter than the file";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			const auto parameters = m_io_policy->GetParameters(path);
+			const auto chunk_size = std::min<uint64_t>(parameters.chunk_size, range_size);
+
+			// KAA: ranges are handed out on demand, so a slow worker does not hold the others back.
+			const auto ranges = ( size + range_size - 1 ) / range_size;
+			std::atomic<uint64_t> next_range(0);
+			std::atomic<uint64_t> processed(0);
+			std::atomic<bool> stop(false);
+
+			std::mutex guard;
+			std::condition_variable finished;
+			unsigned running = GetWorkerCount(ranges, parameters.queue_depth);
+			std::exception_ptr failure;
+
+			const auto work = [&]
+			{
+				try
+				{
+					std::vector<uint8_t> data(static_cast<size_t>(chunk_size));
+					std::vector<uint8_t> gamma(static_cast<size_t>(chunk_size));
+					for(auto range = next_range++; range < ranges && !stop; range = next_range++)
+					{
+						const auto end = std::min(size, ( range + 1 ) * range_size);
+						for(auto offset = range * range_size; offset < end && !stop; offset += chunk_size)
+						{
+							const auto length = static_cast<size_t>(std::min(chunk_size, end - offset));
+							// KAA: a file or key truncated meanwhile is a failure, the range would be left unprocessed otherwise.
+							master.ReadExactlyAt(offset, data.data(), length);
+							key.ReadExactlyAt(offset, gamma.data(), length);
+							Gamma(data.data(), gamma.data(), data.data(), length);
+							processed += master.WriteAt(offset, data.data(), length);
+						}
+					}
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> lock(guard);
+					if(!failure)
+						failure = std::current_exception();
+					stop = true;
+				}
+				std::lock_guard<std::mutex> lock(guard);
+				--running;
+				finished.notify_one();
+			};
+
+			std::vector<std::thread> workers;
+			workers.reserve(running);
+			try
+			{
+				for(auto count = running; 0 != count; --count)
+					workers.emplace_back(work);
+			}
+			catch(...)
+			{
+				// KAA: the workers started have to be joined, a joinable thread destroyed terminates the process.
+				stop = true;
+				for(auto& worker : workers)
+					worker.join();
+				throw;
+			}
+
+			// KAA: workers only count bytes, progress is reported from the calling thread as a single stream.
+			auto progress = progress_state_t::proceed;
+			uint64_t reported = 0;
+			for(auto done = false; !done;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(guard);
+					done = finished.wait_for(lock, progress_interval, [&] { return 0 == running; });
+				}
+				const uint64_t current = processed;
+				if(( current != reported ) && ( progress_state_t::quiet != progress ))
+					progress = ChunkProcessed(current - reported);
+				reported = current;
+				if(( progress_state_t::cancel == progress ) || ( progress_state_t::stop == progress ))
+					stop = true;
+			}
+
+			for(auto& worker : workers)
+				worker.join();
+
+			if(failure)
+				std::rethrow_exception(failure);
+			CheckProgressState(progress);
+		}
+
+		void ParallelGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FileCipher.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		class IOPolicy;
+
+		// NOTE: splits the file and the key into ranges and applies gamma to them from several worker threads with positional I/O, local files only.
+		// Ranges are written out of order and are not reported to the data callback: key path digest falls back to reading the file.
+		class ParallelGammaFileCipher final : public FileCipher
+		{
+		public:
+			explicit ParallelGammaFileCipher(std::shared_ptr<IOPolicy>);
+			ParallelGammaFileCipher(const ParallelGammaFileCipher&) = delete;
+			ParallelGammaFileCipher(ParallelGammaFileCipher&&) = delete;
+			~ParallelGammaFileCipher() = default;
+
+			ParallelGammaFileCipher& operator = (const ParallelGammaFileCipher&) = delete;
+			ParallelGammaFileCipher& operator = (ParallelGammaFileCipher&&) = delete;
+
+		private:
+			std::shared_ptr<IOPolicy> m_io_policy;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+		};
+	}
+}
@@ -0,0 +1,148 @@
+#include "PipelinedGammaFileCipher.h"
+
+#include <cerrno>
+#include <exception>
+#include <thread>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include "CancellationToken.h"
+#include "ChunkRing.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		PipelinedGammaFileCipher::PipelinedGammaFileCipher(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy) :
+		m_filesystem(std::move(filesystem)),
+		m_io_policy(std::move(io_policy))
+		{
+			if(!m_filesystem || !m_io_policy)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create pipelined gamma file cipher class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void PipelinedGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			// KAA: reader and writer handles have to tolerate each other, other openers are still denied.
+			const filesystem::driver::mode sequential_read_only(false);
+			const filesystem::driver::mode sequential_write_only(true, false);
+			const filesystem::driver::share allow_write(false, true);
+			const filesystem::driver::share allow_read(true, false);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto reader = m_filesystem->open_file(path, sequential_read_only, allow_write);
+			const auto writer = m_filesystem->open_file(path, sequential_write_only, allow_read);
+			const auto key = m_filesystem->open_file(key_path, sequential_read_only, exclusive_access);
+
+			const auto parameters = m_io_policy->GetParameters(path);
+			Process(*reader, *writer, *key, parameters.chunk_size, parameters.queue_depth);
+		}
+
+		void PipelinedGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
+
+		void PipelinedGammaFileCipher::IEncryptFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const filesystem::path::file& key_path)
+		{
+			const filesystem::driver::mode sequential_read_only(false);
+			const filesystem::driver::share exclusive_access(false, false);
+			const auto reader = m_filesystem->open_file(source_path, sequential_read_only, exclusive_access);
+			const auto key = m_filesystem->open_file(key_path, sequential_read_only, exclusive_access);
+
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::mode sequential_write_only(true, false);
+			const filesystem::driver::permission allow_read_write;
+			const auto writer = m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+
+			const auto parameters = m_io_policy->GetParameters(destination_path);
+			Process(*reader, *writer, *key, parameters.chunk_size, parameters.queue_depth);
+			writer->commit();
+		}
+
+		void PipelinedGammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return EncryptFile(source, destination, key);
+		}
+
+		void PipelinedGammaFileCipher::Process(filesystem::file& reader, filesystem::file& writer, filesystem::file& key, const size_t chunk_size, const unsigned queue_depth)
+		{
+			ChunkRing ring(queue_depth, chunk_size);
+
+			std::exception_ptr read_failure;
+			std::thread read_stage([&]
+			{
+				try
+				{
+					for(auto chunk = ring.AcquireEmpty(); nullptr != chunk; chunk = ring.AcquireEmpty())
+					{
+						chunk->size = reader.read(chunk_size, chunk->data.data());
+						if(0 == chunk->size)
+							break;
+						if(key.read(chunk->size, chunk->key.data()) != chunk->size)
+						{
+							// KAA: stale key bytes would make the chunk undecryptable.
+							constexpr auto source = __FUNCTION__;
+							constexpr auto description = "unable to apply gamma: key is shorter than the file";
+							constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+							constexpr auto severity = operation_failure::severity_t::error;
+							throw operation_failure(source, description, reason, severity);
+						}
+						Gamma(chunk->data.data(), chunk->key.data(), chunk->data.data(), chunk->size);
+						ring.PublishFilled();
+					}
+				}
+				catch(...)
+				{
+					read_failure = std::current_exception();
+				}
+				ring.Close();
+			});
+
+			auto completed = true;
+			try
+			{
+				uint64_t offset = 0;
+				auto progress = progress_state_t::proceed;
+				for(auto chunk = ring.AcquireFilled(); nullptr != chunk; chunk = ring.AcquireFilled())
+				{
+					const auto bytes_written = writer.write(chunk->data.data(), chunk->size);
+					if(bytes_written != chunk->size)
+						throw system_failure { __FUNCTION__, "unable to write file", EIO };
+					ChunkWritten(offset, chunk->data.data(), bytes_written);
+					offset += bytes_written;
+					ring.ReleaseEmpty();
+					if(progress_state_t::quiet != progress)
+						progress = ChunkProcessed(bytes_written);
+					if(( progress_state_t::cancel == progress ) || ( progress_state_t::stop == progress ))
+					{
+						ring.Cancel();
+						completed = false;
+						break;
+					}
+				}
+			}
+			catch(...)
+			{
+				ring.Cancel();
+				read_stage.join();
+				throw;
+			}
+
+			read_stage.join();
+			if(read_failure)
+				std::rethrow_exception(read_failure);
+			if(!completed)
+				throw OperationCancelled();
+		}
+	}
+}
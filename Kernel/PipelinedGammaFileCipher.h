@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FileCipher.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+		class file;
+	}
+
+	namespace FileSecurity
+	{
+		class IOPolicy;
+
+		// NOTE: reader stage (read data and key, gamma) runs on a worker thread, writer stage runs on the calling thread,
+		// so reading of the next chunks overlaps writing of the current one.
+		class PipelinedGammaFileCipher final : public FileCipher
+		{
+		public:
+			PipelinedGammaFileCipher(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>);
+			PipelinedGammaFileCipher(const PipelinedGammaFileCipher&) = delete;
+			PipelinedGammaFileCipher(PipelinedGammaFileCipher&&) = delete;
+			~PipelinedGammaFileCipher() = default;
+
+			PipelinedGammaFileCipher& operator = (const PipelinedGammaFileCipher&) = delete;
+			PipelinedGammaFileCipher& operator = (PipelinedGammaFileCipher&&) = delete;
+
+		private:
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+
+			// NOTE: throws OperationCancelled if processing was cancelled or stopped.
+			void Process(filesystem::file& reader, filesystem::file& writer, filesystem::file& key, size_t chunk_size, unsigned queue_depth);
+		};
+	}
+}
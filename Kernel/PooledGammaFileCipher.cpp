@@ -0,0 +1,186 @@
+#include "PooledGammaFileCipher.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/windows_api_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include <windows.h>
+
+#include "CancellationToken.h"
+#include "GammaKernel.h"
+#include "IOPolicy.h"
+#include "NativeFile.h"
+#include "WorkStealingPool.h"
+
+namespace
+{
+	bool IsStopped(const KAA::progress_state_t state)
+	{
+		return ( KAA::progress_state_t::cancel == state ) || ( KAA::progress_state_t::stop == state );
+	}
+
+	// KAA: ranges written at once would otherwise extend the file one after another.
+	void SetFileSize(const KAA::FileSecurity::NativeFile& file, const uint64_t size)
+	{
+		FILE_END_OF_FILE_INFO end_of_file = { 0 };
+		end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+		if(0 == ::SetFileInformationByHandle(file.GetHandle(), FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+		{
+			const auto error = ::GetLastError();
+			throw KAA::windows_api_failure { __FUNCTION__, "unable to set file size", error };
+		}
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		PooledGammaFileCipher::PooledGammaFileCipher(std::shared_ptr<filesystem::driver> filesystem, std::shared_ptr<IOPolicy> io_policy, WorkStealingPool& pool, const uint64_t split_size) :
+		m_filesystem(std::move(filesystem)),
+		m_io_policy(std::move(io_policy)),
+		m_pool(pool),
+		m_split_size(split_size)
+		{
+			if(!m_filesystem || !m_io_policy || 0 == m_split_size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create pooled gamma file cipher class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void PooledGammaFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			const NativeFile master(path, NativeFile::read_write, NativeFile::overlapped);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::overlapped);
+			return Apply(master, master, key, m_io_policy->GetParameters(path).chunk_size);
+		}
+
+		void PooledGammaFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file& key)
+		{
+			return EncryptFile(path, key);
+		}
+
+		void PooledGammaFileCipher::IEncryptFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, const filesystem::path::file& key_path)
+		{
+			{
+				const filesystem::driver::create_mode persistent_not_exists;
+				const filesystem::driver::mode sequential_write_only(true, false);
+				const filesystem::driver::share exclusive_access(false, false);
+				const filesystem::driver::permission allow_read_write;
+				m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+			}
+
+			const NativeFile source(source_path, NativeFile::read_only, NativeFile::overlapped);
+			const NativeFile destination(destination_path, NativeFile::read_write, NativeFile::overlapped);
+			const NativeFile key(key_path, NativeFile::read_only, NativeFile::overlapped);
+			return Apply(source, destination, key, m_io_policy->GetParameters(destination_path).chunk_size);
+		}
+
+		void PooledGammaFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file& key)
+		{
+			return EncryptFile(source, destination, key);
+		}
+
+		void PooledGammaFileCipher::Apply(const NativeFile& input, const NativeFile& output, const NativeFile& key, const size_t chunk_size)
+		{
+			const auto size = input.GetSize();
+			if(0 == size)
+				return;
+
+			if(key.GetSize() < size)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to apply gamma: key is shorter than the file";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			const auto chunk = static_cast<size_t>(std::min<uint64_t>(chunk_size, m_split_size));
+			if(size <= m_split_size)
+				return ApplyWhole(input, output, key, size, chunk);
+			return ApplySplit(input, output, key, size, chunk);
+		}
+
+		// NOTE: in order, from the calling task: the data callback sees the whole file as from a sequential cipher.
+		void PooledGammaFileCipher::ApplyWhole(const NativeFile& input, const NativeFile& output, const NativeFile& key, const uint64_t size, const size_t chunk_size)
+		{
+			std::vector<uint8_t> data(chunk_size);
+			std::vector<uint8_t> gamma(chunk_size);
+			auto progress = progress_state_t::proceed;
+			for(uint64_t offset = 0; offset < size;)
+			{
+				const auto length = static_cast<size_t>(std::min<uint64_t>(chunk_size, size - offset));
+				// KAA: a file or key truncated meanwhile is a failure, the rest of the file would be left unprocessed otherwise.
+				input.ReadExactlyAt(offset, data.data(), length);
+				key.ReadExactlyAt(offset, gamma.data(), length);
+				Gamma(data.data(), gamma.data(), data.data(), length);
+				const auto bytes_written = output.WriteAt(offset, data.data(), length);
+				ChunkWritten(offset, data.data(), bytes_written);
+				offset += bytes_written;
+
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(bytes_written);
+				CheckProgressState(progress);
+			}
+		}
+
+		// KAA: ranges finish out of order and are not reported to the data callback: key path digest falls back to reading the file.
+		void PooledGammaFileCipher::ApplySplit(const NativeFile& input, const NativeFile& output, const NativeFile& key, const uint64_t size, const size_t chunk_size)
+		{
+			if(&input != &output)
+				SetFileSize(output, size);
+
+			std::mutex progress_guard;
+			auto progress = progress_state_t::proceed;
+			std::atomic<bool> stop(false);
+
+			WorkStealingPool::TaskGroup ranges;
+			try
+			{
+				for(uint64_t begin = 0; begin < size; begin += m_split_size)
+				{
+					const auto end = std::min(size, begin + m_split_size);
+					m_pool.Submit(ranges, task_kind_t::io, [&, begin, end]
+					{
+						std::vector<uint8_t> data(chunk_size);
+						std::vector<uint8_t> gamma(chunk_size);
+						for(auto offset = begin; offset < end && !stop;)
+						{
+							const auto length = static_cast<size_t>(std::min<uint64_t>(chunk_size, end - offset));
+							input.ReadExactlyAt(offset, data.data(), length);
+							key.ReadExactlyAt(offset, gamma.data(), length);
+							Gamma(data.data(), gamma.data(), data.data(), length);
+							const auto bytes_written = output.WriteAt(offset, data.data(), length);
+							offset += bytes_written;
+
+							std::lock_guard<std::mutex> lock(progress_guard);
+							if(progress_state_t::quiet != progress)
+								progress = ChunkProcessed(bytes_written);
+							if(IsStopped(progress))
+								stop = true;
+						}
+					});
+				}
+			}
+			catch(...)
+			{
+				// KAA: the ranges submitted so far refer to this frame.
+				stop = true;
+				m_pool.Wait(ranges);
+				throw;
+			}
+			m_pool.Wait(ranges);
+			CheckProgressState(progress);
+		}
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+#include "FileCipher.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		class IOPolicy;
+		class NativeFile;
+		class WorkStealingPool;
+
+		// NOTE: applies gamma from a task of a work stealing pool with positional I/O, local files only.
+		// A file up to split size is processed by the calling task, a larger one is split into ranges of that size processed as I/O tasks of the pool,
+		// so that one huge file does not hold up the rest of a job.
+		class PooledGammaFileCipher final : public FileCipher
+		{
+		public:
+			PooledGammaFileCipher(std::shared_ptr<filesystem::driver>, std::shared_ptr<IOPolicy>, WorkStealingPool&, uint64_t split_size);
+			PooledGammaFileCipher(const PooledGammaFileCipher&) = delete;
+			PooledGammaFileCipher(PooledGammaFileCipher&&) = delete;
+			~PooledGammaFileCipher() = default;
+
+			PooledGammaFileCipher& operator = (const PooledGammaFileCipher&) = delete;
+			PooledGammaFileCipher& operator = (PooledGammaFileCipher&&) = delete;
+
+		private:
+			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
+			WorkStealingPool& m_pool;
+			const uint64_t m_split_size;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void Apply(const NativeFile& input, const NativeFile& output, const NativeFile& key, size_t chunk_size);
+			void ApplyWhole(const NativeFile& input, const NativeFile& output, const NativeFile& key, uint64_t size, size_t chunk_size);
+			void ApplySplit(const NativeFile& input, const NativeFile& output, const NativeFile& key, uint64_t size, size_t chunk_size);
+		};
+	}
+}
@@ -0,0 +1,29 @@
+#include "ProgressCounter.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		ProgressCounter::ProgressCounter() :
+		processed(0),
+		state(progress_state_t::proceed)
+		{}
+
+		// KAA: relaxed: the count orders nothing, the consumer only needs it to grow.
+		progress_state_t ProgressCounter::Publish(const uint64_t size)
+		{
+			processed.fetch_add(size, std::memory_order_relaxed);
+			return state.load(std::memory_order_relaxed);
+		}
+
+		ProgressCounter::snapshot_t ProgressCounter::GetSnapshot(void) const
+		{
+			return { processed.load(std::memory_order_relaxed), state.load(std::memory_order_relaxed) };
+		}
+
+		void ProgressCounter::SetState(const progress_state_t value)
+		{
+			state.store(value, std::memory_order_relaxed);
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "KAA/include/progress_state.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: progress surface shared by the workers of an operation and its consumer. Workers add the bytes they have processed
+		// with no lock and no virtual call, the consumer reads a snapshot whenever it likes and sets the state workers get back.
+		class ProgressCounter final
+		{
+		public:
+			struct snapshot_t
+			{
+				uint64_t processed;
+				progress_state_t state;
+			};
+
+			ProgressCounter();
+			ProgressCounter(const ProgressCounter&) = delete;
+			ProgressCounter(ProgressCounter&&) = delete;
+			~ProgressCounter() = default;
+
+			ProgressCounter& operator = (const ProgressCounter&) = delete;
+			ProgressCounter& operator = (ProgressCounter&&) = delete;
+
+			// NOTE: called by the workers, from any thread.
+			// RETURNS: the state set by the consumer.
+			progress_state_t Publish(uint64_t size);
+
+			snapshot_t GetSnapshot(void) const;
+			// NOTE: proceed, cancel or stop.
+			void SetState(progress_state_t);
+
+		private:
+			std::atomic<uint64_t> processed;
+			std::atomic<progress_state_t> state;
+		};
+	}
+}
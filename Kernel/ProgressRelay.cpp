@@ -0,0 +1,131 @@
+#include "ProgressRelay.h"
+
+#include "KAA/include/exception/operation_failure.h"
+
+#include "CancellationToken.h"
+#include "ProgressCounter.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		ProgressRelay::ProgressRelay(std::shared_ptr<CommunicatorProgressHandler> consumer, const std::chrono::milliseconds interval, std::function<bool(void)> cancelled) :
+		consumer(std::move(consumer)),
+		interval(interval),
+		cancelled(std::move(cancelled)),
+		counter(std::make_shared<ProgressCounter>()),
+		token(std::make_shared<CancellationToken>()),
+		reported(0),
+		quiet(false),
+		stopping(false)
+		{
+			if(nullptr == this->consumer || interval <= std::chrono::milliseconds::zero())
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create progress relay class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+			reporter = std::thread(&ProgressRelay::Report, this);
+		}
+
+		ProgressRelay::~ProgressRelay()
+		{
+			{
+				std::lock_guard<std::mutex> lock(state_guard);
+				stopping = true;
+			}
+			state_changed.notify_one();
+			reporter.join();
+			try
+			{
+				Flush();
+			}
+			catch(...)
+			{} // KAA: the operation is over, there is nothing left to cancel.
+		}
+
+		std::shared_ptr<ProgressCounter> ProgressRelay::GetCounter(void) const
+		{
+			return counter;
+		}
+
+		std::shared_ptr<CancellationToken> ProgressRelay::GetCancellationToken(void) const
+		{
+			return token;
+		}
+
+		void ProgressRelay::Flush(void)
+		{
+			std::lock_guard<std::mutex> lock(consumer_guard);
+			Deliver();
+		}
+
+		progress_state_t ProgressRelay::IOperationStarted(const std::string& name, const uint64_t size)
+		{
+			std::lock_guard<std::mutex> lock(consumer_guard);
+			Deliver();
+			quiet = false;
+			const auto state = consumer->OperationStarted(name, size);
+			Accept(state);
+			return state;
+		}
+
+		progress_state_t ProgressRelay::IOperationProgress(const uint64_t processed)
+		{
+			return counter->Publish(processed);
+		}
+
+		void ProgressRelay::Report(void)
+		{
+			std::unique_lock<std::mutex> lock(state_guard);
+			while(!state_changed.wait_for(lock, interval, [this] { return stopping; }))
+			{
+				lock.unlock();
+				try
+				{
+					Flush();
+					CheckCancelled();
+				}
+				catch(...)
+				{
+					std::lock_guard<std::mutex> consumer_lock(consumer_guard);
+					Accept(progress_state_t::cancel); // KAA: nobody to rethrow to, a failing consumer cancels the operation.
+				}
+				lock.lock();
+			}
+		}
+
+		// NOTE: consumer_guard held.
+		void ProgressRelay::Deliver(void)
+		{
+			const auto snapshot = counter->GetSnapshot();
+			if(snapshot.processed <= reported)
+				return;
+			const auto portion = snapshot.processed - reported;
+			reported = snapshot.processed;
+			if(!quiet)
+				Accept(consumer->OperationProgress(portion));
+		}
+
+		void ProgressRelay::CheckCancelled(void)
+		{
+			if(nullptr == cancelled || !cancelled())
+				return;
+			std::lock_guard<std::mutex> lock(consumer_guard);
+			Accept(progress_state_t::cancel);
+		}
+
+		// NOTE: consumer_guard held.
+		void ProgressRelay::Accept(const progress_state_t state)
+		{
+			if(progress_state_t::quiet == state)
+				quiet = true;
+			else
+				counter->SetState(state);
+			if(( progress_state_t::cancel == state ) || ( progress_state_t::stop == state ))
+				token->Cancel();
+		}
+	}
+}
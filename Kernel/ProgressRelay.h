@@ -0,0 +1,69 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../Common/CommunicatorProgressHandler.h"
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		class CancellationToken;
+		class ProgressCounter;
+
+		// NOTE: reports progress published to its counter to a consumer, a portion per interval, from a thread of its own: a slow consumer
+		// (a window updated by SendMessage) never holds the workers up. Progress reported to the relay itself only adds to the counter,
+		// a stage started is reported at once, after everything published before it. The state returned by the consumer goes to the counter,
+		// cancel and stop also cancel the token, so stages that report no progress learn of it too. The cancellation check is made every interval
+		// whether there is progress to report or not, whether the consumer wants it or not: an operation cancelled meanwhile is cancelled within an interval.
+		class ProgressRelay final : public CommunicatorProgressHandler
+		{
+		public:
+			// NOTE: cancelled: true once the operation is to be cancelled, called by the relay thread; nullptr: only the consumer cancels.
+			ProgressRelay(std::shared_ptr<CommunicatorProgressHandler> consumer, std::chrono::milliseconds interval, std::function<bool(void)> cancelled = nullptr);
+			ProgressRelay(const ProgressRelay&) = delete;
+			ProgressRelay(ProgressRelay&&) = delete;
+			~ProgressRelay();
+
+			ProgressRelay& operator = (const ProgressRelay&) = delete;
+			ProgressRelay& operator = (ProgressRelay&&) = delete;
+
+			std::shared_ptr<ProgressCounter> GetCounter(void) const;
+			std::shared_ptr<CancellationToken> GetCancellationToken(void) const;
+
+			// NOTE: returns once the consumer has got everything published so far.
+			void Flush(void);
+
+		private:
+			const std::shared_ptr<CommunicatorProgressHandler> consumer;
+			const std::chrono::milliseconds interval;
+			const std::function<bool(void)> cancelled;
+			const std::shared_ptr<ProgressCounter> counter;
+			const std::shared_ptr<CancellationToken> token;
+
+			std::mutex consumer_guard;
+			uint64_t reported;
+			bool quiet; // KAA: the consumer wants no more portions of the current stage.
+
+			std::mutex state_guard;
+			std::condition_variable state_changed;
+			bool stopping;
+
+			std::thread reporter;
+
+			progress_state_t IOperationStarted(const std::string& name, uint64_t size) override;
+			progress_state_t IOperationProgress(uint64_t processed) override;
+
+			void Report(void);
+			void Deliver(void);
+			void CheckCancelled(void);
+			void Accept(progress_state_t);
+		};
+	}
+}
@@ -2,8 +2,12 @@
 
 #include "ServerCommunicator.h"
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <stdexcept>
 #include <string>
+#include <thread>
 #include <cerrno>
 
 #include "KAA/include/load_string.h"
@@ -11,6 +15,7 @@
 #include "KAA/include/registry_key.h"
 #include "KAA/include/unicode.h"
 #include "KAA/include/dll/module_context.h"
+#include "KAA/include/exception/failure.h"
 #include "KAA/include/exception/windows_api_failure.h"
 #undef EncryptFile
 #undef DecryptFile
@@ -24,9 +29,20 @@
 
 #include "Core/Core.h"
 
+#include "CancellationToken.h"
 #include "CoreFactory.h"
+#include "DirectoryJob.h"
+#include "FileCipherFactory.h"
+#include "IOPolicy.h"
+#include "KeyStorage.h"
+#include "NativeCopy.h"
+#include "NativeFileSystem.h"
+#include "PooledGammaFileCipher.h"
+#include "ProgressRelay.h"
 #include "RegistryFactory.h"
+#include "Tracer.h"
 #include "WiperFactory.h"
+#include "WorkStealingPool.h"
 
 #include "CoreProgressDispatcher.h"
 #include "WiperProgressDispatcher.h"
@@ -46,6 +62,27 @@ namespace
 	constexpr auto registry_wipe_algorithm_value_name = "WipeMethod";
 	constexpr auto registry_core_value_name = "Engine";
 	constexpr auto registry_key_storage_path_value_name = "KeyStoragePath";
+	constexpr auto registry_cipher_mode_value_name = "CipherMode";
+	constexpr auto registry_processing_mode_value_name = "ProcessingMode";
+	constexpr auto registry_key_storage_value_name = "KeyStorage";
+	constexpr auto registry_key_storage_layout_value_name = "KeyStorageLayout";
+	constexpr auto registry_cpu_concurrency_value_name = "CPUConcurrency";
+	constexpr auto registry_io_concurrency_value_name = "IOConcurrency";
+	constexpr auto registry_progress_interval_value_name = "ProgressInterval";
+	constexpr auto registry_trace_file_value_name = "TraceFile";
+
+	// NOTE: settings of a new installation, the registry of the current user gets them on the first run.
+	constexpr auto default_core = KAA::FileSecurity::core_t::absolute_security; // FUTURE: KAA: introduce and change to strong security.
+	constexpr auto default_cipher = KAA::FileSecurity::gamma_cipher;
+	constexpr auto default_key_storage = KAA::FileSecurity::key_storage_t::md5_based;
+	constexpr auto default_key_storage_layout = KAA::FileSecurity::key_storage_layout_t::flat;
+	constexpr auto default_key_storage_path = LR"(.\keys)";
+	constexpr auto default_wipe_algorithm = KAA::FileSecurity::wiper_t::ordinary_remove;
+	constexpr auto default_processing = KAA::FileSecurity::processing_t::in_place;
+	constexpr DWORD default_progress_interval = 50; // KAA: 20 updates a second, smooth enough for a progress bar.
+	constexpr DWORD automatic_concurrency = 0;
+
+	constexpr uint64_t directory_split_size = 64U * 1024U * 1024U; // 64 MiB : a larger file of a directory is processed by several workers.
 
 	KAA::FileSecurity::wipe_method_id ToWipeMethodID(const KAA::FileSecurity::wiper_t wipe_algorithm)
 	{
@@ -83,7 +120,6 @@ namespace
 	{
 		if(ERROR_FILE_NOT_FOUND == error)
 		{
-			constexpr auto default_wipe_algorithm = KAA::FileSecurity::wiper_t::ordinary_remove;
 			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
 			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
 			software_root->set_dword_value(registry_wipe_algorithm_value_name, ToWipeMethodID(default_wipe_algorithm));
@@ -134,7 +170,6 @@ namespace
 	{
 		if(ERROR_FILE_NOT_FOUND == error)
 		{
-			constexpr auto default_core = KAA::FileSecurity::core_t::absolute_security; // FUTURE: KAA: introduce and change to strong security.
 			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
 			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
 			software_root->set_dword_value(registry_core_value_name, ToCoreID(default_core));
@@ -150,6 +185,98 @@ namespace
 		return software_root->set_dword_value(registry_core_value_name, ToCoreID(engine));
 	}
 
+	DWORD ToCipherModeID(const KAA::FileSecurity::cipher_t mode)
+	{
+		switch(mode)
+		{
+		case KAA::FileSecurity::gamma_cipher: return 0x01;
+		case KAA::FileSecurity::pipelined_gamma_cipher: return 0x02;
+		case KAA::FileSecurity::mapped_gamma_cipher: return 0x03;
+		case KAA::FileSecurity::parallel_gamma_cipher: return 0x04;
+		case KAA::FileSecurity::fused_gamma_cipher: return 0x05;
+		case KAA::FileSecurity::async_gamma_cipher: return 0x06;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	KAA::FileSecurity::cipher_t ToCipherType(const DWORD value)
+	{
+		switch(value)
+		{
+		case 0x01: return KAA::FileSecurity::gamma_cipher;
+		case 0x02: return KAA::FileSecurity::pipelined_gamma_cipher;
+		case 0x03: return KAA::FileSecurity::mapped_gamma_cipher;
+		case 0x04: return KAA::FileSecurity::parallel_gamma_cipher;
+		case 0x05: return KAA::FileSecurity::fused_gamma_cipher;
+		case 0x06: return KAA::FileSecurity::async_gamma_cipher;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	// NOTE: advanced setting, there is no user interface for it.
+	KAA::FileSecurity::cipher_t QueryCipherType(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return ToCipherType(software_root->query_dword_value(registry_cipher_mode_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_cipher_mode_value_name, ToCipherModeID(default_cipher));
+			return default_cipher;
+		}
+		throw;
+	}
+
+	DWORD ToProcessingModeID(const KAA::FileSecurity::processing_t mode)
+	{
+		switch(mode)
+		{
+		case KAA::FileSecurity::processing_t::in_place: return 0x01;
+		case KAA::FileSecurity::processing_t::out_of_place: return 0x02;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	KAA::FileSecurity::processing_t ToProcessingMode(const DWORD value)
+	{
+		switch(value)
+		{
+		case 0x01: return KAA::FileSecurity::processing_t::in_place;
+		case 0x02: return KAA::FileSecurity::processing_t::out_of_place;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	// NOTE: advanced setting, there is no user interface for it.
+	KAA::FileSecurity::processing_t QueryProcessingMode(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return ToProcessingMode(software_root->query_dword_value(registry_processing_mode_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_processing_mode_value_name, ToProcessingModeID(default_processing));
+			return default_processing;
+		}
+		throw;
+	}
+
 	KAA::filesystem::path::directory QueryKeyStoragePath(KAA::system::registry& registry)
 	try
 	{
@@ -161,35 +288,402 @@ namespace
 	{
 		if(ERROR_FILE_NOT_FOUND == error)
 		{
-			const KAA::filesystem::path::directory default_key_storage_path { LR"(.\keys)" };
 			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
 			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
-			software_root->set_string_value(registry_key_storage_path_value_name, to_UTF8(default_key_storage_path.to_wstring()));
-			return default_key_storage_path;
+			software_root->set_string_value(registry_key_storage_path_value_name, to_UTF8(default_key_storage_path));
+			return KAA::filesystem::path::directory { default_key_storage_path };
+		}
+		throw;
+	}
+
+	DWORD ToKeyStorageID(const KAA::FileSecurity::key_storage_t key_storage)
+	{
+		switch(key_storage)
+		{
+		case KAA::FileSecurity::key_storage_t::md5_based: return 0x01;
+		case KAA::FileSecurity::key_storage_t::blake3_based: return 0x02;
+		case KAA::FileSecurity::key_storage_t::packed: return 0x03;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	KAA::FileSecurity::key_storage_t ToKeyStorage(const DWORD value)
+	{
+		switch(value)
+		{
+		case 0x01: return KAA::FileSecurity::key_storage_t::md5_based;
+		case 0x02: return KAA::FileSecurity::key_storage_t::blake3_based;
+		case 0x03: return KAA::FileSecurity::key_storage_t::packed;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	// NOTE: advanced setting, there is no user interface for it. Key files named by MD5 are found by the BLAKE3 and packed storages as well.
+	KAA::FileSecurity::key_storage_t QueryKeyStorageType(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return ToKeyStorage(software_root->query_dword_value(registry_key_storage_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_key_storage_value_name, ToKeyStorageID(default_key_storage));
+			return default_key_storage;
+		}
+		throw;
+	}
+
+	DWORD ToKeyStorageLayoutID(const KAA::FileSecurity::key_storage_layout_t layout)
+	{
+		switch(layout)
+		{
+		case KAA::FileSecurity::key_storage_layout_t::flat: return 0x01;
+		case KAA::FileSecurity::key_storage_layout_t::sharded: return 0x02;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	KAA::FileSecurity::key_storage_layout_t ToKeyStorageLayout(const DWORD value)
+	{
+		switch(value)
+		{
+		case 0x01: return KAA::FileSecurity::key_storage_layout_t::flat;
+		case 0x02: return KAA::FileSecurity::key_storage_layout_t::sharded;
+		default:
+			throw std::invalid_argument(__FUNCTION__);
+		}
+	}
+
+	// NOTE: advanced setting, there is no user interface for it.
+	KAA::FileSecurity::key_storage_layout_t QueryKeyStorageLayout(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return ToKeyStorageLayout(software_root->query_dword_value(registry_key_storage_layout_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_key_storage_layout_value_name, ToKeyStorageLayoutID(default_key_storage_layout));
+			return default_key_storage_layout;
+		}
+		throw;
+	}
+
+	// NOTE: advanced setting, there is no user interface for it. 0 - chosen automatically.
+	DWORD QueryConcurrency(KAA::system::registry& registry, const char* value_name)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return software_root->query_dword_value(value_name);
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(value_name, automatic_concurrency);
+			return automatic_concurrency;
+		}
+		throw;
+	}
+
+	// KAA: automatically, a file per processor core and as many requests in flight as the volume takes.
+	KAA::FileSecurity::concurrency_limits_t ToConcurrencyLimits(const KAA::FileSecurity::concurrency_limits_t limits, const unsigned queue_depth)
+	{
+		return { 0 == limits.cpu ? std::max(1U, std::thread::hardware_concurrency()) : limits.cpu, 0 == limits.io ? std::max(1U, queue_depth) : limits.io };
+	}
+
+	// NOTE: automatic limits are kept as they are, the communicator chooses them once the I/O policy is known.
+	KAA::FileSecurity::concurrency_limits_t QueryConcurrencyLimits(KAA::system::registry& registry)
+	{
+		return { static_cast<unsigned>(QueryConcurrency(registry, registry_cpu_concurrency_value_name)), static_cast<unsigned>(QueryConcurrency(registry, registry_io_concurrency_value_name)) };
+	}
+
+	// NOTE: advanced setting, there is no user interface for it. Milliseconds between progress reports, 0 is taken as 1.
+	std::chrono::milliseconds QueryProgressInterval(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return std::chrono::milliseconds(std::max<DWORD>(1, software_root->query_dword_value(registry_progress_interval_value_name)));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_dword_value(registry_progress_interval_value_name, default_progress_interval);
+			return std::chrono::milliseconds(default_progress_interval);
+		}
+		throw;
+	}
+
+	// NOTE: advanced setting, there is no user interface for it. Stages are traced to the file while it is set, the default is empty.
+	std::wstring QueryTraceFile(KAA::system::registry& registry)
+	try
+	{
+		const KAA::system::registry::key_access query_value = { false, false, false, false, true, false };
+		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, query_value);
+		return to_UTF16(software_root->query_string_value(registry_trace_file_value_name));
+	}
+	catch(const KAA::windows_api_failure& error)
+	{
+		if(ERROR_FILE_NOT_FOUND == error)
+		{
+			const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
+			const auto software_root = registry.create_key(KAA::system::registry::current_user, registry_software_sub_key, KAA::system::registry::persistent, set_value);
+			software_root->set_string_value(registry_trace_file_value_name, std::string());
+			return std::wstring();
 		}
 		throw;
 	}
 
+	// NOTE: settings absent from the registry are created with the defaults.
+	KAA::FileSecurity::server_settings_t QuerySettings(KAA::system::registry& registry)
+	{
+		return { QueryCoreType(registry), QueryCipherType(registry), QueryKeyStorageType(registry), QueryKeyStorageLayout(registry), QueryKeyStoragePath(registry), QueryWiperType(registry), QueryProcessingMode(registry),
+			QueryProgressInterval(registry), QueryTraceFile(registry), QueryConcurrencyLimits(registry) };
+	}
+
+	// NOTE: mapped and parallel ciphers process files in place only, out-of-place processing falls back to the gamma cipher.
+	KAA::FileSecurity::cipher_t QueryProcessingCipher(const KAA::FileSecurity::server_settings_t& settings)
+	{
+		if(KAA::FileSecurity::processing_t::out_of_place == settings.processing)
+		{
+			if(( KAA::FileSecurity::mapped_gamma_cipher == settings.cipher ) || ( KAA::FileSecurity::parallel_gamma_cipher == settings.cipher ))
+				return KAA::FileSecurity::gamma_cipher;
+		}
+		return settings.cipher;
+	}
+
+	// NOTE: volumes are probed through native Windows files, other drivers (e.g. in-memory filesystem) have got none.
+	std::shared_ptr<KAA::FileSecurity::IOPolicy> QueryIOPolicy(const std::shared_ptr<KAA::filesystem::driver>& filesystem)
+	{
+		if(( nullptr == filesystem ) || KAA::FileSecurity::IsWindowsFileSystem(filesystem.get()))
+			return std::make_shared<KAA::FileSecurity::IOPolicy>();
+		constexpr KAA::FileSecurity::io_parameters_t memory_parameters = { 1024U * 1024U, 1U }; // 1 MiB
+		return std::make_shared<KAA::FileSecurity::IOPolicy>(memory_parameters);
+	}
+
 	void SaveKeyStoragePath(KAA::system::registry& registry, const KAA::filesystem::path::directory& path)
 	{
 		const KAA::system::registry::key_access set_value = { false, false, false, false, false, true };
 		const auto software_root = registry.open_key(KAA::system::registry::current_user, registry_software_sub_key, set_value);
 		return software_root->set_string_value(registry_key_storage_path_value_name, to_UTF8(path.to_wstring()));
 	}
+
+	std::string LoadStageName(const unsigned identifier)
+	{
+		return to_UTF8(KAA::resources::load_string(identifier, core_dll.get_module_handle()));
+	}
+
+	// NOTE: rollback helpers: a stage may fail before it has created its file, the error of the stage is the one to report then.
+	bool IsCreated(KAA::filesystem::driver& filesystem, const KAA::filesystem::path::file& path)
+	{
+		return KAA::filesystem::file_exists(filesystem, path);
+	}
+
+	// NOTE: turns the stages of every file of a batch into one operation: a file advances it by the furthest any of its stages has got.
+	// Portions come from the progress relay thread, files from the thread processing the batch.
+	class BatchProgress final : public KAA::FileSecurity::CommunicatorProgressHandler
+	{
+	public:
+		explicit BatchProgress(std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> session) :
+		session(std::move(session)),
+		state(KAA::progress_state_t::proceed),
+		file_size(0),
+		file_reported(0),
+		stage_processed(0)
+		{}
+
+		BatchProgress(const BatchProgress&) = delete;
+		BatchProgress& operator = (const BatchProgress&) = delete;
+
+		void FileStarted(const uint64_t size)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			file_size = size;
+			file_reported = 0;
+			stage_processed = 0;
+		}
+
+		// KAA: failed and skipped files count as done, so the operation still ends at its full size.
+		void FileFinished(void)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			Report(file_size);
+		}
+
+		bool IsStopped(void)
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			return ( KAA::progress_state_t::cancel == state ) || ( KAA::progress_state_t::stop == state );
+		}
+
+	private:
+		std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> session;
+		std::mutex guard;
+		KAA::progress_state_t state;
+		uint64_t file_size;
+		uint64_t file_reported;
+		uint64_t stage_processed;
+
+		KAA::progress_state_t IOperationStarted(const std::string&, uint64_t) override
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			stage_processed = 0;
+			return state;
+		}
+
+		KAA::progress_state_t IOperationProgress(const uint64_t processed) override
+		{
+			std::lock_guard<std::mutex> lock(guard);
+			stage_processed += processed;
+			Report(std::min(stage_processed, file_size));
+			return state;
+		}
+
+		void Report(const uint64_t reached)
+		{
+			if(reached <= file_reported)
+				return;
+			const auto portion = reached - file_reported;
+			file_reported = reached;
+			const auto session_state = session->OperationProgress(portion);
+			if(KAA::progress_state_t::quiet != session_state)
+				state = session_state;
+		}
+	};
+
+	class ScopedProgressHandler final
+	{
+	public:
+		// NOTE: install sets the handler and returns the previous one.
+		typedef std::function<std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler>(std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler>)> install_t;
+
+		ScopedProgressHandler(install_t install, std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> handler) :
+		install(std::move(install)),
+		previous(this->install(std::move(handler)))
+		{}
+
+		ScopedProgressHandler(const ScopedProgressHandler&) = delete;
+		ScopedProgressHandler& operator = (const ScopedProgressHandler&) = delete;
+
+		~ScopedProgressHandler()
+		{
+			install(std::move(previous));
+		}
+
+	private:
+		install_t install;
+		std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> previous;
+	};
+
+	// NOTE: the cancellation check of the running operation, made by its progress relays every interval.
+	class ScopedCancellationCheck final
+	{
+	public:
+		ScopedCancellationCheck(std::function<bool(void)>& check, std::function<bool(void)> value) :
+		check(check)
+		{
+			this->check = std::move(value);
+		}
+
+		ScopedCancellationCheck(const ScopedCancellationCheck&) = delete;
+		ScopedCancellationCheck& operator = (const ScopedCancellationCheck&) = delete;
+
+		~ScopedCancellationCheck()
+		{
+			check = nullptr;
+		}
+
+	private:
+		std::function<bool(void)>& check;
+	};
+
+	// NOTE: progress of an asynchronous operation: reported to the handler of the operation, cancels the processing once the operation is cancelled or the communicator is closing.
+	class OperationProgress final : public KAA::FileSecurity::CommunicatorProgressHandler
+	{
+	public:
+		OperationProgress(std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> handler, std::shared_ptr<KAA::FileSecurity::batch_operation_t> operation, const std::atomic<bool>& closing) :
+		handler(std::move(handler)),
+		operation(std::move(operation)),
+		closing(closing)
+		{}
+
+		OperationProgress(const OperationProgress&) = delete;
+		OperationProgress& operator = (const OperationProgress&) = delete;
+
+	private:
+		std::shared_ptr<KAA::FileSecurity::CommunicatorProgressHandler> handler;
+		std::shared_ptr<KAA::FileSecurity::batch_operation_t> operation;
+		const std::atomic<bool>& closing;
+
+		KAA::progress_state_t IOperationStarted(const std::string& name, const uint64_t size) override
+		{
+			if(operation->IsCancelled() || closing)
+				return KAA::progress_state_t::cancel;
+			return nullptr == handler ? KAA::progress_state_t::quiet : handler->OperationStarted(name, size);
+		}
+
+		KAA::progress_state_t IOperationProgress(const uint64_t processed) override
+		{
+			if(operation->IsCancelled() || closing)
+				return KAA::progress_state_t::cancel;
+			return nullptr == handler ? KAA::progress_state_t::quiet : handler->OperationProgress(processed);
+		}
+	};
 }
 
 namespace KAA
 {
 	namespace FileSecurity
 	{
+		server_settings_t GetDefaultSettings(filesystem::path::directory key_storage_path)
+		{
+			return { default_core, default_cipher, default_key_storage, default_key_storage_layout, std::move(key_storage_path), default_wipe_algorithm, default_processing,
+				std::chrono::milliseconds(default_progress_interval), std::wstring(), { automatic_concurrency, automatic_concurrency } };
+		}
+
 		ServerCommunicator::ServerCommunicator(std::shared_ptr<filesystem::driver> filesystem) :
-		m_registry(QueryRegistry(windows_registry)),
+		ServerCommunicator(std::move(filesystem), QuerySettings(*QueryRegistry(windows_registry)), QueryRegistry(windows_registry))
+		{}
+
+		ServerCommunicator::ServerCommunicator(std::shared_ptr<filesystem::driver> filesystem, server_settings_t settings) :
+		ServerCommunicator(std::move(filesystem), std::move(settings), nullptr)
+		{}
+
+		ServerCommunicator::ServerCommunicator(std::shared_ptr<filesystem::driver> filesystem, server_settings_t settings, std::unique_ptr<system::registry> registry) :
+		m_registry(std::move(registry)),
+		m_settings(std::move(settings)),
 		m_filesystem(std::move(filesystem)),
-		m_wiper(QueryWiper(QueryWiperType(*m_registry), m_filesystem)),
-		m_core(QueryCore(QueryCoreType(*m_registry), m_filesystem, QueryKeyStoragePath(*m_registry))),
+		m_io_policy(QueryIOPolicy(m_filesystem)),
+		m_wiper(QueryWiper(m_settings.wipe_algorithm, m_filesystem)),
+		m_core(QueryCore(m_settings.engine, m_filesystem, m_io_policy, m_settings.key_storage_path, QueryProcessingCipher(m_settings), m_settings.key_storage, m_settings.key_storage_layout)),
+		tracer(m_settings.trace_file.empty() ? nullptr : std::make_unique<Tracer>()),
+		stage_names { LoadStageName(IDS_CREATING_BACKUP), LoadStageName(IDS_ENCRYPTING_FILE), LoadStageName(IDS_WIPING_FILE), LoadStageName(IDS_DECRYPTING_FILE), LoadStageName(IDS_REMOVING_BACKUP) },
 		core_progress(new CoreProgressDispatcher),
 		wiper_progress(new WiperProgressDispatcher),
-		server_progress(nullptr)
+		server_progress(nullptr),
+		progress_relay(nullptr),
+		closing(false),
+		strand_running(false)
 		{
 			// KAA: filesystem already verified by wiper and core.
 			try
@@ -206,44 +700,134 @@ namespace KAA
 					//throw KAA::FileSecurity::UserReport(message, KAA::FileSecurity::UserReport::error);
 				//}
 			}
+			// KAA: the executor keeps as many requests in flight as the volume of the keys takes, its probe is kept in the registry.
+			m_settings.concurrency = ToConcurrencyLimits(m_settings.concurrency, m_io_policy->GetParameters(m_core->GetKeyStoragePath()).queue_depth);
+			if(nullptr != tracer)
+				Tracer::Install(tracer.get());
 		}
 
-		ServerCommunicator::~ServerCommunicator() = default;
+		// NOTE: queued operations fail, running ones stop within a progress interval.
+		ServerCommunicator::~ServerCommunicator()
+		{
+			closing = true;
+			WorkStealingPool* running_executor = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(executor_guard);
+				running_executor = executor.get();
+			}
+			if(nullptr != running_executor)
+				running_executor->Wait(operations);
+			{
+				std::lock_guard<std::mutex> lock(query_guard);
+			}
+			query_added.notify_one();
+			if(query_thread.joinable())
+				query_thread.join();
+			if(nullptr != tracer)
+			{
+				Tracer::Install(nullptr);
+				try
+				{
+					SaveTrace();
+				}
+				catch(...)
+				{} // KAA: tracing is a diagnostic aid, it never fails the application.
+			}
+		}
 
 		void ServerCommunicator::IEncryptFile(const filesystem::path::file& path)
 		{
-			const auto file_size = get_file_size(*m_filesystem.get(), path);
-
-			OperationStarted(to_UTF8(resources::load_string(IDS_CREATING_BACKUP, core_dll.get_module_handle())), file_size);
-			const auto backup = BackupFile(path);
-
-			// TODO: KAA: #SubOperationStarted
-			OperationStarted(to_UTF8(resources::load_string(IDS_ENCRYPTING_FILE, core_dll.get_module_handle())), file_size);
-			m_core->EncryptFile(path);
-
-			OperationStarted(to_UTF8(resources::load_string(IDS_WIPING_FILE, core_dll.get_module_handle())), file_size);
-			m_wiper->wipe_file(backup);
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			Encrypt(path, get_file_size(*m_filesystem.get(), path));
+			FlushProgress();
 		}
 
 		void ServerCommunicator::IDecryptFile(const filesystem::path::file& path)
 		{
-			const auto file_size = get_file_size(*m_filesystem.get(), path);
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			Decrypt(path, get_file_size(*m_filesystem.get(), path));
+			FlushProgress();
+		}
 
-			OperationStarted(to_UTF8(resources::load_string(IDS_CREATING_BACKUP, core_dll.get_module_handle())), file_size);
-			const auto backup = BackupFile(path);
+		std::vector<file_result_t> ServerCommunicator::IEncryptFiles(const std::vector<filesystem::path::file>& paths)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			return ProcessFiles(paths, &ServerCommunicator::Encrypt, stage_names.encrypting_file);
+		}
 
-			OperationStarted(to_UTF8(resources::load_string(IDS_DECRYPTING_FILE, core_dll.get_module_handle())), file_size);
-			m_core->DecryptFile(path);
+		std::vector<file_result_t> ServerCommunicator::IDecryptFiles(const std::vector<filesystem::path::file>& paths)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			return ProcessFiles(paths, &ServerCommunicator::Decrypt, stage_names.decrypting_file);
+		}
 
-			OperationStarted(to_UTF8(resources::load_string(IDS_REMOVING_BACKUP, core_dll.get_module_handle())), file_size);
-			m_filesystem->remove_file(backup);
+		std::vector<file_result_t> ServerCommunicator::IEncryptDirectory(const filesystem::path::directory& path)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			return ProcessDirectory(path, &DirectoryJob::EncryptDirectory, stage_names.encrypting_file);
+		}
+
+		std::vector<file_result_t> ServerCommunicator::IDecryptDirectory(const filesystem::path::directory& path)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			return ProcessDirectory(path, &DirectoryJob::DecryptDirectory, stage_names.decrypting_file);
 		}
 
 		bool ServerCommunicator::IIsFileEncrypted(const filesystem::path::file& path) const
 		{
+			std::shared_lock<std::shared_timed_mutex> lock(core_guard);
 			return m_core->IsFileEncrypted(path);
 		}
 
+		std::shared_ptr<batch_operation_t> ServerCommunicator::IStartEncryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return StartOperation([this, paths] { return ProcessFiles(paths, &ServerCommunicator::Encrypt, stage_names.encrypting_file); }, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ServerCommunicator::IStartDecryptFiles(const std::vector<filesystem::path::file>& paths, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return StartOperation([this, paths] { return ProcessFiles(paths, &ServerCommunicator::Decrypt, stage_names.decrypting_file); }, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ServerCommunicator::IStartEncryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return StartOperation([this, path] { return ProcessDirectory(path, &DirectoryJob::EncryptDirectory, stage_names.encrypting_file); }, std::move(handler));
+		}
+
+		std::shared_ptr<batch_operation_t> ServerCommunicator::IStartDecryptDirectory(const filesystem::path::directory& path, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			return StartOperation([this, path] { return ProcessDirectory(path, &DirectoryJob::DecryptDirectory, stage_names.decrypting_file); }, std::move(handler));
+		}
+
+		// NOTE: a status query does not wait for the strand, it runs as soon as no operation changing files holds the core: between operations, not during one.
+		// KAA: the running operation installs its progress handler and cancellation token into the core, a query cannot share the core with it.
+		std::shared_ptr<query_operation_t> ServerCommunicator::IStartIsFileEncrypted(const filesystem::path::file& path)
+		{
+			auto operation = std::make_shared<query_operation_t>();
+			std::lock_guard<std::mutex> lock(query_guard);
+			if(!query_thread.joinable())
+				query_thread = std::thread(&ServerCommunicator::RunQueries, this);
+			pending_queries.push_back([this, operation, path]
+			{
+				if(operation->IsCancelled() || closing)
+					return operation->Fail(std::make_exception_ptr(OperationCancelled()));
+
+				bool encrypted = false;
+				try
+				{
+					std::shared_lock<std::shared_timed_mutex> lock(core_guard);
+					encrypted = m_core->IsFileEncrypted(path);
+				}
+				catch(...)
+				{
+					return operation->Fail(std::current_exception());
+				}
+				operation->Complete(encrypted);
+			});
+			query_added.notify_one();
+			return operation;
+		}
+
 		// FIX: KAA: implement communicator.
 		std::vector<std::pair<std::wstring, core_id>> ServerCommunicator::IGetAvailableCiphers(void) const
 		{
@@ -252,15 +836,19 @@ namespace KAA
 
 		core_id ServerCommunicator::IGetCipher(void) const
 		{
-			return ToCoreID(QueryCoreType(*m_registry));
+			std::shared_lock<std::shared_timed_mutex> lock(core_guard);
+			return ToCoreID(m_settings.engine);
 		}
 
 		void ServerCommunicator::ISetCipher(const core_id value)
 		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
 			const core_t engine = ToCoreType(value);
 			auto current_key_storage_path = m_core->GetKeyStoragePath();
-			m_core = QueryCore(engine, m_filesystem, std::move(current_key_storage_path));
-			SaveCoreType(*m_registry, engine);
+			m_core = QueryCore(engine, m_filesystem, m_io_policy, std::move(current_key_storage_path), QueryProcessingCipher(m_settings), m_settings.key_storage, m_settings.key_storage_layout);
+			m_settings.engine = engine;
+			if(nullptr != m_registry)
+				SaveCoreType(*m_registry, engine);
 		}
 
 		std::vector<std::pair<std::wstring, wipe_method_id>> ServerCommunicator::IGetAvailableWipeMethods(void) const
@@ -273,24 +861,30 @@ namespace KAA
 
 		wipe_method_id ServerCommunicator::IGetWipeMethod(void) const
 		{
-			return ToWipeMethodID(QueryWiperType(*m_registry));
+			std::shared_lock<std::shared_timed_mutex> lock(core_guard);
+			return ToWipeMethodID(m_settings.wipe_algorithm);
 		}
 
 		void ServerCommunicator::ISetWipeMethod(const wipe_method_id value)
 		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
 			const wiper_t algorithm = ToWiperType(value);
 			m_wiper = QueryWiper(algorithm, m_filesystem);
-			SaveWiperType(*m_registry, algorithm);
+			m_settings.wipe_algorithm = algorithm;
+			if(nullptr != m_registry)
+				SaveWiperType(*m_registry, algorithm);
 		}
 
 		filesystem::path::directory ServerCommunicator::IGetKeyStoragePath(void) const
 		{
+			std::shared_lock<std::shared_timed_mutex> lock(core_guard);
 			return m_core->GetKeyStoragePath();
 		}
 
 		// FUTURE: KAA: consider use SetWorkingDirectory / _wchdir.
 		void ServerCommunicator::ISetKeyStoragePath(const filesystem::path::directory new_key_storage_path)
 		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
 			const auto previous_key_storage_path = m_core->GetKeyStoragePath();
 			if(previous_key_storage_path != new_key_storage_path)
 			{
@@ -305,7 +899,9 @@ namespace KAA
 				}
 
 				m_core->SetKeyStoragePath(new_key_storage_path);
-				SaveKeyStoragePath(*m_registry, new_key_storage_path);
+				m_settings.key_storage_path = new_key_storage_path;
+				if(nullptr != m_registry)
+					SaveKeyStoragePath(*m_registry, new_key_storage_path);
 
 				try
 				{
@@ -324,24 +920,406 @@ namespace KAA
 		}
 
 		std::shared_ptr<CommunicatorProgressHandler> ServerCommunicator::ISetProgressHandler(std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+			return InstallProgressHandler(std::move(handler));
+		}
+
+		// NOTE: core_guard held exclusively.
+		std::shared_ptr<CommunicatorProgressHandler> ServerCommunicator::InstallProgressHandler(std::shared_ptr<CommunicatorProgressHandler> handler)
 		{
 			server_progress.swap(handler);
-			core_progress->SetProgressHandler(server_progress);
-			wiper_progress->SetProgressHandler(server_progress);
+			progress_relay = nullptr == server_progress ? nullptr : std::make_shared<ProgressRelay>(server_progress, m_settings.progress_interval, operation_cancelled);
+			core_progress->SetProgressHandler(progress_relay);
+			wiper_progress->SetProgressHandler(progress_relay);
 			m_core->SetProgressHandler(core_progress);
+			m_core->SetProgressCounter(nullptr == progress_relay ? nullptr : progress_relay->GetCounter());
+			m_core->SetCancellationToken(nullptr == progress_relay ? nullptr : progress_relay->GetCancellationToken());
 			m_wiper->set_progress_handler(wiper_progress);
 			return handler;
 		}
 
-		filesystem::path::file ServerCommunicator::BackupFile(const filesystem::path::file& path)
+		void ServerCommunicator::Encrypt(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			if(processing_t::out_of_place == m_settings.processing)
+				return EncryptFileOutOfPlace(path, file_size);
+
+			const TraceSpan span("EncryptFile", file_size);
+			OperationStarted(stage_names.creating_backup, file_size);
+			const auto backup = BackupFile(path, file_size);
+
+			// TODO: KAA: #SubOperationStarted
+			OperationStarted(stage_names.encrypting_file, file_size);
+			try
+			{
+				m_core->EncryptFile(path);
+			}
+			catch(...)
+			{
+				RestoreBackup(path, backup, file_size);
+				throw;
+			}
+
+			OperationStarted(stage_names.wiping_file, file_size);
+			DiscardFile(backup, file_size);
+		}
+
+		void ServerCommunicator::Decrypt(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			if(processing_t::out_of_place == m_settings.processing)
+				return DecryptFileOutOfPlace(path, file_size);
+
+			const TraceSpan span("DecryptFile", file_size);
+			OperationStarted(stage_names.creating_backup, file_size);
+			const auto backup = BackupFile(path, file_size);
+
+			OperationStarted(stage_names.decrypting_file, file_size);
+			try
+			{
+				m_core->DecryptFile(path);
+			}
+			catch(...)
+			{
+				RestoreBackup(path, backup, file_size);
+				throw;
+			}
+
+			OperationStarted(stage_names.removing_backup, file_size);
+			RemoveFile(backup);
+		}
+
+		// NOTE: sizes are queried once up front: they make the size of the operation and are handed to every stage.
+		std::vector<file_result_t> ServerCommunicator::ProcessFiles(const std::vector<filesystem::path::file>& paths, void (ServerCommunicator::*process)(const filesystem::path::file&, uint64_t), const std::string& operation_name)
+		{
+			std::vector<file_result_t> results;
+			std::vector<uint64_t> sizes;
+			results.reserve(paths.size());
+			sizes.reserve(paths.size());
+			uint64_t total_size = 0;
+			for(const auto& path : paths)
+			{
+				results.push_back({ path, file_status_t::stopped, std::string() }); // KAA: until processed.
+				uint64_t size = 0;
+				try
+				{
+					size = get_file_size(*m_filesystem.get(), path);
+				}
+				catch(const failure& error)
+				{
+					results.back().status = file_status_t::failed;
+					results.back().failure = error.get_system_message();
+				}
+				sizes.push_back(size);
+				total_size += size;
+			}
+
+			const auto session = server_progress;
+			std::shared_ptr<BatchProgress> batch;
+			if(nullptr != session)
+			{
+				OperationStarted(operation_name, total_size);
+				batch = std::make_shared<BatchProgress>(session);
+			}
+			const ScopedProgressHandler batch_progress([this](std::shared_ptr<CommunicatorProgressHandler> handler) { return InstallProgressHandler(std::move(handler)); }, batch);
+
+			for(size_t index = 0; index < paths.size(); ++index)
+			{
+				auto& result = results[index];
+				if(( file_status_t::failed == result.status ) || ( batch && batch->IsStopped() ))
+					continue;
+
+				if(batch)
+				{
+					FlushProgress();
+					batch->FileStarted(sizes[index]);
+				}
+				try
+				{
+					( this->*process )(paths[index], sizes[index]);
+					result.status = file_status_t::succeeded;
+				}
+				catch(const failure& error)
+				{
+					result.status = file_status_t::failed;
+					result.failure = error.get_system_message();
+				}
+				catch(const std::exception& error)
+				{
+					result.status = file_status_t::failed;
+					result.failure = error.what();
+				}
+				if(batch)
+				{
+					FlushProgress();
+					batch->FileFinished();
+				}
+			}
+			return results;
+		}
+
+		// NOTE: files are processed out-of-place whatever the processing mode is: the backup copy of in-place processing would double the I/O of the job.
+		// Cores of the job share a key storage of their own, the core reopens the key storage afterwards to see the keys stored meanwhile.
+		std::vector<file_result_t> ServerCommunicator::ProcessDirectory(const filesystem::path::directory& path, std::vector<file_result_t> (DirectoryJob::*process)(const filesystem::path::directory&, const std::vector<filesystem::path::directory>&, std::shared_ptr<CommunicatorProgressHandler>, const std::string&), const std::string& operation_name)
+		{
+			const auto engine = m_settings.engine;
+			const auto key_storage_path = m_core->GetKeyStoragePath();
+			const auto key_storage_type = m_settings.key_storage;
+			const auto key_storage_layout = m_settings.key_storage_layout;
+			const auto reopen_core = [&]
+			{
+				m_core = QueryCore(engine, m_filesystem, m_io_policy, key_storage_path, QueryProcessingCipher(m_settings), key_storage_type, key_storage_layout);
+				m_core->SetProgressHandler(core_progress);
+				m_core->SetProgressCounter(nullptr == progress_relay ? nullptr : progress_relay->GetCounter());
+				m_core->SetCancellationToken(nullptr == progress_relay ? nullptr : progress_relay->GetCancellationToken());
+			};
+
+			std::vector<file_result_t> results;
+			try
+			{
+				const auto filesystem = m_filesystem;
+				const auto io_policy = m_io_policy;
+				const auto key_storage = QueryKeyStorage(engine, filesystem, io_policy, key_storage_path, key_storage_type, key_storage_layout);
+				key_storage->SetCancellationToken(nullptr == progress_relay ? nullptr : progress_relay->GetCancellationToken());
+				const auto wipe_algorithm = m_settings.wipe_algorithm;
+				const auto create_lane = [=] (WorkStealingPool& pool)
+				{
+					// KAA: the pooled cipher splits files of Windows volumes into ranges, files of other drivers go through the driver.
+					auto cipher = IsWindowsFileSystem(filesystem.get()) ? std::unique_ptr<FileCipher>(std::make_unique<PooledGammaFileCipher>(filesystem, io_policy, pool, directory_split_size)) : CreateFileCipher(gamma_cipher, filesystem, io_policy);
+					return DirectoryJob::lane_t { QueryCore(engine, filesystem, io_policy, key_storage, std::move(cipher)), QueryWiper(wipe_algorithm, filesystem) };
+				};
+
+				WorkStealingPool* executor_pool = nullptr;
+				{
+					std::lock_guard<std::mutex> lock(executor_guard);
+					executor_pool = &GetExecutor();
+				}
+				DirectoryJob job(m_filesystem, create_lane, *executor_pool); // KAA: the operation may run on the executor already, waiting for the job there runs its tasks.
+				results = ( job.*process )(path, { key_storage_path }, progress_relay, operation_name);
+			}
+			catch(...)
+			{
+				reopen_core();
+				throw;
+			}
+			reopen_core();
+			FlushProgress();
+			return results;
+		}
+
+		// NOTE: executor_guard held.
+		WorkStealingPool& ServerCommunicator::GetExecutor(void)
 		{
+			if(nullptr == executor)
+				executor = std::make_unique<WorkStealingPool>(m_settings.concurrency);
+			return *executor;
+		}
+
+		std::shared_ptr<batch_operation_t> ServerCommunicator::StartOperation(std::function<std::vector<file_result_t>(void)> work, std::shared_ptr<CommunicatorProgressHandler> handler)
+		{
+			auto operation = std::make_shared<batch_operation_t>();
+			auto progress = std::make_shared<OperationProgress>(std::move(handler), operation, closing);
+
+			std::lock_guard<std::mutex> lock(executor_guard);
+			pending_operations.push_back([this, operation, progress, work]
+			{
+				if(operation->IsCancelled() || closing)
+					return operation->Fail(std::make_exception_ptr(OperationCancelled()));
+
+				std::vector<file_result_t> results;
+				try
+				{
+					std::lock_guard<std::shared_timed_mutex> lock(core_guard);
+					const ScopedCancellationCheck cancellation_check(operation_cancelled, [this, operation] { return operation->IsCancelled() || closing; });
+					const ScopedProgressHandler operation_progress([this](std::shared_ptr<CommunicatorProgressHandler> handler) { return InstallProgressHandler(std::move(handler)); }, progress);
+					results = work();
+				}
+				catch(...)
+				{
+					return operation->Fail(std::current_exception());
+				}
+				operation->Complete(std::move(results));
+			});
+
+			if(!strand_running)
+			{
+				strand_running = true;
+				GetExecutor().Submit(operations, task_kind_t::cpu, [this] { RunOperations(); });
+			}
+			return operation;
+		}
+
+		// NOTE: the strand: runs queued operations in the order started until there are none left.
+		void ServerCommunicator::RunOperations(void)
+		{
+			for(;;)
+			{
+				std::function<void(void)> operation;
+				{
+					std::lock_guard<std::mutex> lock(executor_guard);
+					if(pending_operations.empty())
+					{
+						strand_running = false;
+						return;
+					}
+					operation = std::move(pending_operations.front());
+					pending_operations.pop_front();
+				}
+				operation();
+			}
+		}
+
+		// NOTE: runs queries in the order started; once the communicator is closing, the queries left fail.
+		void ServerCommunicator::RunQueries(void)
+		{
+			std::unique_lock<std::mutex> lock(query_guard);
+			for(;;)
+			{
+				query_added.wait(lock, [this] { return !pending_queries.empty() || closing; });
+				if(pending_queries.empty())
+					return;
+				const auto query = std::move(pending_queries.front());
+				pending_queries.pop_front();
+				lock.unlock();
+				query();
+				lock.lock();
+			}
+		}
+
+		void ServerCommunicator::EncryptFileOutOfPlace(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			const TraceSpan span("EncryptFile", file_size);
+			const auto encrypted = m_filesystem->get_temp_filename(path.get_directory());
+
+			// TODO: KAA: #SubOperationStarted
+			OperationStarted(stage_names.encrypting_file, file_size);
+			try
+			{
+				m_core->EncryptFile(path, encrypted);
+			}
+			catch(...)
+			{
+				if(IsCreated(*m_filesystem, encrypted))
+					m_filesystem->remove_file(encrypted); // KAA: ciphertext only, the original is intact.
+				throw;
+			}
+			filesystem::path::file plain;
+			try
+			{
+				plain = PutInPlace(path, encrypted);
+			}
+			catch(...)
+			{
+				try
+				{
+					m_core->DecryptFile(encrypted); // KAA: removes the key of the ciphertext, the original stays plain.
+					DiscardFile(encrypted, file_size);
+				}
+				catch(...)
+				{
+					// DEFECT: KAA: the ciphertext is left under a temporary name; the original is intact, the error of the stage is the one to report.
+				}
+				throw;
+			}
+
+			OperationStarted(stage_names.wiping_file, file_size);
+			DiscardFile(plain, file_size);
+		}
+
+		void ServerCommunicator::DecryptFileOutOfPlace(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			const TraceSpan span("DecryptFile", file_size);
+			const auto decrypted = m_filesystem->get_temp_filename(path.get_directory());
+
+			OperationStarted(stage_names.decrypting_file, file_size);
+			try
+			{
+				m_core->DecryptFile(path, decrypted);
+			}
+			catch(...)
+			{
+				if(IsCreated(*m_filesystem, decrypted))
+					DiscardFile(decrypted, file_size); // KAA: may hold plain text already.
+				throw;
+			}
+			filesystem::path::file encrypted;
+			try
+			{
+				encrypted = PutInPlace(path, decrypted);
+			}
+			catch(...)
+			{
+				// KAA: the key has been removed with the decryption, the decrypted file is the only copy of the data left.
+				throw std::runtime_error(LoadStageName(IDS_BACKUP_NOT_RESTORED) + to_UTF8(decrypted.to_wstring()));
+			}
+
+			OperationStarted(stage_names.removing_backup, file_size);
+			RemoveFile(encrypted);
+		}
+
+		filesystem::path::file ServerCommunicator::BackupFile(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			const TraceSpan span("BackupFile", file_size);
 			auto backup_file_path = m_filesystem->get_temp_filename(path.get_directory());
-			CopyFile(path, backup_file_path); // FUTURE: KAA: remove incomplete file.
+			try
+			{
+				CopyFile(path, backup_file_path);
+			}
+			catch(...)
+			{
+				if(IsCreated(*m_filesystem, backup_file_path))
+					m_filesystem->remove_file(backup_file_path); // KAA: incomplete copy, the original is intact.
+				throw;
+			}
 			return backup_file_path;
 		}
 
+		// NOTE: rollback of an in-place stage that has not completed: the backup takes the place of the file again.
+		// Called from a catch block: throws only if the backup stays where it is, the message tells the user where that is.
+		void ServerCommunicator::RestoreBackup(const filesystem::path::file& path, const filesystem::path::file& backup, const uint64_t file_size)
+		{
+			const TraceSpan span("RestoreBackup", file_size);
+			filesystem::path::file damaged;
+			try
+			{
+				damaged = PutInPlace(path, backup);
+			}
+			catch(...)
+			{
+				throw std::runtime_error(LoadStageName(IDS_BACKUP_NOT_RESTORED) + to_UTF8(backup.to_wstring()));
+			}
+
+			try
+			{
+				DiscardFile(damaged, file_size); // KAA: partly processed, may hold plain text.
+			}
+			catch(...)
+			{
+				// DEFECT: KAA: the damaged file is left under a temporary name; the file itself is restored, the error of the stage is the one to report.
+			}
+		}
+
+		filesystem::path::file ServerCommunicator::PutInPlace(const filesystem::path::file& path, const filesystem::path::file& replacement)
+		{
+			const TraceSpan span("ReplaceFile");
+			return ReplaceOriginal(*m_filesystem, path, replacement);
+		}
+
+		void ServerCommunicator::RemoveFile(const filesystem::path::file& path)
+		{
+			const TraceSpan span("RemoveFile");
+			m_filesystem->remove_file(path);
+		}
+
 		void ServerCommunicator::CopyFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path)
 		{
+			// KAA: block clone and system copy only apply when paths are native Windows files.
+			if(IsWindowsFileSystem(m_filesystem.get()))
+			{
+				const auto report = [this](const uint64_t size) { return PortionProcessed(size); };
+				if(CloneFile(source_path, destination_path, report) || SystemCopyFile(source_path, destination_path, report))
+					return;
+			}
+
 			const KAA::filesystem::driver::mode sequential_read_only(false, true);
 			const KAA::filesystem::driver::share exclusive_access(false, false);
 			const auto source = m_filesystem->open_file(source_path, sequential_read_only, exclusive_access);
@@ -350,10 +1328,13 @@ namespace KAA
 			const KAA::filesystem::driver::mode sequential_write_only(true, false);
 			const KAA::filesystem::driver::permission allow_read_write;
 			const auto destination = m_filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+			PreallocateFile(*destination, source->get_size());
 
 			{
-				constexpr auto chunk_size = 64U * 1024U; // 64 KiB
-				std::vector<uint8_t> buffer(chunk_size);
+				const auto chunk_size = m_io_policy->GetParameters(destination_path).chunk_size;
+				if(copy_buffer.size() < chunk_size)
+					copy_buffer.resize(chunk_size); // KAA: kept for the following files.
+				auto& buffer = copy_buffer;
 				{
 					size_t bytes_read = 0;
 					size_t bytes_written = 0;
@@ -361,7 +1342,7 @@ namespace KAA
 					{
 						bytes_read = source->read(chunk_size, &buffer[0]);
 						bytes_written = destination->write(&buffer[0], bytes_read);
-						PortionProcessed(bytes_written);
+						CheckProgressState(PortionProcessed(bytes_written));
 
 						if(bytes_read != bytes_written)
 						{
@@ -374,18 +1355,81 @@ namespace KAA
 			destination->commit();
 		}
 
+		// NOTE: a wipe cancelled halfway leaves the file behind, it is removed then: the operation stops within a chunk, the file is gone all the same.
+		void ServerCommunicator::DiscardFile(const filesystem::path::file& path, const uint64_t file_size)
+		{
+			const TraceSpan span("WipeFile", file_size);
+			try
+			{
+				m_wiper->wipe_file(path);
+			}
+			catch(const OperationCancelled&)
+			{
+				m_filesystem->remove_file(path);
+			}
+		}
+
 		progress_state_t ServerCommunicator::OperationStarted(const std::string& name, uint64_t size)
 		{
-			if(nullptr != server_progress)
-				return server_progress->OperationStarted(name, size);
+			if(nullptr != progress_relay)
+				return progress_relay->OperationStarted(name, size);
 			return progress_state_t::quiet;
 		}
 
 		progress_state_t ServerCommunicator::PortionProcessed(uint64_t size)
 		{
-			if(nullptr != server_progress)
-				return server_progress->OperationProgress(size);
+			if(nullptr != progress_relay)
+				return progress_relay->OperationProgress(size);
 			return progress_state_t::quiet;
 		}
+
+		// NOTE: the handler gets the progress of an operation before the operation returns.
+		void ServerCommunicator::FlushProgress(void)
+		{
+			if(nullptr != progress_relay)
+				progress_relay->Flush();
+		}
+
+		// NOTE: the file is written once, when the communicator is destroyed: spans of the whole session make one trace.
+		// The trace of the previous session is replaced: the new one is written next to it and takes its place once complete.
+		void ServerCommunicator::SaveTrace(void)
+		{
+			const auto json = tracer->Export();
+			const filesystem::path::file path { m_settings.trace_file };
+			const auto written = m_filesystem->get_temp_filename(path.get_directory());
+			try
+			{
+				const KAA::filesystem::driver::create_mode persistent_not_exists;
+				const KAA::filesystem::driver::mode sequential_write_only(true, false);
+				const KAA::filesystem::driver::share exclusive_access(false, false);
+				const KAA::filesystem::driver::permission allow_read_write;
+				const auto trace = m_filesystem->create_file(written, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+				if(trace->write(json.data(), json.size()) != json.size())
+					throw std::runtime_error(__FUNCTION__);
+				trace->commit();
+			}
+			catch(...)
+			{
+				if(IsCreated(*m_filesystem, written))
+					m_filesystem->remove_file(written);
+				throw;
+			}
+
+			if(!filesystem::file_exists(*m_filesystem, path))
+			{
+				m_filesystem->rename_file(written, path);
+				return;
+			}
+			try
+			{
+				m_filesystem->remove_file(ReplaceOriginal(*m_filesystem, path, written));
+			}
+			catch(...)
+			{
+				if(IsCreated(*m_filesystem, written))
+					m_filesystem->remove_file(written); // KAA: the trace of the previous session is kept.
+				throw;
+			}
+		}
 	}
 }
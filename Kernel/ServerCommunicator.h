@@ -2,13 +2,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "KAA/include/progress_state.h"
 
 #include "../Common/Communicator.h"
 
+#include "CoreFactory.h"
+#include "WiperFactory.h"
+#include "WorkStealingPool.h"
+
 namespace KAA
 {
 	namespace system
@@ -25,13 +39,44 @@ namespace KAA
 	namespace FileSecurity
 	{
 		class Core;
+		class DirectoryJob;
+		class IOPolicy;
 		class CoreProgressDispatcher;
+		class ProgressRelay;
+		class Tracer;
 		class WiperProgressDispatcher;
 
+		enum class processing_t
+		{
+			in_place, // NOTE: backup copy, in-place rewrite, backup wipe.
+			out_of_place // NOTE: result streamed into a temporary file next to the original, atomic replace, previous content wiped.
+		};
+
+		// NOTE: what a communicator works with; the settings of the current user are kept in the registry.
+		struct server_settings_t
+		{
+			core_t engine;
+			cipher_t cipher;
+			key_storage_t key_storage;
+			key_storage_layout_t key_storage_layout;
+			filesystem::path::directory key_storage_path;
+			wiper_t wipe_algorithm;
+			processing_t processing;
+			std::chrono::milliseconds progress_interval;
+			std::wstring trace_file; // KAA: empty unless tracing.
+			concurrency_limits_t concurrency; // KAA: 0 - chosen automatically: a worker per processor core, the queue depth of the key storage volume.
+		};
+
+		// RETURNS: settings of a new installation with the key storage given.
+		server_settings_t GetDefaultSettings(filesystem::path::directory key_storage_path);
+
 		class ServerCommunicator final : public Communicator
 		{
 		public:
+			// NOTE: works with the settings of the current user, changes to them are saved.
 			explicit ServerCommunicator(std::shared_ptr<filesystem::driver>);
+			// NOTE: works with the settings given, the settings of the current user are neither read nor changed.
+			ServerCommunicator(std::shared_ptr<filesystem::driver>, server_settings_t);
 			ServerCommunicator(const ServerCommunicator&) = delete;
 			ServerCommunicator(ServerCommunicator&&) = delete;
 			~ServerCommunicator();
@@ -40,20 +85,67 @@ namespace KAA
 			ServerCommunicator& operator = (ServerCommunicator&&) = delete;
 
 		private:
-			std::unique_ptr<system::registry> m_registry;
+			// NOTE: names of the stages reported to the progress handler, loaded once.
+			struct stage_names_t
+			{
+				std::string creating_backup;
+				std::string encrypting_file;
+				std::string wiping_file;
+				std::string decrypting_file;
+				std::string removing_backup;
+			};
+
+			std::unique_ptr<system::registry> m_registry; // KAA: nullptr unless the settings are those of the current user.
+			server_settings_t m_settings;
 			std::shared_ptr<filesystem::driver> m_filesystem;
+			std::shared_ptr<IOPolicy> m_io_policy;
 			std::unique_ptr<filesystem::wiper> m_wiper;
 			std::unique_ptr<Core> m_core;
+			std::unique_ptr<Tracer> tracer;
+			const stage_names_t stage_names;
+			std::vector<uint8_t> copy_buffer;
 
 			std::shared_ptr<CoreProgressDispatcher> core_progress;
 			std::shared_ptr<WiperProgressDispatcher> wiper_progress;
 			std::shared_ptr<CommunicatorProgressHandler> server_progress;
+			// NOTE: stands between the dispatchers and the handler: chunks go to its counter, the handler gets them at the progress interval.
+			std::shared_ptr<ProgressRelay> progress_relay;
+			std::function<bool(void)> operation_cancelled; // KAA: core_guard held exclusively: set while an asynchronous operation runs.
+
+			// KAA: shared by status queries, exclusive to operations changing files or settings.
+			mutable std::shared_timed_mutex core_guard;
+			std::atomic<bool> closing;
+
+			// NOTE: asynchronous operations changing files are queued (strand) and run one at a time by a task of the executor.
+			std::mutex executor_guard;
+			std::unique_ptr<WorkStealingPool> executor; // KAA: created on the first asynchronous operation.
+			WorkStealingPool::TaskGroup operations;
+			std::deque<std::function<void(void)>> pending_operations;
+			bool strand_running;
+
+			// NOTE: status queries are answered by a thread of their own: waiting for the core, a query holds no slot of the executor the operation holding the core needs.
+			std::mutex query_guard;
+			std::condition_variable query_added;
+			std::deque<std::function<void(void)>> pending_queries;
+			std::thread query_thread; // KAA: started on the first status query.
 
 			void IEncryptFile(const filesystem::path::file&) override;
 			void IDecryptFile(const filesystem::path::file&) override;
 
+			std::vector<file_result_t> IEncryptFiles(const std::vector<filesystem::path::file>&) override;
+			std::vector<file_result_t> IDecryptFiles(const std::vector<filesystem::path::file>&) override;
+
+			std::vector<file_result_t> IEncryptDirectory(const filesystem::path::directory&) override;
+			std::vector<file_result_t> IDecryptDirectory(const filesystem::path::directory&) override;
+
 			bool IIsFileEncrypted(const filesystem::path::file&) const override;
 
+			std::shared_ptr<batch_operation_t> IStartEncryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartDecryptFiles(const std::vector<filesystem::path::file>&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartEncryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<batch_operation_t> IStartDecryptDirectory(const filesystem::path::directory&, std::shared_ptr<CommunicatorProgressHandler>) override;
+			std::shared_ptr<query_operation_t> IStartIsFileEncrypted(const filesystem::path::file&) override;
+
 			std::vector<std::pair<std::wstring, core_id>> IGetAvailableCiphers(void) const override;
 			core_id IGetCipher(void) const override;
 			void ISetCipher(core_id) override;
@@ -67,11 +159,33 @@ namespace KAA
 
 			std::shared_ptr<CommunicatorProgressHandler> ISetProgressHandler(std::shared_ptr<CommunicatorProgressHandler>) override;
 
-			filesystem::path::file BackupFile(const filesystem::path::file&);
+			ServerCommunicator(std::shared_ptr<filesystem::driver>, server_settings_t, std::unique_ptr<system::registry>);
+
+			std::shared_ptr<CommunicatorProgressHandler> InstallProgressHandler(std::shared_ptr<CommunicatorProgressHandler>);
+
+			WorkStealingPool& GetExecutor(void);
+			std::shared_ptr<batch_operation_t> StartOperation(std::function<std::vector<file_result_t>(void)>, std::shared_ptr<CommunicatorProgressHandler>);
+			void RunOperations(void);
+			void RunQueries(void);
+
+			void Encrypt(const filesystem::path::file&, uint64_t file_size);
+			void Decrypt(const filesystem::path::file&, uint64_t file_size);
+			void EncryptFileOutOfPlace(const filesystem::path::file&, uint64_t file_size);
+			void DecryptFileOutOfPlace(const filesystem::path::file&, uint64_t file_size);
+			std::vector<file_result_t> ProcessFiles(const std::vector<filesystem::path::file>&, void (ServerCommunicator::*)(const filesystem::path::file&, uint64_t), const std::string& operation_name);
+			std::vector<file_result_t> ProcessDirectory(const filesystem::path::directory&, std::vector<file_result_t> (DirectoryJob::*)(const filesystem::path::directory&, const std::vector<filesystem::path::directory>&, std::shared_ptr<CommunicatorProgressHandler>, const std::string&), const std::string& operation_name);
+
+			filesystem::path::file BackupFile(const filesystem::path::file&, uint64_t file_size);
+			void RestoreBackup(const filesystem::path::file& path, const filesystem::path::file& backup, uint64_t file_size);
+			filesystem::path::file PutInPlace(const filesystem::path::file& path, const filesystem::path::file& replacement);
 			void CopyFile(const filesystem::path::file& from, const filesystem::path::file& to);
+			void DiscardFile(const filesystem::path::file&, uint64_t file_size);
+			void RemoveFile(const filesystem::path::file&);
 
 			progress_state_t OperationStarted(const std::string& name, uint64_t size);
 			progress_state_t PortionProcessed(uint64_t size);
+			void FlushProgress(void);
+			void SaveTrace(void);
 		};
 	}
 }
@@ -0,0 +1,191 @@
+#include "ShardedKeyStorage.h"
+
+#include <cerrno>
+
+#include "KAA/include/exception/operation_failure.h"
+#include "KAA/include/exception/system_failure.h"
+#include "KAA/include/filesystem/driver.h"
+
+#include "KeyPathDigest.h"
+
+namespace
+{
+	constexpr size_t shard_name_length = 2U; // KAA: 256 subdirectories per level.
+
+	std::wstring GetKeyName(const KAA::filesystem::path::file& key_path)
+	{
+		const auto path = key_path.to_wstring();
+		const auto separator = path.find_last_of(L"\\/");
+		return std::wstring::npos == separator ? path : path.substr(separator + 1);
+	}
+
+	bool IsShardable(const std::wstring& key_name)
+	{
+		return key_name.length() > 2 * shard_name_length;
+	}
+
+	KAA::filesystem::path::directory GetShard(const KAA::filesystem::path::directory& storage_path, const std::wstring& key_name, const size_t level)
+	{
+		auto shard = storage_path;
+		for(size_t depth = 0; depth <= level; ++depth)
+			shard = KAA::filesystem::path::directory { ( shard + key_name.substr(depth * shard_name_length, shard_name_length) ).to_wstring() };
+		return shard;
+	}
+
+	// NOTE: digest of the wrapped storage, its key path is moved into the shard.
+	class ShardedKeyPathDigest final : public KAA::FileSecurity::KeyPathDigest
+	{
+	public:
+		ShardedKeyPathDigest(std::shared_ptr<KAA::FileSecurity::KeyPathDigest> digest, KAA::filesystem::path::directory storage_path) :
+		digest(std::move(digest)),
+		storage_path(std::move(storage_path))
+		{}
+
+		ShardedKeyPathDigest(const ShardedKeyPathDigest&) = delete;
+		ShardedKeyPathDigest& operator = (const ShardedKeyPathDigest&) = delete;
+
+	private:
+		std::shared_ptr<KAA::FileSecurity::KeyPathDigest> digest;
+		KAA::filesystem::path::directory storage_path;
+
+		void IChunkWritten(const uint64_t offset, const void* data, const size_t size) override
+		{
+			digest->ChunkWritten(offset, data, size);
+		}
+
+		bool IIsComplete(const uint64_t file_size) const override
+		{
+			return digest->IsComplete(file_size);
+		}
+
+		KAA::filesystem::path::file IGetKeyPath(void) override
+		{
+			return KAA::FileSecurity::GetShardedKeyPath(storage_path, digest->GetKeyPath());
+		}
+	};
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		ShardedKeyStorage::ShardedKeyStorage(std::unique_ptr<KeyStorage> storage, std::shared_ptr<filesystem::driver> driver) :
+		m_storage(std::move(storage)),
+		m_filesystem(std::move(driver))
+		{
+			if(!m_storage || !m_filesystem)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create sharded key storage class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+		}
+
+		void ShardedKeyStorage::ISetPath(filesystem::path::directory path)
+		{
+			m_storage->SetPath(std::move(path));
+			std::lock_guard<std::mutex> lock(shards_guard);
+			created_shards.clear();
+		}
+
+		filesystem::path::directory ShardedKeyStorage::IGetPath(void) const
+		{
+			return m_storage->GetPath();
+		}
+
+		// NOTE: a new key goes to the sharded layout, an existing one is looked up there first and in the flat layout then.
+		filesystem::path::file ShardedKeyStorage::IGetKeyPathForSpecifiedPath(const filesystem::path::file& path) const
+		{
+			const auto flat_key_path = m_storage->GetKeyPathForSpecifiedPath(path);
+			auto key_path = GetShardedKeyPath(m_storage->GetPath(), flat_key_path);
+			if(m_storage->ContainsKey(key_path) || !m_storage->ContainsKey(flat_key_path))
+				return key_path;
+			return flat_key_path;
+		}
+
+		std::shared_ptr<KeyPathDigest> ShardedKeyStorage::IStartKeyPathDigest(void) const
+		{
+			auto digest = m_storage->StartKeyPathDigest();
+			if(!digest)
+				return nullptr;
+			return std::make_shared<ShardedKeyPathDigest>(std::move(digest), m_storage->GetPath());
+		}
+
+		void ShardedKeyStorage::IRememberKeyPath(const filesystem::path::file& path, const filesystem::path::file& key_path)
+		{
+			m_storage->RememberKeyPath(path, key_path);
+		}
+
+		void ShardedKeyStorage::ISetCancellationToken(std::shared_ptr<CancellationToken> token)
+		{
+			m_storage->SetCancellationToken(std::move(token));
+		}
+
+		void ShardedKeyStorage::IStoreKey(const filesystem::path::file& key_file, const filesystem::path::file& key_path)
+		{
+			const auto key_name = GetKeyName(key_path);
+			if(IsShardable(key_name) && ( GetShardedKeyPath(m_storage->GetPath(), key_path).to_wstring() == key_path.to_wstring() ))
+				CreateShard(key_name);
+			m_storage->StoreKey(key_file, key_path);
+		}
+
+		bool ShardedKeyStorage::IContainsKey(const filesystem::path::file& key_path) const
+		{
+			return m_storage->ContainsKey(key_path);
+		}
+
+		filesystem::path::file ShardedKeyStorage::ILoadKey(const filesystem::path::file& key_path)
+		{
+			return m_storage->LoadKey(key_path);
+		}
+
+		std::unique_ptr<filesystem::file> ShardedKeyStorage::IOpenKey(const filesystem::path::file& key_path)
+		{
+			return m_storage->OpenKey(key_path);
+		}
+
+		void ShardedKeyStorage::IUnloadKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return m_storage->UnloadKey(key_path, key_file);
+		}
+
+		// KAA: emptied shards are kept, they are likely to be filled again.
+		void ShardedKeyStorage::IRemoveKey(const filesystem::path::file& key_path, const filesystem::path::file& key_file)
+		{
+			return m_storage->RemoveKey(key_path, key_file);
+		}
+
+		void ShardedKeyStorage::CreateShard(const std::wstring& key_name)
+		{
+			const auto shard_name = key_name.substr(0, 2 * shard_name_length);
+			std::lock_guard<std::mutex> lock(shards_guard);
+			if(created_shards.end() != created_shards.find(shard_name))
+				return;
+
+			const auto storage_path = m_storage->GetPath();
+			for(size_t level = 0; level < 2; ++level)
+			{
+				try
+				{
+					m_filesystem->create_directory(GetShard(storage_path, key_name, level));
+				}
+				catch(const system_failure& error)
+				{
+					if(EEXIST != error)
+						throw;
+				}
+			}
+			created_shards.insert(shard_name);
+		}
+
+		filesystem::path::file GetShardedKeyPath(const filesystem::path::directory& storage_path, const filesystem::path::file& key_path)
+		{
+			const auto key_name = GetKeyName(key_path);
+			if(!IsShardable(key_name))
+				return storage_path + key_name;
+			return GetShard(storage_path, key_name, 1) + key_name;
+		}
+	}
+}
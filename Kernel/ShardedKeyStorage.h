@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+#include "KeyStorage.h"
+
+namespace KAA
+{
+	namespace filesystem
+	{
+		class driver;
+	}
+
+	namespace FileSecurity
+	{
+		// NOTE: spreads key files of the wrapped storage over two levels of subdirectories named after the first hex digits of the key name
+		// (ab\cd\abcd...bin), so that no directory of a large key storage holds more than a few entries. Keys in the flat layout are still found.
+		class ShardedKeyStorage final : public KeyStorage
+		{
+		public:
+			ShardedKeyStorage(std::unique_ptr<KeyStorage>, std::shared_ptr<filesystem::driver>);
+			ShardedKeyStorage(const ShardedKeyStorage&) = delete;
+			ShardedKeyStorage(ShardedKeyStorage&&) = delete;
+			~ShardedKeyStorage() = default;
+
+			ShardedKeyStorage& operator = (const ShardedKeyStorage&) = delete;
+			ShardedKeyStorage& operator = (ShardedKeyStorage&&) = delete;
+
+		private:
+			std::unique_ptr<KeyStorage> m_storage;
+			std::shared_ptr<filesystem::driver> m_filesystem;
+
+			std::mutex shards_guard;
+			std::set<std::wstring> created_shards;
+
+			void ISetPath(filesystem::path::directory) override;
+			filesystem::path::directory IGetPath(void) const override;
+
+			filesystem::path::file IGetKeyPathForSpecifiedPath(const filesystem::path::file&) const override;
+			std::shared_ptr<KeyPathDigest> IStartKeyPathDigest(void) const override;
+			void IRememberKeyPath(const filesystem::path::file&, const filesystem::path::file&) override;
+			void ISetCancellationToken(std::shared_ptr<CancellationToken>) override;
+
+			void IStoreKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			bool IContainsKey(const filesystem::path::file&) const override;
+			filesystem::path::file ILoadKey(const filesystem::path::file&) override;
+			std::unique_ptr<filesystem::file> IOpenKey(const filesystem::path::file&) override;
+			void IUnloadKey(const filesystem::path::file&, const filesystem::path::file&) override;
+			void IRemoveKey(const filesystem::path::file&, const filesystem::path::file&) override;
+
+			void CreateShard(const std::wstring& key_name);
+		};
+
+		// RETURNS: path of the key in the sharded layout of the storage; names shorter than the shard prefix stay in the storage directory.
+		filesystem::path::file GetShardedKeyPath(const filesystem::path::directory& storage_path, const filesystem::path::file& key_path);
+	}
+}
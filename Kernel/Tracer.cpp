@@ -0,0 +1,142 @@
+#include "Tracer.h"
+
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	// KAA: small numbers in order of the first span of a thread, easier to read in a viewer than system thread ids.
+	uint32_t GetTraceThreadID(void)
+	{
+		static std::atomic<uint32_t> next_thread(1);
+		thread_local const uint32_t thread = next_thread++;
+		return thread;
+	}
+
+	double ToMicroseconds(const std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+
+	void WriteString(std::ostream& stream, const char* text)
+	{
+		stream << '"';
+		for(; '\0' != *text; ++text)
+		{
+			if('"' == *text || '\\' == *text)
+				stream << '\\';
+			stream << *text;
+		}
+		stream << '"';
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		std::atomic<Tracer*> Tracer::active(nullptr);
+
+		Tracer::Tracer() :
+		origin(std::chrono::steady_clock::now())
+		{}
+
+		void Tracer::Install(Tracer* tracer)
+		{
+			active.store(tracer, std::memory_order_release);
+		}
+
+		Tracer* Tracer::GetActive(void)
+		{
+			return active.load(std::memory_order_acquire);
+		}
+
+		void Tracer::Record(const char* name, const std::chrono::steady_clock::time_point begin, const std::chrono::steady_clock::time_point end, const uint64_t bytes)
+		{
+			const auto thread = GetTraceThreadID();
+			std::lock_guard<std::mutex> lock(guard);
+			events.push_back({ name, begin, end, thread, bytes });
+		}
+
+		void Tracer::Count(const char* name, const std::chrono::steady_clock::time_point time, const std::initializer_list<std::pair<const char*, uint64_t>> values)
+		{
+			counter_t counter = { name, time, values };
+			std::lock_guard<std::mutex> lock(guard);
+			counters.push_back(std::move(counter));
+		}
+
+		// NOTE: complete events ("ph":"X") and counter events ("ph":"C"), timestamps and durations in microseconds since the tracer has been created.
+		std::string Tracer::Export(void) const
+		{
+			std::ostringstream json;
+			json << std::fixed << std::setprecision(3);
+			json << "{\"traceEvents\":[";
+			{
+				std::lock_guard<std::mutex> lock(guard);
+				for(size_t index = 0; index < events.size(); ++index)
+				{
+					const auto& event = events[index];
+					if(0 != index)
+						json << ',';
+					json << "\n{\"name\":";
+					WriteString(json, event.name);
+					json << ",\"cat\":\"kernel\",\"ph\":\"X\",\"ts\":" << ToMicroseconds(event.begin - origin);
+					json << ",\"dur\":" << ToMicroseconds(event.end - event.begin);
+					json << ",\"pid\":1,\"tid\":" << event.thread;
+					json << ",\"args\":{\"bytes\":" << event.bytes << "}}";
+				}
+				for(size_t index = 0; index < counters.size(); ++index)
+				{
+					const auto& counter = counters[index];
+					if(0 != index + events.size())
+						json << ',';
+					json << "\n{\"name\":";
+					WriteString(json, counter.name);
+					json << ",\"cat\":\"kernel\",\"ph\":\"C\",\"ts\":" << ToMicroseconds(counter.time - origin);
+					json << ",\"pid\":1,\"args\":{";
+					for(size_t value = 0; value < counter.values.size(); ++value)
+					{
+						if(0 != value)
+							json << ',';
+						WriteString(json, counter.values[value].first);
+						json << ':' << counter.values[value].second;
+					}
+					json << "}}";
+				}
+			}
+			json << "\n],\"displayTimeUnit\":\"ms\"}\n";
+			return json.str();
+		}
+
+		TraceSpan::TraceSpan(const char* name, const uint64_t bytes) :
+		tracer(Tracer::GetActive()),
+		name(name),
+		bytes(bytes)
+		{
+			if(nullptr != tracer)
+				begin = std::chrono::steady_clock::now();
+		}
+
+		TraceSpan::~TraceSpan()
+		{
+			if(nullptr == tracer)
+				return;
+			try
+			{
+				tracer->Record(name, begin, std::chrono::steady_clock::now(), bytes);
+			}
+			catch(...)
+			{} // KAA: a span lost is better than an operation failed.
+		}
+
+		bool TraceSpan::IsRecording(void) const
+		{
+			return nullptr != tracer;
+		}
+
+		void TraceSpan::SetBytes(const uint64_t value)
+		{
+			bytes = value;
+		}
+	}
+}
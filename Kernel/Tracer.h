@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: records spans of the stages of an operation (backup, key generation, cipher, key path hashing, wipe, ...) while it is installed,
+		// exported as Chrome trace JSON, opened by chrome://tracing and Perfetto. Spans are stages, not chunks: a file makes a handful of them.
+		class Tracer final
+		{
+		public:
+			Tracer();
+			Tracer(const Tracer&) = delete;
+			Tracer(Tracer&&) = delete;
+			~Tracer() = default;
+
+			Tracer& operator = (const Tracer&) = delete;
+			Tracer& operator = (Tracer&&) = delete;
+
+			// NOTE: one tracer at a time, nullptr stops tracing. The tracer has to outlive the spans started while it is installed.
+			static void Install(Tracer*);
+			// RETURNS: nullptr unless tracing, one atomic load.
+			static Tracer* GetActive(void);
+
+			// NOTE: name has to be a string literal (static storage), it is kept as a pointer.
+			void Record(const char* name, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end, uint64_t bytes);
+			// NOTE: values of named series at a time (e.g. cache hits and misses so far), drawn as a graph per name. Names are string literals as well.
+			void Count(const char* name, std::chrono::steady_clock::time_point time, std::initializer_list<std::pair<const char*, uint64_t>> values);
+
+			// RETURNS: trace events recorded so far, the JSON object format.
+			std::string Export(void) const;
+
+		private:
+			struct event_t
+			{
+				const char* name;
+				std::chrono::steady_clock::time_point begin;
+				std::chrono::steady_clock::time_point end;
+				uint32_t thread;
+				uint64_t bytes;
+			};
+
+			struct counter_t
+			{
+				const char* name;
+				std::chrono::steady_clock::time_point time;
+				std::vector<std::pair<const char*, uint64_t>> values;
+			};
+
+			static std::atomic<Tracer*> active;
+
+			const std::chrono::steady_clock::time_point origin;
+			mutable std::mutex guard;
+			std::vector<event_t> events;
+			std::vector<counter_t> counters;
+		};
+
+		// NOTE: a stage from construction to destruction, recorded by the active tracer. Costs a load and a branch when there is none.
+		class TraceSpan final
+		{
+		public:
+			explicit TraceSpan(const char* name, uint64_t bytes = 0);
+			TraceSpan(const TraceSpan&) = delete;
+			TraceSpan(TraceSpan&&) = delete;
+			~TraceSpan();
+
+			TraceSpan& operator = (const TraceSpan&) = delete;
+			TraceSpan& operator = (TraceSpan&&) = delete;
+
+			bool IsRecording(void) const;
+			// NOTE: for stages that learn their size on the way.
+			void SetBytes(uint64_t);
+
+		private:
+			Tracer* const tracer;
+			const char* const name;
+			uint64_t bytes;
+			std::chrono::steady_clock::time_point begin;
+		};
+	}
+}
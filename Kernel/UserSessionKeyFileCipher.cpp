@@ -1,22 +1,98 @@
 #include "UserSessionKeyFileCipher.h"
 
-#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
 
 #include "KAA/include/cryptography/cryptography.h"
 #include "KAA/include/exception/operation_failure.h"
 #include "KAA/include/filesystem/driver.h"
+#include "KAA/include/filesystem/path.h"
+#include "KAA/include/filesystem/wiper.h"
 
-#include "FileProgressHandler.h"
+#include "CancellationToken.h"
+#include "NativeCopy.h"
+#include "WiperFactory.h"
+
+namespace
+{
+	constexpr uint8_t signature[] = { 'F', 'S', 'U', 'K' };
+	constexpr uint32_t format_version = 2;
+	constexpr size_t file_id_size = 16;
+	constexpr size_t header_size = sizeof(signature) + 2 * sizeof(uint32_t) + file_id_size;
+	constexpr size_t length_size = sizeof(uint32_t);
+	constexpr size_t index_size = sizeof(uint64_t);
+	constexpr size_t prefix_size = file_id_size + index_size + 1; // NOTE: protected with the data of a chunk: identifier of the file, index of the chunk, kind of the frame.
+
+	enum frame_kind_t : uint8_t
+	{
+		data_frame,
+		end_frame // NOTE: follows the last data frame, carries no data; its index is the number of data frames.
+	};
+
+	constexpr uint32_t default_chunk_size = 1024U * 1024U; // 1 MiB
+	constexpr uint32_t max_chunk_size = 64U * 1024U * 1024U; // 64 MiB : bounds the memory a damaged header may ask for.
+	constexpr uint32_t max_protection_overhead = 64U * 1024U; // KAA: the system adds a few hundred bytes to the data.
+
+	void StoreLE(uint8_t* bytes, uint64_t value, const size_t size)
+	{
+		for(size_t index = 0; index < size; ++index, value >>= 8)
+			bytes[index] = static_cast<uint8_t>(value);
+	}
+
+	uint64_t LoadLE(const uint8_t* bytes, const size_t size)
+	{
+		uint64_t value = 0;
+		for(size_t index = size; 0 != index; --index)
+			value = ( value << 8 ) | bytes[index - 1];
+		return value;
+	}
+
+	// RETURNS: number of bytes read, less than size at the end of the file only.
+	size_t ReadFully(KAA::filesystem::file& file, const size_t size, void* buffer)
+	{
+		auto bytes = static_cast<uint8_t*>(buffer);
+		size_t total = 0;
+		for(size_t bytes_read = 1; ( total < size ) && ( 0 != bytes_read ); total += bytes_read)
+			bytes_read = file.read(size - total, bytes + total);
+		return total;
+	}
+
+	void WriteFully(KAA::filesystem::file& file, const void* data, const size_t size)
+	{
+		if(file.write(data, size) != size)
+			throw std::runtime_error(__FUNCTION__); // DEFECT: KAA: correct?
+	}
+
+	[[noreturn]] void ThrowDamaged(const char* source)
+	{
+		constexpr auto description = "unable to unprotect file: the file is not protected by the user session or has been damaged";
+		constexpr auto reason = KAA::operation_failure::status_code_t::invalid_argument;
+		constexpr auto severity = KAA::operation_failure::severity_t::error;
+		throw KAA::operation_failure(source, description, reason, severity);
+	}
+}
 
 namespace KAA
 {
 	namespace FileSecurity
 	{
+		session_protection_t GetUserSessionProtection(void)
+		{
+			return { &cryptography::protect_data, &cryptography::unprotect_data };
+		}
+
 		UserSessionKeyFileCipher::UserSessionKeyFileCipher(std::shared_ptr<filesystem::driver> driver) :
+		UserSessionKeyFileCipher(std::move(driver), GetUserSessionProtection(), default_chunk_size)
+		{}
+
+		UserSessionKeyFileCipher::UserSessionKeyFileCipher(std::shared_ptr<filesystem::driver> driver, session_protection_t session_protection, const uint32_t chunk_size) :
 		filesystem(std::move(driver)),
-		cipher_progress(nullptr)
+		protection(std::move(session_protection)),
+		chunk_size(chunk_size),
+		wiper(nullptr == filesystem ? nullptr : QueryWiper(wiper_t::simple_overwrite, filesystem))
 		{
-			if (!filesystem)
+			if (( !filesystem ) || ( !protection.protect ) || ( !protection.unprotect ) || ( 0 == chunk_size ) || ( max_chunk_size < chunk_size ))
 			{
 				constexpr auto source = __FUNCTION__ ;
 				constexpr auto description = "unable to create user session key based file cipher class instance";
@@ -26,52 +102,176 @@ namespace KAA
 			}
 		}
 
+		UserSessionKeyFileCipher::~UserSessionKeyFileCipher() = default;
+
 		void UserSessionKeyFileCipher::IEncryptFile(const filesystem::path::file& path, const filesystem::path::file&)
 		{
-			const filesystem::driver::mode serial_read_write { true, true, true, false };
-			const filesystem::driver::share exclusive_access { false, false };
-			const auto master = filesystem->open_file(path, serial_read_write, exclusive_access);
+			return ProcessInPlace(path, &UserSessionKeyFileCipher::Protect);
+		}
 
-			// DEFECT: KAA: reads whole file to memory.
-			const auto data_size = master->get_size();
-			std::vector<uint8_t> master_buffer(data_size);
+		void UserSessionKeyFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file&)
+		{
+			return ProcessInPlace(path, &UserSessionKeyFileCipher::Unprotect);
+		}
 
-			const auto bytes_read = master->read(data_size, &master_buffer[0]);
-			master_buffer = cryptography::protect_data(&master_buffer[0], bytes_read);
-			master->seek(0, filesystem::file::set);
-			const auto bytes_written = master->write(&master_buffer[0], bytes_read);
+		void UserSessionKeyFileCipher::IEncryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file&)
+		{
+			return ProcessFile(source, destination, &UserSessionKeyFileCipher::Protect);
+		}
 
-			if (0 != bytes_read)
-				ChunkProcessed(bytes_written);
+		void UserSessionKeyFileCipher::IDecryptFile(const filesystem::path::file& source, const filesystem::path::file& destination, const filesystem::path::file&)
+		{
+			return ProcessFile(source, destination, &UserSessionKeyFileCipher::Unprotect);
 		}
 
-		void UserSessionKeyFileCipher::IDecryptFile(const filesystem::path::file& path, const filesystem::path::file&)
+		void UserSessionKeyFileCipher::Protect(filesystem::file& source, filesystem::file& destination)
 		{
-			const filesystem::driver::mode serial_read_write { true, true, true, false };
-			const filesystem::driver::share exclusive_access { false, false };
-			const auto master = filesystem->open_file(path, serial_read_write, exclusive_access);
+			uint8_t header[header_size] = { 0 };
+			std::copy(std::begin(signature), std::end(signature), header);
+			StoreLE(header + sizeof(signature), format_version, sizeof(uint32_t));
+			StoreLE(header + sizeof(signature) + sizeof(uint32_t), chunk_size, sizeof(uint32_t));
+			const auto file_id = header + header_size - file_id_size;
+			cryptography::generate(file_id_size, file_id); // KAA: frames of another file do not carry it.
+			WriteFully(destination, header, header_size);
+			ChunkWritten(0, header, header_size);
+			uint64_t offset = header_size;
 
-			const auto data_size = master->get_size();
-			std::vector<uint8_t> master_buffer(data_size);
+			std::vector<uint8_t> chunk(prefix_size + chunk_size); // NOTE: prefix of the chunk, then its data.
+			std::copy(file_id, file_id + file_id_size, chunk.begin());
+			const auto write_frame = [&](const uint64_t index, const frame_kind_t kind, const size_t data_size)
+			{
+				StoreLE(&chunk[file_id_size], index, index_size);
+				chunk[file_id_size + index_size] = kind;
+				const auto frame = protection.protect(&chunk[0], prefix_size + data_size);
+
+				uint8_t length[length_size] = { 0 };
+				StoreLE(length, frame.size(), length_size);
+				WriteFully(destination, length, length_size);
+				ChunkWritten(offset, length, length_size);
+				offset += length_size;
+				WriteFully(destination, &frame[0], frame.size());
+				ChunkWritten(offset, &frame[0], frame.size());
+				offset += frame.size();
+			};
+
+			auto progress = progress_state_t::proceed;
+			uint64_t index = 0;
+			for(;; ++index)
+			{
+				const auto bytes_read = ReadFully(source, chunk_size, &chunk[prefix_size]);
+				if(0 == bytes_read)
+					break;
+				write_frame(index, data_frame, bytes_read);
 
-			const auto bytes_read = master->read(data_size, &master_buffer[0]);
-			master_buffer = cryptography::unprotect_data(&master_buffer[0], bytes_read);
-			master->seek(0, filesystem::file::set);
-			const auto bytes_written = master->write(&master_buffer[0], bytes_read);
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(bytes_read);
+				CheckProgressState(progress);
+			}
 
-			if (0 != bytes_read)
-				ChunkProcessed(bytes_written);
+			// KAA: the end is protected too: a file cut at a frame boundary lacks it, the end frame of another file does not match.
+			write_frame(index, end_frame, 0);
+			destination.commit();
 		}
 
-		std::shared_ptr<FileProgressHandler> UserSessionKeyFileCipher::ISetProgressCallback(std::shared_ptr<FileProgressHandler> handler)
+		// KAA: progress counts bytes of the protected file, it is the size the caller knows.
+		void UserSessionKeyFileCipher::Unprotect(filesystem::file& source, filesystem::file& destination)
 		{
-			cipher_progress.swap(handler);
-			return handler;
+			uint8_t header[header_size] = { 0 };
+			if(ReadFully(source, header_size, header) != header_size)
+				ThrowDamaged(__FUNCTION__);
+			const auto file_chunk_size = static_cast<uint32_t>(LoadLE(header + sizeof(signature) + sizeof(uint32_t), sizeof(uint32_t)));
+			if(( !std::equal(std::begin(signature), std::end(signature), header) ) ||
+				( format_version != LoadLE(header + sizeof(signature), sizeof(uint32_t)) ) ||
+				( 0 == file_chunk_size ) || ( max_chunk_size < file_chunk_size ))
+				ThrowDamaged(__FUNCTION__);
+			const auto file_id = header + header_size - file_id_size;
+
+			std::vector<uint8_t> frame;
+			uint64_t offset = 0;
+			uint64_t unreported = header_size;
+			auto progress = progress_state_t::proceed;
+			for(uint64_t index = 0; ; ++index)
+			{
+				uint8_t length[length_size] = { 0 };
+				if(ReadFully(source, length_size, length) != length_size)
+					ThrowDamaged(__FUNCTION__); // KAA: truncated, the end frame is missing.
+				const auto frame_size = static_cast<size_t>(LoadLE(length, length_size));
+				if(( 0 == frame_size ) || ( prefix_size + file_chunk_size + max_protection_overhead < frame_size ))
+					ThrowDamaged(__FUNCTION__);
+
+				frame.resize(frame_size);
+				if(ReadFully(source, frame_size, &frame[0]) != frame_size)
+					ThrowDamaged(__FUNCTION__);
+				const auto chunk = protection.unprotect(&frame[0], frame_size);
+				if(( chunk.size() < prefix_size ) || ( file_chunk_size < chunk.size() - prefix_size ) ||
+					( !std::equal(file_id, file_id + file_id_size, chunk.begin()) ) || ( index != LoadLE(&chunk[file_id_size], index_size) ))
+					ThrowDamaged(__FUNCTION__); // KAA: frames reordered, or a frame of another file.
+				unreported += length_size + frame_size;
+
+				const auto kind = chunk[file_id_size + index_size];
+				const auto data_size = chunk.size() - prefix_size;
+				if(( end_frame == kind ) && ( 0 == data_size ))
+					break;
+				if(( data_frame != kind ) || ( 0 == data_size ))
+					ThrowDamaged(__FUNCTION__);
+
+				WriteFully(destination, &chunk[prefix_size], data_size);
+				ChunkWritten(offset, &chunk[prefix_size], data_size);
+				offset += data_size;
+
+				if(progress_state_t::quiet != progress)
+					progress = ChunkProcessed(unreported);
+				unreported = 0;
+				CheckProgressState(progress);
+			}
+
+			uint8_t trailing = 0;
+			if(0 != source.read(sizeof(trailing), &trailing))
+				ThrowDamaged(__FUNCTION__);
+			if(progress_state_t::quiet != progress)
+				ChunkProcessed(unreported);
+			destination.commit();
 		}
 
-		progress_state_t UserSessionKeyFileCipher::ChunkProcessed(uint64_t size)
+		void UserSessionKeyFileCipher::ProcessFile(const filesystem::path::file& source_path, const filesystem::path::file& destination_path, void (UserSessionKeyFileCipher::*process)(filesystem::file&, filesystem::file&))
 		{
-			return cipher_progress ? cipher_progress->ChunkProcessed(size) : progress_state_t::quiet;
+			const filesystem::driver::mode sequential_read_only { false };
+			const filesystem::driver::share exclusive_access { false, false };
+			const auto source = filesystem->open_file(source_path, sequential_read_only, exclusive_access);
+
+			const filesystem::driver::create_mode persistent_not_exists;
+			const filesystem::driver::mode sequential_write_only { true, false };
+			const filesystem::driver::permission allow_read_write;
+			auto destination = filesystem->create_file(destination_path, persistent_not_exists, sequential_write_only, exclusive_access, allow_read_write);
+			try
+			{
+				(this->*process)(*source, *destination);
+			}
+			catch(...)
+			{
+				destination.reset();
+				filesystem->remove_file(destination_path); // KAA: incomplete, the source is intact.
+				throw;
+			}
+		}
+
+		// NOTE: the original is kept under a temporary name until the processed file has taken its place, then it is wiped.
+		void UserSessionKeyFileCipher::ProcessInPlace(const filesystem::path::file& path, void (UserSessionKeyFileCipher::*process)(filesystem::file&, filesystem::file&))
+		{
+			const auto processed = filesystem->get_temp_filename(path.get_directory());
+			ProcessFile(path, processed, process);
+
+			filesystem::path::file original;
+			try
+			{
+				original = ReplaceOriginal(*filesystem, path, processed);
+			}
+			catch(...)
+			{
+				filesystem->remove_file(processed); // KAA: the original is in place again.
+				throw;
+			}
+			wiper->wipe_file(original);
 		}
 	}
 }
@@ -1,6 +1,10 @@
 #pragma once
 
-#include "KAA/include/progress_state.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "FileCipher.h"
 
@@ -9,33 +13,56 @@ namespace KAA
 	namespace filesystem
 	{
 		class driver;
+		class file;
+		class wiper;
 	}
 
 	namespace FileSecurity
 	{
-		class FileProgressHandler;
+		// NOTE: transforms data with a secret of the user session; the result of protect is larger than the data, unprotect restores it.
+		struct session_protection_t
+		{
+			std::function<std::vector<uint8_t>(const void* data, size_t size)> protect;
+			std::function<std::vector<uint8_t>(const void* data, size_t size)> unprotect;
+		};
+
+		// RETURNS: data protection of the system bound to the current user.
+		session_protection_t GetUserSessionProtection(void);
 
+		// NOTE: protects the file chunk by chunk, memory use is bounded by the chunk size whatever the size of the file.
+		// Protected file: header (signature, version, chunk size, random identifier of the file), then a frame per chunk: length of the protected chunk,
+		// the protected chunk; an end frame follows the last one. A chunk is protected together with the identifier, its index and the kind of the frame,
+		// so that frames cannot be reordered, taken from another file or cut off at the end.
+		// The key is not used, the secret is kept by the user session. The file is processed into a temporary file which replaces it then, the original is wiped.
 		class UserSessionKeyFileCipher final : public FileCipher
 		{
 		public:
 			explicit UserSessionKeyFileCipher(std::shared_ptr<filesystem::driver>);
+			UserSessionKeyFileCipher(std::shared_ptr<filesystem::driver>, session_protection_t, uint32_t chunk_size);
 			UserSessionKeyFileCipher(const UserSessionKeyFileCipher&) = delete;
 			UserSessionKeyFileCipher(UserSessionKeyFileCipher&&) = delete;
-			~UserSessionKeyFileCipher() = default;
+			~UserSessionKeyFileCipher();
 
 			UserSessionKeyFileCipher& operator = (const UserSessionKeyFileCipher&) = delete;
 			UserSessionKeyFileCipher& operator = (UserSessionKeyFileCipher&&) = delete;
 
 		private:
 			std::shared_ptr<filesystem::driver> filesystem;
-			std::shared_ptr<FileProgressHandler> cipher_progress;
+			const session_protection_t protection;
+			const uint32_t chunk_size;
+			const std::unique_ptr<filesystem::wiper> wiper;
 
 			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
 			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&) override;
 
-			std::shared_ptr<FileProgressHandler> ISetProgressCallback(std::shared_ptr<FileProgressHandler>) override;
+			void IEncryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
+			void IDecryptFile(const filesystem::path::file&, const filesystem::path::file&, const filesystem::path::file&) override;
 
-			progress_state_t ChunkProcessed(uint64_t size);
+			void Protect(filesystem::file& source, filesystem::file& destination);
+			void Unprotect(filesystem::file& source, filesystem::file& destination);
+			// NOTE: the destination is removed unless process has succeeded.
+			void ProcessFile(const filesystem::path::file& source, const filesystem::path::file& destination, void (UserSessionKeyFileCipher::*process)(filesystem::file&, filesystem::file&));
+			void ProcessInPlace(const filesystem::path::file&, void (UserSessionKeyFileCipher::*process)(filesystem::file&, filesystem::file&));
 		};
 	}
 }
@@ -2,6 +2,8 @@
 
 #include "../Common/CommunicatorProgressHandler.h"
 
+#include "CancellationToken.h"
+
 namespace KAA
 {
 	namespace FileSecurity
@@ -20,11 +22,14 @@ namespace KAA
 			return handler;
 		}
 		
+		// NOTE: wiper stops at the chunk the operation has been cancelled at, the caller decides what to do with the rest of the file.
 		progress_state_t WiperProgressDispatcher::ichunk_processed(size_t bytes_processed)
 		{
-			if(nullptr != communicator_progress)
-				return communicator_progress->OperationProgress(bytes_processed);
-			return progress_state_t::quiet;
+			if(nullptr == communicator_progress)
+				return progress_state_t::quiet;
+			const auto state = communicator_progress->OperationProgress(bytes_processed);
+			CheckProgressState(state);
+			return state;
 		}
 	}
 }
@@ -0,0 +1,253 @@
+#include "WorkStealingPool.h"
+
+#include "KAA/include/exception/operation_failure.h"
+
+namespace
+{
+	// KAA: the pool the current thread works for and the kind of the task it runs, if any.
+	thread_local const KAA::FileSecurity::WorkStealingPool* current_pool = nullptr;
+	thread_local size_t current_worker = 0;
+	thread_local bool running_task = false;
+	thread_local KAA::FileSecurity::task_kind_t running_kind = KAA::FileSecurity::task_kind_t::cpu;
+
+	size_t ToIndex(const KAA::FileSecurity::task_kind_t kind)
+	{
+		return static_cast<size_t>(kind);
+	}
+}
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		WorkStealingPool::TaskGroup::TaskGroup() :
+		pending(0)
+		{}
+
+		WorkStealingPool::WorkStealingPool(const concurrency_limits_t limits) :
+		limits(limits),
+		epoch(0),
+		stopping(false)
+		{
+			if(0 == limits.cpu || 0 == limits.io)
+			{
+				constexpr auto source = __FUNCTION__;
+				constexpr auto description = "unable to create work stealing pool class instance";
+				constexpr auto reason = operation_failure::status_code_t::invalid_argument;
+				constexpr auto severity = operation_failure::severity_t::error;
+				throw operation_failure(source, description, reason, severity);
+			}
+
+			running[ToIndex(task_kind_t::cpu)] = 0;
+			running[ToIndex(task_kind_t::io)] = 0;
+
+			const size_t worker_count = limits.cpu + limits.io;
+			for(size_t queue = 0; queue <= worker_count; ++queue)
+				queues.push_back(std::make_unique<queue_t>());
+
+			workers.reserve(worker_count);
+			try
+			{
+				for(size_t worker = 0; worker < worker_count; ++worker)
+					workers.emplace_back(&WorkStealingPool::Work, this, worker);
+			}
+			catch(...)
+			{
+				Stop(); // KAA: the destructor does not run for a partially constructed pool.
+				throw;
+			}
+		}
+
+		// NOTE: tasks still queued are dropped, wait for the groups before.
+		WorkStealingPool::~WorkStealingPool()
+		{
+			Stop();
+		}
+
+		concurrency_limits_t WorkStealingPool::GetLimits(void) const
+		{
+			return limits;
+		}
+
+		void WorkStealingPool::Submit(TaskGroup& group, const task_kind_t kind, std::function<void(void)> work)
+		{
+			++group.pending;
+			{
+				auto& queue = *queues[GetCurrentQueue()];
+				std::lock_guard<std::mutex> lock(queue.guard);
+				queue.tasks.push_back(task_t { &group, kind, std::move(work) });
+			}
+			AdvanceEpoch();
+		}
+
+		// NOTE: the slot of the task calling Wait is given up meanwhile, otherwise tasks waiting for subtasks of their own kind could take every slot.
+		void WorkStealingPool::Wait(TaskGroup& group)
+		{
+			const bool nested = running_task && this == current_pool;
+			const auto kind = running_kind;
+			if(nested)
+				Release(kind);
+
+			while(0 != group.pending)
+			{
+				const auto seen = GetEpoch();
+				if(RunTask(GetCurrentQueue(), &group))
+					continue;
+				WaitForEpoch(seen, [&group] { return 0 == group.pending; });
+			}
+
+			// KAA: the limit may be exceeded for a while, the waiting task has to continue anyway.
+			if(nested)
+				++running[ToIndex(kind)];
+
+			std::exception_ptr failure;
+			{
+				std::lock_guard<std::mutex> lock(group.failure_guard);
+				std::swap(failure, group.failure);
+			}
+			if(failure)
+				std::rethrow_exception(failure);
+		}
+
+		void WorkStealingPool::Work(const size_t worker)
+		{
+			current_pool = this;
+			current_worker = worker;
+			for(;;)
+			{
+				const auto seen = GetEpoch();
+				if(RunTask(worker, nullptr))
+					continue;
+				{
+					std::lock_guard<std::mutex> lock(state_guard);
+					if(stopping)
+						return;
+				}
+				WaitForEpoch(seen, [this] { return stopping; });
+			}
+		}
+
+		void WorkStealingPool::Stop(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(state_guard);
+				stopping = true;
+			}
+			state_changed.notify_all();
+			for(auto& worker : workers)
+				worker.join();
+		}
+
+		bool WorkStealingPool::RunTask(const size_t queue, const TaskGroup* filter)
+		{
+			task_t task;
+			if(!TakeTask(queue, filter, task))
+				return false;
+
+			const auto outer_running = running_task;
+			const auto outer_kind = running_kind;
+			running_task = true;
+			running_kind = task.kind;
+			try
+			{
+				task.work();
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> lock(task.group->failure_guard);
+				if(!task.group->failure)
+					task.group->failure = std::current_exception();
+			}
+			running_task = outer_running;
+			running_kind = outer_kind;
+
+			Release(task.kind);
+			--task.group->pending;
+			AdvanceEpoch();
+			return true;
+		}
+
+		// NOTE: the own queue is taken from the back, the others are stolen from the front; tasks of a kind at its limit are skipped.
+		bool WorkStealingPool::TakeTask(const size_t queue, const TaskGroup* filter, task_t& task)
+		{
+			const auto matches = [this, filter] (const task_t& candidate)
+			{
+				return ( nullptr == filter || filter == candidate.group ) && TryAcquire(candidate.kind);
+			};
+
+			{
+				auto& own = *queues[queue];
+				std::lock_guard<std::mutex> lock(own.guard);
+				for(auto candidate = own.tasks.rbegin(); candidate != own.tasks.rend(); ++candidate)
+				{
+					if(matches(*candidate))
+					{
+						task = std::move(*candidate);
+						own.tasks.erase(std::next(candidate).base());
+						return true;
+					}
+				}
+			}
+
+			for(size_t offset = 1; offset < queues.size(); ++offset)
+			{
+				auto& victim = *queues[( queue + offset ) % queues.size()];
+				std::lock_guard<std::mutex> lock(victim.guard);
+				for(auto candidate = victim.tasks.begin(); candidate != victim.tasks.end(); ++candidate)
+				{
+					if(matches(*candidate))
+					{
+						task = std::move(*candidate);
+						victim.tasks.erase(candidate);
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		bool WorkStealingPool::TryAcquire(const task_kind_t kind)
+		{
+			const auto limit = task_kind_t::cpu == kind ? limits.cpu : limits.io;
+			auto& counter = running[ToIndex(kind)];
+			auto value = counter.load();
+			while(value < limit)
+			{
+				if(counter.compare_exchange_weak(value, value + 1))
+					return true;
+			}
+			return false;
+		}
+
+		void WorkStealingPool::Release(const task_kind_t kind)
+		{
+			--running[ToIndex(kind)];
+		}
+
+		uint64_t WorkStealingPool::GetEpoch(void)
+		{
+			std::lock_guard<std::mutex> lock(state_guard);
+			return epoch;
+		}
+
+		void WorkStealingPool::AdvanceEpoch(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(state_guard);
+				++epoch;
+			}
+			state_changed.notify_all();
+		}
+
+		void WorkStealingPool::WaitForEpoch(const uint64_t seen, const std::function<bool(void)>& done)
+		{
+			std::unique_lock<std::mutex> lock(state_guard);
+			state_changed.wait(lock, [this, seen, &done] { return seen != epoch || done(); });
+		}
+
+		size_t WorkStealingPool::GetCurrentQueue(void) const
+		{
+			return this == current_pool ? current_worker : queues.size() - 1;
+		}
+	}
+}
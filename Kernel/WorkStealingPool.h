@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace KAA
+{
+	namespace FileSecurity
+	{
+		// NOTE: kind of work a task mostly does, each kind has a concurrency limit of its own.
+		enum class task_kind_t
+		{
+			cpu,
+			io
+		};
+
+		struct concurrency_limits_t
+		{
+			unsigned cpu; // NOTE: tasks computing at once, processor cores.
+			unsigned io; // NOTE: tasks waiting for the disk at once, requests in flight.
+		};
+
+		// NOTE: every worker has a deque of its own: tasks submitted by a worker go to its back and it takes them from there (the most recent first),
+		// an idle worker steals from the front of the others (the oldest, usually the largest pieces of work).
+		// A task is taken only while fewer tasks of its kind than the limit are running. A thread waiting for a group runs tasks of that group meanwhile.
+		class WorkStealingPool final
+		{
+		public:
+			// NOTE: tasks waited for together, the first failure of them is rethrown by Wait.
+			class TaskGroup final
+			{
+			public:
+				TaskGroup();
+				TaskGroup(const TaskGroup&) = delete;
+				TaskGroup(TaskGroup&&) = delete;
+				~TaskGroup() = default;
+
+				TaskGroup& operator = (const TaskGroup&) = delete;
+				TaskGroup& operator = (TaskGroup&&) = delete;
+
+			private:
+				friend class WorkStealingPool;
+
+				std::atomic<size_t> pending;
+				std::mutex failure_guard;
+				std::exception_ptr failure;
+			};
+
+			explicit WorkStealingPool(concurrency_limits_t);
+			WorkStealingPool(const WorkStealingPool&) = delete;
+			WorkStealingPool(WorkStealingPool&&) = delete;
+			~WorkStealingPool();
+
+			WorkStealingPool& operator = (const WorkStealingPool&) = delete;
+			WorkStealingPool& operator = (WorkStealingPool&&) = delete;
+
+			concurrency_limits_t GetLimits(void) const;
+
+			void Submit(TaskGroup&, task_kind_t, std::function<void(void)>);
+			void Wait(TaskGroup&);
+
+		private:
+			struct task_t
+			{
+				TaskGroup* group;
+				task_kind_t kind;
+				std::function<void(void)> work;
+			};
+
+			struct queue_t
+			{
+				std::mutex guard;
+				std::deque<task_t> tasks;
+			};
+
+			const concurrency_limits_t limits;
+			std::vector<std::unique_ptr<queue_t>> queues; // KAA: one per worker and the last one for other threads.
+			std::atomic<unsigned> running[2];
+
+			std::mutex state_guard;
+			std::condition_variable state_changed;
+			uint64_t epoch; // KAA: advanced whenever a task is queued or finished, idle threads sleep until it changes.
+			bool stopping;
+
+			std::vector<std::thread> workers;
+
+			void Work(size_t worker);
+			// NOTE: joins the workers started so far.
+			void Stop(void);
+			bool RunTask(size_t queue, const TaskGroup* filter);
+			bool TakeTask(size_t queue, const TaskGroup* filter, task_t& task);
+			bool TryAcquire(task_kind_t);
+			void Release(task_kind_t);
+			uint64_t GetEpoch(void);
+			void AdvanceEpoch(void);
+			void WaitForEpoch(uint64_t seen, const std::function<bool(void)>& done);
+			size_t GetCurrentQueue(void) const;
+		};
+	}
+}
@@ -16,6 +16,7 @@
 #define IDS_WIPING_FILE                 10011
 #define IDS_STRING10012                 10012
 #define IDS_REMOVING_BACKUP             10012
+#define IDS_BACKUP_NOT_RESTORED         10013
 
 // Next default values for new objects
 // 